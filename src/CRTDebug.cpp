@@ -20,6 +20,22 @@
 ***************************************************************************/
 
 #include "CRTDebug.h"
+#include "CRTDebugBuffer.h"
+#include "CRTDebugArena.h"
+#include "CRTDebugSink.h"
+#include "CRTDebugBlockFile.h"
+#include "CRTDebugColumns.h"
+#include "CRTDebugUring.h"
+#include "CRTDebugPerCPU.h"
+#include "CRTDebugModules.h"
+#include "CRTDebugLookback.h"
+#include "CRTDebugBacktrace.h"
+#include "CRTDebugCounters.h"
+#include "CRTDebugVolume.h"
+#include "CRTDebugProfile.h"
+#include "CRTDebugInstrument.h"
+#include "CRTDebugAsync.h"
+#include "CRTDebugBatch.h"
 
 #ifndef _GNU_SOURCE
 #define _GNU_SOURCE
@@ -30,6 +46,13 @@
 #include <cstdlib>
 #include <cstring>
 #include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include <iostream>
 #include <algorithm>
 #include <iomanip>
@@ -38,40 +61,20 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <sys/time.h>
+#include <time.h>
+#include <fnmatch.h>
 
 #include "config.h"
 
-#if defined(HAVE_VASPRINTF)
-#if defined(_WIN32)
-#ifndef _vscprintf
-/* For some reason, MSVC fails to honour this #ifndef. */
-/* Hence function renamed to _vscprintf_so(). */
-int _vscprintf_so(const char * format, va_list pargs) {
-    int retval;
-    va_list argcopy;
-    va_copy(argcopy, pargs);
-    retval = vsnprintf(NULL, 0, format, argcopy);
-    va_end(argcopy);
-    return retval;}
-#endif // _vscprintf
-#ifndef vasprintf
-int vasprintf(char **strp, const char *fmt, va_list ap) {
-    int len = _vscprintf_so(fmt, ap);
-    if (len == -1) return -1;
-    char *str = (char *)malloc((size_t) len + 1);
-    if (!str) return -1;
-    int r = vsnprintf(str, len + 1, fmt, ap); /* "secure" version of vsprintf */
-    if (r == -1) return free(str), -1;
-    *strp = str;
-    return r;}
-#endif // vasprintf
-#endif
-#endif
-
 #if defined(HAVE_LIBPTHREAD)
 #include <pthread.h>
 #endif
 
+#if defined(HAVE_MEMBARRIER)
+#include <sys/syscall.h>
+#include <linux/membarrier.h>
+#endif
+
 // define variables for using ANSI colors in our debugging scheme
 #define ANSI_ESC_CLR        "\033[0m"
 #define ANSI_ESC_BOLD       "\033[1m"
@@ -114,9 +117,14 @@ int vasprintf(char **strp, const char *fmt, va_list ap) {
 #define DBC_ERROR_COLOR     ANSI_ESC_FG_RED
 #define DBC_WARNING_COLOR   ANSI_ESC_FG_YELLOW
 
-#define PROCESS_ID          m_pData->m_PID
 #define PROCESS_WIDTH       5
-#define PROCESS_PREFIX      std::setw(PROCESS_WIDTH) << std::setfill(' ') << std::dec << PROCESS_ID
+
+// the default layout of the record header
+#if defined(HAVE_LIBPTHREAD)
+#define DEFAULT_LAYOUT      "%{green}[%T] %{yellow}%P.%t: %s%i%{class}%f:%l:%m"
+#else
+#define DEFAULT_LAYOUT      "%{green}[%T] %{yellow}%P: %s%i%{class}%f:%l:%m"
+#endif
 
 #if defined(HAVE_GETTIMEOFDAY)
 #define GET_TIMEINFO(tp) \
@@ -140,64 +148,223 @@ int vasprintf(char **strp, const char *fmt, va_list ap) {
   #error "no matching localtime() function"
 #endif
 
-#if defined(HAVE_STRFTIME)
-#define GET_TIMESTR(tp) \
-  time_t tt_time = (tp)->tv_sec + ((tp)->tv_usec/MICROSEC); \
-  struct tm tm_time; \
-  LOCALTIME(&tm_time, &tt_time); \
-  char fmtTime[20]; \
-  { \
-    char fmtBuf[10]; \
-    strftime(fmtBuf, sizeof(fmtBuf), "%T", &tm_time); \
-    snprintf(fmtTime, sizeof(fmtTime), "%s.%06ld", fmtBuf, (tp)->tv_usec); \
-  }
-#define TIME_PREFIX       "[" << fmtTime << "] "
-#define TIME_PREFIX_COLOR ANSI_ESC_FG_GREEN << TIME_PREFIX
-#else
-#define GET_TIMESTR(tp) (void(0))
-#define TIME_PREFIX
-#define TIME_PREFIX_COLOR
-#endif
-
 #define UPDATE_TIMEINFO \
   struct timeval newtp; \
-  GET_TIMEINFO(&newtp); \
-  GET_TIMESTR(&newtp)
+  GET_TIMEINFO(&newtp)
 
-// some often used macros to output the thread number at the beginning of each
-// debug output so that we know from which thread this output came.
+// some often used macros to sync the output of different threads and to
+// output the thread number at the beginning of each debug output so that we
+// know from which thread this output came.
 #if defined(HAVE_LIBPTHREAD)
 
-#define THREAD_TYPE         pthread_self()
-#define THREAD_ID           m_pData->m_ThreadID[THREAD_TYPE]
 #define THREAD_WIDTH        2
-#define THREAD_PREFIX       PROCESS_PREFIX << "." << std::setw(THREAD_WIDTH) << std::setfill('0') << std::dec << THREAD_ID << ": "
-#define THREAD_PREFIX_COLOR ANSI_ESC_FG_YELLOW << PROCESS_PREFIX << "." << ANSI_ESC_BG << std::dec << THREAD_ID%6 << "m" << \
-                            std::setw(THREAD_WIDTH) << std::setfill('0') << std::dec << THREAD_ID << ANSI_ESC_CLR << ": "
-#define THREAD_ID_CHECK     if(m_pData->m_ThreadID[THREAD_TYPE] == 0)\
-                              m_pData->m_ThreadID[THREAD_TYPE] = ++(m_pData->m_iThreadCount)
-#define INDENT_OUTPUT       std::string(m_pData->m_IdentLevel[THREAD_TYPE], ' ')
-#define LOCK_OUTPUTSTREAM   pthread_mutex_lock(&(m_pData->m_pCoutMutex))
-#define UNLOCK_OUTPUTSTREAM pthread_mutex_unlock(&(m_pData->m_pCoutMutex))
+#define LOCK_OUTPUTSTREAM   m_pData->lockOutput()
+#define UNLOCK_OUTPUTSTREAM m_pData->unlockOutput()
+
+// the output of debug records doesn't need the lock with per-CPU buffers
+#define LOCK_RECORD         m_pData->lockRecord()
+#define UNLOCK_RECORD       m_pData->unlockRecord()
 
 #else
 
-#define THREAD_TYPE         0
-#define THREAD_PREFIX       PROCESS_PREFIX << ": "
-#define THREAD_PREFIX_COLOR THREAD_PREFIX
-#define THREAD_ID_CHECK     (void(0))
-#define INDENT_OUTPUT       std::string(m_pData->m_IdentLevel[THREAD_TYPE], ' ')
 #define LOCK_OUTPUTSTREAM   (void(0))
 #define UNLOCK_OUTPUTSTREAM (void(0))
+#define LOCK_RECORD         (void(0))
+#define UNLOCK_RECORD       (void(0))
 
 #warning "no pthread library found/supported. librtdebug is compiled without being thread-safe!"
 #endif
 
+// the per-thread buffer in which each output record is assembled before it
+// is written with a single write() call.
+#define RECORD_BUFFER       recordBuffer
+
+// the per-thread buffer SHOWVALUE() formats its values into before the
+// record is locked. Used like a stack, as the formatter of a user type may
+// again use SHOWVALUE().
+#define VALUE_BUFFER        valueBuffer
+
 // define how MICRO and MILLI are related to normal
 #define MILLISEC 1000L    // 10^-3
 #define MICROSEC 1000000L // 10^-6
 
-#define STRINGSIZE 10000
+// functions whose stack frames are skipped in backtraces must not be inlined
+#if defined(__GNUC__)
+#define NOINLINE __attribute__((noinline))
+#else
+#define NOINLINE
+#endif
+
+// the default time window in which repeated identical records are coalesced
+#define COALESCE_TIME 1000 // ms
+
+// the default number of suppressed records kept per thread
+#define LOOKBACK_RECORDS 32
+
+// the default interval of the counter reports
+#define COUNTER_INTERVAL 10 // s
+
+// the default file of the call and timer profile
+#define PROFILE_FILE "rtdebug.prof"
+
+// the default path prefix of the per-thread files
+#define PERTHREAD_PREFIX "trace"
+
+// the default number of entries of the volume report
+#define VOLUME_TOP 10
+
+// the interval in which the per-CPU buffers are collected
+#define PERCPU_INTERVAL 100 // ms
+
+// the time of day and date of a record header, which are only formatted
+// once per second
+struct CRTDebugTimeCache
+{
+  time_t  second;   //!< the second of the formatted time
+  char    time[12]; //!< the formatted time of day
+  char    date[12]; //!< the formatted date
+};
+
+// the per-thread data of the debugging framework. Each thread which outputs
+// something automatically registers such a structure with the instance.
+class CRTDebugThread
+{
+  public:
+    CRTDebugThread();
+    ~CRTDebugThread();
+
+  public:
+    CRTDebugPrivate*    m_pOwner;           //!< the instance the thread is registered at
+    unsigned int        m_iThreadID;        //!< thread identification number
+    unsigned int        m_iIdentLevel;      //!< ident level of the thread
+    struct timeval      m_TimeMeasure;      //!< start time of the last STARTCLOCK()
+
+    // the record currently assembled
+    const char*         m_pFile;            //!< source file of the record
+    long                m_iLine;            //!< source line of the record
+    const char*         m_pHighlight;       //!< color of the record
+    const char*         m_pFunction;        //!< function of ENTER()/LEAVE() records
+    const char*         m_pFormat;          //!< format string of D()/E()/W() records
+    size_t              m_iHeaderLength;    //!< length of the record header
+
+    // coalescing of repeated records
+    std::string         m_sLastRecord;      //!< message text of the last record
+    const char*         m_pLastFile;        //!< source file of the last record
+    long                m_iLastLine;        //!< source line of the last record
+    int                 m_iLastClass;       //!< debug class of the last record
+    const char*         m_pLastHighlight;   //!< color of the last record
+    unsigned int        m_iRepeatCount;     //!< number of suppressed repeats
+    struct timeval      m_WindowStart;      //!< time the coalescing window started
+    struct timeval      m_RepeatStart;      //!< time of the first suppressed repeat
+    struct timeval      m_RepeatLast;       //!< time of the last suppressed repeat
+    CRTDebugBuffer      m_SummaryBuffer;    //!< buffer for the repeat summary
+
+    // thread scoping
+    unsigned int        m_iScopeGeneration; //!< scope rules the masks were calculated for
+    unsigned int        m_iScopeClasses;    //!< classes enabled for the thread
+    unsigned int        m_iScopeModuleClasses; //!< classes enabled for certain modules only
+    std::vector<std::pair<unsigned int, const CRTDebugModuleNode*> > m_ScopeModules; //!< module specific classes
+
+    // lookback of suppressed records
+    CRTDebugLookback*   m_pLookback;        //!< the suppressed records of the thread
+
+    // output volume accounting
+    CRTDebugVolume      m_Volume;           //!< the output volume per call site
+
+    // call and timer profiling
+    CRTDebugProfile     m_Profile;          //!< the durations of functions and timers
+
+    // self-overhead accounting (all times in ns)
+    unsigned long long  m_iOverheadStart;   //!< time the accounting started for the thread
+    unsigned long long  m_iLockStart;       //!< time the output lock was acquired
+    unsigned long long  m_iLockWait;        //!< time spent waiting for the output lock
+    unsigned long long  m_iLockHold;        //!< time the output lock was held
+    unsigned long long  m_iIOTime;          //!< time spent writing to the output sink
+    unsigned long long  m_iRecords;         //!< number of output records
+    unsigned long long  m_iBytes;           //!< number of output bytes
+
+    // per-CPU buffers and per-thread files
+    bool                m_bUnlocked;        //!< the record is output without the output lock
+    CRTDebugSink*       m_pThreadOutput;    //!< the own output file of the thread or NULL
+    bool                m_bThreadOutputFailed; //!< the own output file couldn't be opened
+
+    // logical trace contexts
+    std::string         m_sName;            //!< the name of a context for the thread scopes
+    std::atomic<unsigned int> m_iReferences; //!< creator and threads switched to the context
+
+    // cross-thread flow correlation
+    unsigned long long  m_iSpan;            //!< the span attached to the thread or context
+    unsigned long long  m_iLastSpan;        //!< span of the last record
+
+    // the time of day is only formatted once per second
+    CRTDebugTimeCache   m_TimeCache;        //!< the formatted time of the last record
+};
+
+// a line layout compiled from a pattern like "%T %P.%t %i%f:%l:%m". The
+// header (everything before %m) is compiled into a flat list of render
+// operations, once with and once without highlighting. All constant text
+// and ANSI color escapes are merged into literal segments, so rendering a
+// header only has to handle the fields actually used.
+class CRTDebugLayout
+{
+  public:
+    enum Type
+    {
+      LITERAL,    //!< constant text
+      TIME,       //!< %T time of day with microseconds
+      DATE,       //!< %D date
+      PID,        //!< %P process ID
+      THREAD,     //!< %t rtdebug thread ID
+      INDENT,     //!< %i indention of the thread
+      FILE,       //!< %f source file name
+      PATH,       //!< %F source file path
+      LINE,       //!< %l source line
+      SPAN,       //!< %s attached span
+      SEQUENCE,   //!< %n record sequence number
+      COLOR       //!< %{class} color of the record
+    };
+
+    struct Op
+    {
+      Type    type;     //!< what to render
+      size_t  offset;   //!< offset of a literal
+      size_t  length;   //!< length of a literal
+    };
+
+    bool compile(const char* pattern);
+
+  private:
+    void addLiteral(const int highlight, const char* text, const size_t len);
+    void addOp(const int highlight, const Type type);
+
+  public:
+    std::string       m_sPattern;       //!< the source pattern
+    std::string       m_sLiterals[2];   //!< constant text without/with highlighting
+    std::vector<Op>   m_Header[2];      //!< header ops without/with highlighting
+    std::string       m_sTrailer[2];    //!< constant text following the message
+    bool              m_bTime;          //!< the local time has to be determined
+};
+
+// the self-overhead of a terminated thread
+struct CRTDebugOverhead
+{
+  unsigned int        threadID;     //!< the rtdebug thread ID
+  unsigned long long  wall;         //!< time between the first record and the end
+  unsigned long long  lockWait;     //!< time spent waiting for the output lock
+  unsigned long long  lockHold;     //!< time the output lock was held
+  unsigned long long  io;           //!< time spent writing to the output sink
+  unsigned long long  records;      //!< number of output records
+  unsigned long long  bytes;        //!< number of output bytes
+};
+
+// a rule enabling debug classes for certain threads only
+struct CRTDebugThreadScope
+{
+  unsigned int              threadID;     //!< the thread ID or 0
+  std::string               pattern;      //!< the thread name pattern if no ID
+  unsigned int              classes;      //!< the enabled debug classes
+  const CRTDebugModuleNode* module;       //!< the module the classes are limited to or NULL
+};
 
 // we define the private inline class of that one so that we
 // are able to hide the private methods & data of that class in the
@@ -206,32 +373,458 @@ class CRTDebugPrivate
 {
   // methods
   public:
-    bool matchDebugSpec(const int cl, const char* module, const char* file);
+    bool matchDebugSpec(const int cl, const CRTDebugModule* module, const char* file);
     bool matchInfoSpec(const int cl, const char* module, const char* file);
+    bool matchThreadScope(const int cl, const CRTDebugModule* module);
+    void updateThreadScope(CRTDebugThread* thread);
+    void addThreadScope(const CRTDebugThreadScope& scope);
+    NOINLINE void lookback(const int cl, const char* file, const long line, const char* fmt, ...);
+    NOINLINE void lookbackValue(const int cl, const char* file, const long line, const CRTDebugRawValue* value, const char* fmt, ...);
+    NOINLINE void vlookback(const int cl, const char* file, const long line, const char* fmt, va_list args, const int skip=0, const CRTDebugRawValue* value=NULL);
+    NOINLINE void appendBacktrace(CRTDebugBuffer& buf, const int skip);
+    void reportCounters();
+    void reportVolume();
+    void reportOverhead();
+    void reportOverload();
+    CRTDebugThread* profileThread();
+    bool writeProfile(const char* filename);
+    CRTDebugSink* asyncSink(CRTDebugSink* sink, const size_t size, const unsigned int maxWait);
+    CRTDebugSink* releaseAsync();
+    CRTDebugSink* batchSink(CRTDebugSink* sink);
+    void lockOutput();
+    void unlockOutput();
+    void lockRecord();
+    void unlockRecord();
+    void output(const CRTDebugRecordInfo& info, const char* data, const size_t len);
+    CRTDebugSink* threadOutput(const unsigned long long time);
+    void collectThread();
+    void stopCollectThread();
+    CRTDebugOverhead threadOverhead(const CRTDebugThread* thread, const unsigned long long now);
+    void reportThread();
+    void startReportThread();
+    void stopReportThread();
+    void flushExpiredRepeats();
+    void dumpLookback(CRTDebugThread* thread, const unsigned long long span);
+    CRTDebugThread* currentThread();
+    void registerThread(CRTDebugThread* thread);
+    void removeThread(CRTDebugThread* thread);
+    void appendHeader(CRTDebugBuffer& buf, CRTDebugThread* thread, const struct timeval* tp, const char* highlight, const char* file, const long line, const int ident=-1);
+    void formatHeader(CRTDebugBuffer& buf, CRTDebugTimeCache& cache, const unsigned int threadID, const struct timeval* tp, const char* highlight, const char* file, const long line, const int ident, const unsigned long long span);
+    void finishRecord(CRTDebugBuffer& buf, const bool newline);
+    NOINLINE void writeRecord(CRTDebugBuffer& buf, CRTDebugThread* thread, const int cl, const CRTDebugModule* module, const struct timeval* tp, const bool newline);
+    bool coalesceRecord(CRTDebugBuffer& buf, CRTDebugThread* thread, const int cl, const struct timeval* tp);
+    void flushRepeats(CRTDebugThread* thread);
+    void flushOutput();
 
   // data
   public:
     pid_t m_PID;                              //!< process identification number
-    std::map<pthread_t, unsigned int>   m_ThreadID;           //!< thread identification number
-    std::map<pthread_t, unsigned int>   m_IdentLevel;         //!< different ident levels for different threads
-    std::map<pthread_t, struct timeval> m_TimeMeasure;        //!< for measuring the time we need more structs
+    std::set<CRTDebugThread*>           m_Threads;            //!< the data of all known threads
     bool                                m_bHighlighting;      //!< text ANSI highlighting?
     bool                                m_bDebugMode;         //!< is compile-time debugging enabled
+    bool                                m_bDormant;           //!< the instance left by destroy() ignoring all calls
     unsigned int                        m_iDebugClasses;      //!< the currently active debug classes
-    std::map<std::string, bool>         m_DebugModules;       //!< to map actual specified debug modules
+    CRTDebugModuleTree*                 m_pDebugModules;      //!< the hierarchical debug module namespace
+    std::string                         m_sDebugModules;      //!< the last returned debug module spec
     std::map<std::string, bool>         m_DebugFiles;         //!< to map actual specified source file names*/
     unsigned int                        m_iDebugFlags;        //!< the currently active debug flags
     unsigned int                        m_iInfoClasses;       //!< the currently active debug classes
-    std::map<std::string, bool>         m_InfoModules;        //!< to map actual specified debug modules
+    CRTDebugModuleTree                  m_InfoModules;        //!< the hierarchical info module namespace
+    std::string                         m_sInfoModules;       //!< the last returned info module spec
     std::map<std::string, bool>         m_InfoFiles;          //!< to map actual specified source file names*/
     unsigned int                        m_iInfoFlags;         //!< the currently active debug flags
     unsigned int                        m_iThreadCount;       //!< counter of total number of threads processing
+    CRTDebugSink*                       m_pOutput;            //!< the sink all debug records are written to
+    unsigned int                        m_iCoalesceTime;      //!< time window for coalescing repeated records (ms)
+    std::vector<CRTDebugThreadScope>    m_ThreadScopes;       //!< the per-thread scope rules
+    std::atomic<unsigned int>           m_iScopeGeneration;   //!< generation of the scope rules (0 = none)
+    unsigned int                        m_iScopeCounter;      //!< last used scope generation
+    unsigned int                        m_iLookbackClasses;   //!< classes kept in the lookback buffers
+    unsigned int                        m_iLookbackSize;      //!< records kept per thread
+    bool                                m_bLookbackAllThreads; //!< output the lookback of all threads
+    unsigned int                        m_iBacktraceClasses;  //!< debug classes with a backtrace
+    unsigned int                        m_iBacktraceInfoClasses; //!< info classes with a backtrace
+    bool                                m_bBacktraceDeferred; //!< capture backtraces of suppressed records
+    std::vector<long long>              m_LastCounts;         //!< counter values of the last report
+    struct timeval                      m_LastCounterReport;  //!< time of the last counter report
+    unsigned int                        m_iVolumeTop;         //!< entries of the volume report (0 = no accounting)
+    CRTDebugVolume                      m_RetiredVolume;      //!< output volume of terminated threads
+    std::map<unsigned int, CRTDebugVolumeCount> m_RetiredThreads; //!< total volume of terminated threads
+    std::map<std::string, CRTDebugVolumeCount>  m_LastVolume; //!< volume of the last report
+    struct timeval                      m_LastVolumeReport;   //!< time of the last volume report
+    std::atomic<bool>                   m_bOverhead;          //!< measure the own overhead of every thread
+    std::vector<CRTDebugOverhead>       m_RetiredOverhead;    //!< overhead of terminated threads
+    bool                                m_bProfile;           //!< profile the functions and timers
+    std::string                         m_sProfileFile;       //!< the file the profile is written to
+    CRTDebugProfile                     m_RetiredProfile;     //!< profile of terminated threads
+    std::atomic<CRTDebugLayout*>        m_pLayout;            //!< the compiled record layout
+    std::vector<CRTDebugLayout*>        m_RetiredLayouts;     //!< replaced layouts freed at destroy()
+    CRTDebugPerCPU*                     m_pPerCPU;            //!< per-CPU record buffers or NULL
+    bool                                m_bPerThread;         //!< every thread writes to its own file
+    std::string                         m_sPerThreadPrefix;   //!< prefix of the per-thread files
+    unsigned int                        m_iEpoch;             //!< number of the instance within the process
+    CRTDebugAsyncSink*                  m_pAsync;             //!< the asynchronous output or NULL
+    unsigned long long                  m_RetiredRecords[ASYNC_CLASSES]; //!< records of replaced asynchronous outputs
+    unsigned long long                  m_RetiredDropped[ASYNC_CLASSES]; //!< losses of replaced asynchronous outputs
+    CRTDebugBatchSink*                  m_pBatch;             //!< the batching of the output or NULL
+    size_t                              m_iBatchSize;         //!< byte threshold of a batch (0 = no batching)
+    unsigned int                        m_iBatchDelay;        //!< maximum delay of a batched record (ms)
+    unsigned int                        m_iBatchClasses;      //!< classes flushing the batch immediately
+    CRTDebugOverloadPolicy              m_Overload[ASYNC_CLASSES]; //!< overload policy per class bit
+    std::atomic<unsigned long long>     m_iSequence;          //!< sequence number of the next record
+    std::thread                         m_CollectThread;      //!< thread collecting the per-CPU buffers
+    std::mutex                          m_CollectMutex;       //!< protects the collect thread state
+    std::condition_variable             m_CollectCond;        //!< wakes up the collect thread
+    bool                                m_bCollectQuit;       //!< ask the collect thread to terminate
+    unsigned int                        m_iReportInterval;    //!< seconds between periodic reports
+    std::thread                         m_ReportThread;       //!< thread outputting the periodic reports
+    std::mutex                          m_ReportMutex;        //!< protects the report thread state
+    std::condition_variable             m_ReportCond;         //!< wakes up the report thread
+    bool                                m_bReportQuit;        //!< ask the report thread to terminate
 
     #if defined(HAVE_LIBPTHREAD)
     pthread_mutex_t                     m_pCoutMutex;         //!< a mutex to sync cout output
     #endif
 };
 
+// the names of the debug classes as used in the environment variables
+static const struct { const char* token; const unsigned int flag; } dbclasses[] =
+{
+  { "ctrace", DBC_CTRACE  },
+  { "report", DBC_REPORT  },
+  { "assert", DBC_ASSERT  },
+  { "timeval",DBC_TIMEVAL },
+  { "debug",  DBC_DEBUG   },
+  { "error",  DBC_ERROR   },
+  { "warning",DBC_WARNING },
+  { "all",    DBC_ALL     },
+  { NULL,     0           }
+};
+
+// parses a list of "+" separated debug class names
+static unsigned int parseClasses(const char* spec)
+{
+  unsigned int classes = 0;
+
+  for(const char* c = spec; *c; )
+  {
+    for(int i=0; dbclasses[i].token; i++)
+    {
+      if(strncasecmp(c, dbclasses[i].token, strlen(dbclasses[i].token)) == 0)
+        classes |= dbclasses[i].flag;
+    }
+
+    if((c = strpbrk(c, "+ ,;")) == NULL || *c != '+')
+      break;
+
+    c++;
+  }
+
+  return classes;
+}
+
+// returns the highlight color of a debug class
+static const char* classColor(const int cl)
+{
+  switch(cl)
+  {
+    case DBC_CTRACE:  return DBC_CTRACE_COLOR;
+    case DBC_REPORT:  return DBC_REPORT_COLOR;
+    case DBC_ASSERT:  return DBC_ASSERT_COLOR;
+    case DBC_TIMEVAL: return DBC_TIMEVAL_COLOR;
+    case DBC_DEBUG:   return DBC_DEBUG_COLOR;
+    case DBC_ERROR:   return DBC_ERROR_COLOR;
+    case DBC_WARNING: return DBC_WARNING_COLOR;
+  }
+
+  return ANSI_ESC_FG_WHITE;
+}
+
+// the names of the colors usable in layout patterns
+static const struct { const char* name; const char* escape; } layoutColors[] =
+{
+  { "reset",    ANSI_ESC_CLR        },
+  { "bold",     ANSI_ESC_BOLD       },
+  { "underline",ANSI_ESC_UNDERLINE  },
+  { "black",    ANSI_ESC_FG_BLACK   },
+  { "red",      ANSI_ESC_FG_RED     },
+  { "green",    ANSI_ESC_FG_GREEN   },
+  { "brown",    ANSI_ESC_FG_BROWN   },
+  { "blue",     ANSI_ESC_FG_BLUE    },
+  { "purple",   ANSI_ESC_FG_PURPLE  },
+  { "cyan",     ANSI_ESC_FG_CYAN    },
+  { "lgray",    ANSI_ESC_FG_LGRAY   },
+  { "dgray",    ANSI_ESC_FG_DGRAY   },
+  { "lred",     ANSI_ESC_FG_LRED    },
+  { "lgreen",   ANSI_ESC_FG_LGREEN  },
+  { "yellow",   ANSI_ESC_FG_YELLOW  },
+  { "lblue",    ANSI_ESC_FG_LBLUE   },
+  { "lpurple",  ANSI_ESC_FG_LPURPLE },
+  { "lcyan",    ANSI_ESC_FG_LCYAN   },
+  { "white",    ANSI_ESC_FG_WHITE   },
+};
+
+void CRTDebugLayout::addLiteral(const int highlight, const char* text, const size_t len)
+{
+  std::vector<Op>& ops = m_Header[highlight];
+
+  // literals of a layout are stored one after the other, so consecutive
+  // ones can be merged
+  if(ops.empty() == false && ops.back().type == LITERAL)
+    ops.back().length += len;
+  else
+  {
+    Op op = { LITERAL, m_sLiterals[highlight].length(), len };
+    ops.push_back(op);
+  }
+
+  m_sLiterals[highlight].append(text, len);
+}
+
+void CRTDebugLayout::addOp(const int highlight, const Type type)
+{
+  Op op = { type, 0, 0 };
+  m_Header[highlight].push_back(op);
+}
+
+//  Class:       CRTDebugLayout
+//  Method:      compile
+//!
+//! Compiles a layout pattern. Besides the fields %T, %D, %P, %t, %i, %f,
+//! %F, %l, %s, %n and the message %m the pattern may contain "%%" and color
+//! directives like %{green} or %{class} for the color of the record class,
+//! which are only output with highlighting switched on. Only constant text
+//! and colors may follow the message. The span field %s outputs "#<id> "
+//! and nothing at all while no span is attached. The sequence number %n
+//! counts all records, so gaps show dropped (or coalesced) records.
+//!
+//! @param  pattern  the layout pattern
+//! @return          false if the pattern is invalid
+////////////////////////////////////////////////////////////////////////////////
+bool CRTDebugLayout::compile(const char* pattern)
+{
+  bool message = false;
+
+  m_sPattern = pattern;
+  m_bTime = false;
+
+  for(const char* p = pattern; *p != '\0'; p++)
+  {
+    if(*p != '%')
+    {
+      for(int h=0; h < 2; h++)
+      {
+        if(message == true)
+          m_sTrailer[h].append(p, 1);
+        else
+          addLiteral(h, p, 1);
+      }
+      continue;
+    }
+
+    p++;
+
+    if(*p == '{')
+    {
+      const char* end = strchr(p, '}');
+      if(end == NULL)
+        return false;
+
+      std::string name(p+1, end-p-1);
+      p = end;
+
+      if(name == "class")
+      {
+        if(message == true)
+          return false;
+
+        addOp(1, COLOR);
+        continue;
+      }
+
+      size_t i;
+      for(i=0; i < sizeof(layoutColors)/sizeof(layoutColors[0]); i++)
+      {
+        if(strcasecmp(name.c_str(), layoutColors[i].name) == 0)
+          break;
+      }
+
+      if(i == sizeof(layoutColors)/sizeof(layoutColors[0]))
+        return false;
+
+      if(message == true)
+        m_sTrailer[1].append(layoutColors[i].escape);
+      else
+        addLiteral(1, layoutColors[i].escape, strlen(layoutColors[i].escape));
+
+      continue;
+    }
+
+    if(*p == '%')
+    {
+      for(int h=0; h < 2; h++)
+      {
+        if(message == true)
+          m_sTrailer[h].append("%");
+        else
+          addLiteral(h, "%", 1);
+      }
+      continue;
+    }
+
+    if(*p == 'm')
+    {
+      if(message == true)
+        return false;
+
+      message = true;
+      continue;
+    }
+
+    Type type;
+    switch(*p)
+    {
+      case 'T': type = TIME;   m_bTime = true; break;
+      case 'D': type = DATE;   m_bTime = true; break;
+      case 'P': type = PID;    break;
+      case 't': type = THREAD; break;
+      case 'i': type = INDENT; break;
+      case 'f': type = FILE;   break;
+      case 'F': type = PATH;   break;
+      case 'l': type = LINE;   break;
+      case 's': type = SPAN;   break;
+      case 'n': type = SEQUENCE; break;
+      default:  return false;
+    }
+
+    // the fields are only known when the header is output
+    if(message == true)
+      return false;
+
+    addOp(0, type);
+    addOp(1, type);
+  }
+
+  return true;
+}
+
+// releases the call slot of a terminating thread
+struct CRTDebugCallSlotOwner
+{
+  ~CRTDebugCallSlotOwner() { CRTDebugCall::releaseSlot(); }
+};
+
+// defined before threadData so that it is destroyed after it
+static thread_local CRTDebugCallSlotOwner callSlotOwner;
+
+static thread_local CRTDebugBuffer recordBuffer;
+static thread_local CRTDebugBuffer valueBuffer;
+static thread_local CRTDebugThread threadData;
+
+RTDEBUG_THREAD_LOCAL CRTDebugContext* CRTDebug::m_pCurrentContext = NULL;
+
+// the source of the span IDs
+static std::atomic<unsigned long long> spanCounter(1);
+
+// returns the data of the current trace context, which is the calling
+// thread itself as long as no own context was switched to
+static inline CRTDebugThread* contextData()
+{
+  CRTDebugThread* context = CRTDebug::currentContext();
+
+  return context != NULL ? context : &threadData;
+}
+
+// a monotonic time stamp in ns for the overhead accounting
+static inline unsigned long long monotonicTime()
+{
+  #if defined(CLOCK_MONOTONIC)
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec*1000000000ULL + ts.tv_nsec;
+  #else
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec*1000000000ULL + tv.tv_usec*1000ULL;
+  #endif
+}
+
+//  Class:       CRTDebugPrivate
+//  Method:      lockOutput
+//!
+//! Locks the output stream. With the overhead accounting enabled the time
+//! spent waiting for the lock is added to the calling thread.
+////////////////////////////////////////////////////////////////////////////////
+inline void CRTDebugPrivate::lockOutput()
+{
+  #if defined(HAVE_LIBPTHREAD)
+  if(m_bOverhead.load(std::memory_order_relaxed) == false)
+  {
+    pthread_mutex_lock(&m_pCoutMutex);
+    return;
+  }
+
+  CRTDebugThread* thread = &threadData;
+  unsigned long long start = monotonicTime();
+
+  pthread_mutex_lock(&m_pCoutMutex);
+
+  thread->m_iLockStart = monotonicTime();
+  thread->m_iLockWait += thread->m_iLockStart - start;
+  if(thread->m_iOverheadStart == 0)
+    thread->m_iOverheadStart = start;
+  #endif
+}
+
+//  Class:       CRTDebugPrivate
+//  Method:      unlockOutput
+//!
+//! Unlocks the output stream and adds the time the lock was held to the
+//! calling thread.
+////////////////////////////////////////////////////////////////////////////////
+inline void CRTDebugPrivate::unlockOutput()
+{
+  #if defined(HAVE_LIBPTHREAD)
+  CRTDebugThread* thread = &threadData;
+
+  // the accounting might have been enabled while the lock was held
+  if(thread->m_iLockStart != 0)
+  {
+    thread->m_iLockHold += monotonicTime() - thread->m_iLockStart;
+    thread->m_iLockStart = 0;
+  }
+
+  pthread_mutex_unlock(&m_pCoutMutex);
+  #endif
+}
+
+//  Class:       CRTDebugPrivate
+//  Method:      lockRecord
+//!
+//! Locks the output stream for the output of a debug record. With per-CPU
+//! buffers or per-thread files the record is output without taking the lock
+//! at all.
+////////////////////////////////////////////////////////////////////////////////
+inline void CRTDebugPrivate::lockRecord()
+{
+  if(m_pPerCPU != NULL || m_bPerThread == true)
+  {
+    threadData.m_bUnlocked = true;
+    if(m_bOverhead.load(std::memory_order_relaxed) == true && threadData.m_iOverheadStart == 0)
+      threadData.m_iOverheadStart = monotonicTime();
+  }
+  else
+    lockOutput();
+}
+
+inline void CRTDebugPrivate::unlockRecord()
+{
+  if(threadData.m_bUnlocked == true)
+    threadData.m_bUnlocked = false;
+  else
+    unlockOutput();
+}
+
 //!
 //! The following "NameCompare" inlined class is a small helper class to please
 //! the damned STL find_if() method so that we can "easily" do a lowercase
@@ -263,40 +856,199 @@ bool NameCompare::operator()(std::pair<std::string, bool> cur)
   return pos != std::string::npos;
 }
 
+std::atomic<CRTDebug*> CRTDebug::m_pSingletonInstance(NULL);
+CRTDebug* CRTDebug::m_pDormantInstance = NULL;
+RTDEBUG_THREAD_LOCAL CRTDebugCallSlot* CRTDebugCall::m_pCurrentSlot = NULL;
+std::atomic<bool> CRTDebugCall::m_bBarrier(false);
+
+// serializes the creation and destruction of instances
+static std::mutex instanceMutex;
+
+// serializes terminating threads with the instance detaching its threads
+static std::mutex ownerMutex;
+
+// counts the instances created, keeping the per-thread files of each apart
+static std::atomic<unsigned int> instanceEpoch(0);
+
+// the list of all call slots ever allocated
+static std::atomic<CRTDebugCallSlot*> callSlots(NULL);
+
 //  Class:       CRTDebug
-//  Method:      instance
+//  Method:      createInstance
 //!
-//! Return the current instance for the debug class. If no one exists
-//! creates one.
+//! Creates the singleton instance if there is none yet. Concurrent first
+//! calls from several threads all get the same instance.
 //!
-//! @return      pointer to current instance of CRTDebug
+//! @param  revive   also replace the dormant instance left by destroy()
+//! @return          pointer to current instance of CRTDebug
 ////////////////////////////////////////////////////////////////////////////////
-CRTDebug* CRTDebug::m_pSingletonInstance = 0;
-CRTDebug* CRTDebug::instance()
+CRTDebug* CRTDebug::createInstance(const bool revive)
 {
-  if(m_pSingletonInstance == 0)
-    m_pSingletonInstance = new CRTDebug();
+  std::lock_guard<std::mutex> lock(instanceMutex);
 
-  return m_pSingletonInstance;
+  CRTDebug* rtdebug = m_pSingletonInstance.load(std::memory_order_acquire);
+  if(rtdebug == NULL || (revive == true && rtdebug == m_pDormantInstance))
+  {
+    rtdebug = new CRTDebug();
+    m_pSingletonInstance.store(rtdebug, std::memory_order_release);
+  }
+
+  return rtdebug;
 }
 
 //  Class:       CRTDebug
 //  Method:      destroy
 //!
-//! Destroys (free) the singleton object and set the singleton Instance
-//! variable to 0 so that the next call to instance() will create a new
-//! singleton object.
+//! Destroys (free) the singleton object. The instance is first replaced by
+//! a dormant one which silently ignores all calls, then destroy() waits for
+//! all calls still in progress with the old instance (see CRTDebugCall)
+//! before it outputs the final reports and frees it. Thus other threads
+//! may keep on using the debug macros while and after the framework is
+//! shut down. The next call to init() creates a new singleton object.
 //!
 ////////////////////////////////////////////////////////////////////////////////
 void CRTDebug::destroy()
 {
-  if(m_pSingletonInstance)
+  std::lock_guard<std::mutex> lock(instanceMutex);
+
+  CRTDebug* rtdebug = m_pSingletonInstance.load(std::memory_order_acquire);
+  if(rtdebug == NULL || rtdebug == m_pDormantInstance)
+    return;
+
+  // the dormant instance is kept forever as late calls might still use it
+  if(m_pDormantInstance == NULL)
+  {
+    m_pDormantInstance = new CRTDebug(0, 0, 0, 0, true);
+  }
+
+  m_pSingletonInstance.store(m_pDormantInstance);
+  CRTDebugCall::waitForCalls();
+
+  delete rtdebug;
+}
+
+//  Class:       CRTDebugCall
+//  Method:      acquireSlot
+//!
+//! Assigns a call slot to the current thread, either a free one of a
+//! terminated thread or a newly allocated one.
+//!
+//! @return      the call slot of the current thread
+////////////////////////////////////////////////////////////////////////////////
+CRTDebugCallSlot* CRTDebugCall::acquireSlot()
+{
+  // decide how calls are ordered before the first one of any thread
+  barrier();
+
+  CRTDebugCallSlot* slot;
+
+  for(slot = callSlots.load(std::memory_order_acquire); slot != NULL; slot = slot->next)
+  {
+    bool used = false;
+    if(slot->used.load(std::memory_order_relaxed) == false &&
+       slot->used.compare_exchange_strong(used, true))
+    {
+      break;
+    }
+  }
+
+  if(slot == NULL)
+  {
+    slot = new CRTDebugCallSlot;
+    slot->calls = 0;
+    slot->used = true;
+    slot->next = callSlots.load(std::memory_order_relaxed);
+    while(callSlots.compare_exchange_weak(slot->next, slot) == false)
+      ;
+  }
+
+  // make sure the slot is given back when the thread terminates
+  (void)&callSlotOwner;
+  m_pCurrentSlot = slot;
+
+  return slot;
+}
+
+//  Class:       CRTDebugCall
+//  Method:      barrier
+//!
+//! Registers the process for expedited memory barriers on first use. If
+//! that succeeds, waitForCalls() issues a memory barrier on all running
+//! threads of the process, so that the calls only have to keep the
+//! compiler from reordering their count and the instance pointer.
+//!
+//! @return      true if waitForCalls() fences all threads
+////////////////////////////////////////////////////////////////////////////////
+bool CRTDebugCall::barrier()
+{
+  #if defined(HAVE_MEMBARRIER)
+  static const bool registered = (m_bBarrier = (syscall(__NR_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0) == 0));
+  #else
+  static const bool registered = false;
+  #endif
+
+  return registered;
+}
+
+//  Class:       CRTDebugCall
+//  Method:      releaseSlot
+//!
+//! Gives back the call slot of a terminating thread.
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugCall::releaseSlot()
+{
+  if(m_pCurrentSlot != NULL)
+  {
+    m_pCurrentSlot->used.store(false, std::memory_order_release);
+    m_pCurrentSlot = NULL;
+  }
+}
+
+//  Class:       CRTDebugCall
+//  Method:      waitForCalls
+//!
+//! Waits until all other threads have left the calls they entered before
+//! the instance pointer was changed by the caller.
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugCall::waitForCalls()
+{
+  #if defined(HAVE_MEMBARRIER)
+  if(barrier() == true)
+    syscall(__NR_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0);
+  else
+  #endif
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  for(CRTDebugCallSlot* slot = callSlots.load(std::memory_order_acquire); slot != NULL; slot = slot->next)
   {
-    delete m_pSingletonInstance;
-    m_pSingletonInstance = 0;
+    if(slot == m_pCurrentSlot)
+      continue;
+
+    while(slot->calls.load(std::memory_order_acquire) != 0)
+      std::this_thread::yield();
   }
 }
 
+//  Class:       CRTDebug
+//  Method:      module
+//!
+//! Returns the node of a debug module within the hierarchical module
+//! namespace. The node stays valid for the whole runtime of the application
+//! and always carries the currently resolved state and verbosity level of
+//! the module, so that a call site looks it up once and passes it to the
+//! output methods, which then don't have to resolve the module again.
+//!
+//! @param  name  the dotted module name or DBM_NONE for no module
+//! @return       the node of the module
+////////////////////////////////////////////////////////////////////////////////
+const CRTDebugModule* CRTDebug::module(const char* name)
+{
+  if(name == DBM_NONE)
+    return CRTDebugModuleTree::debugModules()->none();
+
+  return CRTDebugModuleTree::debugModules()->node(name);
+}
+
 //  Class:       CRTDebug
 //  Method:      init
 //!
@@ -306,7 +1058,7 @@ void CRTDebug::destroy()
 ////////////////////////////////////////////////////////////////////////////////
 void CRTDebug::init(const char* variable, const bool debugMode)
 {
-  CRTDebug* rtdebug = CRTDebug::instance();
+  CRTDebug* rtdebug = CRTDebug::createInstance(true);
 
   if(debugMode == true)
     std::cerr << "*** " << PROJECT_LONGNAME << " v" << PROJECT_VERSION << " (" << __DATE__ << ") runtime debugging framework startup ***********" << std::endl;
@@ -318,7 +1070,7 @@ void CRTDebug::init(const char* variable, const bool debugMode)
     if(debugMode == true)
     {
       std::cerr << "*** parsing ENV variable: '" << variable << "' for debug options." << std::endl
-                << "*** for tokens: '@' class, '+' flags, '&' name, '%' module" << std::endl
+                << "*** for tokens: '@' class, '+' flags, '&' name, '%' module[=level], '>' output file" << std::endl
                 << "*** --------------------------------------------------------------------------" << std::endl;
     }
 
@@ -326,6 +1078,35 @@ void CRTDebug::init(const char* variable, const bool debugMode)
     if(var != NULL)
     {
       char* s = var;
+      std::string outputFile;
+      unsigned int outputOptions = 0;
+      bool ansi = false;
+
+      // the buffer arena is reserved before all other tokens are applied,
+      // so that the buffers they set up are already taken from it
+      for(char* a = var; (a = strcasestr(a, "arena")) != NULL; a += 5)
+      {
+        if(a != var && strchr(" ,;", a[-1]) == NULL)
+          continue;
+
+        char* n = a+5;
+        size_t size = (*n == '=') ? strtoul(n+1, &n, 10)*1024*1024 : ARENA_SIZE;
+        int pages = DBA_NORMAL;
+        if(*n == '/')
+        {
+          if(strncasecmp(n+1, "thp", 3) == 0)
+            pages = DBA_THP;
+          else if(strncasecmp(n+1, "huge", 4) == 0)
+            pages = DBA_HUGETLB;
+        }
+
+        if(rtdebug->setArena(size, pages) == false)
+          std::cerr << "*** ERROR: couldn't reserve a buffer arena of " << size/(1024*1024) << " MB" << std::endl;
+        else if(debugMode == true)
+          std::cerr << "*** using a buffer arena of " << size/(1024*1024) << " MB with " << CRTDebugArena::instance()->pageType() << " pages" << std::endl;
+
+        break;
+      }
 
       // now we iterate through the env-variable
       while(*s)
@@ -360,20 +1141,7 @@ void CRTDebug::init(const char* variable, const bool debugMode)
           // class definition
           case '@':
           {
-            static const struct { const char* token; const unsigned int flag; } dbclasses[] =
-            {
-              { "ctrace", DBC_CTRACE  },
-              { "report", DBC_REPORT  },
-              { "assert", DBC_ASSERT  },
-              { "timeval",DBC_TIMEVAL },
-              { "debug",  DBC_DEBUG   },
-              { "error",  DBC_ERROR   },
-              { "warning",DBC_WARNING },
-              { "all",    DBC_ALL     },
-              { NULL,     0           }
-            };
-
-            for(int i=0; dbclasses[i].token; i++)
+            for(int i=0; dbclasses[i].token; i++)
             {
               if(strncasecmp(s+1, dbclasses[i].token, strlen(dbclasses[i].token)) == 0)
               {
@@ -448,6 +1216,14 @@ void CRTDebug::init(const char* variable, const bool debugMode)
             if((t = strpbrk(tk, " ,;")))
               *t = '\0';
 
+            // an optional verbosity level may follow the module name
+            int level = -1;
+            if((t = strchr(tk, '=')))
+            {
+              *t = '\0';
+              level = atoi(t+1);
+            }
+
             // convert the C-string to an STL std::string
             std::string token = tk;
             std::transform(token.begin(),
@@ -455,21 +1231,250 @@ void CRTDebug::init(const char* variable, const bool debugMode)
                            token.begin(), tolower);
             free(tk);
 
-            // lets add the lowercase token to our sourcefilemap.
-            rtdebug->m_pData->m_DebugModules[token] = !negate;
+            // lets add the lowercase token to our module tree.
+            rtdebug->m_pData->m_pDebugModules->set(token.c_str(), !negate, level);
+            if(debugMode == true)
+            {
+              std::cerr << "*** %module.: " << (!negate ? "show" : "hide") << " '" << token << "' output";
+              if(level >= 0)
+                std::cerr << " up to level " << level;
+              std::cerr << std::endl;
+            }
+          }
+          break;
+
+          // output file definition
+          case '>':
+          {
+            outputFile.assign(s+1, e-s-1);
             if(debugMode == true)
-              std::cerr << "*** %module.: " << (!negate ? "show" : "hide") << " '" << token << "' output" << std::endl;
+              std::cerr << "*** >output.: writing output to '" << outputFile << "'" << std::endl;
           }
           break;
 
           default:
           {
-            if(strncasecmp(s, "ansi", 4) == 0)
+            if(e-s == 4 && strncasecmp(s, "ansi", 4) == 0)
             {
               if(debugMode == true)
                 std::cerr << "*** switching " << (!negate ? "on" : "off") << " ANSI color output" << std::endl;
 
               rtdebug->m_pData->m_bHighlighting = !negate;
+              ansi = true;
+            }
+            else if(strncasecmp(s, "compress", 8) == 0)
+            {
+              if(debugMode == true)
+                std::cerr << "*** switching " << (!negate ? "on" : "off") << " output file compression" << std::endl;
+
+              if(negate)
+                outputOptions &= ~DBO_COMPRESS;
+              else
+                outputOptions |= DBO_COMPRESS;
+            }
+            else if(strncasecmp(s, "columns", 7) == 0)
+            {
+              if(debugMode == true)
+                std::cerr << "*** switching " << (!negate ? "on" : "off") << " columnar output file export" << std::endl;
+
+              if(negate)
+                outputOptions &= ~DBO_COLUMNS;
+              else
+                outputOptions |= DBO_COLUMNS;
+            }
+            else if(strncasecmp(s, "uring", 5) == 0)
+            {
+              if(debugMode == true)
+                std::cerr << "*** switching " << (!negate ? "on" : "off") << " asynchronous output file writes" << std::endl;
+
+              if(negate)
+                outputOptions &= ~DBO_URING;
+              else
+                outputOptions |= DBO_URING;
+            }
+            else if(strncasecmp(s, "backtrace", 9) == 0)
+            {
+              bool deferred = strncasecmp(s+9, "-deferred", 9) == 0;
+              const char* n = s + (deferred ? 18 : 9);
+              unsigned int classes = 0;
+              if(negate == false)
+                classes = (*n == '=') ? parseClasses(n+1) : DBC_ERROR | DBC_ASSERT;
+
+              if(debugMode == true)
+                std::cerr << "*** output backtraces for classes 0x" << std::setw(8) << std::setfill('0') << std::hex << classes << std::dec << (deferred ? " (deferred)" : "") << std::endl;
+
+              rtdebug->setBacktrace(classes, classes != 0 ? INC_FATAL : 0, deferred);
+            }
+            else if(strncasecmp(s, "interval=", 9) == 0)
+            {
+              unsigned int seconds = atoi(s+9);
+
+              if(debugMode == true)
+                std::cerr << "*** periodic reports every " << seconds << " seconds" << std::endl;
+
+              rtdebug->setReportInterval(seconds);
+            }
+            else if(strncasecmp(s, "percpu", 6) == 0 && negate == false)
+            {
+              size_t size = (s[6] == '=') ? atoi(s+7)*1024 : PERCPU_BUFSIZE;
+
+              if(debugMode == true)
+                std::cerr << "*** using per-CPU buffers of " << size/1024 << " KB" << std::endl;
+
+              rtdebug->setPerCPUBuffers(size);
+            }
+            else if(strncasecmp(s, "batch", 5) == 0)
+            {
+              size_t size = 0;
+              unsigned int maxDelay = BATCH_MAXDELAY;
+              if(negate == false)
+              {
+                char* n = s+5;
+                size = (*n == '=') ? strtoul(n+1, &n, 10)*1024 : BATCH_BUFSIZE;
+                if(*n == '/')
+                  maxDelay = atoi(n+1);
+              }
+
+              if(debugMode == true)
+                std::cerr << "*** batched output: " << size/1024 << " KB, " << maxDelay << " ms" << std::endl;
+
+              rtdebug->setBatchedOutput(size, maxDelay);
+            }
+            else if(strncasecmp(s, "arena", 5) == 0)
+            {
+              // already reserved before all other tokens
+            }
+            else if(strncasecmp(s, "perthread", 9) == 0 && negate == false)
+            {
+              std::string prefix = (s[9] == '=') ? std::string(s+10, e-s-10) : PERTHREAD_PREFIX;
+              bool highlighting = rtdebug->m_pData->m_bHighlighting;
+
+              if(debugMode == true)
+                std::cerr << "*** writing per-thread files '" << prefix << ".<pid>.<tid>'" << std::endl;
+
+              rtdebug->setPerThreadFiles(prefix.c_str());
+
+              // a preceding 'ansi' token still wins, a later one is applied anyway
+              if(ansi == true)
+                rtdebug->m_pData->m_bHighlighting = highlighting;
+            }
+            else if(strncasecmp(s, "async", 5) == 0)
+            {
+              size_t size = 0;
+              unsigned int maxWait = ASYNC_MAXWAIT;
+              if(negate == false)
+              {
+                char* n = s+5;
+                size = (*n == '=') ? strtoul(n+1, &n, 10)*1024 : ASYNC_BUFSIZE;
+                if(*n == '/')
+                  maxWait = atoi(n+1);
+              }
+
+              if(debugMode == true)
+                std::cerr << "*** asynchronous output via a queue of " << size/1024 << " KB, waiting at most " << maxWait << " ms" << std::endl;
+
+              rtdebug->setAsyncOutput(size, maxWait);
+            }
+            else if(strncasecmp(s, "overload=", 9) == 0)
+            {
+              static const struct { const char* token; const int policy; } policies[] =
+              {
+                { "block",       DBP_BLOCK      },
+                { "drop-newest", DBP_DROPNEWEST },
+                { "drop-oldest", DBP_DROPOLDEST },
+                { "sample",      DBP_SAMPLE     },
+                { NULL,          0              }
+              };
+
+              unsigned int classes = parseClasses(s+9);
+              const char* p = strchr(s+9, ':');
+              if(p != NULL && p < e)
+              {
+                for(int i=0; policies[i].token; i++)
+                {
+                  if(strncasecmp(p+1, policies[i].token, strlen(policies[i].token)) == 0)
+                  {
+                    const char* r = p+1+strlen(policies[i].token);
+                    unsigned int rate = (*r == '/') ? atoi(r+1) : ASYNC_SAMPLERATE;
+
+                    if(debugMode == true)
+                      std::cerr << "*** overload policy of classes 0x" << std::setw(8) << std::setfill('0') << std::hex << classes << std::dec << ": " << policies[i].token << std::endl;
+
+                    rtdebug->setOverloadPolicy(classes, policies[i].policy, rate);
+                  }
+                }
+              }
+            }
+            else if(strncasecmp(s, "instrument", 10) == 0)
+            {
+              if(debugMode == true)
+                std::cerr << "*** tracing instrumented functions: " << (negate ? "off" : "on") << std::endl;
+
+              rtdebug->setInstrumentation(negate == false);
+            }
+            else if(strncasecmp(s, "overhead", 8) == 0)
+            {
+              if(debugMode == true)
+                std::cerr << "*** measuring the own overhead: " << (negate ? "off" : "on") << std::endl;
+
+              rtdebug->setOverheadAccounting(negate == false);
+            }
+            else if(strncasecmp(s, "profile", 7) == 0)
+            {
+              std::string filename;
+              if(negate == false)
+                filename = (s[7] == '=') ? std::string(s+8, e-s-8) : PROFILE_FILE;
+
+              if(debugMode == true)
+                std::cerr << "*** writing the call and timer profile to '" << filename << "'" << std::endl;
+
+              rtdebug->setProfile(negate == false ? filename.c_str() : NULL);
+            }
+            else if(strncasecmp(s, "volume", 6) == 0)
+            {
+              unsigned int top = 0;
+              if(negate == false)
+                top = (s[6] == '=') ? atoi(s+7) : VOLUME_TOP;
+
+              if(debugMode == true)
+                std::cerr << "*** reporting the top " << top << " emitters of output volume" << std::endl;
+
+              rtdebug->setVolumeAccounting(top);
+            }
+            else if(strncasecmp(s, "counters", 8) == 0)
+            {
+              unsigned int seconds = 0;
+              if(negate == false)
+                seconds = (s[8] == '=') ? atoi(s+9) : COUNTER_INTERVAL;
+
+              if(debugMode == true)
+                std::cerr << "*** reporting counters every " << seconds << " seconds" << std::endl;
+
+              rtdebug->setReportInterval(seconds);
+            }
+            else if(strncasecmp(s, "lookback", 8) == 0)
+            {
+              bool allThreads = strncasecmp(s+8, "all", 3) == 0;
+              const char* n = s + (allThreads ? 11 : 8);
+              unsigned int records = 0;
+              if(negate == false)
+                records = (*n == '=') ? atoi(n+1) : LOOKBACK_RECORDS;
+
+              if(debugMode == true)
+                std::cerr << "*** keeping " << records << " suppressed records per thread for errors" << (allThreads ? " of all threads" : "") << std::endl;
+
+              rtdebug->setLookback(records, DBC_ALL, allThreads);
+            }
+            else if(strncasecmp(s, "coalesce", 8) == 0)
+            {
+              unsigned int ms = 0;
+              if(negate == false)
+                ms = (s[8] == '=') ? atoi(s+9) : COALESCE_TIME;
+
+              if(debugMode == true)
+                std::cerr << "*** coalescing repeated messages: " << ms << " ms" << std::endl;
+
+              rtdebug->setCoalescing(ms);
             }
           }
         }
@@ -481,6 +1486,18 @@ void CRTDebug::init(const char* variable, const bool debugMode)
           break;
       }
 
+      // redirect the output now that we know all output options. An
+      // explicitly specified 'ansi' token still wins over the file default.
+      if(outputFile.empty() == false)
+      {
+        bool highlighting = rtdebug->m_pData->m_bHighlighting;
+
+        if(rtdebug->setOutputFile(outputFile.c_str(), outputOptions) == false)
+          std::cerr << "*** ERROR: couldn't open output file '" << outputFile << "'" << std::endl;
+        else if(ansi == true)
+          rtdebug->m_pData->m_bHighlighting = highlighting;
+      }
+
       if(debugMode == true)
         std::cerr << "*** --------------------------------------------------------------------------" << std::endl;
     }
@@ -493,6 +1510,99 @@ void CRTDebug::init(const char* variable, const bool debugMode)
     }
   }
 
+  // the layout of the record header contains spaces, so it is specified
+  // in an own variable
+  char* layout = getenv("RTDEBUG_LAYOUT");
+  if(layout != NULL)
+  {
+    if(debugMode == true)
+      std::cerr << "*** record layout: '" << layout << "'" << std::endl;
+
+    if(rtdebug->setLayout(layout) == false)
+      std::cerr << "*** ERROR: invalid record layout '" << layout << "'" << std::endl;
+  }
+
+  // the functions to trace in builds compiled with -finstrument-functions
+  // are selected by "+pattern" and "-pattern" entries matching the function
+  // or object file name (e.g. "+net::* -*::operator*")
+  char* functions = getenv("RTDEBUG_INSTRUMENT");
+  if(functions != NULL)
+  {
+    std::string filters = functions;
+    std::string::size_type pos = 0;
+
+    while((pos = filters.find_first_not_of(" \t", pos)) != std::string::npos)
+    {
+      std::string::size_type end = filters.find_first_of(" \t", pos);
+      std::string filter = filters.substr(pos, end == std::string::npos ? std::string::npos : end-pos);
+      bool show = filter[0] != '-';
+
+      if(filter[0] == '+' || filter[0] == '-')
+        filter.erase(0, 1);
+
+      if(filter.empty() == false)
+      {
+        if(debugMode == true)
+          std::cerr << "*** instrument: " << (show ? "show" : "hide") << " '" << filter << "' calls" << std::endl;
+
+        rtdebug->setInstrumentFilter(filter.c_str(), show);
+      }
+
+      pos = end;
+    }
+  }
+
+  // the classes to enable for certain threads only are specified in an own
+  // variable as "selector=class+class[%module]" entries. The selector
+  // is either a thread ID, "self" for the calling thread or a thread name
+  // pattern (e.g. "worker-*").
+  char* scope = getenv("RTDEBUG_THREAD_SCOPE");
+  if(scope != NULL)
+  {
+    char* tk = strdup(scope);
+    char* save = NULL;
+
+    for(char* entry = strtok_r(tk, " ,;", &save); entry != NULL; entry = strtok_r(NULL, " ,;", &save))
+    {
+      char* cls = strchr(entry, '=');
+      if(cls == NULL)
+        continue;
+
+      *cls++ = '\0';
+
+      char* module = strchr(cls, '%');
+      if(module != NULL)
+        *module++ = '\0';
+
+      unsigned int classes = parseClasses(cls);
+
+      // a rule without any known class would silently enable nothing
+      if(classes == 0)
+      {
+        std::cerr << "*** ERROR: invalid thread scope '" << entry << "=" << cls << "' without any known debug class" << std::endl;
+        continue;
+      }
+
+      if(debugMode == true)
+      {
+        std::cerr << "*** thread scope: show classes 0x" << std::setw(8) << std::setfill('0') << std::hex << classes << std::dec
+                  << " for thread '" << entry << "'";
+        if(module != NULL)
+          std::cerr << " in module '" << module << "'";
+        std::cerr << std::endl;
+      }
+
+      if(strcasecmp(entry, "self") == 0)
+        rtdebug->setCurrentThreadScope(classes, module);
+      else if(entry[0] != '\0' && entry[strspn(entry, "0123456789")] == '\0')
+        rtdebug->setThreadScope(atoi(entry), classes, module);
+      else
+        rtdebug->setThreadNameScope(entry, classes, module);
+    }
+
+    free(tk);
+  }
+
   // save compile-time debug mode flag
   rtdebug->m_pData->m_bDebugMode = debugMode;
 }
@@ -500,23 +1610,77 @@ void CRTDebug::init(const char* variable, const bool debugMode)
 //  Class:       CRTDebug
 //  Constructor: CRTDebug
 //!
-//! Construct a CRTDebug object.
+//! Construct a CRTDebug object. The dormant instance taking the calls
+//! after destroy() outputs nothing and leaves the global module tree and
+//! instrumentation alone, which are still in use by the old instance.
 //!
+//! @param  dormant  construct the dormant instance
 ////////////////////////////////////////////////////////////////////////////////
 CRTDebug::CRTDebug(const int dbclasses, const int dbflags,
-                   const int infoclasses, const int infoflags)
+                   const int infoclasses, const int infoflags,
+                   const bool dormant)
 {
   // allocate data from our private instance class
   m_pData = new CRTDebugPrivate();
 
   // set some default values
   m_pData->m_PID = getpid();
+  m_pData->m_iEpoch = instanceEpoch++;
+  m_pData->m_bDormant = dormant;
   m_pData->m_bHighlighting = true;
   m_pData->m_iDebugClasses = dbclasses;
   m_pData->m_iDebugFlags = dbflags;
   m_pData->m_iInfoClasses = infoclasses;
   m_pData->m_iInfoFlags = infoflags;
   m_pData->m_iThreadCount = 0;
+  m_pData->m_pOutput = new CRTDebugFileSink(STDERR_FILENO);
+  m_pData->m_iCoalesceTime = 0;
+  m_pData->m_iScopeGeneration = 0;
+  m_pData->m_iScopeCounter = 0;
+  m_pData->m_iLookbackClasses = 0;
+  m_pData->m_iLookbackSize = 0;
+  m_pData->m_bLookbackAllThreads = false;
+  m_pData->m_iBacktraceClasses = 0;
+  m_pData->m_iBacktraceInfoClasses = 0;
+  m_pData->m_bBacktraceDeferred = false;
+  m_pData->m_iReportInterval = 0;
+  m_pData->m_iVolumeTop = 0;
+  m_pData->m_bOverhead = false;
+  m_pData->m_bProfile = false;
+  m_pData->m_pPerCPU = NULL;
+  m_pData->m_bPerThread = false;
+  m_pData->m_pAsync = NULL;
+  memset(m_pData->m_RetiredRecords, 0, sizeof(m_pData->m_RetiredRecords));
+  memset(m_pData->m_RetiredDropped, 0, sizeof(m_pData->m_RetiredDropped));
+  m_pData->m_pBatch = NULL;
+  m_pData->m_iBatchSize = 0;
+  m_pData->m_iBatchDelay = BATCH_MAXDELAY;
+  m_pData->m_iBatchClasses = DBC_ERROR | DBC_ASSERT;
+  m_pData->m_iSequence = 1;
+
+  // errors are never dropped unless they would block for too long
+  for(unsigned int i=0; i < ASYNC_CLASSES; i++)
+  {
+    m_pData->m_Overload[i].policy = ((1U << i) & (DBC_ERROR | DBC_ASSERT | DBC_WARNING)) ? DBP_BLOCK : DBP_DROPNEWEST;
+    m_pData->m_Overload[i].rate = ASYNC_SAMPLERATE;
+  }
+
+  CRTDebugLayout* layout = new CRTDebugLayout();
+  layout->compile(DEFAULT_LAYOUT);
+  m_pData->m_pLayout = layout;
+  m_pData->m_bCollectQuit = false;
+  gettimeofday(&m_pData->m_LastVolumeReport, NULL);
+  m_pData->m_bReportQuit = false;
+  gettimeofday(&m_pData->m_LastCounterReport, NULL);
+
+  // the debug module tree outlives the instances, so make sure the
+  // configuration of a previous instance is gone.
+  m_pData->m_pDebugModules = CRTDebugModuleTree::debugModules();
+  if(dormant == false)
+  {
+    m_pData->m_pDebugModules->reset();
+    CRTDebugInstrument::instance()->reset();
+  }
 
   #if defined(HAVE_LIBPTHREAD)
   pthread_mutex_init(&(m_pData->m_pCoutMutex), NULL);
@@ -539,6 +1703,12 @@ CRTDebug::CRTDebug(const int dbclasses, const int dbflags,
 
   if(m_pData->m_iInfoFlags == 0)
     m_pData->m_iInfoFlags = INF_ALWAYS | INF_STARTUP;
+
+  if(dormant == true)
+  {
+    m_pData->m_iDebugClasses = 0;
+    m_pData->m_iInfoClasses = 0;
+  }
 }
 
 //  Class:       CRTDebug
@@ -549,12 +1719,65 @@ CRTDebug::CRTDebug(const int dbclasses, const int dbflags,
 ////////////////////////////////////////////////////////////////////////////////
 CRTDebug::~CRTDebug()
 {
+  // the per-CPU buffers are collected a last time below
+  m_pData->stopCollectThread();
+
+  // a final report of all counters
+  m_pData->stopReportThread();
+  if(CRTDebugCounters::instance()->size() > 0)
+    m_pData->reportCounters();
+
+  if(m_pData->m_iVolumeTop > 0)
+    m_pData->reportVolume();
+
+  if(m_pData->m_bOverhead == true)
+    m_pData->reportOverhead();
+
+  if(m_pData->m_pAsync != NULL)
+    m_pData->reportOverload();
+
+  if(m_pData->m_bProfile == true)
+    m_pData->writeProfile(m_pData->m_sProfileFile.c_str());
+
+  // output the pending repeat summaries of all threads and detach
+  // them from this instance. Threads terminating meanwhile wait for the
+  // owner mutex and then find themselves detached.
+  std::unique_lock<std::mutex> owner(ownerMutex);
+  LOCK_OUTPUTSTREAM;
+
+  for(std::set<CRTDebugThread*>::iterator it = m_pData->m_Threads.begin(); it != m_pData->m_Threads.end(); ++it)
+  {
+    m_pData->flushRepeats(*it);
+    (*it)->m_pOwner = NULL;
+
+    delete (*it)->m_pThreadOutput;
+    (*it)->m_pThreadOutput = NULL;
+    (*it)->m_bThreadOutputFailed = false;
+  }
+  m_pData->m_Threads.clear();
+
+  if(m_pData->m_pPerCPU != NULL)
+    m_pData->m_pPerCPU->collect(m_pData->m_pOutput);
+
+  UNLOCK_OUTPUTSTREAM;
+  owner.unlock();
+
+  // deleting the output sink writes out all pending data
+  delete m_pData->m_pOutput;
+  delete m_pData->m_pPerCPU;
+
+  delete m_pData->m_pLayout.load();
+  for(size_t i=0; i < m_pData->m_RetiredLayouts.size(); i++)
+    delete m_pData->m_RetiredLayouts[i];
+
   #if defined(HAVE_LIBPTHREAD)
   pthread_mutex_destroy(&(m_pData->m_pCoutMutex));
   #endif
 
   if(m_pData->m_bDebugMode == true)
     std::cerr << "*** " << PROJECT_LONGNAME << " framework shutdowned *********************************************" << std::endl;
+
+  delete m_pData;
 }
 
 //  Class:       CRTDebug
@@ -571,46 +1794,50 @@ CRTDebug::~CRTDebug()
 //! @param       line the line number on which the ENTER() was placed
 //! @param       function name of the function in which the ENTER() was placed.
 ////////////////////////////////////////////////////////////////////////////////
-std::ostream& CRTDebug::Enter(const int c, const char* m, const char* file, long line,
+std::ostream& CRTDebug::Enter(const int c, const CRTDebugModule* m, const char* file, long line,
                               const char* function)
 {
   // check if we should really output something
   if(m_pData->matchDebugSpec(c, m, file) == false)
+  {
+    // keep the record for a later output in case of an error
+    if(m_pData->m_iLookbackClasses & c)
+      m_pData->lookback(c, file, line, "Entering %s()", function);
+
+    if(m_pData->m_bProfile == true)
+      m_pData->profileThread()->m_Profile.enter(file, function, monotonicTime());
+
     return std::cerr;
+  }
 
   // lock the output stream
-  LOCK_OUTPUTSTREAM;
+  LOCK_RECORD;
 
   // update time information
   UPDATE_TIMEINFO;
 
-  // check if the call is issued from a new thread or if this is an already
-  // known one for which we have assigned an own ID
-  THREAD_ID_CHECK;
+  // get the data of the calling thread. In case this is a new thread
+  // an own ID will be assigned to it.
+  CRTDebugThread* thread = m_pData->currentThread();
 
-  if(m_pData->m_bHighlighting)
-  {
-    std::cerr << TIME_PREFIX_COLOR
-              << THREAD_PREFIX_COLOR
-              << INDENT_OUTPUT << DBC_CTRACE_COLOR
-              << (strrchr(file, '/') ? strrchr(file, '/')+1 : file) << ":"
-              << std::dec << line << ":Entering " << function << "()"
-              << ANSI_ESC_CLR << std::endl;
-  }
-  else
-  {
-    std::cerr << TIME_PREFIX
-              << THREAD_PREFIX
-              << INDENT_OUTPUT
-              << (strrchr(file, '/') ? strrchr(file, '/')+1 : file) << ":"
-              << std::dec << line << ":Entering " << function << "()" << std::endl;
-  }
+  CRTDebugBuffer& buf = RECORD_BUFFER;
+  buf.clear();
+  m_pData->appendHeader(buf, thread, &newtp, DBC_CTRACE_COLOR, file, line);
+  thread->m_pFunction = function;
+  buf.append("Entering ");
+  buf.append(function);
+  buf.append("()");
+  m_pData->writeRecord(buf, thread, c, m, &newtp, true);
 
   // increase the indention level
-  m_pData->m_IdentLevel[THREAD_TYPE] = m_pData->m_IdentLevel[THREAD_TYPE] + 1;
+  thread->m_iIdentLevel++;
 
   // unlock the output stream
-  UNLOCK_OUTPUTSTREAM;
+  UNLOCK_RECORD;
+
+  // the own output doesn't count to the measured time
+  if(m_pData->m_bProfile == true)
+    thread->m_Profile.enter(file, function, monotonicTime());
 
   return std::cerr;
 }
@@ -629,46 +1856,47 @@ std::ostream& CRTDebug::Enter(const int c, const char* m, const char* file, long
 //! @param       line the line number on which the LEAVE() was placed
 //! @param       function name of the function in which the LEAVE() was placed.
 ////////////////////////////////////////////////////////////////////////////////
-std::ostream& CRTDebug::Leave(const int c, const char* m, const char *file, const long line,
+std::ostream& CRTDebug::Leave(const int c, const CRTDebugModule* m, const char *file, const long line,
                               const char *function)
 {
+  // the profile measures all calls, whether they are output or not
+  if(m_pData->m_bProfile == true)
+    m_pData->profileThread()->m_Profile.leave(function, monotonicTime());
+
   // check if we should really output something
   if(m_pData->matchDebugSpec(c, m, file) == false)
+  {
+    // keep the record for a later output in case of an error
+    if(m_pData->m_iLookbackClasses & c)
+      m_pData->lookback(c, file, line, "Leaving %s()", function);
+
     return std::cerr;
+  }
 
   // lock the output stream
-  LOCK_OUTPUTSTREAM;
+  LOCK_RECORD;
 
   // update time information
   UPDATE_TIMEINFO;
 
-  if(m_pData->m_IdentLevel[THREAD_TYPE] > 0)
-    m_pData->m_IdentLevel[THREAD_TYPE]--;
+  // get the data of the calling thread. In case this is a new thread
+  // an own ID will be assigned to it.
+  CRTDebugThread* thread = m_pData->currentThread();
 
-  // check if the call is issued from a new thread or if this is an already
-  // known one for which we have assigned an own ID
-  THREAD_ID_CHECK;
+  if(thread->m_iIdentLevel > 0)
+    thread->m_iIdentLevel--;
 
-  if(m_pData->m_bHighlighting)
-  {
-    std::cerr << TIME_PREFIX_COLOR
-              << THREAD_PREFIX_COLOR
-              << INDENT_OUTPUT << DBC_CTRACE_COLOR
-              << (strrchr(file, '/') ? strrchr(file, '/')+1 : file) << ":"
-              << std::dec << line << ":Leaving " << function << "()"
-              << ANSI_ESC_CLR << std::endl;
-  }
-  else
-  {
-    std::cerr << TIME_PREFIX
-              << THREAD_PREFIX
-              << INDENT_OUTPUT
-              << (strrchr(file, '/') ? strrchr(file, '/')+1 : file) << ":"
-              << std::dec << line << ":Leaving " << function << "()" << std::endl;
-  }
+  CRTDebugBuffer& buf = RECORD_BUFFER;
+  buf.clear();
+  m_pData->appendHeader(buf, thread, &newtp, DBC_CTRACE_COLOR, file, line);
+  thread->m_pFunction = function;
+  buf.append("Leaving ");
+  buf.append(function);
+  buf.append("()");
+  m_pData->writeRecord(buf, thread, c, m, &newtp, true);
 
   // unlock the output stream
-  UNLOCK_OUTPUTSTREAM;
+  UNLOCK_RECORD;
 
   return std::cerr;
 }
@@ -688,49 +1916,51 @@ std::ostream& CRTDebug::Leave(const int c, const char* m, const char *file, cons
 //! @param       function name of the function in which the RETURN() was placed.
 //! @param       return the return value
 ////////////////////////////////////////////////////////////////////////////////
-std::ostream& CRTDebug::Return(const int c, const char* m, const char *file, const long line,
+std::ostream& CRTDebug::Return(const int c, const CRTDebugModule* m, const char *file, const long line,
                                const char *function, const long result)
 {
+  // the profile measures all calls, whether they are output or not
+  if(m_pData->m_bProfile == true)
+    m_pData->profileThread()->m_Profile.leave(function, monotonicTime());
+
   // check if we should really output something
   if(m_pData->matchDebugSpec(c, m, file) == false)
+  {
+    // keep the record for a later output in case of an error
+    if(m_pData->m_iLookbackClasses & c)
+      m_pData->lookback(c, file, line, "Leaving %s() (result 0x%08lx, %ld)", function, result, result);
+
     return std::cerr;
+  }
 
   // lock the output stream
-  LOCK_OUTPUTSTREAM;
+  LOCK_RECORD;
 
   // update time information
   UPDATE_TIMEINFO;
 
-  if(m_pData->m_IdentLevel[THREAD_TYPE] > 0)
-    m_pData->m_IdentLevel[THREAD_TYPE]--;
-
-  // check if the call is issued from a new thread or if this is an already
-  // known one for which we have assigned an own ID
-  THREAD_ID_CHECK;
-
-  if(m_pData->m_bHighlighting)
-  {
-    std::cerr << TIME_PREFIX_COLOR
-              << THREAD_PREFIX_COLOR
-              << INDENT_OUTPUT << DBC_CTRACE_COLOR
-              << (strrchr(file, '/') ? strrchr(file, '/')+1 : file) << ":"
-              << std::dec << line << ":Leaving " << function << "() (result 0x"
-              << std::hex << std::setw(8) << std::setfill('0') << result << ", "
-              << std::dec << result << ")" << ANSI_ESC_CLR << std::dec << std::endl;
-  }
-  else
-  {
-    std::cerr << TIME_PREFIX
-              << THREAD_PREFIX
-              << INDENT_OUTPUT
-              << (strrchr(file, '/') ? strrchr(file, '/')+1 : file) << ":"
-              << std::dec << line << ":Leaving " << function << "() (result 0x"
-              << std::hex << std::setw(8) << std::setfill('0') << result << ", "
-              << std::dec << result << ")" << std::dec << std::endl;
-  }
+  // get the data of the calling thread. In case this is a new thread
+  // an own ID will be assigned to it.
+  CRTDebugThread* thread = m_pData->currentThread();
+
+  if(thread->m_iIdentLevel > 0)
+    thread->m_iIdentLevel--;
+
+  CRTDebugBuffer& buf = RECORD_BUFFER;
+  buf.clear();
+  m_pData->appendHeader(buf, thread, &newtp, DBC_CTRACE_COLOR, file, line);
+  thread->m_pFunction = function;
+  buf.append("Leaving ");
+  buf.append(function);
+  buf.append("() (result 0x");
+  buf.appendHex((unsigned long)result, 8);
+  buf.append(", ");
+  buf.appendDec(result);
+  buf.append(")");
+  m_pData->writeRecord(buf, thread, c, m, &newtp, true);
 
   // unlock the output stream
-  UNLOCK_OUTPUTSTREAM;
+  UNLOCK_RECORD;
 
   return std::cerr;
 }
@@ -752,136 +1982,203 @@ std::ostream& CRTDebug::Return(const int c, const char* m, const char *file, con
 //! @param       file   the file name of the source code where we placed SHOWVALUE()
 //! @param       line   the line number on which the SHOWVALUE() is.
 ////////////////////////////////////////////////////////////////////////////////
-std::ostream& CRTDebug::ShowValue(const int c, const char* m, long long value, int size,
+std::ostream& CRTDebug::ShowValue(const int c, const CRTDebugModule* m, long long value, int size,
                                   const char *name, const char *file, long line)
 {
   // check if we should really output something
   if(m_pData->matchDebugSpec(c, m, file) == false)
+  {
+    // keep the record for a later output in case of an error
+    if(m_pData->m_iLookbackClasses & c)
+      m_pData->lookback(c, file, line, "%s = %lld, 0x%0*llx", name, value, size*2, value);
+
     return std::cerr;
+  }
 
   // lock the output stream
-  LOCK_OUTPUTSTREAM;
+  LOCK_RECORD;
 
   // update time information
   UPDATE_TIMEINFO;
 
-  // check if the call is issued from a new thread or if this is an already
-  // known one for which we have assigned an own ID
-  THREAD_ID_CHECK;
+  // get the data of the calling thread. In case this is a new thread
+  // an own ID will be assigned to it.
+  CRTDebugThread* thread = m_pData->currentThread();
 
-  if(m_pData->m_bHighlighting)
-  {
-    std::cerr << TIME_PREFIX_COLOR
-              << THREAD_PREFIX_COLOR
-              << INDENT_OUTPUT << DBC_REPORT_COLOR
-              << (strrchr(file, '/') ? strrchr(file, '/')+1 : file)
-              << ":" << std::dec << line << ":" << name << " = " << value
-              << ", 0x" << std::hex << std::setw(size*2) << std::setfill('0')
-              << value;
-  }
-  else
-  {
-    std::cerr << TIME_PREFIX
-              << THREAD_PREFIX
-              << INDENT_OUTPUT
-              << (strrchr(file, '/') ? strrchr(file, '/')+1 : file)
-              << ":" << std::dec << line << ":" << name << " = " << value
-              << ", 0x" << std::hex << std::setw(size*2) << std::setfill('0')
-              << value;
-  }
+  CRTDebugBuffer& buf = RECORD_BUFFER;
+  buf.clear();
+  m_pData->appendHeader(buf, thread, &newtp, DBC_REPORT_COLOR, file, line);
+  buf.append(name);
+  buf.append(" = ");
+  buf.appendDec(value);
+  buf.append(", 0x");
+  buf.appendHex(value, size*2);
 
   if(size == 1 && value < 256)
   {
     if(value < ' ' || (value >= 127 && value <= 160))
     {
-      std::cerr << ", '" << std::hex << std::setw(2) << std::setfill('0') << value
-                << "'";
+      buf.append(", '");
+      buf.appendHex(value, 2);
+      buf.append("'");
     }
     else
     {
-      std::cerr << ", '" << (char)value << "'";
+      buf.append(", '");
+      buf.append((char)value);
+      buf.append("'");
     }
   }
 
-  if(m_pData->m_bHighlighting)
-    std::cerr << ANSI_ESC_CLR;
-
-  std::cerr << std::dec << std::endl;
+  m_pData->writeRecord(buf, thread, c, m, &newtp, true);
 
   // unlock the output stream
-  UNLOCK_OUTPUTSTREAM;
+  UNLOCK_RECORD;
 
   return std::cerr;
 }
 
 //  Class:       CRTDebug
-//  Method:      ShowPointer
+//  Method:      ShowFormatted
 //!
-//! Method to give a developer the possibility to view a currently set
-//! pointer variable. It outputs the current address of that pointer.
+//! Outputs a value of any type which is not an integer. The value is only
+//! passed by address together with the formatter of its type (see
+//! CRTDebugFormat), which formats it once the record passed the filters.
+//! As a user supplied formatter may output records itself, it runs into the
+//! value buffer of the thread before the record buffer is used and the
+//! output is locked. Suppressed records keep numbers and strings in raw
+//! form for the lookback, all other values have to be formatted right away.
 //!
-//! It is normally invoked by the SHOWPOINTER() macro.
+//! It is normally executed by the SHOWVALUE() macro for floating point
+//! numbers, strings, containers and user types.
 //!
-//! @param       c        the debug class
-//! @param       pointer  the pointer variable which we want to output
-//! @param       name     the name of the variable
-//! @param       file     the file name of the source we have the SHOWPOINTER()
-//! @param       line     the line number on which the SHOWPOINTER() is.
+//! @param       c      the debug class on which this output should be placed
+//! @param       value  the address of the value
+//! @param       format the formatter of the type of the value
+//! @param       capture the capture of the raw value for the lookback
+//! @param       name   the name of the variable for our output
+//! @param       file   the file name of the source code where we placed SHOWVALUE()
+//! @param       line   the line number on which the SHOWVALUE() is.
 ////////////////////////////////////////////////////////////////////////////////
-std::ostream& CRTDebug::ShowPointer(const int c, const char* m, const void* pointer,
-                                    const char* name, const char* file, const long line)
+std::ostream& CRTDebug::ShowFormatted(const int c, const CRTDebugModule* m, const void* value, CRTDebugFormatFunc format,
+                                      CRTDebugCaptureFunc capture, const char* name, const char* file, const long line)
 {
+  CRTDebugBuffer& text = VALUE_BUFFER;
+  size_t start = text.length();
+  CRTDebugOutput out(text);
+
   // check if we should really output something
   if(m_pData->matchDebugSpec(c, m, file) == false)
+  {
+    // keep the record for a later output in case of an error
+    if(m_pData->m_iLookbackClasses & c)
+    {
+      CRTDebugRawValue raw;
+      if(capture(value, raw) == true)
+        m_pData->lookbackValue(c, file, line, &raw, "%s = ", name);
+      else
+      {
+        format(out, value);
+        m_pData->lookback(c, file, line, "%s = %.*s", name, (int)(text.length()-start), text.data()+start);
+        text.truncate(start);
+      }
+    }
+
     return std::cerr;
+  }
+
+  format(out, value);
 
   // lock the output stream
-  LOCK_OUTPUTSTREAM;
+  LOCK_RECORD;
 
   // update time information
   UPDATE_TIMEINFO;
 
-  // check if the call is issued from a new thread or if this is an already
-  // known one for which we have assigned an own ID
-  THREAD_ID_CHECK;
-
-  if(m_pData->m_bHighlighting)
-  {
-    std::cerr << TIME_PREFIX_COLOR
-              << THREAD_PREFIX_COLOR
-              << INDENT_OUTPUT << DBC_REPORT_COLOR
-              << (strrchr(file, '/') ? strrchr(file, '/')+1 : file)
-              << ":" << std::dec << line << ":" << name << " = ";
-  }
-  else
-  {
-    std::cerr << TIME_PREFIX
-              << THREAD_PREFIX
-              << INDENT_OUTPUT
-              << (strrchr(file, '/') ? strrchr(file, '/')+1 : file)
-              << ":" << std::dec << line << ":" << name << " = ";
-  }
-
-  if(pointer != NULL)
-    std::cerr << "0x" << std::hex << std::setw(8) << std::setfill('0') << pointer;
-  else
-    std::cerr << "NULL";
+  // get the data of the calling thread. In case this is a new thread
+  // an own ID will be assigned to it.
+  CRTDebugThread* thread = m_pData->currentThread();
 
-  if(m_pData->m_bHighlighting)
-    std::cerr << ANSI_ESC_CLR;
+  CRTDebugBuffer& buf = RECORD_BUFFER;
+  buf.clear();
+  m_pData->appendHeader(buf, thread, &newtp, DBC_REPORT_COLOR, file, line);
+  buf.append(name);
+  buf.append(" = ");
+  buf.append(text.data()+start, text.length()-start);
 
-  std::cerr << std::dec << std::endl;
+  m_pData->writeRecord(buf, thread, c, m, &newtp, true);
 
   // unlock the output stream
-  UNLOCK_OUTPUTSTREAM;
+  UNLOCK_RECORD;
+
+  text.truncate(start);
 
   return std::cerr;
 }
 
 //  Class:       CRTDebug
-//  Method:      ShowString
+//  Method:      ShowPointer
 //!
-//! Method to show the user a string on the terminal. This string will
+//! Method to give a developer the possibility to view a currently set
+//! pointer variable. It outputs the current address of that pointer.
+//!
+//! It is normally invoked by the SHOWPOINTER() macro.
+//!
+//! @param       c        the debug class
+//! @param       pointer  the pointer variable which we want to output
+//! @param       name     the name of the variable
+//! @param       file     the file name of the source we have the SHOWPOINTER()
+//! @param       line     the line number on which the SHOWPOINTER() is.
+////////////////////////////////////////////////////////////////////////////////
+std::ostream& CRTDebug::ShowPointer(const int c, const CRTDebugModule* m, const void* pointer,
+                                    const char* name, const char* file, const long line)
+{
+  // check if we should really output something
+  if(m_pData->matchDebugSpec(c, m, file) == false)
+  {
+    // keep the record for a later output in case of an error
+    if(m_pData->m_iLookbackClasses & c)
+      m_pData->lookback(c, file, line, "%s = %p", name, pointer);
+
+    return std::cerr;
+  }
+
+  // lock the output stream
+  LOCK_RECORD;
+
+  // update time information
+  UPDATE_TIMEINFO;
+
+  // get the data of the calling thread. In case this is a new thread
+  // an own ID will be assigned to it.
+  CRTDebugThread* thread = m_pData->currentThread();
+
+  CRTDebugBuffer& buf = RECORD_BUFFER;
+  buf.clear();
+  m_pData->appendHeader(buf, thread, &newtp, DBC_REPORT_COLOR, file, line);
+  buf.append(name);
+  buf.append(" = ");
+
+  if(pointer != NULL)
+  {
+    buf.append("0x");
+    buf.appendHex((unsigned long long)(size_t)pointer, 8);
+  }
+  else
+    buf.append("NULL");
+
+  m_pData->writeRecord(buf, thread, c, m, &newtp, true);
+
+  // unlock the output stream
+  UNLOCK_RECORD;
+
+  return std::cerr;
+}
+
+//  Class:       CRTDebug
+//  Method:      ShowString
+//!
+//! Method to show the user a string on the terminal. This string will
 //! not be preparsed or altered in anyway, this is done by another method.
 //!
 //! This method is invoked by the SHOWSTRING() method which gives a developer
@@ -895,46 +2192,48 @@ std::ostream& CRTDebug::ShowPointer(const int c, const char* m, const void* poin
 //! @param       file   the file name were the SHOWSTRING() is
 //! @param       line   the line number on which the SHOWSTRING() is
 ////////////////////////////////////////////////////////////////////////////////
-std::ostream& CRTDebug::ShowString(const int c, const char* m, const char* string,
+std::ostream& CRTDebug::ShowString(const int c, const CRTDebugModule* m, const char* string,
                                    const char* name, const char* file, long line)
 {
   // check if we should really output something
   if(m_pData->matchDebugSpec(c, m, file) == false)
+  {
+    // keep the record for a later output in case of an error
+    if(m_pData->m_iLookbackClasses & c)
+      m_pData->lookback(c, file, line, "%s = %p \"%s\"", name, string, string);
+
     return std::cerr;
+  }
 
   // lock the output stream
-  LOCK_OUTPUTSTREAM;
+  LOCK_RECORD;
 
   // update time information
   UPDATE_TIMEINFO;
 
-  // check if the call is issued from a new thread or if this is an already
-  // known one for which we have assigned an own ID
-  THREAD_ID_CHECK;
-
-  if(m_pData->m_bHighlighting)
+  // get the data of the calling thread. In case this is a new thread
+  // an own ID will be assigned to it.
+  CRTDebugThread* thread = m_pData->currentThread();
+
+  CRTDebugBuffer& buf = RECORD_BUFFER;
+  buf.clear();
+  m_pData->appendHeader(buf, thread, &newtp, DBC_REPORT_COLOR, file, line);
+  buf.append(name);
+  buf.append(" = 0x");
+  buf.appendHex((unsigned long long)(size_t)string, 8);
+  if(string != NULL)
   {
-    std::cerr << TIME_PREFIX_COLOR
-              << THREAD_PREFIX_COLOR
-              << INDENT_OUTPUT << DBC_REPORT_COLOR
-              << (strrchr(file, '/') ? strrchr(file, '/')+1 : file)
-              << ":" << std::dec << line << ":" << name << " = 0x" << std::hex
-              << std::setw(8) << std::setfill('0') << string << " \""
-              << string << "\"" << ANSI_ESC_CLR << std::dec << std::endl;
+    buf.append(" \"");
+    buf.append(string);
+    buf.append("\"");
   }
   else
-  {
-    std::cerr << TIME_PREFIX
-              << THREAD_PREFIX
-              << INDENT_OUTPUT
-              << (strrchr(file, '/') ? strrchr(file, '/')+1 : file)
-              << ":" << std::dec << line << ":" << name << " = 0x" << std::hex
-              << std::setw(8) << std::setfill('0') << string << " \""
-              << string << "\"" << std::dec << std::endl;
-  }
+    buf.append(" NULL");
+
+  m_pData->writeRecord(buf, thread, c, m, &newtp, true);
 
   // unlock the output stream
-  UNLOCK_OUTPUTSTREAM;
+  UNLOCK_RECORD;
 
   return std::cerr;
 }
@@ -953,43 +2252,94 @@ std::ostream& CRTDebug::ShowString(const int c, const char* m, const char* strin
 //! @param       file   the filename of the source
 //! @param       line   the line number where we have placed the SHOWMSG()
 ////////////////////////////////////////////////////////////////////////////////
-std::ostream& CRTDebug::ShowMessage(const int c, const char* m, const char* string,
+std::ostream& CRTDebug::ShowMessage(const int c, const CRTDebugModule* m, const char* string,
                                     const char* file, long line)
 {
   // check if we should really output something
   if(m_pData->matchDebugSpec(c, m, file) == false)
+  {
+    // keep the record for a later output in case of an error
+    if(m_pData->m_iLookbackClasses & c)
+      m_pData->lookback(c, file, line, "%s", string);
+
     return std::cerr;
+  }
 
   // lock the output stream
-  LOCK_OUTPUTSTREAM;
+  LOCK_RECORD;
 
   // update time information
   UPDATE_TIMEINFO;
 
-  // check if the call is issued from a new thread or if this is an already
-  // known one for which we have assigned an own ID
-  THREAD_ID_CHECK;
+  // get the data of the calling thread. In case this is a new thread
+  // an own ID will be assigned to it.
+  CRTDebugThread* thread = m_pData->currentThread();
 
-  if(m_pData->m_bHighlighting)
-  {
-    std::cerr << TIME_PREFIX_COLOR
-              << THREAD_PREFIX_COLOR
-              << INDENT_OUTPUT << DBC_REPORT_COLOR
-              << (strrchr(file, '/') ? strrchr(file, '/')+1 : file)
-              << ":" << std::dec << line << ":" << string << ANSI_ESC_CLR
-              << std::endl;
-  }
-  else
+  CRTDebugBuffer& buf = RECORD_BUFFER;
+  buf.clear();
+  m_pData->appendHeader(buf, thread, &newtp, DBC_REPORT_COLOR, file, line);
+  buf.append(string);
+  m_pData->writeRecord(buf, thread, c, m, &newtp, true);
+
+  // unlock the output stream
+  UNLOCK_RECORD;
+
+  return std::cerr;
+}
+
+//  Class:       CRTDebug
+//  Method:      Flow
+//!
+//! Outputs a flow event linking the producer and the consumer of a unit of
+//! work handed between threads. The producer outputs "-> flow #<span>"
+//! right before queueing the work, the consumer attaches the span and
+//! outputs "<- flow #<span>" when it takes the work, so that the time
+//! between both records is the queueing latency of the span.
+//!
+//! This method is invoked by the FLOW_SEND() and FLOW_RECV() macros.
+//!
+//! @param       c       the debug class
+//! @param       span    the span handed over
+//! @param       receive the calling thread is the consumer
+//! @param       file    the filename of the source
+//! @param       line    the line number where we have placed the macro
+////////////////////////////////////////////////////////////////////////////////
+std::ostream& CRTDebug::Flow(const int c, const CRTDebugModule* m, const unsigned long long span,
+                             const bool receive, const char* file, const long line)
+{
+  // the consumer continues the span even if nothing is output
+  if(receive == true)
+    attachSpan(span);
+
+  // check if we should really output something
+  if(m_pData->matchDebugSpec(c, m, file) == false)
   {
-    std::cerr << TIME_PREFIX
-              << THREAD_PREFIX
-              << INDENT_OUTPUT
-              << (strrchr(file, '/') ? strrchr(file, '/')+1 : file)
-              << ":" << std::dec << line << ":" << string << std::endl;
+    // keep the record for a later output in case of an error
+    if(m_pData->m_iLookbackClasses & c)
+      m_pData->lookback(c, file, line, "%s flow #%llx", receive ? "<-" : "->", span);
+
+    return std::cerr;
   }
 
+  // lock the output stream
+  LOCK_RECORD;
+
+  // update time information
+  UPDATE_TIMEINFO;
+
+  // get the data of the calling thread. In case this is a new thread
+  // an own ID will be assigned to it.
+  CRTDebugThread* thread = m_pData->currentThread();
+
+  CRTDebugBuffer& buf = RECORD_BUFFER;
+  buf.clear();
+  m_pData->appendHeader(buf, thread, &newtp, DBC_REPORT_COLOR, file, line);
+  buf.append(receive ? "<- flow #" : "-> flow #");
+  buf.appendHex(span);
+  m_pData->writeRecord(buf, thread, c, m, &newtp, true);
+
   // unlock the output stream
-  UNLOCK_OUTPUTSTREAM;
+  UNLOCK_RECORD;
 
   return std::cerr;
 }
@@ -1010,64 +2360,60 @@ std::ostream& CRTDebug::ShowMessage(const int c, const char* m, const char* stri
 //! @param       file   the filename of the source code
 //! @param       line   the line number on which we have the STARTCLOCK()
 ////////////////////////////////////////////////////////////////////////////////
-std::ostream& CRTDebug::StartClock(const int c, const char* m, const char* string,
+std::ostream& CRTDebug::StartClock(const int c, const CRTDebugModule* m, const char* string,
                                    const char* file, long line)
 {
   // check if we should really output something
   if(m_pData->matchDebugSpec(c, m, file) == false)
+  {
+    // keep the record for a later output in case of an error
+    if(m_pData->m_iLookbackClasses & c)
+      m_pData->lookback(c, file, line, "%s started", string);
+
+    if(m_pData->m_bProfile == true)
+      m_pData->profileThread()->m_Profile.startClock(monotonicTime());
+
     return std::cerr;
+  }
 
   // lock the output stream
-  LOCK_OUTPUTSTREAM;
+  LOCK_RECORD;
 
   // update time information
   UPDATE_TIMEINFO;
 
+  // get the data of the calling thread. In case this is a new thread
+  // an own ID will be assigned to it.
+  CRTDebugThread* thread = m_pData->currentThread();
+
   // lets get the current time of the day
   time_t starttime = newtp.tv_sec + (newtp.tv_usec/MICROSEC);
 
   // now we convert that starttime to something human readable
   struct tm brokentime;
-  #if defined(HAVE_LOCALTIME_R)
-  localtime_r(&starttime, &brokentime);
-  #elif defined(HAVE_LOCALTIME_S)
-  localtime_s(&brokentime, &starttime);
-  #elif defined(HAVE_LOCALTIME)
-  memcpy(&brokentime, localtime(&starttime), sizeof(brokentime));
-  #endif
-  char buf[10];
-  strftime(buf, sizeof(buf), "%T", &brokentime);
-  char formattedTime[40];
-  snprintf(formattedTime, sizeof(formattedTime), "%s.%06ld", buf, newtp.tv_usec);
+  LOCALTIME(&brokentime, &starttime);
+  char formattedTime[10];
+  strftime(formattedTime, sizeof(formattedTime), "%T", &brokentime);
 
   // save time measurement
-  memcpy(&(m_pData->m_TimeMeasure[THREAD_TYPE]), &newtp, sizeof(struct timeval));
-
-  // check if the call is issued from a new thread or if this is an already
-  // known one for which we have assigned an own ID
-  THREAD_ID_CHECK;
-
-  if(m_pData->m_bHighlighting)
-  {
-    std::cerr << TIME_PREFIX_COLOR
-              << THREAD_PREFIX_COLOR
-              << INDENT_OUTPUT << DBC_TIMEVAL_COLOR
-              << (strrchr(file, '/') ? strrchr(file, '/')+1 : file)
-              << ":" << std::dec << line << ":" << string << " started@"
-              << formattedTime << ANSI_ESC_CLR << std::endl;
-  }
-  else
-  {
-    std::cerr << TIME_PREFIX
-              << THREAD_PREFIX
-              << INDENT_OUTPUT
-              << (strrchr(file, '/') ? strrchr(file, '/')+1 : file)
-              << ":" << std::dec << line << ":" << string << " started@"
-              << formattedTime << std::endl;
-  }
+  memcpy(&(thread->m_TimeMeasure), &newtp, sizeof(struct timeval));
+
+  CRTDebugBuffer& buf = RECORD_BUFFER;
+  buf.clear();
+  m_pData->appendHeader(buf, thread, &newtp, DBC_TIMEVAL_COLOR, file, line);
+  buf.append(string);
+  buf.append(" started@");
+  buf.append(formattedTime);
+  buf.append('.');
+  buf.appendDec(newtp.tv_usec, 6, '0');
+  m_pData->writeRecord(buf, thread, c, m, &newtp, true);
 
   // unlock the output stream
-  UNLOCK_OUTPUTSTREAM;
+  UNLOCK_RECORD;
+
+  // the own output doesn't count to the measured time
+  if(m_pData->m_bProfile == true)
+    thread->m_Profile.startClock(monotonicTime());
 
   return std::cerr;
 }
@@ -1087,21 +2433,35 @@ std::ostream& CRTDebug::StartClock(const int c, const char* m, const char* strin
 //! @param       file   the filename of the source code file
 //! @param       line   the line number on which we placed the STOPCLOCK()
 ////////////////////////////////////////////////////////////////////////////////
-std::ostream& CRTDebug::StopClock(const int c, const char* m, const char* string,
+std::ostream& CRTDebug::StopClock(const int c, const CRTDebugModule* m, const char* string,
                                   const char* file, long line)
 {
+  // the profile measures all calls, whether they are output or not
+  if(m_pData->m_bProfile == true)
+    m_pData->profileThread()->m_Profile.stopClock(string, monotonicTime());
+
   // check if we should really output something
   if(m_pData->matchDebugSpec(c, m, file) == false)
+  {
+    // keep the record for a later output in case of an error
+    if(m_pData->m_iLookbackClasses & c)
+      m_pData->lookback(c, file, line, "%s stopped", string);
+
     return std::cerr;
+  }
 
   // lock the output stream
-  LOCK_OUTPUTSTREAM;
+  LOCK_RECORD;
 
   // update time information
   UPDATE_TIMEINFO;
 
+  // get the data of the calling thread. In case this is a new thread
+  // an own ID will be assigned to it.
+  CRTDebugThread* thread = m_pData->currentThread();
+
   // now we calculate the timedifference
-  struct timeval* oldtp = &(m_pData->m_TimeMeasure[THREAD_TYPE]);
+  struct timeval* oldtp = &(thread->m_TimeMeasure);
   struct timeval  difftp;
   #if defined(timersub)
   timersub(&newtp, oldtp, &difftp);
@@ -1121,45 +2481,23 @@ std::ostream& CRTDebug::StopClock(const int c, const char* m, const char* string
 
   // now we convert that stoptime to something human readable
   struct tm brokentime;
-  #if defined(HAVE_LOCALTIME_R)
-  localtime_r(&stoptime, &brokentime);
-  #elif defined(HAVE_LOCALTIME_S)
-  localtime_s(&brokentime, &stoptime);
-  #elif defined(HAVE_LOCALTIME)
-  memcpy(&brokentime, localtime(&stoptime), sizeof(brokentime));
-  #endif
-  char buf[10];
-  strftime(buf, sizeof(buf), "%T", &brokentime);
-  char formattedTime[40];
-  snprintf(formattedTime, sizeof(formattedTime), "%s.%06ld", buf, newtp.tv_usec);
-
-  // check if the call is issued from a new thread or if this is an already
-  // known one for which we have assigned an own ID
-  THREAD_ID_CHECK;
-
-  if(m_pData->m_bHighlighting)
-  {
-    std::cerr << TIME_PREFIX_COLOR
-              << THREAD_PREFIX_COLOR
-              << INDENT_OUTPUT << DBC_TIMEVAL_COLOR
-              << (strrchr(file, '/') ? strrchr(file, '/')+1 : file)
-              << ":" << std::dec << line << ":" << string << " stopped@"
-              << formattedTime << " = " << std::fixed << std::setprecision(6) << difftime << "s"
-              << ANSI_ESC_CLR << std::endl;
-  }
-  else
-  {
-    std::cerr << TIME_PREFIX
-              << THREAD_PREFIX
-              << INDENT_OUTPUT
-              << (strrchr(file, '/') ? strrchr(file, '/')+1 : file)
-              << ":" << std::dec << line << ":" << string << " stopped@"
-              << formattedTime << " = " << std::fixed << std::setprecision(6) << difftime << "s"
-              << std::endl;
-  }
+  LOCALTIME(&brokentime, &stoptime);
+  char formattedTime[10];
+  strftime(formattedTime, sizeof(formattedTime), "%T", &brokentime);
+
+  CRTDebugBuffer& buf = RECORD_BUFFER;
+  buf.clear();
+  m_pData->appendHeader(buf, thread, &newtp, DBC_TIMEVAL_COLOR, file, line);
+  buf.append(string);
+  buf.append(" stopped@");
+  buf.append(formattedTime);
+  buf.append('.');
+  buf.appendDec(newtp.tv_usec, 6, '0');
+  buf.appendf(" = %.6fs", difftime);
+  m_pData->writeRecord(buf, thread, c, m, &newtp, true);
 
   // unlock the output stream
-  UNLOCK_OUTPUTSTREAM;
+  UNLOCK_RECORD;
 
   return std::cerr;
 }
@@ -1182,75 +2520,59 @@ std::ostream& CRTDebug::StopClock(const int c, const char* m, const char* string
 //! @param  fmt      the format string
 //! @param  ...      a vararg list of parameters.
 ////////////////////////////////////////////////////////////////////////////////
-std::ostream& CRTDebug::dprintf(const int c, const char* m, const char* file,
+std::ostream& CRTDebug::dprintf(const int c, const CRTDebugModule* m, const char* file,
                                 const long line, const bool newline, const char* fmt, ...)
 {
   // check if we should really output something
   if(m_pData->matchDebugSpec(c, m, file) == false)
+  {
+    // keep the record for a later output in case of an error
+    if(m_pData->m_iLookbackClasses & c)
+    {
+      va_list args;
+      va_start(args, fmt);
+      m_pData->vlookback(c, file, line, fmt, args);
+      va_end(args);
+    }
+
     return std::cerr;
+  }
 
   // lock the output stream
-  LOCK_OUTPUTSTREAM;
+  LOCK_RECORD;
 
   // update time information
   UPDATE_TIMEINFO;
 
-  // now we go and create the output string by using the dynamic
-  // vasprintf() function
-  va_list args;
-  va_start(args, fmt);
-  char *buf;
-  #if defined(HAVE_VASPRINTF)
-  if(vasprintf(&buf, fmt, args) == -1)
-    return std::cerr;
-  #else
-  if((buf = (char *)malloc(STRINGSIZE)) == NULL)
-    return std::cerr;
-  vsnprintf(buf, STRINGSIZE, fmt, args);
-  #endif
-  va_end(args);
-
-  // check if the call is issued from a new thread or if this is an already
-  // known one for which we have assigned an own ID
-  THREAD_ID_CHECK;
+  // get the data of the calling thread. In case this is a new thread
+  // an own ID will be assigned to it.
+  CRTDebugThread* thread = m_pData->currentThread();
 
-  if(m_pData->m_bHighlighting)
-  {
-    const char *highlight;
-    switch(c)
-    {
-      case DBC_DEBUG:   highlight = DBC_DEBUG_COLOR;    break;
-      case DBC_ERROR:   highlight = DBC_ERROR_COLOR;    break;
-      case DBC_WARNING: highlight = DBC_WARNING_COLOR;  break;
-      default:          highlight = ANSI_ESC_FG_WHITE;  break;
-    }
-
-    std::cerr << TIME_PREFIX_COLOR
-              << THREAD_PREFIX_COLOR
-              << INDENT_OUTPUT << highlight
-              << (strrchr(file, '/') ? strrchr(file, '/')+1 : file)
-              << ":" << std::dec << line << ":" << buf << ANSI_ESC_CLR;
-  }
-  else
+  const char *highlight;
+  switch(c)
   {
-    std::cerr << TIME_PREFIX
-              << THREAD_PREFIX
-              << INDENT_OUTPUT
-              << (strrchr(file, '/') ? strrchr(file, '/')+1 : file)
-              << ":" << std::dec << line << ":" << buf;
+    case DBC_DEBUG:   highlight = DBC_DEBUG_COLOR;    break;
+    case DBC_ERROR:   highlight = DBC_ERROR_COLOR;    break;
+    case DBC_WARNING: highlight = DBC_WARNING_COLOR;  break;
+    default:          highlight = ANSI_ESC_FG_WHITE;  break;
   }
 
-  // output a newline if wanted
-  if(newline == true)
-    std::cerr << std::endl;
-  else
-    std::cerr << std::flush;
+  CRTDebugBuffer& buf = RECORD_BUFFER;
+  buf.clear();
+  m_pData->appendHeader(buf, thread, &newtp, highlight, file, line);
+  thread->m_pFormat = fmt;
 
-  // unlock the output stream
-  UNLOCK_OUTPUTSTREAM;
+  // now we go and format the output string directly into our
+  // record buffer
+  va_list args;
+  va_start(args, fmt);
+  buf.vappendf(fmt, args);
+  va_end(args);
 
-  // free the memory vasprintf() allocated for us
-  free(buf);
+  m_pData->writeRecord(buf, thread, c, m, &newtp, newline);
+
+  // unlock the output stream
+  UNLOCK_RECORD;
 
   return std::cerr;
 }
@@ -1286,89 +2608,80 @@ std::ostream& CRTDebug::printf(const int c, const char* m, const char* file,
   // update time information
   UPDATE_TIMEINFO;
 
-  // now we go and create the output string by using the dynamic
-  // vasprintf() function
-  va_list args;
-  va_start(args, fmt);
-  char *buf;
-  #if defined(HAVE_VASPRINTF)
-  if(vasprintf(&buf, fmt, args) == -1)
-    return std::cout;
-  #else
-  if((buf = (char *)malloc(STRINGSIZE)) == NULL)
-    return std::cout;
-  vsnprintf(buf, STRINGSIZE, fmt, args);
-  #endif
-  va_end(args);
-
-  // check if the call is issued from a new thread or if this is an already
-  // known one for which we have assigned an own ID
-  THREAD_ID_CHECK;
+  // get the data of the calling thread. In case this is a new thread
+  // an own ID will be assigned to it.
+  CRTDebugThread* thread = m_pData->currentThread();
 
   // output different prefixes depending on the info class
   const char* highlight;
   const char* prefix;
   std::ostream* stream = nullptr;
+  int fd;
   switch(c)
   {
-    case INC_DEBUG:   highlight = DBC_DEBUG_COLOR;   prefix = "DEBUG: ";   stream = &std::cerr; break;
-    case INC_ERROR:   highlight = DBC_ERROR_COLOR;   prefix = "ERROR: ";   stream = &std::cerr; break;
-    case INC_FATAL:   highlight = DBC_ERROR_COLOR;   prefix = "FATAL: ";   stream = &std::cerr; break;
-    case INC_WARNING: highlight = DBC_WARNING_COLOR; prefix = "WARNING: "; stream = &std::cerr; break;
-    case INC_VERBOSE: highlight = ""; prefix = ""; stream = &std::cout; break;
-    default:          highlight = ""; prefix = ""; stream = &std::cout; break;
+    case INC_DEBUG:   highlight = DBC_DEBUG_COLOR;   prefix = "DEBUG: ";   stream = &std::cerr; fd = STDERR_FILENO; break;
+    case INC_ERROR:   highlight = DBC_ERROR_COLOR;   prefix = "ERROR: ";   stream = &std::cerr; fd = STDERR_FILENO; break;
+    case INC_FATAL:   highlight = DBC_ERROR_COLOR;   prefix = "FATAL: ";   stream = &std::cerr; fd = STDERR_FILENO; break;
+    case INC_WARNING: highlight = DBC_WARNING_COLOR; prefix = "WARNING: "; stream = &std::cerr; fd = STDERR_FILENO; break;
+    case INC_VERBOSE: highlight = ""; prefix = ""; stream = &std::cout; fd = STDOUT_FILENO; break;
+    default:          highlight = ""; prefix = ""; stream = &std::cout; fd = STDOUT_FILENO; break;
   }
 
-  if(m_pData->m_bHighlighting)
-  {
-    if(file != NULL)
-    {
-      *stream << TIME_PREFIX_COLOR
-              << THREAD_PREFIX_COLOR
-              << INDENT_OUTPUT << highlight
-              << (strrchr(file, '/') ? strrchr(file, '/')+1 : file)
-              << ":" << std::dec << line << ":"
-              << prefix
-              << buf << ANSI_ESC_CLR;
-    }
-    else
-    {
-      *stream << highlight
-              << prefix
-              << buf << ANSI_ESC_CLR;
-    }
-  }
-  else
-  {
-    if(file != NULL)
-    {
-      *stream << TIME_PREFIX
-              << THREAD_PREFIX
-              << INDENT_OUTPUT
-              << (strrchr(file, '/') ? strrchr(file, '/')+1 : file)
-              << ":" << std::dec << line << ":";
-    }
-    
-    *stream << prefix
-            << buf;
-  }
+  CRTDebugBuffer& buf = RECORD_BUFFER;
+  buf.clear();
+  if(file != NULL)
+    m_pData->appendHeader(buf, thread, &newtp, highlight, file, line);
+  else if(m_pData->m_bHighlighting)
+    buf.append(highlight);
 
-  // output a newline if wanted
-  if(newline == true)
-    *stream << std::endl;
-  else
-    *stream << std::flush;
+  buf.append(prefix);
+
+  // now we go and format the output string directly into our
+  // record buffer
+  va_list args;
+  va_start(args, fmt);
+  buf.vappendf(fmt, args);
+  va_end(args);
+
+  m_pData->finishRecord(buf, newline);
+
+  if(m_pData->m_iBacktraceInfoClasses & c)
+    m_pData->appendBacktrace(buf, 0);
+
+  // make sure that anything the application itself has buffered within
+  // std::cout is output first so that the output order is kept.
+  if(fd == STDOUT_FILENO)
+    std::cout.flush();
+
+  // debug records still held back by the per-CPU buffers or the batching
+  // were issued before this message. The queue of the asynchronous output
+  // is not waited for, as that could block for any time.
+  m_pData->flushOutput();
+
+  // info messages are always output on the console
+  CRTDebugRecordInfo info;
+  info.time = newtp.tv_sec*1000000ULL + newtp.tv_usec;
+  info.cls = c;
+  info.threadID = thread->m_iThreadID;
+  CRTDebugFileSink(fd).write(info, buf.data(), buf.length());
 
   // unlock the output stream
   UNLOCK_OUTPUTSTREAM;
 
-  // free the memory vasprintf() allocated for us
-  free(buf);
-
   // abort anything that follows if this is a Fatal()
-  // call
+  // call, but don't lose the buffered debug records
   if(c == INC_FATAL)
+  {
+    LOCK_OUTPUTSTREAM;
+
+    if(m_pData->m_pPerCPU != NULL)
+      m_pData->m_pPerCPU->collect(m_pData->m_pOutput);
+    m_pData->m_pOutput->flush();
+
+    UNLOCK_OUTPUTSTREAM;
+
     abort();
+  }
 
   return *stream;
 }
@@ -1406,23 +2719,12 @@ const char* CRTDebug::debugFiles() const
 
 const char* CRTDebug::debugModules() const
 {
-  std::string result;
-  std::map<std::string, bool>::iterator it = m_pData->m_DebugModules.begin();
-
-  while(it != m_pData->m_DebugModules.end())
-  {
-    if(it != m_pData->m_DebugModules.begin())
-      result += " ";
-
-    if((*it).second == true)
-      result += (*it).first;
-    else
-      result += "!" + (*it).first;
+  if(m_pData->m_bDormant == true)
+    return "";
 
-    ++it;
-  }
+  m_pData->m_sDebugModules = m_pData->m_pDebugModules->spec();
 
-  return result.c_str();
+  return m_pData->m_sDebugModules.c_str();
 }
 
 unsigned int CRTDebug::infoClasses() const
@@ -1458,23 +2760,12 @@ const char* CRTDebug::infoFiles() const
 
 const char* CRTDebug::infoModules() const
 {
-  std::string result;
-  std::map<std::string, bool>::iterator it = m_pData->m_InfoModules.begin();
-
-  while(it != m_pData->m_InfoModules.end())
-  {
-    if(it != m_pData->m_InfoModules.begin())
-      result += " ";
-
-    if((*it).second == true)
-      result += (*it).first;
-    else
-      result += "!" + (*it).first;
+  if(m_pData->m_bDormant == true)
+    return "";
 
-    ++it;
-  }
+  m_pData->m_sInfoModules = m_pData->m_InfoModules.spec();
 
-  return result.c_str();
+  return m_pData->m_sInfoModules.c_str();
 }
 
 bool CRTDebug::highlighting() const
@@ -1484,16 +2775,25 @@ bool CRTDebug::highlighting() const
 
 void CRTDebug::setDebugClass(unsigned int cl)
 {
+  if(m_pData->m_bDormant == true)
+    return;
+
   m_pData->m_iDebugClasses |= cl;
 }
 
 void CRTDebug::setDebugFlag(unsigned int fl)
 {
+  if(m_pData->m_bDormant == true)
+    return;
+
   m_pData->m_iDebugFlags |= fl;
 }
 
 void CRTDebug::setDebugFile(const char* filename, bool show)
 {
+  if(m_pData->m_bDormant == true)
+    return;
+
   // convert the C-string to an STL std::string
   std::string token = filename;
   std::transform(token.begin(),
@@ -1505,47 +2805,79 @@ void CRTDebug::setDebugFile(const char* filename, bool show)
 
 void CRTDebug::setDebugModule(const char* module, bool show)
 {
+  if(m_pData->m_bDormant == true)
+    return;
+
   // convert the C-string to an STL std::string
   std::string token = module;
   std::transform(token.begin(),
                  token.end(),
                  token.begin(), tolower);
 
-  m_pData->m_DebugModules[token] = show;
+  m_pData->m_pDebugModules->set(token.c_str(), show);
+}
+
+void CRTDebug::setDebugLevel(const char* module, int level)
+{
+  if(m_pData->m_bDormant == true)
+    return;
+
+  m_pData->m_pDebugModules->set(module, true, level);
 }
 
 void CRTDebug::clearDebugClass(unsigned int cl)
 {
+  if(m_pData->m_bDormant == true)
+    return;
+
   m_pData->m_iDebugClasses &= ~cl;
 }
 
 void CRTDebug::clearDebugFlag(unsigned int fl)
 {
+  if(m_pData->m_bDormant == true)
+    return;
+
   m_pData->m_iDebugFlags &= ~fl;
 }
 
 void CRTDebug::clearDebugFile(const char* filename)
 {
+  if(m_pData->m_bDormant == true)
+    return;
+
   m_pData->m_DebugFiles.erase(filename);
 }
 
 void CRTDebug::clearDebugModule(const char* module)
 {
-  m_pData->m_DebugModules.erase(module);
+  if(m_pData->m_bDormant == true)
+    return;
+
+  m_pData->m_pDebugModules->clear(module);
 }
 
 void CRTDebug::setInfoClass(unsigned int cl)
 {
+  if(m_pData->m_bDormant == true)
+    return;
+
   m_pData->m_iInfoClasses |= cl;
 }
 
 void CRTDebug::setInfoFlag(unsigned int fl)
 {
+  if(m_pData->m_bDormant == true)
+    return;
+
   m_pData->m_iInfoFlags |= fl;
 }
 
 void CRTDebug::setInfoFile(const char* filename, bool show)
 {
+  if(m_pData->m_bDormant == true)
+    return;
+
   // convert the C-string to an STL std::string
   std::string token = filename;
   std::transform(token.begin(),
@@ -1557,114 +2889,2514 @@ void CRTDebug::setInfoFile(const char* filename, bool show)
 
 void CRTDebug::setInfoModule(const char* module, bool show)
 {
+  if(m_pData->m_bDormant == true)
+    return;
+
   // convert the C-string to an STL std::string
   std::string token = module;
   std::transform(token.begin(),
                  token.end(),
                  token.begin(), tolower);
 
-  m_pData->m_InfoModules[token] = show;
+  m_pData->m_InfoModules.set(token.c_str(), show);
 }
 
 void CRTDebug::clearInfoClass(unsigned int cl)
 {
+  if(m_pData->m_bDormant == true)
+    return;
+
   m_pData->m_iInfoClasses &= ~cl;
 }
 
 void CRTDebug::clearInfoFlag(unsigned int fl)
 {
+  if(m_pData->m_bDormant == true)
+    return;
+
   m_pData->m_iInfoFlags &= ~fl;
 }
 
 void CRTDebug::clearInfoFile(const char* filename)
 {
+  if(m_pData->m_bDormant == true)
+    return;
+
   m_pData->m_InfoFiles.erase(filename);
 }
 
 void CRTDebug::clearInfoModule(const char* module)
 {
-  m_pData->m_InfoModules.erase(module);
+  if(m_pData->m_bDormant == true)
+    return;
+
+  m_pData->m_InfoModules.clear(module);
 }
 
 void CRTDebug::setHighlighting(bool on)
 {
+  if(m_pData->m_bDormant == true)
+    return;
+
   m_pData->m_bHighlighting = on;
 }
 
-bool CRTDebugPrivate::matchDebugSpec(const int cl, const char* module, const char* file)
+//  Class:       CRTDebug
+//  Method:      setCoalescing
+//!
+//! Sets the time window in which repeated identical debug records of a
+//! thread are coalesced. Instead of writing each repeat, they are counted
+//! and a single "last message repeated N times" record is output as soon
+//! as a different record follows, the time window is over or the thread
+//! terminates. A repeat arriving after the window is over is output itself
+//! and starts a new window.
+//!
+//! Expired summaries are also output by the report thread, unless the
+//! output is unlocked (percpu, perthread) and only the thread itself may
+//! touch its records.
+//!
+//! @param  ms  the time window in milliseconds or 0 to disable coalescing
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebug::setCoalescing(unsigned int ms)
 {
-  bool result = false;
+  if(m_pData->m_bDormant == true)
+    return;
 
-  // first we check if we need to process this debug message or not,
-  // depending on the currently set debug level
-  if(((m_iDebugClasses & cl)) != 0)
-    result = true;
+  m_pData->stopReportThread();
 
-  // now we search through our sourcefileMap and see if we should suppress
-  // the output or force it.
-  if(file != NULL)
+  LOCK_OUTPUTSTREAM;
+
+  // output what was collected until now
+  if(ms == 0)
   {
-    NameCompare cmp(file);
-    std::map<std::string, bool>::iterator iter = find_if(m_DebugFiles.begin(), m_DebugFiles.end(), cmp);
-    if(iter != m_DebugFiles.end())
-    {
-      if((*iter).second == true)
-        result = true;
-      else
-        result = false;
-    }
+    for(std::set<CRTDebugThread*>::iterator it = m_pData->m_Threads.begin(); it != m_pData->m_Threads.end(); ++it)
+      m_pData->flushRepeats(*it);
   }
 
-  if(module != NULL)
-  {
-    std::map<std::string, bool>::iterator it = m_DebugModules.find(module);
-    if(it != m_DebugModules.end())
-    {
-      if((*it).second == true)
-        result = true;
-      else
+  m_pData->m_iCoalesceTime = ms;
+
+  UNLOCK_OUTPUTSTREAM;
+
+  m_pData->startReportThread();
+}
+
+unsigned int CRTDebug::coalescing() const
+{
+  return m_pData->m_iCoalesceTime;
+}
+
+//  Class:       CRTDebug
+//  Method:      setBacktrace
+//!
+//! Appends the native backtrace of the calling thread to records of the
+//! specified classes. The symbols are resolved via a cache, so repeatedly
+//! output backtraces of the same code path are cheap. In deferred mode
+//! also the records kept in the lookback buffers get their raw backtrace
+//! captured, which is only symbolized if the buffer is actually output.
+//!
+//! @param  classes      the debug classes to output a backtrace for
+//! @param  infoClasses  the info classes to output a backtrace for
+//! @param  deferred     capture backtraces of suppressed records as well
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebug::setBacktrace(unsigned int classes, unsigned int infoClasses, bool deferred)
+{
+  if(m_pData->m_bDormant == true)
+    return;
+
+  LOCK_OUTPUTSTREAM;
+
+  m_pData->m_iBacktraceClasses = classes;
+  m_pData->m_iBacktraceInfoClasses = infoClasses;
+  m_pData->m_bBacktraceDeferred = deferred;
+
+  UNLOCK_OUTPUTSTREAM;
+}
+
+unsigned int CRTDebug::backtraceClasses() const
+{
+  return m_pData->m_iBacktraceClasses;
+}
+
+//  Class:       CRTDebug
+//  Method:      reportCounters
+//!
+//! Outputs the current values of all counters, gauges and maxima. For
+//! counters the increase and rate since the last report is output as well.
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebug::reportCounters()
+{
+  if(m_pData->m_bDormant == true)
+    return;
+
+  m_pData->reportCounters();
+}
+
+//  Class:       CRTDebug
+//  Method:      setReportInterval
+//!
+//! Starts a background thread outputting a report of all counters and,
+//! if enabled, of the output volume in a regular interval. Both are always
+//! reported at destroy().
+//!
+//! @param  seconds  the report interval or 0 to stop the periodic reports
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebug::setReportInterval(unsigned int seconds)
+{
+  if(m_pData->m_bDormant == true)
+    return;
+
+  m_pData->stopReportThread();
+
+  m_pData->m_iReportInterval = seconds;
+
+  m_pData->startReportThread();
+}
+
+//  Class:       CRTDebug
+//  Method:      reportVolume
+//!
+//! Outputs the call sites, modules, classes and threads which produced the
+//! most output since the last report, ranked by their byte rate.
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebug::reportVolume()
+{
+  if(m_pData->m_bDormant == true)
+    return;
+
+  if(m_pData->m_iVolumeTop > 0)
+    m_pData->reportVolume();
+}
+
+//  Class:       CRTDebug
+//  Method:      setVolumeAccounting
+//!
+//! Counts the records and bytes output by every call site. The top
+//! emitters are output by reportVolume(), periodically (see
+//! setReportInterval()) and at destroy().
+//!
+//! @param  top      the number of entries per report category or 0 to
+//!                  disable the accounting
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebug::setVolumeAccounting(unsigned int top)
+{
+  if(m_pData->m_bDormant == true)
+    return;
+
+  LOCK_OUTPUTSTREAM;
+
+  m_pData->m_iVolumeTop = top;
+
+  UNLOCK_OUTPUTSTREAM;
+}
+
+unsigned int CRTDebug::volumeAccounting() const
+{
+  return m_pData->m_iVolumeTop;
+}
+
+//  Class:       CRTDebug
+//  Method:      setInstrumentation
+//!
+//! Switches the call tracing of functions compiled with -finstrument-functions
+//! on or off. The calls are output like ENTER()/LEAVE() with the DBC_CTRACE
+//! class, so that this class has to be enabled as well.
+//!
+//! @param  enable   true to trace the instrumented functions
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebug::setInstrumentation(bool enable)
+{
+  if(m_pData->m_bDormant == true)
+    return;
+
+  CRTDebugInstrument::instance()->setEnabled(enable);
+}
+
+bool CRTDebug::instrumentation() const
+{
+  return CRTDebugInstrument::instance()->enabled();
+}
+
+//  Class:       CRTDebug
+//  Method:      setInstrumentFilter
+//!
+//! Adds a pattern selecting instrumented functions to be traced or not (see
+//! CRTDebugInstrument). Patterns are matched against the demangled function
+//! name without parameters and the name of the object file containing it.
+//!
+//! @param  pattern  the fnmatch() pattern, e.g. "net::*" or "libfoo.so*"
+//! @param  show     true to trace, false to ignore matching functions
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebug::setInstrumentFilter(const char* pattern, bool show)
+{
+  if(m_pData->m_bDormant == true)
+    return;
+
+  CRTDebugInstrument::instance()->setFilter(pattern, show);
+}
+
+void CRTDebug::clearInstrumentFilters()
+{
+  if(m_pData->m_bDormant == true)
+    return;
+
+  CRTDebugInstrument::instance()->clearFilters();
+}
+
+//  Class:       CRTDebug
+//  Method:      createContext
+//!
+//! Creates a logical trace context for a coroutine, fiber or task. While a
+//! context is switched to (see switchContext()), it takes the place of the
+//! OS thread for the indention, clocks, thread ID, coalescing, lookback and
+//! thread scopes of all records, so that the output of tasks multiplexed
+//! onto few threads does not interleave.
+//!
+//! @param  name     an optional name matched by thread name scopes
+//! @return          the new context
+////////////////////////////////////////////////////////////////////////////////
+CRTDebugContext* CRTDebug::createContext(const char* name)
+{
+  CRTDebugContext* context = new CRTDebugContext();
+  if(name != NULL)
+    context->m_sName = name;
+
+  return context;
+}
+
+//  Class:       CRTDebug
+//  Method:      destroyContext
+//!
+//! Destroys a trace context after outputting its pending repeat summary.
+//! The calling thread falls back to its own context if it was switched to
+//! the destroyed one. Other threads still switched to the context keep
+//! using it, and it is only freed once the last of them switches away.
+//!
+//! @param  context  the context to destroy
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebug::destroyContext(CRTDebugContext* context)
+{
+  if(m_pCurrentContext == context)
+    switchContext(NULL);
+
+  if(context->m_iReferences.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    delete context;
+}
+
+//  Class:       CRTDebug
+//  Method:      switchContext
+//!
+//! Makes a trace context the current one of the calling thread, e.g. when
+//! a scheduler resumes a coroutine. The thread holds a reference to the
+//! context while it is switched to it, so that destroyContext() on another
+//! thread doesn't free it in between. A thread has to switch back to NULL
+//! before it terminates, or the context is never freed.
+//!
+//! @param  context  the context to switch to or NULL for the OS thread
+//! @return          the previous context or NULL for the OS thread
+////////////////////////////////////////////////////////////////////////////////
+CRTDebugContext* CRTDebug::switchContext(CRTDebugContext* context)
+{
+  CRTDebugContext* previous = m_pCurrentContext;
+  if(context == previous)
+    return previous;
+
+  if(context != NULL)
+    context->m_iReferences.fetch_add(1, std::memory_order_relaxed);
+
+  m_pCurrentContext = context;
+
+  if(previous != NULL && previous->m_iReferences.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    delete previous;
+
+  return previous;
+}
+
+//  Class:       CRTDebug
+//  Method:      createSpan
+//!
+//! Creates a new span ID identifying a unit of work (e.g. a request) which
+//! may be handed between several threads. IDs are unique within the
+//! process and never 0.
+//!
+//! @return          the new span ID
+////////////////////////////////////////////////////////////////////////////////
+unsigned long long CRTDebug::createSpan()
+{
+  return spanCounter.fetch_add(1, std::memory_order_relaxed);
+}
+
+//  Class:       CRTDebug
+//  Method:      attachSpan
+//!
+//! Attaches a span to the current trace context (the calling thread or the
+//! context switched to), so that the span ID is stamped into the header of
+//! all its following records (see the %s field of setLayout()).
+//!
+//! @param  span     the span to attach or 0 to detach the current one
+//! @return          the previously attached span or 0
+////////////////////////////////////////////////////////////////////////////////
+unsigned long long CRTDebug::attachSpan(const unsigned long long span)
+{
+  CRTDebugThread* thread = contextData();
+  unsigned long long previous = thread->m_iSpan;
+  thread->m_iSpan = span;
+
+  return previous;
+}
+
+unsigned long long CRTDebug::currentSpan()
+{
+  return contextData()->m_iSpan;
+}
+
+//  Class:       CRTDebug
+//  Method:      setLayout
+//!
+//! Changes the layout of the record header. The pattern is compiled once
+//! into a list of render operations (see CRTDebugLayout::compile()), e.g.
+//! "%{green}[%D %T] %{yellow}%P.%t: %i%{class}%f:%l:%m". Records output
+//! without the lock might still use the old layout, so instead of waiting
+//! for the calls of other threads it is kept until destroy().
+//!
+//! @param  pattern  the layout pattern or NULL for the default one
+//! @return          false if the pattern is invalid
+////////////////////////////////////////////////////////////////////////////////
+bool CRTDebug::setLayout(const char* pattern)
+{
+  if(m_pData->m_bDormant == true)
+    return false;
+
+  CRTDebugLayout* layout = new CRTDebugLayout();
+  if(layout->compile(pattern != NULL ? pattern : DEFAULT_LAYOUT) == false)
+  {
+    delete layout;
+    return false;
+  }
+
+  LOCK_OUTPUTSTREAM;
+
+  m_pData->m_RetiredLayouts.push_back(m_pData->m_pLayout.exchange(layout));
+
+  UNLOCK_OUTPUTSTREAM;
+
+  return true;
+}
+
+const char* CRTDebug::layout() const
+{
+  return m_pData->m_pLayout.load()->m_sPattern.c_str();
+}
+
+//  Class:       CRTDebug
+//  Method:      setPerCPUBuffers
+//!
+//! Switches to per-CPU record buffers. Debug records are then output
+//! without taking the output stream lock and a background thread merges
+//! the buffers of all CPUs into the output sink. The mode stays active
+//! until destroy(). As records of running threads are no longer serialised
+//! the volume accounting is not available in this mode.
+//!
+//! @param  size     the size of each of the two buffers per CPU
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebug::setPerCPUBuffers(size_t size)
+{
+  if(m_pData->m_bDormant == true)
+    return;
+
+  LOCK_OUTPUTSTREAM;
+
+  if(m_pData->m_pPerCPU == NULL && size > 0)
+  {
+    m_pData->m_pPerCPU = new CRTDebugPerCPU(size);
+    m_pData->m_CollectThread = std::thread(&CRTDebugPrivate::collectThread, m_pData);
+  }
+
+  UNLOCK_OUTPUTSTREAM;
+}
+
+//  Class:       CRTDebug
+//  Method:      setPerThreadFiles
+//!
+//! Lets every thread write its debug records to its own file named
+//! "<prefix>.<pid>.<epoch>.<thread id>" without taking the output stream
+//! lock at all. Records output under the lock (reports and the repeat
+//! summaries of terminating threads) still go to the regular output. The
+//! files are combined into the usual interleaved view by tools/rtdebug-merge.
+//! The mode stays active until destroy() and takes precedence over per-CPU
+//! buffers. The epoch counts the instances of the process, so the files of
+//! an instance created after destroy() don't append to the old ones. If a
+//! file can't be opened the thread keeps using the regular output. The
+//! volume accounting is not available in this mode.
+//!
+//! @param  prefix   the path prefix of the per-thread files
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebug::setPerThreadFiles(const char* prefix)
+{
+  if(m_pData->m_bDormant == true)
+    return;
+
+  LOCK_OUTPUTSTREAM;
+
+  if(m_pData->m_bPerThread == false && prefix != NULL && *prefix != '\0')
+  {
+    m_pData->m_sPerThreadPrefix = prefix;
+    m_pData->m_bHighlighting = false;
+    m_pData->m_bPerThread = true;
+  }
+
+  UNLOCK_OUTPUTSTREAM;
+}
+
+const char* CRTDebug::perThreadFiles() const
+{
+  return m_pData->m_bPerThread ? m_pData->m_sPerThreadPrefix.c_str() : NULL;
+}
+
+//  Class:       CRTDebug
+//  Method:      setBatchedOutput
+//!
+//! Writes the records to plain files and the terminal in batches instead
+//! of one write() call per record (see CRTDebugBatchSink). A batch is
+//! written once it reaches the byte threshold, once its oldest record is
+//! held back for the maximum delay or right away with a record of one of
+//! the flush classes. Block compressed and columnar trace files are not
+//! batched, as they buffer their records themselves.
+//!
+//! @param  size          the byte threshold of a batch, 0 to write every record
+//! @param  maxDelay      the maximum time a record is held back in ms (0 = no limit)
+//! @param  flushClasses  the debug classes which are written immediately
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebug::setBatchedOutput(size_t size, unsigned int maxDelay, unsigned int flushClasses)
+{
+  if(m_pData->m_bDormant == true)
+    return;
+
+  LOCK_OUTPUTSTREAM;
+
+  if(m_pData->m_pPerCPU != NULL)
+    m_pData->m_pPerCPU->collect(m_pData->m_pOutput);
+
+  // unwrap the actual sink from the queue and the previous batching
+  CRTDebugSink* sink = m_pData->m_pOutput;
+  size_t asyncSize = 0;
+  unsigned int maxWait = 0;
+  if(m_pData->m_pAsync != NULL)
+  {
+    asyncSize = m_pData->m_pAsync->size();
+    maxWait = m_pData->m_pAsync->maxWait();
+    sink = m_pData->releaseAsync();
+  }
+
+  if(m_pData->m_pBatch != NULL)
+  {
+    sink = m_pData->m_pBatch->release();
+    delete m_pData->m_pBatch;
+    m_pData->m_pBatch = NULL;
+  }
+
+  m_pData->m_iBatchSize = size;
+  m_pData->m_iBatchDelay = maxDelay;
+  m_pData->m_iBatchClasses = flushClasses;
+  sink = m_pData->batchSink(sink);
+
+  m_pData->m_pOutput = asyncSize > 0 ? m_pData->asyncSink(sink, asyncSize, maxWait) : sink;
+
+  UNLOCK_OUTPUTSTREAM;
+}
+
+size_t CRTDebug::batchedOutput() const
+{
+  return m_pData->m_iBatchSize;
+}
+
+//  Class:       CRTDebug
+//  Method:      setArena
+//!
+//! Reserves the preallocated and prefaulted arena all trace buffers are
+//! taken from (see CRTDebugArena), so that tracing neither allocates memory
+//! nor causes page faults once the buffers reached their steady state size.
+//! Buffers allocated before stay on the heap until they grow. The arena
+//! can only be reserved once per process and is never freed. Its usage is
+//! part of the overhead report.
+//!
+//! @param  size     the size of the arena in bytes
+//! @param  pages    DBA_NORMAL, DBA_THP or DBA_HUGETLB
+//!
+//! @return      true if the arena was reserved
+////////////////////////////////////////////////////////////////////////////////
+bool CRTDebug::setArena(size_t size, int pages)
+{
+  if(m_pData->m_bDormant == true)
+    return false;
+
+  return CRTDebugArena::instance()->reserve(size, pages);
+}
+
+size_t CRTDebug::arenaSize() const
+{
+  return CRTDebugArena::instance()->size();
+}
+
+//  Class:       CRTDebug
+//  Method:      setAsyncOutput
+//!
+//! Decouples the output sink from the threads emitting debug records by a
+//! bounded queue and a writer thread (see CRTDebugAsyncSink). What happens
+//! to records once the queue is full is decided by the overload policy of
+//! their debug class (see setOverloadPolicy()).
+//!
+//! @param  size     the size of the queue in bytes, 0 to write synchronously
+//! @param  maxWait  the maximum time a blocking record waits in ms (0 = forever)
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebug::setAsyncOutput(size_t size, unsigned int maxWait)
+{
+  if(m_pData->m_bDormant == true)
+    return;
+
+  LOCK_OUTPUTSTREAM;
+
+  if(m_pData->m_pPerCPU != NULL)
+    m_pData->m_pPerCPU->collect(m_pData->m_pOutput);
+
+  // unwrap the actual sink by flushing and replacing the queue
+  CRTDebugSink* sink = m_pData->m_pOutput;
+  if(m_pData->m_pAsync != NULL)
+    sink = m_pData->releaseAsync();
+
+  m_pData->m_pOutput = size > 0 ? m_pData->asyncSink(sink, size, maxWait) : sink;
+
+  UNLOCK_OUTPUTSTREAM;
+}
+
+size_t CRTDebug::asyncOutput() const
+{
+  return m_pData->m_pAsync != NULL ? m_pData->m_pAsync->size() : 0;
+}
+
+//  Class:       CRTDebug
+//  Method:      setOverloadPolicy
+//!
+//! Sets what happens to records of certain debug classes if the queue of
+//! the asynchronous output is full: DBP_BLOCK waits for free space (at most
+//! the maximum wait), DBP_DROPNEWEST drops the record, DBP_DROPOLDEST drops
+//! the oldest queued records instead and DBP_SAMPLE only keeps every n-th
+//! record. By default errors, assertions and warnings block while all other
+//! classes drop the newest records.
+//!
+//! @param  classes  the debug classes to set the policy of
+//! @param  policy   one of the DBP_ policies
+//! @param  rate     keep every rate-th record with DBP_SAMPLE
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebug::setOverloadPolicy(unsigned int classes, int policy, unsigned int rate)
+{
+  if(m_pData->m_bDormant == true)
+    return;
+
+  LOCK_OUTPUTSTREAM;
+
+  for(unsigned int i=0; i < ASYNC_CLASSES; i++)
+  {
+    if(classes & (1U << i))
+    {
+      m_pData->m_Overload[i].policy = policy;
+      m_pData->m_Overload[i].rate = rate > 0 ? rate : 1;
+
+      if(m_pData->m_pAsync != NULL)
+        m_pData->m_pAsync->setPolicy(1U << i, m_pData->m_Overload[i]);
+    }
+  }
+
+  UNLOCK_OUTPUTSTREAM;
+}
+
+//  Class:       CRTDebug
+//  Method:      reportOverload
+//!
+//! Outputs the number of records passed to the asynchronous output and the
+//! number of records dropped per debug class.
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebug::reportOverload()
+{
+  if(m_pData->m_bDormant == true)
+    return;
+
+  if(m_pData->m_pAsync != NULL)
+    m_pData->reportOverload();
+}
+
+size_t CRTDebug::perCPUBuffers() const
+{
+  return m_pData->m_pPerCPU != NULL ? m_pData->m_pPerCPU->bufferSize() : 0;
+}
+
+//  Class:       CRTDebug
+//  Method:      reportOverhead
+//!
+//! Outputs the time each thread spent waiting for and holding the output
+//! lock, formatting records and writing them to the output sink as a
+//! fraction of the wall time since its first record.
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebug::reportOverhead()
+{
+  if(m_pData->m_bDormant == true)
+    return;
+
+  if(m_pData->m_bOverhead == true)
+    m_pData->reportOverhead();
+}
+
+//  Class:       CRTDebug
+//  Method:      setOverheadAccounting
+//!
+//! Enables the measurement of the time spent within the debugging framework
+//! by each thread. The overhead is reported by reportOverhead() and at
+//! destroy().
+//!
+//! @param  enable   true to enable the accounting
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebug::setOverheadAccounting(bool enable)
+{
+  if(m_pData->m_bDormant == true)
+    return;
+
+  m_pData->m_bOverhead = enable;
+}
+
+bool CRTDebug::overheadAccounting() const
+{
+  return m_pData->m_bOverhead;
+}
+
+//  Class:       CRTDebug
+//  Method:      setProfile
+//!
+//! Enables the profiling of all ENTER()/LEAVE() calls and STARTCLOCK()/
+//! STOPCLOCK() timers, whether their records are output or not. The count,
+//! total, mean, standard deviation and percentiles of the durations are
+//! written to a tab separated profile file at destroy() or by
+//! writeProfile(), which can be compared with the one of another run by
+//! tools/rtdebug-diff.
+//!
+//! @param  filename  the profile file to write or NULL to stop profiling
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebug::setProfile(const char* filename)
+{
+  if(m_pData->m_bDormant == true)
+    return;
+
+  LOCK_OUTPUTSTREAM;
+
+  m_pData->m_sProfileFile = filename != NULL ? filename : "";
+  m_pData->m_bProfile = (filename != NULL);
+
+  UNLOCK_OUTPUTSTREAM;
+}
+
+const char* CRTDebug::profile() const
+{
+  return m_pData->m_bProfile == true ? m_pData->m_sProfileFile.c_str() : NULL;
+}
+
+//  Class:       CRTDebug
+//  Method:      writeProfile
+//!
+//! Writes the profile collected so far by all threads.
+//!
+//! @param  filename  the file to write or NULL for the one set by setProfile()
+//! @return           false if the file could not be written
+////////////////////////////////////////////////////////////////////////////////
+bool CRTDebug::writeProfile(const char* filename)
+{
+  if(m_pData->m_bDormant == true)
+    return false;
+
+  if(filename == NULL)
+  {
+    if(m_pData->m_bProfile == false)
+      return false;
+
+    filename = m_pData->m_sProfileFile.c_str();
+  }
+
+  return m_pData->writeProfile(filename);
+}
+
+//  Class:       CRTDebug
+//  Method:      setLookback
+//!
+//! Keeps the last suppressed records of each thread in a lookback buffer.
+//! When an error or failed assertion is output, the records are formatted
+//! and output right before it, so that the context of the error is visible
+//! even with the verbose debug classes switched off. Recording a suppressed
+//! record only copies its arguments, the formatting is done on output only.
+//!
+//! @param  records     the number of records kept per thread, 0 to disable
+//! @param  classes     the debug classes to keep in the buffer
+//! @param  allThreads  output the buffers of all threads and not only of the
+//!                     thread causing the error
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebug::setLookback(unsigned int records, unsigned int classes, bool allThreads)
+{
+  if(m_pData->m_bDormant == true)
+    return;
+
+  LOCK_OUTPUTSTREAM;
+
+  m_pData->m_iLookbackSize = records;
+  m_pData->m_iLookbackClasses = records > 0 ? classes : 0;
+  m_pData->m_bLookbackAllThreads = allThreads;
+
+  UNLOCK_OUTPUTSTREAM;
+}
+
+unsigned int CRTDebug::lookback() const
+{
+  return m_pData->m_iLookbackSize;
+}
+
+//  Class:       CRTDebug
+//  Method:      setThreadScope
+//!
+//! Enables debug classes for a single thread only, e.g. to see the call
+//! tracing of one worker thread of a pool. The classes are enabled in
+//! addition to the globally enabled ones. Threads which are not in scope
+//! only pay a thread-local bit test for the check.
+//!
+//! @param  threadID  the ID of the thread as shown in the output
+//! @param  classes   the debug classes to enable for the thread
+//! @param  module    limit the classes to this module and its submodules
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebug::setThreadScope(unsigned int threadID, unsigned int classes, const char* module)
+{
+  if(m_pData->m_bDormant == true)
+    return;
+
+  CRTDebugThreadScope scope;
+  scope.threadID = threadID;
+  scope.classes = classes;
+  scope.module = module != NULL ? m_pData->m_pDebugModules->node(module) : NULL;
+
+  m_pData->addThreadScope(scope);
+}
+
+//  Class:       CRTDebug
+//  Method:      setThreadNameScope
+//!
+//! Enables debug classes for all threads with a matching name (as set by
+//! pthread_setname_np()). The name of a thread is checked the first time it
+//! outputs something after the scope rules were changed.
+//!
+//! @param  pattern   a shell wildcard pattern matching the thread names
+//! @param  classes   the debug classes to enable for the threads
+//! @param  module    limit the classes to this module and its submodules
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebug::setThreadNameScope(const char* pattern, unsigned int classes, const char* module)
+{
+  if(m_pData->m_bDormant == true)
+    return;
+
+  CRTDebugThreadScope scope;
+  scope.threadID = 0;
+  scope.pattern = pattern;
+  scope.classes = classes;
+  scope.module = module != NULL ? m_pData->m_pDebugModules->node(module) : NULL;
+
+  m_pData->addThreadScope(scope);
+}
+
+void CRTDebug::setCurrentThreadScope(unsigned int classes, const char* module)
+{
+  if(m_pData->m_bDormant == true)
+    return;
+
+  LOCK_OUTPUTSTREAM;
+  unsigned int threadID = m_pData->currentThread()->m_iThreadID;
+  UNLOCK_OUTPUTSTREAM;
+
+  setThreadScope(threadID, classes, module);
+}
+
+void CRTDebug::clearThreadScope()
+{
+  if(m_pData->m_bDormant == true)
+    return;
+
+  LOCK_OUTPUTSTREAM;
+
+  m_pData->m_ThreadScopes.clear();
+  m_pData->m_iScopeGeneration = 0;
+
+  UNLOCK_OUTPUTSTREAM;
+}
+
+//  Class:       CRTDebug
+//  Method:      setOutputFile
+//!
+//! Redirects all debug output (the info messages stay on the console) to
+//! a file. With the DBO_COMPRESS option a block compressed trace file with
+//! a time index is written instead of a plain text file, DBO_COLUMNS exports
+//! the records column-wise with dictionary encoded strings for offline
+//! analytics (see CRTDebugColumnWriter). With DBO_URING a plain text file is
+//! written asynchronously via io_uring (falling back to batched pwritev()
+//! calls where it is not available). As trace files are normally not viewed
+//! on a terminal, ANSI highlighting is switched off and has to be switched
+//! on again explicitly if wanted.
+//!
+//! @param  filename  the file to write to or NULL to return to stderr
+//! @param  options   DBO_* output options
+//! @return           false if the file could not be opened
+////////////////////////////////////////////////////////////////////////////////
+bool CRTDebug::setOutputFile(const char* filename, unsigned int options)
+{
+  if(m_pData->m_bDormant == true)
+    return false;
+
+  CRTDebugSink* sink;
+
+  if(filename == NULL)
+    sink = new CRTDebugFileSink(STDERR_FILENO);
+  else if(options & DBO_COLUMNS)
+  {
+    CRTDebugColumnWriter* writer = new CRTDebugColumnWriter(filename);
+    if(writer->isOpen() == false)
+    {
+      delete writer;
+      return false;
+    }
+
+    sink = writer;
+  }
+  else if(options & DBO_COMPRESS)
+  {
+    CRTDebugBlockWriter* writer = new CRTDebugBlockWriter(filename);
+    if(writer->isOpen() == false)
+    {
+      delete writer;
+      return false;
+    }
+
+    sink = writer;
+  }
+  else if(options & DBO_URING)
+  {
+    CRTDebugUringSink* uring = new CRTDebugUringSink(filename);
+    if(uring->isOpen() == false)
+    {
+      delete uring;
+      return false;
+    }
+
+    sink = uring;
+  }
+  else
+  {
+    CRTDebugFileSink* file = new CRTDebugFileSink(filename);
+    if(file->isOpen() == false)
+    {
+      delete file;
+      return false;
+    }
+
+    sink = file;
+  }
+
+  LOCK_OUTPUTSTREAM;
+
+  // the records collected so far still belong to the old sink
+  if(m_pData->m_pPerCPU != NULL)
+    m_pData->m_pPerCPU->collect(m_pData->m_pOutput);
+
+  // the old queue is written out before the new sink is decoupled in the
+  // same way
+  size_t asyncSize = 0;
+  unsigned int maxWait = 0;
+  CRTDebugSink* old = m_pData->m_pOutput;
+  if(m_pData->m_pAsync != NULL)
+  {
+    asyncSize = m_pData->m_pAsync->size();
+    maxWait = m_pData->m_pAsync->maxWait();
+    old = m_pData->releaseAsync();
+  }
+
+  m_pData->m_pBatch = NULL;
+  sink = m_pData->batchSink(sink);
+
+  if(asyncSize > 0)
+    sink = m_pData->asyncSink(sink, asyncSize, maxWait);
+
+  delete old;
+  m_pData->m_pOutput = sink;
+  m_pData->m_bHighlighting = (filename == NULL);
+
+  UNLOCK_OUTPUTSTREAM;
+
+  return true;
+}
+
+bool CRTDebugPrivate::matchDebugSpec(const int cl, const CRTDebugModule* module, const char* file)
+{
+  // the global module tree still holds the configuration of the last
+  // instance, which must not let records through the dormant one
+  if(m_bDormant == true)
+    return false;
+
+  bool result = false;
+
+  // first we check if we need to process this debug message or not,
+  // depending on the currently set debug level
+  if(((m_iDebugClasses & cl)) != 0)
+    result = true;
+
+  // now we search through our sourcefileMap and see if we should suppress
+  // the output or force it.
+  if(file != NULL && m_DebugFiles.empty() == false)
+  {
+    NameCompare cmp(file);
+    std::map<std::string, bool>::iterator iter = find_if(m_DebugFiles.begin(), m_DebugFiles.end(), cmp);
+    if(iter != m_DebugFiles.end())
+    {
+      if((*iter).second == true)
+        result = true;
+      else
         result = false;
     }
   }
 
-  return result;
+  // the node of the module was looked up once by the call site and
+  // always carries the resolved state of the module
+  if(module != NULL)
+  {
+    int state = module->state.load(std::memory_order_relaxed);
+    if(state >= 0)
+      result = (state == 1);
+  }
+
+  // classes enabled for the calling thread only
+  if(result == false)
+    result = matchThreadScope(cl, module);
+
+  return result;
+}
+
+bool CRTDebugPrivate::matchInfoSpec(const int cl, const char* module, const char* file)
+{
+  if(m_bDormant == true)
+    return false;
+
+  bool result = false;
+
+  // first we check if we need to process this debug message or not,
+  // depending on the currently set debug level
+  if(((m_iInfoClasses & cl)) != 0)
+    result = true;
+
+  // now we search through our sourcefileMap and see if we should suppress
+  // the output or force it.
+  if(file != NULL && m_InfoFiles.empty() == false)
+  {
+    NameCompare cmp(file);
+    std::map<std::string, bool>::iterator iter = find_if(m_InfoFiles.begin(), m_InfoFiles.end(), cmp);
+    if(iter != m_InfoFiles.end())
+    {
+      if((*iter).second == true)
+        result = true;
+      else
+        result = false;
+    }
+  }
+
+  if(module != NULL)
+  {
+    const CRTDebugModule* node = m_InfoModules.resolve(module);
+    int state = node->state.load(std::memory_order_relaxed);
+    if(state >= 0)
+      result = (state == 1);
+  }
+
+  return result;
+}
+
+//  Class:       CRTDebugPrivate
+//  Method:      matchThreadScope
+//!
+//! Checks if a debug class is enabled for the calling thread by a thread
+//! scope rule. The classes enabled for a thread are cached in its thread
+//! local data and only recalculated after the rules were changed.
+//!
+//! @param  cl       the debug class of the record
+//! @param  module   the module node of the record
+//! @return          true if the class is enabled for the thread
+////////////////////////////////////////////////////////////////////////////////
+bool CRTDebugPrivate::matchThreadScope(const int cl, const CRTDebugModule* module)
+{
+  unsigned int generation = m_iScopeGeneration.load(std::memory_order_acquire);
+  if(generation == 0)
+    return false;
+
+  CRTDebugThread* thread = contextData();
+  if(thread->m_iScopeGeneration != generation || thread->m_pOwner != this)
+    updateThreadScope(thread);
+
+  if(thread->m_iScopeClasses & cl)
+    return true;
+
+  if((thread->m_iScopeModuleClasses & cl) && module != NULL && module->name != NULL)
+  {
+    // check if the module is the scope module or one of its submodules
+    const CRTDebugModuleNode* node = static_cast<const CRTDebugModuleNode*>(module);
+    for(size_t i=0; i < thread->m_ScopeModules.size(); i++)
+    {
+      if((thread->m_ScopeModules[i].first & cl) == 0)
+        continue;
+
+      for(const CRTDebugModuleNode* n = node; n != NULL; n = n->m_pParent)
+      {
+        if(n == thread->m_ScopeModules[i].second)
+          return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+//  Class:       CRTDebugPrivate
+//  Method:      updateThreadScope
+//!
+//! Recalculates the classes the scope rules enable for a thread.
+//!
+//! @param  thread   the data of the calling thread
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugPrivate::updateThreadScope(CRTDebugThread* thread)
+{
+  char name[64] = "";
+  if(thread->m_sName.empty() == false)
+    strncpy(name, thread->m_sName.c_str(), sizeof(name)-1);
+  #if defined(HAVE_PTHREAD_GETNAME_NP)
+  else
+    pthread_getname_np(pthread_self(), name, sizeof(name));
+  #endif
+
+  #if defined(HAVE_LIBPTHREAD)
+  pthread_mutex_lock(&m_pCoutMutex);
+  #endif
+
+  // make sure the thread has its ID assigned
+  currentThread();
+
+  thread->m_iScopeClasses = 0;
+  thread->m_iScopeModuleClasses = 0;
+  thread->m_ScopeModules.clear();
+
+  for(size_t i=0; i < m_ThreadScopes.size(); i++)
+  {
+    const CRTDebugThreadScope& scope = m_ThreadScopes[i];
+
+    if(scope.threadID != 0 ? scope.threadID != thread->m_iThreadID
+                           : fnmatch(scope.pattern.c_str(), name, 0) != 0)
+    {
+      continue;
+    }
+
+    if(scope.module == NULL)
+      thread->m_iScopeClasses |= scope.classes;
+    else
+    {
+      thread->m_iScopeModuleClasses |= scope.classes;
+      thread->m_ScopeModules.push_back(std::make_pair(scope.classes, scope.module));
+    }
+  }
+
+  thread->m_iScopeGeneration = m_iScopeGeneration;
+
+  #if defined(HAVE_LIBPTHREAD)
+  pthread_mutex_unlock(&m_pCoutMutex);
+  #endif
+}
+
+void CRTDebugPrivate::addThreadScope(const CRTDebugThreadScope& scope)
+{
+  #if defined(HAVE_LIBPTHREAD)
+  pthread_mutex_lock(&m_pCoutMutex);
+  #endif
+
+  m_ThreadScopes.push_back(scope);
+  m_iScopeGeneration = ++m_iScopeCounter;
+
+  #if defined(HAVE_LIBPTHREAD)
+  pthread_mutex_unlock(&m_pCoutMutex);
+  #endif
+}
+
+void CRTDebugPrivate::lookback(const int cl, const char* file, const long line, const char* fmt, ...)
+{
+  va_list args;
+  va_start(args, fmt);
+  vlookback(cl, file, line, fmt, args, 1);
+  va_end(args);
+}
+
+// stores a suppressed record with a raw value following its message
+void CRTDebugPrivate::lookbackValue(const int cl, const char* file, const long line, const CRTDebugRawValue* value, const char* fmt, ...)
+{
+  va_list args;
+  va_start(args, fmt);
+  vlookback(cl, file, line, fmt, args, 1, value);
+  va_end(args);
+}
+
+//  Class:       CRTDebugPrivate
+//  Method:      vlookback
+//!
+//! Stores a suppressed record in the lookback buffer of the calling thread.
+//!
+//! @param  cl       the debug class of the record
+//! @param  file     the filename of the source file
+//! @param  line     the line number on which the macro was placed
+//! @param  fmt      the format string of the record message
+//! @param  args     the arguments to the format string
+//! @param  skip     the number of calling frames within the framework
+//! @param  value    an optional raw value following the message
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugPrivate::vlookback(const int cl, const char* file, const long line, const char* fmt, va_list args, const int skip,
+                                const CRTDebugRawValue* value)
+{
+  CRTDebugThread* thread = contextData();
+
+  // (re)allocating the buffer has to be done with the output locked as
+  // other threads might output the buffer at the same time
+  if(thread->m_pOwner != this || thread->m_pLookback == NULL ||
+     thread->m_pLookback->capacity() != m_iLookbackSize)
+  {
+    #if defined(HAVE_LIBPTHREAD)
+    pthread_mutex_lock(&m_pCoutMutex);
+    #endif
+
+    currentThread();
+
+    if(thread->m_pLookback == NULL || thread->m_pLookback->capacity() != m_iLookbackSize)
+    {
+      delete thread->m_pLookback;
+      thread->m_pLookback = new CRTDebugLookback(m_iLookbackSize);
+    }
+
+    #if defined(HAVE_LIBPTHREAD)
+    pthread_mutex_unlock(&m_pCoutMutex);
+    #endif
+  }
+
+  struct timeval tp;
+  #if defined(HAVE_GETTIMEOFDAY)
+  gettimeofday(&tp, NULL);
+  #else
+  tp.tv_sec = GetTickCount() / MILLISEC;
+  tp.tv_usec = 0;
+  #endif
+
+  // in deferred mode the backtrace is symbolized on output only
+  void* frames[LOOKBACK_FRAMES];
+  int count = 0;
+  if(m_bBacktraceDeferred == true && (m_iBacktraceClasses & cl))
+    count = CRTDebugBacktrace::capture(frames, LOOKBACK_FRAMES, skip+2);
+
+  thread->m_pLookback->record(&tp, cl, file, line, thread->m_iIdentLevel, fmt, args, frames, count, value);
+}
+
+//  Class:       CRTDebugPrivate
+//  Method:      dumpLookback
+//!
+//! Formats and outputs the records of the lookback buffer of a thread and
+//! empties it. Has to be called with the output stream locked. The thread
+//! may be another one still writing records itself (lookbackall), so the
+//! records are formatted into a local buffer and none of the record state
+//! of the thread is touched.
+//!
+//! @param  thread   the data of the thread to output the buffer of
+//! @param  span     the span to output the records with
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugPrivate::dumpLookback(CRTDebugThread* thread, const unsigned long long span)
+{
+  if(thread->m_pLookback == NULL)
+    return;
+
+  std::lock_guard<std::mutex> lock(thread->m_pLookback->mutex());
+
+  CRTDebugBuffer buf;
+  CRTDebugTimeCache cache;
+  cache.second = -1;
+
+  for(size_t i=0; i < thread->m_pLookback->size(); i++)
+  {
+    const CRTDebugLookbackEntry& entry = thread->m_pLookback->entry(i);
+
+    buf.clear();
+    formatHeader(buf, cache, thread->m_iThreadID, &entry.time, classColor(entry.cls), entry.file, entry.line, entry.ident, span);
+    size_t headerLength = buf.length();
+    CRTDebugLookback::format(entry, buf);
+
+    CRTDebugRecordInfo info;
+    info.time = entry.time.tv_sec*1000000ULL + entry.time.tv_usec;
+    info.cls = entry.cls;
+    info.threadID = thread->m_iThreadID;
+    info.file = entry.file;
+    info.line = entry.line;
+    info.format = entry.fmt;
+    info.indent = entry.ident;
+    info.messageOffset = headerLength;
+    info.messageLength = buf.length() - headerLength;
+
+    finishRecord(buf, true);
+    CRTDebugBacktrace::append(buf, entry.frames, entry.frameCount);
+
+    output(info, buf.data(), buf.length());
+  }
+
+  thread->m_pLookback->clear();
+}
+
+//  Class:       CRTDebugPrivate
+//  Method:      reportCounters
+//!
+//! Outputs one record per counter. The records are attributed to the call
+//! site which first used the counter.
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugPrivate::reportCounters()
+{
+  std::vector<CRTDebugCounterValue> values;
+  CRTDebugCounters::instance()->snapshot(values);
+
+  #if defined(HAVE_LIBPTHREAD)
+  pthread_mutex_lock(&m_pCoutMutex);
+  #endif
+
+  struct timeval tp;
+  gettimeofday(&tp, NULL);
+
+  double elapsed = (tp.tv_sec - m_LastCounterReport.tv_sec) +
+                   (tp.tv_usec - m_LastCounterReport.tv_usec) / (double)MICROSEC;
+
+  CRTDebugThread* thread = currentThread();
+  CRTDebugBuffer& buf = RECORD_BUFFER;
+
+  m_LastCounts.resize(values.size(), 0);
+  for(size_t i=0; i < values.size(); i++)
+  {
+    const CRTDebugCounterValue& v = values[i];
+
+    buf.clear();
+    appendHeader(buf, thread, &tp, DBC_REPORT_COLOR, v.file, v.line);
+
+    switch(v.type)
+    {
+      case DBN_COUNT: buf.append("count "); break;
+      case DBN_GAUGE: buf.append("gauge "); break;
+      default:        buf.append("max "); break;
+    }
+
+    buf.append(v.name.c_str());
+    buf.append(" = ");
+    if(v.valid == true)
+      buf.appendDec(v.value);
+    else
+      buf.append('-');
+
+    if(v.type == DBN_COUNT)
+    {
+      long long delta = v.value - m_LastCounts[i];
+      buf.appendf(" (+%lld, %.1f/s)", delta, elapsed > 0 ? delta/elapsed : 0.0);
+      m_LastCounts[i] = v.value;
+    }
+
+    finishRecord(buf, true);
+
+    CRTDebugRecordInfo info;
+    info.time = tp.tv_sec*1000000ULL + tp.tv_usec;
+    info.cls = DBC_REPORT;
+    info.threadID = thread->m_iThreadID;
+
+    output(info, buf.data(), buf.length());
+  }
+
+  m_LastCounterReport = tp;
+
+  #if defined(HAVE_LIBPTHREAD)
+  pthread_mutex_unlock(&m_pCoutMutex);
+  #endif
+}
+
+//  Class:       CRTDebugPrivate
+//  Method:      reportVolume
+//!
+//! Sums up the output volume of all threads per call site, module, class
+//! and thread and outputs one record per category listing the entries with
+//! the highest byte rate since the last report.
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugPrivate::reportVolume()
+{
+  #if defined(HAVE_LIBPTHREAD)
+  pthread_mutex_lock(&m_pCoutMutex);
+  #endif
+
+  struct timeval tp;
+  gettimeofday(&tp, NULL);
+
+  double elapsed = (tp.tv_sec - m_LastVolumeReport.tv_sec) +
+                   (tp.tv_usec - m_LastVolumeReport.tv_usec) / (double)MICROSEC;
+
+  // the call sites of all threads. Sites of the same file compiled into
+  // different translation units are joined by their name.
+  CRTDebugVolume sites;
+  sites.merge(m_RetiredVolume);
+  for(std::set<CRTDebugThread*>::iterator it = m_Threads.begin(); it != m_Threads.end(); ++it)
+    sites.merge((*it)->m_Volume);
+
+  static const char* categories[] = { "call site", "module", "class", "thread" };
+  std::map<std::string, CRTDebugVolumeCount> totals[4];
+  char key[256];
+
+  for(CRTDebugVolume::SiteMap::const_iterator it = sites.sites().begin(); it != sites.sites().end(); ++it)
+  {
+    const CRTDebugVolumeSite& site = it->second;
+
+    snprintf(key, sizeof(key), "%s:%ld", strrchr(site.file, '/') ? strrchr(site.file, '/')+1 : site.file, site.line);
+    totals[0][key].records += site.count.records;
+    totals[0][key].bytes += site.count.bytes;
+
+    const char* module = site.module != NULL ? site.module : "(none)";
+    totals[1][module].records += site.count.records;
+    totals[1][module].bytes += site.count.bytes;
+
+    const char* cls = "(unknown)";
+    for(size_t i=0; i < sizeof(dbclasses)/sizeof(dbclasses[0]); i++)
+    {
+      if(site.cls == (int)dbclasses[i].flag)
+        cls = dbclasses[i].token;
+    }
+    totals[2][cls].records += site.count.records;
+    totals[2][cls].bytes += site.count.bytes;
+  }
+
+  for(std::map<unsigned int, CRTDebugVolumeCount>::iterator it = m_RetiredThreads.begin(); it != m_RetiredThreads.end(); ++it)
+  {
+    snprintf(key, sizeof(key), "%u (terminated)", it->first);
+    totals[3][key] = it->second;
+  }
+  for(std::set<CRTDebugThread*>::iterator it = m_Threads.begin(); it != m_Threads.end(); ++it)
+  {
+    if((*it)->m_Volume.total().records == 0)
+      continue;
+
+    snprintf(key, sizeof(key), "%u", (*it)->m_iThreadID);
+    totals[3][key] = (*it)->m_Volume.total();
+  }
+
+  CRTDebugThread* thread = currentThread();
+  CRTDebugBuffer& buf = RECORD_BUFFER;
+
+  for(int c=0; c < 4; c++)
+  {
+    // rank the entries by the bytes output since the last report
+    std::vector<std::pair<unsigned long long, std::map<std::string, CRTDebugVolumeCount>::iterator> > ranking;
+    for(std::map<std::string, CRTDebugVolumeCount>::iterator it = totals[c].begin(); it != totals[c].end(); ++it)
+    {
+      const CRTDebugVolumeCount& last = m_LastVolume[std::string(categories[c]) + ' ' + it->first];
+      ranking.push_back(std::make_pair(it->second.bytes - last.bytes, it));
+    }
+
+    size_t count = std::min((size_t)m_iVolumeTop, ranking.size());
+    std::partial_sort(ranking.begin(), ranking.begin()+count, ranking.end(),
+                      [](const std::pair<unsigned long long, std::map<std::string, CRTDebugVolumeCount>::iterator>& a,
+                         const std::pair<unsigned long long, std::map<std::string, CRTDebugVolumeCount>::iterator>& b)
+                      { return a.first > b.first; });
+
+    buf.clear();
+    appendHeader(buf, thread, &tp, DBC_REPORT_COLOR, __FILE__, __LINE__);
+    buf.appendf(" output volume by %s (top %zu of %zu, %.1fs):", categories[c], count, ranking.size(), elapsed);
+
+    for(size_t i=0; i < count; i++)
+    {
+      const CRTDebugVolumeCount& current = ranking[i].second->second;
+      CRTDebugVolumeCount& last = m_LastVolume[std::string(categories[c]) + ' ' + ranking[i].second->first];
+      unsigned long long records = current.records - last.records;
+
+      buf.appendf("\n    %-32s %10.1f records/s %12.1f bytes/s  (total %llu records, %llu bytes)",
+                  ranking[i].second->first.c_str(),
+                  elapsed > 0 ? records/elapsed : 0.0, elapsed > 0 ? ranking[i].first/elapsed : 0.0,
+                  current.records, current.bytes);
+    }
+
+    finishRecord(buf, true);
+
+    CRTDebugRecordInfo info;
+    info.time = tp.tv_sec*1000000ULL + tp.tv_usec;
+    info.cls = DBC_REPORT;
+    info.threadID = thread->m_iThreadID;
+
+    output(info, buf.data(), buf.length());
+
+    for(std::map<std::string, CRTDebugVolumeCount>::iterator it = totals[c].begin(); it != totals[c].end(); ++it)
+      m_LastVolume[std::string(categories[c]) + ' ' + it->first] = it->second;
+  }
+
+  m_LastVolumeReport = tp;
+
+  #if defined(HAVE_LIBPTHREAD)
+  pthread_mutex_unlock(&m_pCoutMutex);
+  #endif
+}
+
+//  Class:       CRTDebugPrivate
+//  Method:      threadOverhead
+//!
+//! Collects the overhead of a thread. Has to be called with the output
+//! stream locked.
+////////////////////////////////////////////////////////////////////////////////
+CRTDebugOverhead CRTDebugPrivate::threadOverhead(const CRTDebugThread* thread, const unsigned long long now)
+{
+  CRTDebugOverhead overhead;
+  overhead.threadID = thread->m_iThreadID;
+  overhead.wall = now - thread->m_iOverheadStart;
+  overhead.lockWait = thread->m_iLockWait;
+  overhead.lockHold = thread->m_iLockHold;
+  overhead.io = thread->m_iIOTime;
+  overhead.records = thread->m_iRecords;
+  overhead.bytes = thread->m_iBytes;
+
+  return overhead;
+}
+
+//  Class:       CRTDebugPrivate
+//  Method:      reportOverhead
+//!
+//! Outputs one record with a line per thread. The formatting time is the
+//! time the lock was held minus the time spent in the output sink. The
+//! time the reporting thread holds the lock for this report is not yet
+//! included.
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugPrivate::reportOverhead()
+{
+  lockOutput();
+
+  struct timeval tp;
+  gettimeofday(&tp, NULL);
+  unsigned long long now = monotonicTime();
+
+  std::vector<CRTDebugOverhead> overheads(m_RetiredOverhead);
+  for(std::set<CRTDebugThread*>::iterator it = m_Threads.begin(); it != m_Threads.end(); ++it)
+  {
+    if((*it)->m_iOverheadStart != 0)
+      overheads.push_back(threadOverhead(*it, now));
+  }
+
+  std::sort(overheads.begin(), overheads.end(),
+            [](const CRTDebugOverhead& a, const CRTDebugOverhead& b) { return a.threadID < b.threadID; });
+
+  CRTDebugThread* thread = currentThread();
+  CRTDebugBuffer& buf = RECORD_BUFFER;
+
+  buf.clear();
+  appendHeader(buf, thread, &tp, DBC_REPORT_COLOR, __FILE__, __LINE__);
+  buf.append(" own overhead per thread (percent of wall time):");
+
+  CRTDebugOverhead total;
+  memset(&total, 0, sizeof(total));
+
+  for(size_t i=0; i < overheads.size(); i++)
+  {
+    const CRTDebugOverhead& o = overheads[i];
+    double wall = o.wall > 0 ? o.wall / 100.0 : 1.0;
+    unsigned long long format = o.lockHold > o.io ? o.lockHold - o.io : 0;
+
+    buf.appendf("\n    thread %u: %.3fms wall, lock wait %.3f%%, lock hold %.3f%% (format %.3f%%, I/O %.3f%%), total %.3f%%, %llu records, %llu bytes",
+                o.threadID, o.wall / 1e6, o.lockWait / wall, o.lockHold / wall, format / wall, o.io / wall,
+                (o.lockWait + o.lockHold) / wall, o.records, o.bytes);
+
+    total.lockWait += o.lockWait;
+    total.lockHold += o.lockHold;
+    total.io += o.io;
+    total.records += o.records;
+    total.bytes += o.bytes;
+  }
+
+  buf.appendf("\n    all threads: lock wait %.3fms, lock hold %.3fms, I/O %.3fms, %llu records, %llu bytes",
+              total.lockWait / 1e6, total.lockHold / 1e6, total.io / 1e6, total.records, total.bytes);
+
+  CRTDebugArena* arena = CRTDebugArena::instance();
+  if(arena->size() > 0)
+  {
+    buf.appendf("\n    buffer arena: %zu KB with %s pages, %zu KB allocated, %zu KB in use, %llu heap fallbacks",
+                arena->size()/1024, arena->pageType(), arena->peak()/1024, arena->used()/1024, arena->fallbacks());
+  }
+
+  finishRecord(buf, true);
+
+  CRTDebugRecordInfo info;
+  info.time = tp.tv_sec*1000000ULL + tp.tv_usec;
+  info.cls = DBC_REPORT;
+  info.threadID = thread->m_iThreadID;
+
+  output(info, buf.data(), buf.length());
+
+  unlockOutput();
+}
+
+//  Class:       CRTDebugPrivate
+//  Method:      flushOutput
+//!
+//! Writes out the records held back in the per-CPU buffers and the current
+//! batch. Records queued for the asynchronous output stay queued, so this
+//! never waits for a slow output. Has to be called with the output lock
+//! held.
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugPrivate::flushOutput()
+{
+  if(m_pPerCPU != NULL)
+    m_pPerCPU->collect(m_pOutput);
+
+  if(m_pBatch != NULL)
+    m_pBatch->flush();
+}
+
+// wraps a plain file sink into a batching one if batching is enabled
+CRTDebugSink* CRTDebugPrivate::batchSink(CRTDebugSink* sink)
+{
+  if(m_iBatchSize == 0 || dynamic_cast<CRTDebugFileSink*>(sink) == NULL)
+    return sink;
+
+  m_pBatch = new CRTDebugBatchSink(sink, m_iBatchSize, m_iBatchDelay, m_iBatchClasses);
+
+  return m_pBatch;
+}
+
+// wraps a sink into an asynchronous one using the current overload policies
+CRTDebugSink* CRTDebugPrivate::asyncSink(CRTDebugSink* sink, const size_t size, const unsigned int maxWait)
+{
+  m_pAsync = new CRTDebugAsyncSink(sink, size, maxWait);
+  for(unsigned int i=0; i < ASYNC_CLASSES; i++)
+    m_pAsync->setPolicy(1U << i, m_Overload[i]);
+
+  return m_pAsync;
+}
+
+// writes out and removes the asynchronous output, keeping its counts for
+// the overload report, and returns the sink it wrapped
+CRTDebugSink* CRTDebugPrivate::releaseAsync()
+{
+  unsigned long long records[ASYNC_CLASSES];
+  unsigned long long dropped[ASYNC_CLASSES];
+
+  CRTDebugSink* sink = m_pAsync->release();
+  m_pAsync->counts(records, dropped);
+
+  for(unsigned int i=0; i < ASYNC_CLASSES; i++)
+  {
+    m_RetiredRecords[i] += records[i];
+    m_RetiredDropped[i] += dropped[i];
+  }
+
+  delete m_pAsync;
+  m_pAsync = NULL;
+
+  return sink;
+}
+
+//  Class:       CRTDebugPrivate
+//  Method:      profileThread
+//!
+//! Returns the data of the current trace context for the profiling. As
+//! this is also called for records which are not output, the thread might
+//! have to be registered without the output lock held.
+////////////////////////////////////////////////////////////////////////////////
+CRTDebugThread* CRTDebugPrivate::profileThread()
+{
+  CRTDebugThread* thread = contextData();
+
+  if(thread->m_pOwner != this)
+  {
+    lockOutput();
+    if(thread->m_pOwner != this)
+      registerThread(thread);
+    unlockOutput();
+  }
+
+  return thread;
+}
+
+//  Class:       CRTDebugPrivate
+//  Method:      writeProfile
+//!
+//! Joins the profiles of all running and terminated threads and writes
+//! them to a profile file.
+//!
+//! @param  filename the file to write
+//! @return          false if the file could not be written
+////////////////////////////////////////////////////////////////////////////////
+bool CRTDebugPrivate::writeProfile(const char* filename)
+{
+  CRTDebugProfileMap functions;
+  CRTDebugProfileMap timers;
+
+  lockOutput();
+
+  m_RetiredProfile.collect(functions, timers);
+  for(std::set<CRTDebugThread*>::iterator it = m_Threads.begin(); it != m_Threads.end(); ++it)
+  {
+    std::lock_guard<std::mutex> lock((*it)->m_Profile.mutex());
+    (*it)->m_Profile.collect(functions, timers);
+  }
+
+  unlockOutput();
+
+  return CRTDebugProfile::write(filename, functions, timers, m_PID);
+}
+
+//  Class:       CRTDebugPrivate
+//  Method:      reportOverload
+//!
+//! Outputs one record with the number of records and losses per class of
+//! the asynchronous output.
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugPrivate::reportOverload()
+{
+  unsigned long long records[ASYNC_CLASSES];
+  unsigned long long dropped[ASYNC_CLASSES];
+
+  lockOutput();
+
+  // make room for the report, but not for longer than a blocking record
+  // would wait
+  m_pAsync->flush(m_pAsync->maxWait());
+  m_pAsync->counts(records, dropped);
+
+  // including the outputs replaced before
+  for(unsigned int i=0; i < ASYNC_CLASSES; i++)
+  {
+    records[i] += m_RetiredRecords[i];
+    dropped[i] += m_RetiredDropped[i];
+  }
+
+  struct timeval tp;
+  gettimeofday(&tp, NULL);
+
+  CRTDebugThread* thread = currentThread();
+  CRTDebugBuffer& buf = RECORD_BUFFER;
+
+  buf.clear();
+  appendHeader(buf, thread, &tp, DBC_REPORT_COLOR, __FILE__, __LINE__);
+  buf.append(" asynchronous output per class (dropped of all records):");
+
+  for(unsigned int i=0; i < ASYNC_CLASSES; i++)
+  {
+    if(records[i] == 0)
+      continue;
+
+    const char* name = NULL;
+    for(int c=0; dbclasses[c].token != NULL; c++)
+    {
+      if(dbclasses[c].flag == (1U << i))
+        name = dbclasses[c].token;
+    }
+
+    buf.append("\n    ");
+    if(name != NULL)
+      buf.append(name);
+    else
+      buf.appendf("class %u", i);
+    buf.appendf(": %llu of %llu", dropped[i], records[i]);
+  }
+
+  finishRecord(buf, true);
+
+  CRTDebugRecordInfo info;
+  info.time = tp.tv_sec*1000000ULL + tp.tv_usec;
+  info.cls = DBC_REPORT;
+  info.threadID = thread->m_iThreadID;
+
+  output(info, buf.data(), buf.length());
+
+  unlockOutput();
+}
+
+//  Class:       CRTDebugPrivate
+//  Method:      output
+//!
+//! Passes a finished record to the output sink or, with per-CPU buffers,
+//! appends it to the buffer of the current CPU. If that buffer is full all
+//! buffers are collected right away. With per-thread files records output
+//! without the lock go to the own file of the thread instead.
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugPrivate::output(const CRTDebugRecordInfo& info, const char* data, const size_t len)
+{
+  if(m_bPerThread == true && threadData.m_bUnlocked == true)
+  {
+    CRTDebugSink* sink = threadOutput(info.time);
+    if(sink != NULL && sink->write(info, data, len) == true)
+      return;
+
+    // fall back to the regular output if the file couldn't be written
+    #if defined(HAVE_LIBPTHREAD)
+    pthread_mutex_lock(&m_pCoutMutex);
+    #endif
+
+    m_pOutput->write(info, data, len);
+
+    #if defined(HAVE_LIBPTHREAD)
+    pthread_mutex_unlock(&m_pCoutMutex);
+    #endif
+    return;
+  }
+
+  if(m_pPerCPU == NULL)
+  {
+    m_pOutput->write(info, data, len);
+    return;
+  }
+
+  if(m_pPerCPU->append(info, data, len) == true)
+    return;
+
+  #if defined(HAVE_LIBPTHREAD)
+  bool unlocked = threadData.m_bUnlocked;
+  if(unlocked == true)
+    pthread_mutex_lock(&m_pCoutMutex);
+  #endif
+
+  m_pPerCPU->collect(m_pOutput);
+
+  // records larger than a buffer are written directly
+  if(m_pPerCPU->append(info, data, len) == false)
+    m_pOutput->write(info, data, len);
+
+  #if defined(HAVE_LIBPTHREAD)
+  if(unlocked == true)
+    pthread_mutex_unlock(&m_pCoutMutex);
+  #endif
+}
+
+//  Class:       CRTDebugPrivate
+//  Method:      threadOutput
+//!
+//! Returns the own output file of the current OS thread, which is opened
+//! on its first record as "<prefix>.<pid>.<epoch>.<thread id>". The file
+//! starts with a line holding the date of its first record, which lets
+//! tools/rtdebug-merge put the times of day of the records in order.
+//!
+//! @param  time     the time of the first record (usec since the epoch)
+//! @return          the file or NULL if it couldn't be opened, which is
+//!                  only tried once per thread and instance
+////////////////////////////////////////////////////////////////////////////////
+CRTDebugSink* CRTDebugPrivate::threadOutput(const unsigned long long time)
+{
+  CRTDebugThread* thread = &threadData;
+  if(thread->m_pThreadOutput != NULL || thread->m_bThreadOutputFailed == true)
+    return thread->m_pThreadOutput;
+
+  if(thread->m_pOwner != this)
+    registerThread(thread);
+
+  std::string filename = m_sPerThreadPrefix + "." + std::to_string(m_PID) + "." +
+                         std::to_string(m_iEpoch) + "." + std::to_string(thread->m_iThreadID);
+  CRTDebugFileSink* sink = new CRTDebugFileSink(filename.c_str());
+  if(sink->isOpen() == false)
+  {
+    delete sink;
+    thread->m_bThreadOutputFailed = true;
+    return NULL;
+  }
+
+  time_t seconds = time / MICROSEC;
+  struct tm tm_time;
+  LOCALTIME(&tm_time, &seconds);
+
+  char date[20];
+  char header[128];
+  strftime(date, sizeof(date), "%F %T", &tm_time);
+  int len = snprintf(header, sizeof(header), "*** rtdebug thread %u of process %d started %s.%06ld\n",
+                     thread->m_iThreadID, m_PID, date, (long)(time % MICROSEC));
+
+  CRTDebugRecordInfo info;
+  info.time = time;
+  info.cls = DBC_REPORT;
+  info.threadID = thread->m_iThreadID;
+  sink->write(info, header, len);
+
+  thread->m_pThreadOutput = sink;
+
+  return sink;
+}
+
+void CRTDebugPrivate::collectThread()
+{
+  std::unique_lock<std::mutex> lock(m_CollectMutex);
+
+  while(m_bCollectQuit == false)
+  {
+    m_CollectCond.wait_for(lock, std::chrono::milliseconds(PERCPU_INTERVAL));
+    lock.unlock();
+
+    #if defined(HAVE_LIBPTHREAD)
+    pthread_mutex_lock(&m_pCoutMutex);
+    #endif
+
+    m_pPerCPU->collect(m_pOutput);
+
+    #if defined(HAVE_LIBPTHREAD)
+    pthread_mutex_unlock(&m_pCoutMutex);
+    #endif
+
+    lock.lock();
+  }
+}
+
+void CRTDebugPrivate::stopCollectThread()
+{
+  if(m_CollectThread.joinable() == false)
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(m_CollectMutex);
+    m_bCollectQuit = true;
+  }
+
+  m_CollectCond.notify_all();
+  m_CollectThread.join();
+}
+
+void CRTDebugPrivate::reportThread()
+{
+  std::unique_lock<std::mutex> lock(m_ReportMutex);
+  std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now() +
+                                               std::chrono::seconds(m_iReportInterval);
+
+  while(m_bReportQuit == false)
+  {
+    // wake up at least once per coalescing window to output expired summaries
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point wakeup = next;
+    if(m_iCoalesceTime > 0 && (m_iReportInterval == 0 || now + std::chrono::milliseconds(m_iCoalesceTime) < next))
+      wakeup = now + std::chrono::milliseconds(m_iCoalesceTime);
+
+    if(m_ReportCond.wait_until(lock, wakeup) == std::cv_status::timeout)
+    {
+      lock.unlock();
+
+      if(m_iCoalesceTime > 0)
+        flushExpiredRepeats();
+
+      if(m_iReportInterval > 0 && std::chrono::steady_clock::now() >= next)
+      {
+        if(CRTDebugCounters::instance()->size() > 0)
+          reportCounters();
+
+        if(m_iVolumeTop > 0)
+          reportVolume();
+
+        next += std::chrono::seconds(m_iReportInterval);
+      }
+
+      lock.lock();
+    }
+  }
+}
+
+void CRTDebugPrivate::startReportThread()
+{
+  if(m_iReportInterval == 0 && m_iCoalesceTime == 0)
+    return;
+
+  m_bReportQuit = false;
+  m_ReportThread = std::thread(&CRTDebugPrivate::reportThread, this);
 }
 
-bool CRTDebugPrivate::matchInfoSpec(const int cl, const char* module, const char* file)
+void CRTDebugPrivate::stopReportThread()
 {
-  bool result = false;
+  if(m_ReportThread.joinable() == false)
+    return;
 
-  // first we check if we need to process this debug message or not,
-  // depending on the currently set debug level
-  if(((m_iInfoClasses & cl)) != 0)
-    result = true;
+  {
+    std::lock_guard<std::mutex> lock(m_ReportMutex);
+    m_bReportQuit = true;
+  }
 
-  // now we search through our sourcefileMap and see if we should suppress
-  // the output or force it.
-  if(file != NULL)
+  m_ReportCond.notify_all();
+  m_ReportThread.join();
+}
+
+//  Class:       CRTDebugPrivate
+//  Method:      appendHeader
+//!
+//! Appends the default header (time, process/thread id, indention and
+//! source file position) of an output record to the supplied buffer.
+//!
+//! @param  buf        the record buffer to append the header to
+//! @param  thread     the data of the calling thread
+//! @param  tp         the time information of the record
+//! @param  highlight  the ANSI color sequence to use for the record text
+//! @param  file       the filename of the source file
+//! @param  line       the line number on which the macro was placed
+//! @param  ident      the indention or -1 for the current one of the thread
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugPrivate::appendHeader(CRTDebugBuffer& buf, CRTDebugThread* thread, const struct timeval* tp,
+                                   const char* highlight, const char* file, const long line, const int ident)
+{
+  thread->m_pFile = file;
+  thread->m_iLine = line;
+  thread->m_pHighlight = highlight;
+  thread->m_pFunction = NULL;
+  thread->m_pFormat = NULL;
+
+  formatHeader(buf, thread->m_TimeCache, thread->m_iThreadID, tp, highlight, file, line,
+               ident >= 0 ? ident : thread->m_iIdentLevel, thread->m_iSpan);
+
+  thread->m_iHeaderLength = buf.length();
+}
+
+//  Class:       CRTDebugPrivate
+//  Method:      formatHeader
+//!
+//! Renders the record header of the current layout into a buffer without
+//! touching the data of any thread.
+//!
+//! @param  buf        the record buffer to append the header to
+//! @param  cache      the formatted time of the previous header
+//! @param  threadID   the ID of the thread the record belongs to
+//! @param  tp         the time information of the record
+//! @param  highlight  the ANSI color sequence to use for the record text
+//! @param  file       the filename of the source file
+//! @param  line       the line number on which the macro was placed
+//! @param  ident      the indention of the record
+//! @param  span       the span of the record or 0
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugPrivate::formatHeader(CRTDebugBuffer& buf, CRTDebugTimeCache& cache, const unsigned int threadID,
+                                   const struct timeval* tp, const char* highlight, const char* file,
+                                   const long line, const int ident, const unsigned long long span)
+{
+  const CRTDebugLayout* layout = m_pLayout.load(std::memory_order_acquire);
+  const int h = m_bHighlighting ? 1 : 0;
+  const std::vector<CRTDebugLayout::Op>& ops = layout->m_Header[h];
+  const char* literals = layout->m_sLiterals[h].data();
+
+  if(layout->m_bTime == true && tp->tv_sec != cache.second)
   {
-    NameCompare cmp(file);
-    std::map<std::string, bool>::iterator iter = find_if(m_InfoFiles.begin(), m_InfoFiles.end(), cmp);
-    if(iter != m_InfoFiles.end())
+    time_t tt_time = tp->tv_sec;
+    struct tm tm_time;
+    LOCALTIME(&tm_time, &tt_time);
+
+    #if defined(HAVE_STRFTIME)
+    strftime(cache.time, sizeof(cache.time), "%T", &tm_time);
+    strftime(cache.date, sizeof(cache.date), "%F", &tm_time);
+    #else
+    cache.time[0] = '\0';
+    cache.date[0] = '\0';
+    #endif
+
+    cache.second = tp->tv_sec;
+  }
+
+  for(size_t i=0; i < ops.size(); i++)
+  {
+    const CRTDebugLayout::Op& op = ops[i];
+
+    switch(op.type)
     {
-      if((*iter).second == true)
-        result = true;
-      else
-        result = false;
+      case CRTDebugLayout::LITERAL:
+        buf.append(literals + op.offset, op.length);
+      break;
+
+      case CRTDebugLayout::TIME:
+        buf.append(cache.time);
+        buf.append('.');
+        buf.appendDec(tp->tv_usec, 6, '0');
+      break;
+
+      case CRTDebugLayout::DATE:
+        buf.append(cache.date);
+      break;
+
+      case CRTDebugLayout::PID:
+        buf.appendDec(m_PID, PROCESS_WIDTH);
+      break;
+
+      case CRTDebugLayout::THREAD:
+        #if defined(HAVE_LIBPTHREAD)
+        if(h == 1)
+        {
+          buf.append(ANSI_ESC_BG);
+          buf.appendDec(threadID%6);
+          buf.append('m');
+          buf.appendDec(threadID, THREAD_WIDTH, '0');
+          buf.append(ANSI_ESC_CLR);
+        }
+        else
+          buf.appendDec(threadID, THREAD_WIDTH, '0');
+        #endif
+      break;
+
+      case CRTDebugLayout::INDENT:
+        buf.append(' ', ident);
+      break;
+
+      case CRTDebugLayout::FILE:
+        buf.append(strrchr(file, '/') ? strrchr(file, '/')+1 : file);
+      break;
+
+      case CRTDebugLayout::PATH:
+        buf.append(file);
+      break;
+
+      case CRTDebugLayout::LINE:
+        buf.appendDec(line);
+      break;
+
+      case CRTDebugLayout::SEQUENCE:
+        buf.appendDec(m_iSequence.fetch_add(1, std::memory_order_relaxed));
+      break;
+
+      case CRTDebugLayout::SPAN:
+        if(span != 0)
+        {
+          buf.append('#');
+          buf.appendHex(span);
+          buf.append(' ');
+        }
+      break;
+
+      case CRTDebugLayout::COLOR:
+        buf.append(highlight);
+      break;
     }
   }
+}
 
-  if(module != NULL)
+//  Class:       CRTDebugPrivate
+//  Method:      finishRecord
+//!
+//! Finishes an output record by appending the constant text following the
+//! message in the layout, resetting the highlighting and adding the
+//! trailing newline.
+//!
+//! @param  buf      the completely assembled record buffer
+//! @param  newline  a newline will be added at the end
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugPrivate::finishRecord(CRTDebugBuffer& buf, const bool newline)
+{
+  const std::string& trailer = m_pLayout.load(std::memory_order_acquire)->m_sTrailer[m_bHighlighting ? 1 : 0];
+  if(trailer.empty() == false)
+    buf.append(trailer.data(), trailer.length());
+
+  if(m_bHighlighting)
+    buf.append(ANSI_ESC_CLR);
+
+  if(newline == true)
+    buf.append('\n');
+}
+
+//  Class:       CRTDebugPrivate
+//  Method:      writeRecord
+//!
+//! Finishes a debug output record and passes it in one piece to the
+//! currently active output sink, unless it is coalesced with the
+//! previous record of the thread.
+//!
+//! @param  buf      the completely assembled record buffer
+//! @param  thread   the data of the calling thread
+//! @param  cl       the debug class of the record
+//! @param  module   the module node of the record
+//! @param  tp       the time information of the record
+//! @param  newline  a newline will be added at the end
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugPrivate::writeRecord(CRTDebugBuffer& buf, CRTDebugThread* thread, const int cl,
+                                  const CRTDebugModule* module, const struct timeval* tp, const bool newline)
+{
+  // the source information of the record is taken before any lookback or
+  // repeat summary records are assembled with the same thread data
+  CRTDebugRecordInfo info;
+  info.time = tp->tv_sec*1000000ULL + tp->tv_usec;
+  info.cls = cl;
+  info.threadID = thread->m_iThreadID;
+  info.file = thread->m_pFile;
+  info.line = thread->m_iLine;
+  info.module = module != NULL ? module->name : NULL;
+  info.function = thread->m_pFunction;
+  info.format = thread->m_pFormat;
+  info.span = thread->m_iSpan;
+  info.indent = thread->m_iIdentLevel;
+  info.messageOffset = thread->m_iHeaderLength;
+  info.messageLength = buf.length() - thread->m_iHeaderLength;
+
+  finishRecord(buf, newline);
+
+  if(coalesceRecord(buf, thread, cl, tp) == true)
+    return;
+
+  // errors are preceded by the records suppressed before
+  if(m_iLookbackSize > 0 && (cl & (DBC_ERROR | DBC_ASSERT)))
   {
-    std::map<std::string, bool>::iterator it = m_InfoModules.find(module);
-    if(it != m_InfoModules.end())
+    if(m_bLookbackAllThreads == true)
     {
-      if((*it).second == true)
-        result = true;
-      else
-        result = false;
+      // the list of threads is only protected by the output lock
+      #if defined(HAVE_LIBPTHREAD)
+      bool unlocked = threadData.m_bUnlocked;
+      if(unlocked == true)
+      {
+        pthread_mutex_lock(&m_pCoutMutex);
+        threadData.m_bUnlocked = false;
+      }
+      #endif
+
+      for(std::set<CRTDebugThread*>::iterator it = m_Threads.begin(); it != m_Threads.end(); ++it)
+        dumpLookback(*it, *it == thread ? thread->m_iSpan : 0);
+
+      #if defined(HAVE_LIBPTHREAD)
+      if(unlocked == true)
+      {
+        threadData.m_bUnlocked = true;
+        pthread_mutex_unlock(&m_pCoutMutex);
+      }
+      #endif
     }
+    else
+      dumpLookback(thread, thread->m_iSpan);
   }
 
-  return result;
+  // output the backtrace as part of the record
+  if(m_iBacktraceClasses & cl)
+    appendBacktrace(buf, 1);
+
+  if(m_iVolumeTop > 0 && threadData.m_bUnlocked == false)
+    thread->m_Volume.account(info.file, info.line, info.module, cl, buf.length());
+
+  if(m_bOverhead.load(std::memory_order_relaxed) == true)
+  {
+    unsigned long long start = monotonicTime();
+    output(info, buf.data(), buf.length());
+    threadData.m_iIOTime += monotonicTime() - start;
+    threadData.m_iRecords++;
+    threadData.m_iBytes += buf.length();
+  }
+  else
+    output(info, buf.data(), buf.length());
+
+  // errors should reach the output quickly
+  if(threadData.m_bUnlocked == true && (cl & (DBC_ERROR | DBC_ASSERT)))
+    m_CollectCond.notify_one();
+}
+
+//  Class:       CRTDebugPrivate
+//  Method:      appendBacktrace
+//!
+//! Appends the symbolized backtrace of the calling thread to a finished
+//! record.
+//!
+//! @param  buf      the finished record buffer
+//! @param  skip     the number of calling frames within the framework
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugPrivate::appendBacktrace(CRTDebugBuffer& buf, const int skip)
+{
+  void* frames[BACKTRACE_FRAMES];
+  int count = CRTDebugBacktrace::capture(frames, BACKTRACE_FRAMES, skip+2);
+
+  if(count > 0 && buf.length() > 0 && buf.data()[buf.length()-1] != '\n')
+    buf.append('\n');
+
+  CRTDebugBacktrace::append(buf, frames, count);
+}
+
+//  Class:       CRTDebugPrivate
+//  Method:      coalesceRecord
+//!
+//! Compares a finished record with the last one the thread has written.
+//! If it came from the same source position, has the same class and the
+//! same text, it is only counted. A summary of the counted repeats is
+//! output once the time window is over or a different record follows.
+//!
+//! @param  buf      the completely assembled record buffer
+//! @param  thread   the data of the calling thread
+//! @param  cl       the debug class of the record
+//! @param  tp       the time information of the record
+//! @return          true if the record was coalesced and must not be output
+////////////////////////////////////////////////////////////////////////////////
+bool CRTDebugPrivate::coalesceRecord(CRTDebugBuffer& buf, CRTDebugThread* thread, const int cl,
+                                     const struct timeval* tp)
+{
+  if(m_iCoalesceTime == 0)
+    return false;
+
+  // the header contains the time, so only the message text is compared
+  const char* text = buf.data() + thread->m_iHeaderLength;
+  size_t len = buf.length() - thread->m_iHeaderLength;
+
+  if(thread->m_pLastFile == thread->m_pFile && thread->m_iLastLine == thread->m_iLine &&
+     thread->m_iLastClass == cl && thread->m_iLastSpan == thread->m_iSpan &&
+     thread->m_sLastRecord.compare(0, std::string::npos, text, len) == 0)
+  {
+    long elapsed = (tp->tv_sec - thread->m_WindowStart.tv_sec)*MILLISEC +
+                   (tp->tv_usec - thread->m_WindowStart.tv_usec)/MILLISEC;
+
+    // once the time window is over the record itself starts a new one
+    if(elapsed >= (long)m_iCoalesceTime)
+    {
+      flushRepeats(thread);
+      memcpy(&(thread->m_WindowStart), tp, sizeof(struct timeval));
+
+      return false;
+    }
+
+    if(thread->m_iRepeatCount++ == 0)
+      memcpy(&(thread->m_RepeatStart), tp, sizeof(struct timeval));
+    memcpy(&(thread->m_RepeatLast), tp, sizeof(struct timeval));
+
+    return true;
+  }
+
+  // flushRepeats() outputs a header itself, so save the position first
+  const char* file = thread->m_pFile;
+  long line = thread->m_iLine;
+  const char* highlight = thread->m_pHighlight;
+
+  flushRepeats(thread);
+
+  thread->m_sLastRecord.assign(text, len);
+  thread->m_pLastFile = file;
+  thread->m_iLastLine = line;
+  thread->m_iLastClass = cl;
+  thread->m_pLastHighlight = highlight;
+  thread->m_iLastSpan = thread->m_iSpan;
+  memcpy(&(thread->m_WindowStart), tp, sizeof(struct timeval));
+
+  return false;
+}
+
+//  Class:       CRTDebugPrivate
+//  Method:      flushRepeats
+//!
+//! Outputs the "last message repeated N times" summary of a thread in case
+//! repeated records were coalesced. Has to be called with the output
+//! stream locked.
+//!
+//! @param  thread   the data of the thread to output the summary for
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugPrivate::flushRepeats(CRTDebugThread* thread)
+{
+  if(thread->m_iRepeatCount == 0)
+    return;
+
+  long elapsed = (thread->m_RepeatLast.tv_sec - thread->m_RepeatStart.tv_sec)*MILLISEC +
+                 (thread->m_RepeatLast.tv_usec - thread->m_RepeatStart.tv_usec)/MILLISEC;
+
+  // the summary belongs to the span of the repeated record
+  unsigned long long span = thread->m_iSpan;
+  thread->m_iSpan = thread->m_iLastSpan;
+
+  CRTDebugBuffer& buf = thread->m_SummaryBuffer;
+  buf.clear();
+  appendHeader(buf, thread, &(thread->m_RepeatLast), thread->m_pLastHighlight, thread->m_pLastFile, thread->m_iLastLine);
+  thread->m_iSpan = span;
+  buf.append(" last message repeated ");
+  buf.appendDec(thread->m_iRepeatCount);
+  buf.append(thread->m_iRepeatCount == 1 ? " time over " : " times over ");
+  buf.appendDec(elapsed);
+  buf.append(" ms");
+
+  CRTDebugRecordInfo info;
+  info.time = thread->m_RepeatLast.tv_sec*1000000ULL + thread->m_RepeatLast.tv_usec;
+  info.cls = thread->m_iLastClass;
+  info.threadID = thread->m_iThreadID;
+  info.file = thread->m_pLastFile;
+  info.line = thread->m_iLastLine;
+  info.span = thread->m_iLastSpan;
+  info.indent = thread->m_iIdentLevel;
+  info.messageOffset = thread->m_iHeaderLength;
+  info.messageLength = buf.length() - thread->m_iHeaderLength;
+
+  finishRecord(buf, true);
+
+  output(info, buf.data(), buf.length());
+
+  thread->m_iRepeatCount = 0;
+}
+
+//  Class:       CRTDebugPrivate
+//  Method:      flushExpiredRepeats
+//!
+//! Outputs the repeat summaries of all threads whose coalescing window is
+//! over, so that they do not wait for the next record of their thread.
+//! Called periodically by the report thread. In the unlocked modes the
+//! records of a thread are only touched by the thread itself, so their
+//! summaries are left to it.
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugPrivate::flushExpiredRepeats()
+{
+  if(m_pPerCPU != NULL || m_bPerThread == true)
+    return;
+
+  struct timeval now;
+  gettimeofday(&now, NULL);
+
+  lockOutput();
+
+  for(std::set<CRTDebugThread*>::iterator it = m_Threads.begin(); it != m_Threads.end(); ++it)
+  {
+    CRTDebugThread* thread = *it;
+    if(thread->m_iRepeatCount == 0)
+      continue;
+
+    long elapsed = (now.tv_sec - thread->m_WindowStart.tv_sec)*MILLISEC +
+                   (now.tv_usec - thread->m_WindowStart.tv_usec)/MILLISEC;
+
+    if(elapsed >= (long)m_iCoalesceTime)
+      flushRepeats(thread);
+  }
+
+  unlockOutput();
+}
+
+//  Class:       CRTDebugPrivate
+//  Method:      currentThread
+//!
+//! Returns the data of the current trace context, which is the calling
+//! thread unless a logical context was switched to. A thread or context
+//! outputting something for the first time is registered and gets its own
+//! thread ID assigned. Has to be called with the output stream locked (or
+//! locked for a record with per-CPU buffers).
+//!
+//! @return      the data of the current trace context
+////////////////////////////////////////////////////////////////////////////////
+CRTDebugThread* CRTDebugPrivate::currentThread()
+{
+  CRTDebugThread* thread = contextData();
+
+  if(thread->m_pOwner != this)
+    registerThread(thread);
+
+  // the own overhead is still accounted to the OS thread
+  if(m_bOverhead.load(std::memory_order_relaxed) == true && thread != &threadData && threadData.m_pOwner != this)
+    registerThread(&threadData);
+
+  return thread;
+}
+
+//  Class:       CRTDebugPrivate
+//  Method:      registerThread
+//!
+//! Registers a thread or trace context and assigns its thread ID.
+//!
+//! @param  thread   the data of the thread or context
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugPrivate::registerThread(CRTDebugThread* thread)
+{
+  // without the output lock held the registration has to be locked
+  #if defined(HAVE_LIBPTHREAD)
+  if(threadData.m_bUnlocked == true)
+    pthread_mutex_lock(&m_pCoutMutex);
+  #endif
+
+  thread->m_pOwner = this;
+  thread->m_iThreadID = ++m_iThreadCount;
+  m_Threads.insert(thread);
+
+  #if defined(HAVE_LIBPTHREAD)
+  if(threadData.m_bUnlocked == true)
+    pthread_mutex_unlock(&m_pCoutMutex);
+  #endif
+}
+
+//  Class:       CRTDebugPrivate
+//  Method:      removeThread
+//!
+//! Deregisters a terminating thread and outputs its pending summary of
+//! coalesced records.
+//!
+//! @param  thread   the data of the terminating thread
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugPrivate::removeThread(CRTDebugThread* thread)
+{
+  #if defined(HAVE_LIBPTHREAD)
+  pthread_mutex_lock(&m_pCoutMutex);
+  #endif
+
+  flushRepeats(thread);
+  m_Threads.erase(thread);
+  thread->m_pOwner = NULL;
+
+  // keep the overhead and output volume of the thread for the reports
+  if(thread->m_iOverheadStart != 0)
+  {
+    m_RetiredOverhead.push_back(threadOverhead(thread, monotonicTime()));
+    thread->m_iOverheadStart = 0;
+  }
+
+  if(thread->m_Volume.total().records > 0)
+  {
+    m_RetiredVolume.merge(thread->m_Volume);
+    m_RetiredThreads[thread->m_iThreadID] = thread->m_Volume.total();
+    thread->m_Volume.clear();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(thread->m_Profile.mutex());
+    m_RetiredProfile.merge(thread->m_Profile);
+    thread->m_Profile.clear();
+  }
+
+  delete thread->m_pThreadOutput;
+  thread->m_pThreadOutput = NULL;
+
+  #if defined(HAVE_LIBPTHREAD)
+  pthread_mutex_unlock(&m_pCoutMutex);
+  #endif
+}
+
+CRTDebugThread::CRTDebugThread()
+  : m_pOwner(NULL),
+    m_iThreadID(0),
+    m_iIdentLevel(0),
+    m_pFile(NULL),
+    m_iLine(0),
+    m_pHighlight(NULL),
+    m_pFunction(NULL),
+    m_pFormat(NULL),
+    m_iHeaderLength(0),
+    m_pLastFile(NULL),
+    m_iLastLine(0),
+    m_iLastClass(0),
+    m_pLastHighlight(NULL),
+    m_iRepeatCount(0),
+    m_iScopeGeneration(0),
+    m_iScopeClasses(0),
+    m_iScopeModuleClasses(0),
+    m_pLookback(NULL),
+    m_iOverheadStart(0),
+    m_iLockStart(0),
+    m_iLockWait(0),
+    m_iLockHold(0),
+    m_iIOTime(0),
+    m_iRecords(0),
+    m_iBytes(0),
+    m_bUnlocked(false),
+    m_pThreadOutput(NULL),
+    m_bThreadOutputFailed(false),
+    m_iReferences(1),
+    m_iSpan(0),
+    m_iLastSpan(0),
+    m_TimeCache()
+{
+  m_TimeCache.second = -1;
+  memset(&m_TimeMeasure, 0, sizeof(m_TimeMeasure));
+  memset(&m_RepeatStart, 0, sizeof(m_RepeatStart));
+  memset(&m_WindowStart, 0, sizeof(m_WindowStart));
+  memset(&m_RepeatLast, 0, sizeof(m_RepeatLast));
+}
+
+CRTDebugThread::~CRTDebugThread()
+{
+  // an instance detaches all its threads with the owner mutex held before
+  // it is freed, so a set owner is still alive even while it is destroyed
+  {
+    std::lock_guard<std::mutex> lock(ownerMutex);
+    if(m_pOwner != NULL)
+      m_pOwner->removeThread(this);
+  }
+
+  delete m_pLookback;
 }
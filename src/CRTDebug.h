@@ -23,6 +23,12 @@
 #define CRTDEBUG_H
 
 #include <iostream>
+#include <atomic>
+#include <string>
+#include <type_traits>
+#include <cstddef>
+
+#include "CRTDebugValue.h"
 
 // debug classes
 #define DBC_CTRACE    (1<<0) // call tracing (ENTER/LEAVE etc.)
@@ -61,8 +67,70 @@
 #define INM_NONE      NULL
 #define INM_ALL       "all"
 
+// counter types
+#define DBN_COUNT     0 // events to be summed up       RTCOUNT()
+#define DBN_GAUGE     1 // last value set               RTGAUGE()
+#define DBN_MAX       2 // maximum of all values        RTMAX()
+
+// output options
+#define DBO_COMPRESS  (1<<0) // block compressed trace file
+#define DBO_URING     (1<<1) // asynchronous writes via io_uring (Linux)
+#define DBO_COLUMNS   (1<<2) // columnar, dictionary encoded export
+
+// page types of the trace buffer arena
+#define DBA_NORMAL      0 // regular pages
+#define DBA_THP         1 // transparent huge pages
+#define DBA_HUGETLB     2 // explicit huge pages, transparent ones if unavailable
+
+// overload policies of the asynchronous output
+#define DBP_BLOCK       0 // wait for free space (bounded)
+#define DBP_DROPNEWEST  1 // drop the new record
+#define DBP_DROPOLDEST  2 // drop the oldest queued records
+#define DBP_SAMPLE      3 // keep only every n-th record
+
+// the inline parts of the library must not show up in call traces of
+// code compiled with -finstrument-functions
+#if defined(__GNUC__)
+#define RTDEBUG_NO_INSTRUMENT __attribute__((no_instrument_function))
+#else
+#define RTDEBUG_NO_INSTRUMENT
+#endif
+
+// plain __thread variables need no access wrapper function as they are
+// always constant-initialized
+#if defined(__GNUC__)
+#define RTDEBUG_THREAD_LOCAL __thread
+#else
+#define RTDEBUG_THREAD_LOCAL thread_local
+#endif
+
 // forward declarations
 class CRTDebugPrivate;
+class CRTDebugThread;
+
+//! a logical trace context (e.g. of a coroutine) used in place of the
+//! OS thread, see CRTDebug::createContext()
+typedef CRTDebugThread CRTDebugContext;
+
+//! the count of calls a thread currently has in progress within the
+//! library. Slots are recycled when threads terminate but never freed,
+//! so that CRTDebug::destroy() can always walk over all of them.
+struct CRTDebugCallSlot
+{
+  std::atomic<unsigned int> calls;  //!< nesting depth of calls in progress
+  std::atomic<bool>         used;   //!< the slot is owned by a thread
+  CRTDebugCallSlot*         next;   //!< the next slot of the global list
+};
+
+//! the resolved configuration of a module of the hierarchical
+//! module namespace (e.g. "net.tls"). The values are changed at runtime
+//! while call sites read them, so they are only accessed atomically.
+struct CRTDebugModule
+{
+  std::atomic<int> state; //!< -1 not configured, 0 hidden, 1 shown
+  std::atomic<int> level; //!< the verbosity level used by V()
+  const char*      name;  //!< the dotted module name or NULL (DBM_NONE)
+};
 
 //  Classname:   CRTDebug
 //! @brief debugging purpose class
@@ -98,30 +166,127 @@ class CRTDebugPrivate;
 //! sync it with a mutal exclusion and as an nice addition also output the
 //! threadnumber in front of every debug output to easily identify to which
 //! thread a output belongs to.
+//!
+//! Besides the class, flag, name and module tokens, the environment variable
+//! passed to init() understands the following options (separated by " ,;",
+//! a leading '!' switches an option off):
+//!
+//!   >file                 write the records to a plain trace file. Every
+//!                         record is output with a single write() call.
+//!   compress              write a block compressed trace file with a
+//!                         seekable time index (see tools/rtdebug-cat)
+//!   columns               write a columnar trace file with delta encoded
+//!                         times, dictionary encoded source files, modules,
+//!                         functions and format strings and per-column
+//!                         compression (see tools/rtdebug-columns)
+//!   uring                 write the trace file asynchronously via io_uring
+//!                         with registered buffers (Linux), falling back to
+//!                         batched pwritev() calls
+//!   coalesce[=ms]         output repeated identical messages of a thread
+//!                         only once followed by a "repeated N times" record
+//!   %module[=level]       select dotted module names (e.g. %net,!%net.tls)
+//!                         with a verbosity level for the V() macros
+//!   lookback[=N]          keep the last N suppressed records of a thread in
+//!   lookbackall[=N]       binary form and output them on an error or failed
+//!                         assertion (of the thread or of all threads)
+//!   backtrace[=classes]   append symbolized backtraces to records of these
+//!                         classes, backtrace-deferred also captures raw
+//!                         backtraces of the records kept for the lookback
+//!   counters[=sec]        report the RTCOUNT()/RTGAUGE()/RTMAX() values at
+//!                         destroy() or periodically
+//!   volume[=N]            report the top N emitters of records and bytes per
+//!                         call site, module, class and thread
+//!   interval=sec          output the counter and volume reports periodically
+//!   overhead              report the time each thread spends waiting for and
+//!                         holding the output lock, formatting and writing
+//!   percpu[=KB]           output records into per-CPU buffers without the
+//!                         output lock, merged by time by a collector thread
+//!   instrument            trace functions compiled with -finstrument-functions
+//!                         (filtered by RTDEBUG_INSTRUMENT="+net::* -*::op*")
+//!   async[=KB[/ms]]       decouple the output by a bounded queue and a writer
+//!   overload=classes:policy  overload policy of the queue per class (block,
+//!                         drop-newest, drop-oldest or sample/N)
+//!   profile[=file]        write the ENTER()/LEAVE() and STARTCLOCK()/
+//!                         STOPCLOCK() durations as a tab separated profile
+//!                         (compared run-to-run by tools/rtdebug-diff)
+//!   perthread[=prefix]    let every thread write its own file without any
+//!                         locking (merged by tools/rtdebug-merge)
+//!   arena[=MB][/thp|/huge]  take all trace buffers from a prefaulted arena
+//!                         backed by regular, transparent or explicit huge pages
+//!   batch[=KB][/ms]       write the records in batches, flushed by size, age
+//!                         or an error/failed assertion
+//!
+//! The threads can be scoped by RTDEBUG_THREAD_SCOPE (e.g. "worker-3=ctrace")
+//! and the record header is configured by RTDEBUG_LAYOUT (e.g.
+//! "%D %T %P.%t %i%f:%l:%m"). Spans (%s) correlate work handed between threads
+//! and logical trace contexts take the place of the OS thread for coroutines.
 ////////////////////////////////////////////////////////////////////////////////
 class CRTDebug
 {
   public:
     // the static singleton instance method
-    static CRTDebug* instance();
+    static inline CRTDebug* instance() RTDEBUG_NO_INSTRUMENT;
     static void destroy();
 
     // for initialization via ENV variables
     static void init(const char* variable=0, const bool debugMode=false);
 
+    // lookup of the (cacheable) node of a debug module
+    static const CRTDebugModule* module(const char* name);
+    template<size_t N, typename C> static inline const CRTDebugModule* module(const char (&name)[N], C cache) RTDEBUG_NO_INSTRUMENT;
+    template<typename T, typename C> static inline const CRTDebugModule* module(T* const& name, C cache) RTDEBUG_NO_INSTRUMENT;
+    template<typename C> static inline const CRTDebugModule* module(std::nullptr_t, C cache) RTDEBUG_NO_INSTRUMENT;
+
+    // logical trace contexts used in place of the OS thread
+    static CRTDebugContext* createContext(const char* name=NULL);
+    static void destroyContext(CRTDebugContext* context);
+    static CRTDebugContext* switchContext(CRTDebugContext* context);
+    static inline CRTDebugContext* currentContext() RTDEBUG_NO_INSTRUMENT;
+
+    // spans correlating work handed between threads
+    static unsigned long long createSpan();
+    static unsigned long long attachSpan(const unsigned long long span);
+    static unsigned long long currentSpan();
+
+    // sharded counters, gauges and maxima
+    static int counter(const char* name, const int type, const char* file, const long line);
+    static void count(const int id, const int type, const long long value);
+
     // our main debug output methods
-    std::ostream& Enter(const int c, const char* m, const char* file, const long line, const char* function);
-    std::ostream& Leave(const int c, const char* m, const char* file, const long line, const char* function);
-    std::ostream& Return(const int c, const char* m, const char* file, const long line, const char* function, const long result);
-    std::ostream& ShowValue(const int c, const char* m, const long long value, const int size, const char* name, const char* file, const long line);
-    std::ostream& ShowPointer(const int c, const char* m, const void* pointer, const char* name, const char* file, const long line);
-    std::ostream& ShowString(const int c, const char* m, const char* string, const char* name, const char* file, const long line);
-    std::ostream& ShowMessage(const int c, const char* m, const char* string, const char* file, const long line);
-    std::ostream& StartClock(const int c, const char* m, const char* string, const char* file, const long line);
-    std::ostream& StopClock(const int c, const char* m, const char* string, const char* file, const long line);
+    std::ostream& Enter(const int c, const CRTDebugModule* m, const char* file, const long line, const char* function);
+    std::ostream& Leave(const int c, const CRTDebugModule* m, const char* file, const long line, const char* function);
+    std::ostream& Return(const int c, const CRTDebugModule* m, const char* file, const long line, const char* function, const long result);
+    std::ostream& ShowValue(const int c, const CRTDebugModule* m, const long long value, const int size, const char* name, const char* file, const long line);
+    std::ostream& ShowFormatted(const int c, const CRTDebugModule* m, const void* value, CRTDebugFormatFunc format, CRTDebugCaptureFunc capture, const char* name, const char* file, const long line);
+    std::ostream& ShowPointer(const int c, const CRTDebugModule* m, const void* pointer, const char* name, const char* file, const long line);
+    std::ostream& ShowString(const int c, const CRTDebugModule* m, const char* string, const char* name, const char* file, const long line);
+
+    // type dependent variants of SHOWVALUE() and SHOWSTRING(). Integers keep
+    // their decimal/hex output, all other values are only formatted (see
+    // CRTDebugFormat) if the record is actually output.
+    template<typename T> typename std::enable_if<(std::is_integral<T>::value && std::is_same<T, bool>::value == false) || std::is_enum<T>::value, std::ostream&>::type
+      ShowValue(const int c, const CRTDebugModule* m, const T& value, const char* name, const char* file, const long line)
+    {
+      return ShowValue(c, m, (long long)value, sizeof(value), name, file, line);
+    }
+
+    template<typename T> typename std::enable_if<(std::is_integral<T>::value && std::is_same<T, bool>::value == false) == false && std::is_enum<T>::value == false, std::ostream&>::type
+      ShowValue(const int c, const CRTDebugModule* m, const T& value, const char* name, const char* file, const long line)
+    {
+      return ShowFormatted(c, m, &value, &CRTDebugFormat::formatErased<T>, &CRTDebugFormat::captureErased<T>, name, file, line);
+    }
+
+    std::ostream& ShowString(const int c, const CRTDebugModule* m, const std::string& string, const char* name, const char* file, const long line)
+    {
+      return ShowFormatted(c, m, &string, &CRTDebugFormat::formatErased<std::string>, &CRTDebugFormat::captureErased<std::string>, name, file, line);
+    }
+    std::ostream& ShowMessage(const int c, const CRTDebugModule* m, const char* string, const char* file, const long line);
+    std::ostream& StartClock(const int c, const CRTDebugModule* m, const char* string, const char* file, const long line);
+    std::ostream& StopClock(const int c, const CRTDebugModule* m, const char* string, const char* file, const long line);
+    std::ostream& Flow(const int c, const CRTDebugModule* m, const unsigned long long span, const bool receive, const char* file, const long line);
 
     // some raw methods to format text like printf() does
-    std::ostream& dprintf(const int c, const char* m, const char* file, const long line, const bool newline, const char* fmt, ...);
+    std::ostream& dprintf(const int c, const CRTDebugModule* m, const char* file, const long line, const bool newline, const char* fmt, ...);
     std::ostream& printf(const int c, const char* m, const char* file, const long line, const bool newline, const char* fmt, ...);
 
     // general public methods to control debug class
@@ -133,11 +298,18 @@ class CRTDebug
     void setDebugFlag(unsigned int fl);
     void setDebugFile(const char* filename, bool show);
     void setDebugModule(const char* module, bool show);
+    void setDebugLevel(const char* module, int level);
     void clearDebugClass(unsigned int cl);
     void clearDebugFlag(unsigned int fl);
     void clearDebugFile(const char* filename);
     void clearDebugModule(const char* module);
 
+    // per-thread scoping of debug classes
+    void setThreadScope(unsigned int threadID, unsigned int classes, const char* module=DBM_NONE);
+    void setThreadNameScope(const char* pattern, unsigned int classes, const char* module=DBM_NONE);
+    void setCurrentThreadScope(unsigned int classes, const char* module=DBM_NONE);
+    void clearThreadScope();
+
     // general public methods to control info class
     unsigned int infoClasses() const;
     unsigned int infoFlags() const;
@@ -155,15 +327,163 @@ class CRTDebug
     // methods to control additional options
     bool highlighting() const;
     void setHighlighting(bool on);
+    bool setOutputFile(const char* filename, unsigned int options=0);
+    unsigned int coalescing() const;
+    void setCoalescing(unsigned int ms);
+    unsigned int lookback() const;
+    unsigned int backtraceClasses() const;
+    void setBacktrace(unsigned int classes, unsigned int infoClasses=INC_FATAL, bool deferred=false);
+    void setLookback(unsigned int records, unsigned int classes=DBC_ALL, bool allThreads=false);
+    void reportCounters();
+    void reportVolume();
+    unsigned int volumeAccounting() const;
+    void setVolumeAccounting(unsigned int top);
+    bool instrumentation() const;
+    void setInstrumentation(bool enable);
+    void setInstrumentFilter(const char* pattern, bool show);
+    void clearInstrumentFilters();
+    const char* layout() const;
+    bool setLayout(const char* pattern);
+    size_t perCPUBuffers() const;
+    void setPerCPUBuffers(size_t size);
+    const char* perThreadFiles() const;
+    void setPerThreadFiles(const char* prefix);
+    size_t arenaSize() const;
+    bool setArena(size_t size, int pages=DBA_NORMAL);
+    size_t asyncOutput() const;
+    void setAsyncOutput(size_t size, unsigned int maxWait=100);
+    size_t batchedOutput() const;
+    void setBatchedOutput(size_t size, unsigned int maxDelay=10, unsigned int flushClasses=DBC_ERROR|DBC_ASSERT);
+    void setOverloadPolicy(unsigned int classes, int policy, unsigned int rate=10);
+    void reportOverload();
+    void reportOverhead();
+    bool overheadAccounting() const;
+    void setOverheadAccounting(bool enable);
+    void setReportInterval(unsigned int seconds);
+    const char* profile() const;
+    void setProfile(const char* filename);
+    bool writeProfile(const char* filename=NULL);
 
   protected:
     CRTDebug(const int dbclasses=0, const int dbflags=0,
-             const int infoclasses=0, const int infoflags=0);
+             const int infoclasses=0, const int infoflags=0,
+             const bool dormant=false);
     ~CRTDebug();
 
   private:
-    static CRTDebug*  m_pSingletonInstance; //!< the singleton instance
-    CRTDebugPrivate*  m_pData;              //!< the private, internal rtdebug data
+    static CRTDebug* createInstance(const bool revive);
+
+    friend class CRTDebugThread;
+
+  private:
+    static std::atomic<CRTDebug*> m_pSingletonInstance; //!< the singleton instance
+    static CRTDebug*              m_pDormantInstance;   //!< the instance silently taking calls after destroy()
+    static RTDEBUG_THREAD_LOCAL CRTDebugContext* m_pCurrentContext; //!< the trace context of the current thread
+    CRTDebugPrivate*              m_pData;              //!< the private, internal rtdebug data
+};
+
+//  Class:       CRTDebug
+//  Method:      instance
+//!
+//! Returns the current instance and creates one on first use. As the
+//! instance pointer is constant-initialized, the common case is a single
+//! atomic load.
+//!
+//! @return      pointer to current instance of CRTDebug
+////////////////////////////////////////////////////////////////////////////////
+inline CRTDebug* CRTDebug::instance()
+{
+  CRTDebug* rtdebug = m_pSingletonInstance.load(std::memory_order_acquire);
+  if(rtdebug == NULL)
+    rtdebug = createInstance(false);
+
+  return rtdebug;
+}
+
+//  Class:       CRTDebug
+//  Method:      module
+//!
+//! Returns the node of the module of a call site. The debug macros pass a
+//! lambda which caches the node in a static variable of the call site. It
+//! is only used if the module name is a string literal (or DBM_NONE), while
+//! any other name is looked up on every call as it may change at runtime.
+//!
+//! @param  name   the dotted module name
+//! @param  cache  looks up the node once per call site
+//! @return        the node of the module
+////////////////////////////////////////////////////////////////////////////////
+template<size_t N, typename C>
+inline const CRTDebugModule* CRTDebug::module(const char (&name)[N], C cache)
+{
+  return cache(name);
+}
+
+template<typename T, typename C>
+inline const CRTDebugModule* CRTDebug::module(T* const& name, C)
+{
+  return module(name);
+}
+
+template<typename C>
+inline const CRTDebugModule* CRTDebug::module(std::nullptr_t, C cache)
+{
+  return cache(DBM_NONE);
+}
+
+inline CRTDebugContext* CRTDebug::currentContext()
+{
+  return m_pCurrentContext;
+}
+
+//  Classname:   CRTDebugCall
+//! @brief marks a call into the library as in progress
+//! @ingroup debug
+//!
+//! All debug macros access the instance through a temporary of this class,
+//! which lives until the complete macro statement has been executed. While
+//! it exists CRTDebug::destroy() will not free the instance the call is
+//! using, so that destroy() can safely be called while other threads are
+//! still outputting debug records.
+////////////////////////////////////////////////////////////////////////////////
+class CRTDebugCall
+{
+  public:
+    RTDEBUG_NO_INSTRUMENT CRTDebugCall()
+    {
+      m_pSlot = m_pCurrentSlot;
+      if(m_pSlot == NULL)
+        m_pSlot = acquireSlot();
+
+      // only the owning thread ever changes the count, but destroy() has
+      // to see it before we look at the instance pointer. Where possible
+      // destroy() enforces this on all threads at once (see waitForCalls()),
+      // otherwise every call needs a full fence.
+      m_pSlot->calls.store(m_pSlot->calls.load(std::memory_order_relaxed)+1, std::memory_order_relaxed);
+      if(m_bBarrier.load(std::memory_order_relaxed) == true)
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+      else
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    RTDEBUG_NO_INSTRUMENT ~CRTDebugCall()
+    {
+      m_pSlot->calls.store(m_pSlot->calls.load(std::memory_order_relaxed)-1, std::memory_order_release);
+    }
+
+    RTDEBUG_NO_INSTRUMENT CRTDebug* operator->() const { return CRTDebug::instance(); }
+
+    // management of the per-thread call slots
+    static CRTDebugCallSlot* acquireSlot();
+    static void releaseSlot();
+    static void waitForCalls();
+
+  private:
+    static bool barrier();
+
+  private:
+    static RTDEBUG_THREAD_LOCAL CRTDebugCallSlot* m_pCurrentSlot; //!< the call slot of the current thread
+    static std::atomic<bool>                      m_bBarrier;     //!< waitForCalls() fences all threads
+    CRTDebugCallSlot* m_pSlot;                                    //!< the slot this call is counted in
 };
 
 #endif // CRTDEBUG_H
@@ -0,0 +1,271 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+
+#include "CRTDebugArena.h"
+#include "CRTDebug.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define ARENA_MAGIC     0x52544441 // "RTDA"
+#define HUGEPAGE_SIZE   (2*1024*1024)
+
+// a free list link holds the offset of a block header in units of the
+// header size (plus one, 0 ends the list) in its lower bits and the change
+// count of the list head in its upper bits
+#define LINK_BITS       40
+#define LINK_MASK       ((1ULL << LINK_BITS) - 1)
+#define LINK_COUNT      (1ULL << LINK_BITS)
+
+CRTDebugArena::CRTDebugArena()
+  : m_pBase(NULL),
+    m_iSize(0),
+    m_iTop(0),
+    m_iUsed(0),
+    m_iFallbacks(0),
+    m_pPageType("no")
+{
+  for(unsigned int i=0; i < ARENA_CLASSES; i++)
+    m_FreeLists[i] = 0;
+}
+
+CRTDebugArena* CRTDebugArena::instance()
+{
+  static CRTDebugArena* arena = new CRTDebugArena();
+
+  return arena;
+}
+
+//  Class:       CRTDebugArena
+//  Method:      reserve
+//!
+//! Maps the memory region of the arena and touches all of its pages so that
+//! they are faulted in right away. Explicit huge pages are taken from the
+//! hugetlbfs pool, which has to be set up by the administrator, otherwise
+//! transparent huge pages are requested. An arena can only be reserved once
+//! per process.
+//!
+//! @param  size     the size of the arena in bytes
+//! @param  pages    the page type (DBA_NORMAL, DBA_THP or DBA_HUGETLB)
+//!
+//! @return      true if the arena was reserved
+////////////////////////////////////////////////////////////////////////////////
+bool CRTDebugArena::reserve(const size_t size, const int pages)
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+
+  if(m_pBase != NULL || size == 0)
+    return false;
+
+  size_t len = size;
+  if(pages != DBA_NORMAL)
+    len = (size + HUGEPAGE_SIZE-1) & ~(size_t)(HUGEPAGE_SIZE-1);
+
+  void* mem = MAP_FAILED;
+  const char* pageType = "regular";
+
+  #if defined(MAP_HUGETLB) && defined(MAP_POPULATE)
+  if(pages == DBA_HUGETLB)
+  {
+    mem = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+    pageType = "explicit huge";
+  }
+  #endif
+
+  if(mem == MAP_FAILED)
+  {
+    mem = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(mem == MAP_FAILED)
+      return false;
+
+    pageType = "regular";
+
+    #if defined(MADV_HUGEPAGE)
+    if(pages != DBA_NORMAL && madvise(mem, len, MADV_HUGEPAGE) == 0)
+      pageType = "transparent huge";
+    #endif
+  }
+
+  // prefault the whole region by writing to every page
+  long pageSize = sysconf(_SC_PAGESIZE);
+  if(pageSize <= 0)
+    pageSize = 4096;
+
+  for(size_t i=0; i < len; i += pageSize)
+    ((volatile char*)mem)[i] = 0;
+
+  m_iSize = len;
+  m_iTop = 0;
+  m_iUsed = 0;
+  m_pPageType = pageType;
+  m_pBase = (char*)mem;
+
+  return true;
+}
+
+CRTDebugArena::Header* CRTDebugArena::block(const unsigned long long link) const
+{
+  return (Header*)(m_pBase.load(std::memory_order_relaxed) + ((link & LINK_MASK) - 1) * sizeof(Header));
+}
+
+unsigned long long CRTDebugArena::link(const Header* header) const
+{
+  return ((const char*)header - m_pBase.load(std::memory_order_relaxed)) / sizeof(Header) + 1;
+}
+
+bool CRTDebugArena::contains(const void* ptr) const
+{
+  const char* base = m_pBase;
+
+  return base != NULL && (const char*)ptr >= base && (const char*)ptr < base + m_iSize;
+}
+
+//  Class:       CRTDebugArena
+//  Method:      allocate
+//!
+//! Allocates a block from the free list of its size class or from the top
+//! of the arena. Requests which don't fit are passed on to malloc().
+//!
+//! A block taken off a free list may meanwhile be taken and released again
+//! by other threads, so the next link read from it may be stale. The change
+//! count of the list head makes the compare-and-swap fail in that case.
+//! The link is always readable as the blocks are never unmapped.
+//!
+//! @return      the block or NULL
+////////////////////////////////////////////////////////////////////////////////
+void* CRTDebugArena::allocate(const size_t size)
+{
+  if(m_pBase.load(std::memory_order_acquire) != NULL)
+  {
+    unsigned int cls = 0;
+    while(cls < ARENA_CLASSES && ((size_t)1 << (cls+ARENA_MINSHIFT)) < size)
+      cls++;
+
+    if(cls < ARENA_CLASSES)
+    {
+      size_t blockSize = (size_t)1 << (cls+ARENA_MINSHIFT);
+      Header* header = NULL;
+
+      unsigned long long head = m_FreeLists[cls].load(std::memory_order_acquire);
+      while((head & LINK_MASK) != 0)
+      {
+        Header* first = block(head);
+        unsigned long long next = (first->next.load(std::memory_order_relaxed) & LINK_MASK) | ((head + LINK_COUNT) & ~LINK_MASK);
+        if(m_FreeLists[cls].compare_exchange_weak(head, next, std::memory_order_acquire))
+        {
+          header = first;
+          break;
+        }
+      }
+
+      if(header == NULL)
+      {
+        size_t top = m_iTop.load(std::memory_order_relaxed);
+        while(top + sizeof(Header) + blockSize <= m_iSize)
+        {
+          if(m_iTop.compare_exchange_weak(top, top + sizeof(Header) + blockSize, std::memory_order_relaxed))
+          {
+            header = (Header*)(m_pBase.load(std::memory_order_relaxed) + top);
+            header->cls = cls;
+            header->magic = ARENA_MAGIC;
+            break;
+          }
+        }
+      }
+
+      if(header != NULL)
+      {
+        header->next.store(0, std::memory_order_relaxed);
+        m_iUsed.fetch_add(blockSize, std::memory_order_relaxed);
+
+        return header+1;
+      }
+    }
+
+    m_iFallbacks++;
+  }
+
+  return malloc(size > 0 ? size : 1);
+}
+
+//  Class:       CRTDebugArena
+//  Method:      reallocate
+//!
+//! Grows a block. Blocks of the arena are only moved if their size class
+//! is too small, blocks from malloc() are moved into the arena if possible.
+//!
+//! @return      the new block or NULL (the old block is still valid then)
+////////////////////////////////////////////////////////////////////////////////
+void* CRTDebugArena::reallocate(void* ptr, const size_t oldSize, const size_t newSize)
+{
+  if(ptr == NULL)
+    return allocate(newSize);
+
+  if(contains(ptr) == true)
+  {
+    const Header* header = (const Header*)ptr - 1;
+    if(((size_t)1 << (header->cls+ARENA_MINSHIFT)) >= newSize)
+      return ptr;
+  }
+  else if(m_pBase == NULL)
+    return realloc(ptr, newSize);
+
+  void* block = allocate(newSize);
+  if(block == NULL)
+    return NULL;
+
+  memcpy(block, ptr, oldSize < newSize ? oldSize : newSize);
+  release(ptr);
+
+  return block;
+}
+
+void CRTDebugArena::release(void* ptr)
+{
+  if(ptr == NULL)
+    return;
+
+  if(contains(ptr) == false)
+  {
+    free(ptr);
+    return;
+  }
+
+  Header* header = (Header*)ptr - 1;
+  if(header->magic != ARENA_MAGIC)
+    abort();
+
+  m_iUsed.fetch_sub((size_t)1 << (header->cls+ARENA_MINSHIFT), std::memory_order_relaxed);
+
+  std::atomic<unsigned long long>& list = m_FreeLists[header->cls];
+  unsigned long long head = list.load(std::memory_order_relaxed);
+  unsigned long long next;
+  do
+  {
+    header->next.store(head & LINK_MASK, std::memory_order_relaxed);
+    next = link(header) | ((head + LINK_COUNT) & ~LINK_MASK);
+  }
+  while(list.compare_exchange_weak(head, next, std::memory_order_release, std::memory_order_relaxed) == false);
+}
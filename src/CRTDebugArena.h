@@ -0,0 +1,128 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+
+#ifndef CRTDEBUGARENA_H
+#define CRTDEBUGARENA_H
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <new>
+
+// the default size of the arena
+#define ARENA_SIZE      (16*1024*1024)
+
+// the number of size classes (powers of two from 2^ARENA_MINSHIFT bytes)
+#define ARENA_MINSHIFT  6
+#define ARENA_CLASSES   40
+
+//  Classname:   CRTDebugArena
+//! @brief preallocated memory arena for all trace buffers
+//! @ingroup debug
+//!
+//! The arena is a single memory region which is reserved once, optionally
+//! backed by transparent or explicit huge pages and completely prefaulted,
+//! so that neither the allocator nor page faults show up in the tracing
+//! hot path. The record buffers, the per-CPU buffers, the asynchronous
+//! queue, the lookback rings and the per-thread call site tables are taken
+//! from it.
+//!
+//! Blocks are handed out in power-of-two size classes (which matches the
+//! doubling growth of the buffers) and are kept on a free list per class
+//! once released. The free lists are lock-free stacks whose heads carry a
+//! change count against the ABA problem, and new blocks are cut from the
+//! top by a compare-and-swap, so that no lock is taken in the tracing hot
+//! path. As long as no arena is reserved, or once it is exhausted,
+//! all requests are passed on to malloc(). release() hands every block back
+//! to where it came from, so buffers allocated before the reservation keep
+//! working. The arena is never freed, as thread local buffers may outlive
+//! the debug instance.
+////////////////////////////////////////////////////////////////////////////////
+class CRTDebugArena
+{
+  public:
+    static CRTDebugArena* instance();
+
+    bool reserve(const size_t size, const int pages);
+    void* allocate(const size_t size);
+    void* reallocate(void* ptr, const size_t oldSize, const size_t newSize);
+    void release(void* ptr);
+
+    bool contains(const void* ptr) const;
+    size_t size() const { return m_pBase != NULL ? m_iSize : 0; }
+    size_t used() const { return m_iUsed.load(std::memory_order_relaxed); }
+    size_t peak() const { return m_iTop.load(std::memory_order_relaxed); }
+    unsigned long long fallbacks() const { return m_iFallbacks; }
+    const char* pageType() const { return m_pPageType; }
+
+  private:
+    CRTDebugArena();
+
+    struct Header
+    {
+      unsigned int  cls;        //!< the size class of the block
+      unsigned int  magic;      //!< marks a valid block
+      std::atomic<unsigned long long> next; //!< the encoded next free block of the class
+    };
+
+    Header* block(const unsigned long long link) const;
+    unsigned long long link(const Header* header) const;
+
+  private:
+    std::atomic<char*>  m_pBase;        //!< start of the region or NULL
+    size_t              m_iSize;        //!< size of the region
+    std::atomic<size_t> m_iTop;         //!< bytes handed out from the top
+    std::atomic<size_t> m_iUsed;        //!< bytes of the allocated blocks
+    std::atomic<unsigned long long> m_FreeLists[ARENA_CLASSES]; //!< released blocks per class with change count
+    std::atomic<unsigned long long> m_iFallbacks; //!< requests passed on to malloc()
+    const char*         m_pPageType;    //!< the kind of pages backing the region
+    std::mutex          m_Mutex;        //!< serializes the reservation
+};
+
+//  Classname:   CRTDebugArenaAllocator
+//! @brief STL allocator taking its memory from the CRTDebugArena
+//! @ingroup debug
+////////////////////////////////////////////////////////////////////////////////
+template<typename T> class CRTDebugArenaAllocator
+{
+  public:
+    typedef T value_type;
+
+    CRTDebugArenaAllocator() {}
+    template<typename U> CRTDebugArenaAllocator(const CRTDebugArenaAllocator<U>&) {}
+
+    T* allocate(const size_t n)
+    {
+      void* ptr = CRTDebugArena::instance()->allocate(n*sizeof(T));
+      if(ptr == NULL)
+        throw std::bad_alloc();
+
+      return (T*)ptr;
+    }
+
+    void deallocate(T* ptr, const size_t) { CRTDebugArena::instance()->release(ptr); }
+
+    template<typename U> bool operator==(const CRTDebugArenaAllocator<U>&) const { return true; }
+    template<typename U> bool operator!=(const CRTDebugArenaAllocator<U>&) const { return false; }
+};
+
+#endif // CRTDEBUGARENA_H
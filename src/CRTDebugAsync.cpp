@@ -0,0 +1,440 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+#include "CRTDebugAsync.h"
+#include "CRTDebugArena.h"
+#include "CRTDebug.h"
+
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+
+#include <sys/time.h>
+
+#define ENTRY_PAD   0xffffffffU   // the rest of the buffer is unused
+#define ENTRY_ALIGN 8
+
+// the names of the debug classes in the loss reports
+static const char* classNames[] = { "ctrace", "report", "assert", "timeval", "debug", "error", "warning" };
+
+static inline unsigned int classIndex(const unsigned int cls)
+{
+  return cls != 0 ? __builtin_ctz(cls) % ASYNC_CLASSES : 0;
+}
+
+CRTDebugAsyncSink::CRTDebugAsyncSink(CRTDebugSink* sink, const size_t size, const unsigned int maxWait)
+  : m_pSink(sink),
+    m_iSize((size + ENTRY_ALIGN-1) & ~(size_t)(ENTRY_ALIGN-1)),
+    m_iHead(0),
+    m_iTail(0),
+    m_iMaxWait(maxWait),
+    m_bOverloaded(false),
+    m_bPending(false),
+    m_bWaiting(false),
+    m_bFlush(false),
+    m_bQuit(false)
+{
+  m_pBuffer = (char*)CRTDebugArena::instance()->allocate(m_iSize);
+
+  for(unsigned int i=0; i < ASYNC_CLASSES; i++)
+  {
+    m_Policies[i].policy = DBP_DROPNEWEST;
+    m_Policies[i].rate = ASYNC_SAMPLERATE;
+    m_Samples[i] = 0;
+    m_Records[i] = 0;
+    m_Dropped[i] = 0;
+    m_Pending[i] = 0;
+  }
+
+  m_Thread = std::thread(&CRTDebugAsyncSink::writerThread, this);
+}
+
+CRTDebugAsyncSink::~CRTDebugAsyncSink()
+{
+  delete release();
+  CRTDebugArena::instance()->release(m_pBuffer);
+}
+
+//  Class:       CRTDebugAsyncSink
+//  Method:      release
+//!
+//! Writes out all queued records and the pending losses, terminates the
+//! writer thread and hands the actual sink back to the caller.
+//!
+//! @return      the actual sink or NULL if it was already released
+////////////////////////////////////////////////////////////////////////////////
+CRTDebugSink* CRTDebugAsyncSink::release()
+{
+  if(m_Thread.joinable() == true)
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_Mutex);
+      m_bQuit = true;
+    }
+
+    m_DataCond.notify_all();
+    m_Thread.join();
+  }
+
+  CRTDebugSink* sink = m_pSink;
+  m_pSink = NULL;
+
+  return sink;
+}
+
+size_t CRTDebugAsyncSink::entrySize(const size_t len) const
+{
+  return (sizeof(Entry) + len + ENTRY_ALIGN-1) & ~(size_t)(ENTRY_ALIGN-1);
+}
+
+// checks if a record of the given entry size fits into the free space,
+// including the unusable space at the end of the buffer if it wraps
+bool CRTDebugAsyncSink::fits(const size_t need) const
+{
+  size_t contiguous = m_iSize - m_iTail % m_iSize;
+  size_t total = need <= contiguous ? need : contiguous + need;
+
+  return m_iSize - (m_iTail - m_iHead) >= total;
+}
+
+// drops the oldest queued record unless it belongs to a blocking class
+bool CRTDebugAsyncSink::evict()
+{
+  while(m_iHead != m_iTail)
+  {
+    size_t pos = m_iHead % m_iSize;
+    const Entry* entry = (const Entry*)(m_pBuffer + pos);
+
+    if(m_iSize - pos < sizeof(Entry) || entry->length == ENTRY_PAD)
+    {
+      m_iHead += m_iSize - pos;
+      continue;
+    }
+
+    if(m_Policies[classIndex(entry->info.cls)].policy == DBP_BLOCK)
+      return false;
+
+    dropped(entry->info.cls);
+    m_iHead += entrySize(entry->length);
+
+    return true;
+  }
+
+  return false;
+}
+
+void CRTDebugAsyncSink::dropped(const unsigned int cls)
+{
+  unsigned int i = classIndex(cls);
+
+  m_Dropped[i]++;
+  m_Pending[i]++;
+  m_bPending = true;
+}
+
+//  Class:       CRTDebugAsyncSink
+//  Method:      write
+//!
+//! Queues a record for the writer thread. Only a record of a blocking
+//! class ever waits, and never longer than the maximum wait.
+//!
+//! @return      false if the record was dropped
+////////////////////////////////////////////////////////////////////////////////
+bool CRTDebugAsyncSink::write(const CRTDebugRecordInfo& info, const char* data, const size_t len)
+{
+  size_t need = entrySize(len);
+  unsigned int i = classIndex(info.cls);
+
+  std::unique_lock<std::mutex> lock(m_Mutex);
+
+  m_Records[i]++;
+
+  // records larger than the whole queue can never be queued
+  if(need > m_iSize)
+  {
+    dropped(info.cls);
+    return false;
+  }
+
+  if(fits(need) == false)
+  {
+    const CRTDebugOverloadPolicy& policy = m_Policies[i];
+
+    switch(policy.policy)
+    {
+      case DBP_BLOCK:
+      {
+        if(m_bOverloaded == true)
+          break;
+
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(m_iMaxWait);
+        while(fits(need) == false)
+        {
+          if(m_iMaxWait == 0)
+            m_SpaceCond.wait(lock);
+          else if(m_SpaceCond.wait_until(lock, deadline) == std::cv_status::timeout)
+            break;
+        }
+
+        if(fits(need) == false)
+          m_bOverloaded = true;
+      }
+      break;
+
+      case DBP_SAMPLE:
+        if(++m_Samples[i] % policy.rate != 0)
+          break;
+      // fall through
+
+      case DBP_DROPOLDEST:
+        while(fits(need) == false && evict() == true)
+          ;
+      break;
+    }
+
+    if(fits(need) == false)
+    {
+      dropped(info.cls);
+      return false;
+    }
+  }
+
+  // skip the end of the buffer if the record doesn't fit in there
+  size_t pos = m_iTail % m_iSize;
+  if(m_iSize - pos < need)
+  {
+    if(m_iSize - pos >= sizeof(Entry))
+      ((Entry*)(m_pBuffer + pos))->length = ENTRY_PAD;
+
+    m_iTail += m_iSize - pos;
+    pos = 0;
+  }
+
+  Entry* entry = (Entry*)(m_pBuffer + pos);
+  entry->info = info;
+  entry->length = len;
+  memcpy(m_pBuffer + pos + sizeof(Entry), data, len);
+  m_iTail += need;
+
+  if(m_bWaiting == true)
+    m_DataCond.notify_one();
+
+  return true;
+}
+
+//  Class:       CRTDebugAsyncSink
+//  Method:      flush
+//!
+//! Waits until all queued records are written and flushes the actual sink.
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugAsyncSink::flush()
+{
+  std::unique_lock<std::mutex> lock(m_Mutex);
+
+  m_bFlush = true;
+  m_DataCond.notify_one();
+
+  while(m_bFlush == true)
+    m_DoneCond.wait(lock);
+}
+
+//  Class:       CRTDebugAsyncSink
+//  Method:      flush
+//!
+//! Like flush(), but waits at most the given time for the writer.
+//!
+//! @param  maxWait  the maximum wait (ms)
+//! @return          false if the queue wasn't written out in time
+////////////////////////////////////////////////////////////////////////////////
+bool CRTDebugAsyncSink::flush(const unsigned int maxWait)
+{
+  std::unique_lock<std::mutex> lock(m_Mutex);
+
+  m_bFlush = true;
+  m_DataCond.notify_one();
+
+  std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(maxWait);
+  while(m_bFlush == true)
+  {
+    if(m_DoneCond.wait_until(lock, deadline) == std::cv_status::timeout)
+      return (m_bFlush == false);
+  }
+
+  return true;
+}
+
+void CRTDebugAsyncSink::setPolicy(const unsigned int cls, const CRTDebugOverloadPolicy& policy)
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+
+  for(unsigned int i=0; i < ASYNC_CLASSES; i++)
+  {
+    if(cls & (1U << i))
+    {
+      m_Policies[i] = policy;
+      if(m_Policies[i].rate == 0)
+        m_Policies[i].rate = 1;
+    }
+  }
+}
+
+//  Class:       CRTDebugAsyncSink
+//  Method:      counts
+//!
+//! Copies the numbers of records passed to the sink and of dropped records
+//! per debug class bit.
+//!
+//! @param  records  array of ASYNC_CLASSES entries receiving the records
+//! @param  dropped  array of ASYNC_CLASSES entries receiving the losses
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugAsyncSink::counts(unsigned long long* records, unsigned long long* dropped)
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+
+  memcpy(records, m_Records, sizeof(m_Records));
+  memcpy(dropped, m_Dropped, sizeof(m_Dropped));
+}
+
+// writes a line with the number of dropped records per class
+void CRTDebugAsyncSink::writeDropped(const unsigned long long* dropped)
+{
+  char line[512];
+  unsigned long long sum = 0;
+  int len = 0;
+
+  for(unsigned int i=0; i < ASYNC_CLASSES; i++)
+    sum += dropped[i];
+
+  len = snprintf(line, sizeof(line), "*** rtdebug: %llu records dropped (", sum);
+
+  const char* separator = "";
+  for(unsigned int i=0; i < ASYNC_CLASSES && len < (int)sizeof(line); i++)
+  {
+    if(dropped[i] == 0)
+      continue;
+
+    if(i < sizeof(classNames)/sizeof(classNames[0]))
+      len += snprintf(line+len, sizeof(line)-len, "%s%s %llu", separator, classNames[i], dropped[i]);
+    else
+      len += snprintf(line+len, sizeof(line)-len, "%sclass %u %llu", separator, i, dropped[i]);
+
+    separator = ", ";
+  }
+
+  if(len < (int)sizeof(line))
+    len += snprintf(line+len, sizeof(line)-len, ")\n");
+  if(len >= (int)sizeof(line))
+    len = sizeof(line)-1;
+
+  struct timeval tp;
+  gettimeofday(&tp, NULL);
+
+  CRTDebugRecordInfo info;
+  info.time = tp.tv_sec*1000000ULL + tp.tv_usec;
+  info.cls = DBC_WARNING;
+  info.threadID = 0;
+
+  m_pSink->write(info, line, len);
+}
+
+//  Class:       CRTDebugAsyncSink
+//  Method:      writerThread
+//!
+//! Takes the queued records out in batches of up to ASYNC_BATCHSIZE bytes,
+//! so that the queue space is free again right away, and writes them to the
+//! actual sink without holding the queue lock.
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugAsyncSink::writerThread()
+{
+  unsigned long long pending[ASYNC_CLASSES];
+  std::unique_lock<std::mutex> lock(m_Mutex);
+
+  while(true)
+  {
+    if(m_iHead == m_iTail && m_bPending == false)
+    {
+      if(m_bFlush == true)
+      {
+        lock.unlock();
+        m_pSink->flush();
+        lock.lock();
+
+        m_bFlush = false;
+        m_DoneCond.notify_all();
+        continue;
+      }
+
+      if(m_bQuit == true)
+        break;
+
+      m_bWaiting = true;
+      m_DataCond.wait(lock);
+      m_bWaiting = false;
+      continue;
+    }
+
+    // take out a batch of records
+    m_Batch.clear();
+    while(m_iHead != m_iTail && m_Batch.size() < ASYNC_BATCHSIZE)
+    {
+      size_t pos = m_iHead % m_iSize;
+      const Entry* entry = (const Entry*)(m_pBuffer + pos);
+
+      if(m_iSize - pos < sizeof(Entry) || entry->length == ENTRY_PAD)
+      {
+        m_iHead += m_iSize - pos;
+        continue;
+      }
+
+      size_t size = entrySize(entry->length);
+      m_Batch.insert(m_Batch.end(), m_pBuffer + pos, m_pBuffer + pos + size);
+      m_iHead += size;
+    }
+
+    bool lost = m_bPending;
+    if(lost == true)
+    {
+      memcpy(pending, m_Pending, sizeof(pending));
+      memset(m_Pending, 0, sizeof(m_Pending));
+      m_bPending = false;
+    }
+
+    if(m_bOverloaded == true && m_iTail - m_iHead <= m_iSize/2)
+      m_bOverloaded = false;
+
+    m_SpaceCond.notify_all();
+    lock.unlock();
+
+    for(size_t offset=0; offset < m_Batch.size();)
+    {
+      const Entry* entry = (const Entry*)(&m_Batch[offset]);
+      m_pSink->write(entry->info, &m_Batch[offset] + sizeof(Entry), entry->length);
+      offset += entrySize(entry->length);
+    }
+
+    // most records are dropped while the queue is full, so the losses
+    // are reported after the records queued before
+    if(lost == true)
+      writeDropped(pending);
+
+    lock.lock();
+  }
+}
@@ -0,0 +1,124 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+#ifndef CRTDEBUGASYNC_H
+#define CRTDEBUGASYNC_H
+
+#include "CRTDebugSink.h"
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#define ASYNC_BUFSIZE     (1024*1024) // default size of the record queue
+#define ASYNC_BATCHSIZE   (64*1024)   // bytes the writer takes out of the queue at once
+#define ASYNC_MAXWAIT     100         // default time a blocking record waits at most (ms)
+#define ASYNC_SAMPLERATE  10          // default rate of the sample policy
+#define ASYNC_CLASSES     32          // one policy per debug class bit
+
+//! the overload policy of a debug class
+struct CRTDebugOverloadPolicy
+{
+  int           policy;     //!< one of the DBP_ policies
+  unsigned int  rate;       //!< keep every n-th record with DBP_SAMPLE
+};
+
+//  Classname:   CRTDebugAsyncSink
+//! @brief sink decoupling the emitting threads from a slow output
+//! @ingroup debug
+//!
+//! Records are copied into a bounded ring buffer and written to the actual
+//! sink by a background thread, so a stalled pipe or a full disk never
+//! stalls a debug macro for more than the configured maximum wait. If the
+//! queue is full, the overload policy of the debug class of the record
+//! decides what happens:
+//!
+//!   DBP_BLOCK       wait for space, but at most the maximum wait. Once a
+//!                   record timed out, blocking records are dropped right
+//!                   away until the queue is half empty again.
+//!   DBP_DROPNEWEST  drop the new record
+//!   DBP_DROPOLDEST  drop the oldest queued records (up to the oldest one
+//!                   of a blocking class) to make room for the new one
+//!   DBP_SAMPLE      only keep every n-th record (like DBP_DROPOLDEST)
+//!                   and drop the others
+//!
+//! Every loss is counted per debug class. After the records queued before
+//! a loss, the writer outputs a line with the number of dropped records,
+//! so that gaps in the output are visible.
+////////////////////////////////////////////////////////////////////////////////
+class CRTDebugAsyncSink : public CRTDebugSink
+{
+  public:
+    CRTDebugAsyncSink(CRTDebugSink* sink, const size_t size, const unsigned int maxWait);
+    ~CRTDebugAsyncSink();
+
+    bool write(const CRTDebugRecordInfo& info, const char* data, const size_t len);
+    void flush();
+    bool flush(const unsigned int maxWait);
+    CRTDebugSink* release();
+
+    size_t size() const { return m_iSize; }
+    unsigned int maxWait() const { return m_iMaxWait; }
+    void setPolicy(const unsigned int cls, const CRTDebugOverloadPolicy& policy);
+    void counts(unsigned long long* records, unsigned long long* dropped);
+
+  private:
+    struct Entry
+    {
+      CRTDebugRecordInfo  info;     //!< meta information of the record
+      unsigned int        length;   //!< length of the record or ENTRY_PAD
+    };
+
+    size_t entrySize(const size_t len) const;
+    bool fits(const size_t need) const;
+    bool evict();
+    void dropped(const unsigned int cls);
+    void writeDropped(const unsigned long long* dropped);
+    void writerThread();
+
+  private:
+    CRTDebugSink*           m_pSink;        //!< the sink the records are written to
+    char*                   m_pBuffer;      //!< the ring buffer
+    size_t                  m_iSize;        //!< size of the ring buffer
+    unsigned long long      m_iHead;        //!< offset of the oldest queued record
+    unsigned long long      m_iTail;        //!< offset the next record is queued at
+    unsigned int            m_iMaxWait;     //!< maximum wait of a blocking record (ms)
+    bool                    m_bOverloaded;  //!< a blocking record timed out
+    CRTDebugOverloadPolicy  m_Policies[ASYNC_CLASSES]; //!< policy per class bit
+    unsigned int            m_Samples[ASYNC_CLASSES];  //!< records seen while sampling
+    unsigned long long      m_Records[ASYNC_CLASSES];  //!< records passed to the sink
+    unsigned long long      m_Dropped[ASYNC_CLASSES];  //!< records dropped in total
+    unsigned long long      m_Pending[ASYNC_CLASSES];  //!< drops not yet reported
+    bool                    m_bPending;     //!< m_Pending contains drops
+
+    std::vector<char>       m_Batch;        //!< records taken out by the writer
+    std::thread             m_Thread;       //!< the writer thread
+    std::mutex              m_Mutex;        //!< protects the queue
+    std::condition_variable m_DataCond;     //!< signals queued records
+    std::condition_variable m_SpaceCond;    //!< signals free space
+    std::condition_variable m_DoneCond;     //!< signals a completed flush
+    bool                    m_bWaiting;     //!< the writer waits for records
+    bool                    m_bFlush;       //!< ask the writer to flush the sink
+    bool                    m_bQuit;        //!< ask the writer to terminate
+};
+
+#endif // CRTDEBUGASYNC_H
@@ -0,0 +1,162 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+#include "CRTDebugBacktrace.h"
+#include "CRTDebugBuffer.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <mutex>
+
+#include "config.h"
+
+#if defined(HAVE_BACKTRACE)
+#include <execinfo.h>
+#endif
+
+#if defined(HAVE_DLADDR)
+#include <dlfcn.h>
+#include <cxxabi.h>
+#endif
+
+// the cache of already symbolized addresses
+static std::mutex symbolMutex;
+static std::unordered_map<void*, std::string>* symbolCache = NULL;
+
+// resolves the symbol of an address
+static void resolve(void* pc, std::string& result)
+{
+  #if defined(HAVE_DLADDR)
+  Dl_info info;
+  if(dladdr(pc, &info) != 0)
+  {
+    const char* module = info.dli_fname != NULL ? strrchr(info.dli_fname, '/') : NULL;
+    module = module != NULL ? module+1 : info.dli_fname;
+
+    char offset[32];
+    if(info.dli_sname != NULL)
+    {
+      int status = -1;
+      char* demangled = abi::__cxa_demangle(info.dli_sname, NULL, NULL, &status);
+
+      result = status == 0 ? demangled : info.dli_sname;
+      snprintf(offset, sizeof(offset), "+0x%lx", (unsigned long)((char*)pc - (char*)info.dli_saddr));
+      result += offset;
+
+      free(demangled);
+    }
+    else
+    {
+      // no exported symbol, so at least output the offset within the module
+      snprintf(offset, sizeof(offset), "+0x%lx", (unsigned long)((char*)pc - (char*)info.dli_fbase));
+      result = offset;
+    }
+
+    if(module != NULL)
+    {
+      result += " (";
+      result += module;
+      result += ")";
+    }
+
+    return;
+  }
+  #else
+  (void)pc;
+  #endif
+
+  result = "??";
+}
+
+//  Class:       CRTDebugBacktrace
+//  Method:      capture
+//!
+//! Captures the program counters of the calling thread.
+//!
+//! @param  frames  the array to store the program counters in
+//! @param  max     the size of the array
+//! @param  skip    the number of innermost frames to skip (the callers
+//!                 within the debug framework)
+//! @return         the number of captured frames
+////////////////////////////////////////////////////////////////////////////////
+int CRTDebugBacktrace::capture(void** frames, const int max, const int skip)
+{
+  #if defined(HAVE_BACKTRACE)
+  void* all[BACKTRACE_FRAMES + 8];
+  int count = backtrace(all, sizeof(all)/sizeof(all[0]));
+
+  // skip ourself and the frames of the caller
+  count -= skip+1;
+  if(count <= 0)
+    return 0;
+  if(count > max)
+    count = max;
+
+  memcpy(frames, all+skip+1, count*sizeof(void*));
+
+  return count;
+  #else
+  (void)frames;
+  (void)max;
+  (void)skip;
+
+  return 0;
+  #endif
+}
+
+//  Class:       CRTDebugBacktrace
+//  Method:      append
+//!
+//! Appends a symbolized backtrace to a buffer with one indented line per
+//! frame. Symbols are looked up in the cache first.
+//!
+//! @param  buf     the buffer to append the backtrace to
+//! @param  frames  the captured program counters
+//! @param  count   the number of captured program counters
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugBacktrace::append(CRTDebugBuffer& buf, void* const* frames, const int count)
+{
+  std::lock_guard<std::mutex> lock(symbolMutex);
+
+  // the cache is never freed as backtraces may be output until the very end
+  if(symbolCache == NULL)
+    symbolCache = new std::unordered_map<void*, std::string>();
+
+  for(int i=0; i < count; i++)
+  {
+    std::unordered_map<void*, std::string>::iterator it = symbolCache->find(frames[i]);
+    if(it == symbolCache->end())
+    {
+      it = symbolCache->insert(std::make_pair(frames[i], std::string())).first;
+      resolve(frames[i], it->second);
+    }
+
+    buf.append("    #");
+    buf.appendDec(i, 2, '0');
+    buf.append(" 0x");
+    buf.appendHex((unsigned long long)(size_t)frames[i], 2*sizeof(void*));
+    buf.append(' ');
+    buf.append(it->second.c_str(), it->second.size());
+    buf.append('\n');
+  }
+}
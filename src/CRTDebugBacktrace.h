@@ -0,0 +1,52 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+#ifndef CRTDEBUGBACKTRACE_H
+#define CRTDEBUGBACKTRACE_H
+
+#include <cstddef>
+
+class CRTDebugBuffer;
+
+// the maximum number of frames of a backtrace
+#define BACKTRACE_FRAMES 32
+
+//  Classname:   CRTDebugBacktrace
+//! @brief capturing and symbolization of native backtraces
+//! @ingroup debug
+//!
+//! Capturing a backtrace only stores the raw program counters. They are
+//! symbolized (via dladdr() and the C++ ABI demangler) when the backtrace is
+//! output. As resolving a symbol is by far the most expensive part, every
+//! resolved address is kept in a cache, so that repeatedly output backtraces
+//! of the same code path are almost free after the first one.
+////////////////////////////////////////////////////////////////////////////////
+class CRTDebugBacktrace
+{
+  public:
+    // capture the program counters of the calling thread
+    static int capture(void** frames, const int max, const int skip);
+
+    // append a symbolized backtrace, one frame per line
+    static void append(CRTDebugBuffer& buf, void* const* frames, const int count);
+};
+
+#endif // CRTDEBUGBACKTRACE_H
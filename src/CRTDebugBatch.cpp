@@ -0,0 +1,163 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+
+#include "CRTDebugBatch.h"
+#include "CRTDebugArena.h"
+
+#include <cstring>
+
+CRTDebugBatchSink::CRTDebugBatchSink(CRTDebugSink* sink, const size_t size, const unsigned int maxDelay,
+                                     const unsigned int flushClasses)
+  : m_pSink(sink),
+    m_iSize(size),
+    m_iUsed(0),
+    m_iMaxDelay(maxDelay),
+    m_iFlushClasses(flushClasses),
+    m_bQuit(false)
+{
+  m_pBuffer = (char*)CRTDebugArena::instance()->allocate(m_iSize);
+
+  if(m_iMaxDelay > 0)
+    m_Thread = std::thread(&CRTDebugBatchSink::flushThread, this);
+}
+
+CRTDebugBatchSink::~CRTDebugBatchSink()
+{
+  delete release();
+  CRTDebugArena::instance()->release(m_pBuffer);
+}
+
+//  Class:       CRTDebugBatchSink
+//  Method:      release
+//!
+//! Writes the pending batch, stops the background thread and hands the
+//! actual sink back to the caller.
+//!
+//! @return      the actual sink which is now owned by the caller
+////////////////////////////////////////////////////////////////////////////////
+CRTDebugSink* CRTDebugBatchSink::release()
+{
+  if(m_Thread.joinable() == true)
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_Mutex);
+      m_bQuit = true;
+    }
+
+    m_Cond.notify_all();
+    m_Thread.join();
+  }
+
+  if(m_pSink != NULL)
+    flush();
+
+  CRTDebugSink* sink = m_pSink;
+  m_pSink = NULL;
+
+  return sink;
+}
+
+// writes the current batch with the mutex held
+bool CRTDebugBatchSink::writeBatch()
+{
+  if(m_iUsed == 0)
+    return true;
+
+  bool result = m_pSink->write(m_Info, m_pBuffer, m_iUsed);
+  m_iUsed = 0;
+  m_Info = CRTDebugRecordInfo();
+
+  return result;
+}
+
+//  Class:       CRTDebugBatchSink
+//  Method:      write
+//!
+//! Appends a record to the current batch. The batch is written once it is
+//! full or the record belongs to one of the flush classes. Records larger
+//! than a batch are written directly after the pending batch.
+//!
+//! @return      false if a batch could not be written
+////////////////////////////////////////////////////////////////////////////////
+bool CRTDebugBatchSink::write(const CRTDebugRecordInfo& info, const char* data, const size_t len)
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  bool result = true;
+
+  if(m_iUsed + len > m_iSize)
+    result = writeBatch();
+
+  if(len > m_iSize)
+    result = m_pSink->write(info, data, len) && result;
+  else
+  {
+    if(m_iUsed == 0)
+    {
+      m_Info = info;
+      m_FirstTime = std::chrono::steady_clock::now();
+      m_Cond.notify_one();
+    }
+
+    memcpy(m_pBuffer + m_iUsed, data, len);
+    m_iUsed += len;
+    m_Info.cls |= info.cls;
+  }
+
+  if((info.cls & m_iFlushClasses) != 0 || m_iUsed >= m_iSize)
+  {
+    result = writeBatch() && result;
+    if((info.cls & m_iFlushClasses) != 0)
+      m_pSink->flush();
+  }
+
+  return result;
+}
+
+void CRTDebugBatchSink::flush()
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+
+  writeBatch();
+  m_pSink->flush();
+}
+
+void CRTDebugBatchSink::flushThread()
+{
+  std::unique_lock<std::mutex> lock(m_Mutex);
+
+  while(m_bQuit == false)
+  {
+    if(m_iUsed == 0)
+    {
+      m_Cond.wait(lock);
+      continue;
+    }
+
+    // write the batch once its oldest record is due
+    std::chrono::steady_clock::time_point due = m_FirstTime + std::chrono::milliseconds(m_iMaxDelay);
+    if(m_Cond.wait_until(lock, due) == std::cv_status::timeout && m_iUsed > 0 &&
+       std::chrono::steady_clock::now() >= m_FirstTime + std::chrono::milliseconds(m_iMaxDelay))
+    {
+      writeBatch();
+    }
+  }
+}
@@ -0,0 +1,86 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+
+#ifndef CRTDEBUGBATCH_H
+#define CRTDEBUGBATCH_H
+
+#include "CRTDebugSink.h"
+
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#define BATCH_BUFSIZE     (64*1024)   // default number of bytes written at once
+#define BATCH_MAXDELAY    10          // default time a record is held back at most (ms)
+
+//  Classname:   CRTDebugBatchSink
+//! @brief sink writing records in batches (group commit)
+//! @ingroup debug
+//!
+//! Instead of one write() call per record the records are collected and
+//! written to the actual sink all at once as soon as whichever comes first
+//! happens: the batch reaches its byte threshold, the oldest record of the
+//! batch has been held back for the maximum delay (checked by a background
+//! thread, 0 = no time limit) or a record of one of the flush classes (e.g. an error or a
+//! failed assertion) arrives. Such a record is written right away together
+//! with the records preceding it, so that important output is never delayed.
+//!
+//! Batching is only useful for sinks which simply write the record data
+//! (files and terminals), as the records lose their meta information.
+////////////////////////////////////////////////////////////////////////////////
+class CRTDebugBatchSink : public CRTDebugSink
+{
+  public:
+    CRTDebugBatchSink(CRTDebugSink* sink, const size_t size, const unsigned int maxDelay,
+                      const unsigned int flushClasses);
+    ~CRTDebugBatchSink();
+
+    bool write(const CRTDebugRecordInfo& info, const char* data, const size_t len);
+    void flush();
+    CRTDebugSink* release();
+
+    size_t size() const { return m_iSize; }
+    unsigned int maxDelay() const { return m_iMaxDelay; }
+    unsigned int flushClasses() const { return m_iFlushClasses; }
+
+  private:
+    bool writeBatch();
+    void flushThread();
+
+  private:
+    CRTDebugSink*           m_pSink;        //!< the sink the batches are written to
+    char*                   m_pBuffer;      //!< the current batch
+    size_t                  m_iSize;        //!< the byte threshold of a batch
+    size_t                  m_iUsed;        //!< bytes in the current batch
+    unsigned int            m_iMaxDelay;    //!< maximum time a record is held back (ms)
+    unsigned int            m_iFlushClasses; //!< classes written immediately
+    CRTDebugRecordInfo      m_Info;         //!< meta information of the batch
+    std::chrono::steady_clock::time_point m_FirstTime; //!< time the batch was started
+
+    std::thread             m_Thread;       //!< the thread writing delayed batches
+    std::mutex              m_Mutex;        //!< protects the batch
+    std::condition_variable m_Cond;         //!< signals a new batch or termination
+    bool                    m_bQuit;        //!< ask the thread to terminate
+};
+
+#endif // CRTDEBUGBATCH_H
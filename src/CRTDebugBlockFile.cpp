@@ -0,0 +1,542 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+#include "CRTDebugBlockFile.h"
+#include "CRTDebugLZ.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define FILEHEADER_SIZE   16
+#define BLOCKHEADER_SIZE  48
+#define INDEXENTRY_SIZE   40
+#define TRAILER_SIZE      16
+
+// the maximum number of full blocks waiting for the compression thread
+// before a writing thread has to wait for it.
+#define MAX_QUEUED        8
+
+static inline void put32(unsigned char* p, const unsigned int v)
+{
+  p[0] = v & 0xff;
+  p[1] = (v >> 8) & 0xff;
+  p[2] = (v >> 16) & 0xff;
+  p[3] = (v >> 24) & 0xff;
+}
+
+static inline void put64(unsigned char* p, const unsigned long long v)
+{
+  put32(p, v & 0xffffffff);
+  put32(p+4, v >> 32);
+}
+
+static inline unsigned int get32(const unsigned char* p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static inline unsigned long long get64(const unsigned char* p)
+{
+  return get32(p) | ((unsigned long long)get32(p+4) << 32);
+}
+
+static bool writeAll(const int fd, const void* data, const size_t len)
+{
+  const char* p = (const char*)data;
+  size_t left = len;
+
+  while(left > 0)
+  {
+    ssize_t written = ::write(fd, p, left);
+    if(written < 0)
+    {
+      if(errno == EINTR)
+        continue;
+
+      return false;
+    }
+
+    p += written;
+    left -= written;
+  }
+
+  return true;
+}
+
+static bool readAll(const int fd, void* data, const size_t len, const unsigned long long offset)
+{
+  char* p = (char*)data;
+  size_t left = len;
+  off_t pos = offset;
+
+  while(left > 0)
+  {
+    ssize_t got = pread(fd, p, left, pos);
+    if(got < 0 && errno == EINTR)
+      continue;
+
+    if(got <= 0)
+      return false;
+
+    p += got;
+    pos += got;
+    left -= got;
+  }
+
+  return true;
+}
+
+//  Class:       CRTDebugBlockWriter
+//  Constructor: CRTDebugBlockWriter
+//!
+//! Creates a new block compressed trace file (an existing file will be
+//! truncated) and starts the background compression thread.
+//!
+////////////////////////////////////////////////////////////////////////////////
+CRTDebugBlockWriter::CRTDebugBlockWriter(const char* filename, const size_t blockSize)
+  : m_iFD(-1),
+    m_iBlockSize(blockSize),
+    m_iOffset(0),
+    m_pCurrent(NULL),
+    m_bQuit(false),
+    m_bBusy(false)
+{
+  m_iFD = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if(m_iFD < 0)
+    return;
+
+  unsigned char header[FILEHEADER_SIZE];
+  memcpy(header, "RTDZ", 4);
+  put32(header+4, BLOCKFILE_VERSION);
+  put32(header+8, m_iBlockSize);
+  put32(header+12, 0);
+
+  if(writeAll(m_iFD, header, sizeof(header)) == false)
+  {
+    close(m_iFD);
+    m_iFD = -1;
+    return;
+  }
+
+  m_iOffset = sizeof(header);
+  m_Thread = std::thread(&CRTDebugBlockWriter::compressThread, this);
+}
+
+//  Class:       CRTDebugBlockWriter
+//  Destructor:  CRTDebugBlockWriter
+//!
+//! Writes out all pending blocks, stops the compression thread and finally
+//! adds the block index to the end of the file.
+//!
+////////////////////////////////////////////////////////////////////////////////
+CRTDebugBlockWriter::~CRTDebugBlockWriter()
+{
+  if(m_iFD < 0)
+    return;
+
+  queueBlock();
+
+  {
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_bQuit = true;
+    m_QueueCond.notify_one();
+  }
+
+  m_Thread.join();
+
+  writeIndex();
+  close(m_iFD);
+}
+
+//  Class:       CRTDebugBlockWriter
+//  Method:      write
+//!
+//! Adds a record to the currently filled block. If the record doesn't fit
+//! into the block anymore, the block is handed over to the compression
+//! thread first, so that records are never split across blocks.
+//!
+////////////////////////////////////////////////////////////////////////////////
+bool CRTDebugBlockWriter::write(const CRTDebugRecordInfo& info, const char* data, const size_t len)
+{
+  if(m_iFD < 0)
+    return false;
+
+  if(m_pCurrent != NULL && m_pCurrent->data.size()+len > m_iBlockSize)
+    queueBlock();
+
+  if(m_pCurrent == NULL)
+  {
+    m_pCurrent = new Block();
+    m_pCurrent->data.reserve(m_iBlockSize);
+    m_pCurrent->info.offset = 0;
+    m_pCurrent->info.firstTime = info.time;
+    m_pCurrent->info.lastTime = info.time;
+    m_pCurrent->info.threadMask = 0;
+    m_pCurrent->info.classMask = 0;
+    m_pCurrent->info.rawSize = 0;
+    m_pCurrent->records = 0;
+  }
+
+  Block* block = m_pCurrent;
+  block->data.insert(block->data.end(), data, data+len);
+
+  if(info.time < block->info.firstTime)
+    block->info.firstTime = info.time;
+  if(info.time > block->info.lastTime)
+    block->info.lastTime = info.time;
+
+  block->info.threadMask |= 1ULL << (info.threadID % 64);
+  block->info.classMask |= info.cls;
+  block->records++;
+
+  return true;
+}
+
+//  Class:       CRTDebugBlockWriter
+//  Method:      flush
+//!
+//! Hands over the currently filled block and waits until all queued blocks
+//! have been written to the file.
+//!
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugBlockWriter::flush()
+{
+  if(m_iFD < 0)
+    return;
+
+  queueBlock();
+
+  std::unique_lock<std::mutex> lock(m_Mutex);
+  while(m_Queue.empty() == false || m_bBusy == true)
+    m_DoneCond.wait(lock);
+}
+
+void CRTDebugBlockWriter::queueBlock()
+{
+  if(m_pCurrent == NULL)
+    return;
+
+  std::unique_lock<std::mutex> lock(m_Mutex);
+
+  // if the compression thread cannot keep up we have to wait
+  while(m_Queue.size() >= MAX_QUEUED)
+    m_DoneCond.wait(lock);
+
+  m_Queue.push_back(m_pCurrent);
+  m_pCurrent = NULL;
+  m_QueueCond.notify_one();
+}
+
+//  Class:       CRTDebugBlockWriter
+//  Method:      compressThread
+//!
+//! The main loop of the background thread which compresses and writes all
+//! queued blocks until it is asked to quit.
+//!
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugBlockWriter::compressThread()
+{
+  std::unique_lock<std::mutex> lock(m_Mutex);
+
+  for(;;)
+  {
+    while(m_Queue.empty() && m_bQuit == false)
+      m_QueueCond.wait(lock);
+
+    if(m_Queue.empty())
+      break;
+
+    Block* block = m_Queue.front();
+    m_Queue.pop_front();
+    m_bBusy = true;
+
+    lock.unlock();
+    writeBlock(block);
+    delete block;
+    lock.lock();
+
+    m_bBusy = false;
+    m_DoneCond.notify_all();
+  }
+}
+
+void CRTDebugBlockWriter::writeBlock(Block* block)
+{
+  size_t rawSize = block->data.size();
+  m_Compressed.resize(BLOCKHEADER_SIZE + CRTDebugLZ::compressBound(rawSize));
+
+  unsigned int flags = 0;
+  char* payload = &m_Compressed[BLOCKHEADER_SIZE];
+  size_t stored = CRTDebugLZ::compress(&block->data[0], rawSize,
+                                       payload, m_Compressed.size()-BLOCKHEADER_SIZE);
+
+  // incompressible data is simply stored
+  if(stored == 0 || stored >= rawSize)
+  {
+    memcpy(payload, &block->data[0], rawSize);
+    stored = rawSize;
+    flags |= BLOCKFILE_FLAG_STORED;
+  }
+
+  unsigned char* header = (unsigned char*)&m_Compressed[0];
+  memcpy(header, "RTDB", 4);
+  put32(header+4, rawSize);
+  put32(header+8, stored);
+  put32(header+12, flags);
+  put64(header+16, block->info.firstTime);
+  put64(header+24, block->info.lastTime);
+  put64(header+32, block->info.threadMask);
+  put32(header+40, block->info.classMask);
+  put32(header+44, block->records);
+
+  if(writeAll(m_iFD, header, BLOCKHEADER_SIZE+stored) == false)
+    return;
+
+  block->info.offset = m_iOffset;
+  block->info.rawSize = rawSize;
+  m_Index.push_back(block->info);
+  m_iOffset += BLOCKHEADER_SIZE+stored;
+}
+
+void CRTDebugBlockWriter::writeIndex()
+{
+  std::vector<unsigned char> index(8 + m_Index.size()*INDEXENTRY_SIZE + TRAILER_SIZE);
+  unsigned char* p = &index[0];
+
+  memcpy(p, "RTDI", 4);
+  put32(p+4, m_Index.size());
+  p += 8;
+
+  for(size_t i=0; i < m_Index.size(); i++)
+  {
+    put64(p, m_Index[i].offset);
+    put64(p+8, m_Index[i].firstTime);
+    put64(p+16, m_Index[i].lastTime);
+    put64(p+24, m_Index[i].threadMask);
+    put32(p+32, m_Index[i].classMask);
+    put32(p+36, m_Index[i].rawSize);
+    p += INDEXENTRY_SIZE;
+  }
+
+  put64(p, m_iOffset);
+  memcpy(p+8, "RTDX", 4);
+  put32(p+12, 0);
+
+  writeAll(m_iFD, &index[0], index.size());
+}
+
+CRTDebugBlockReader::CRTDebugBlockReader()
+  : m_iFD(-1)
+{
+}
+
+CRTDebugBlockReader::~CRTDebugBlockReader()
+{
+  close();
+}
+
+//  Class:       CRTDebugBlockReader
+//  Method:      open
+//!
+//! Opens a block compressed trace file and loads its block index.
+//!
+//! @return      true if the file is a valid trace file
+////////////////////////////////////////////////////////////////////////////////
+bool CRTDebugBlockReader::open(const char* filename)
+{
+  close();
+
+  m_iFD = ::open(filename, O_RDONLY);
+  if(m_iFD < 0)
+    return false;
+
+  unsigned char header[FILEHEADER_SIZE];
+  if(readAll(m_iFD, header, sizeof(header), 0) == false ||
+     memcmp(header, "RTDZ", 4) != 0 || get32(header+4) != BLOCKFILE_VERSION)
+  {
+    close();
+    return false;
+  }
+
+  // use the index at the end of the file or walk all block
+  // headers in case the writer didn't finish the file
+  if(readIndex() == false)
+    scanBlocks();
+
+  // the running maximum of the end times allows a binary search even if
+  // the clock went backwards between blocks
+  unsigned long long lastTime = 0;
+  m_LastTimes.reserve(m_Index.size());
+  for(size_t i=0; i < m_Index.size(); i++)
+  {
+    lastTime = std::max(lastTime, m_Index[i].lastTime);
+    m_LastTimes.push_back(lastTime);
+  }
+
+  return true;
+}
+
+void CRTDebugBlockReader::close()
+{
+  if(m_iFD >= 0)
+    ::close(m_iFD);
+
+  m_iFD = -1;
+  m_Index.clear();
+  m_LastTimes.clear();
+}
+
+bool CRTDebugBlockReader::readIndex()
+{
+  struct stat st;
+  if(fstat(m_iFD, &st) != 0 || st.st_size < FILEHEADER_SIZE+8+TRAILER_SIZE)
+    return false;
+
+  unsigned char trailer[TRAILER_SIZE];
+  if(readAll(m_iFD, trailer, sizeof(trailer), st.st_size-TRAILER_SIZE) == false ||
+     memcmp(trailer+8, "RTDX", 4) != 0)
+  {
+    return false;
+  }
+
+  unsigned long long offset = get64(trailer);
+  unsigned char head[8];
+  if(offset+8 > (unsigned long long)st.st_size ||
+     readAll(m_iFD, head, sizeof(head), offset) == false ||
+     memcmp(head, "RTDI", 4) != 0)
+  {
+    return false;
+  }
+
+  unsigned int count = get32(head+4);
+  if(offset+8+(unsigned long long)count*INDEXENTRY_SIZE+TRAILER_SIZE != (unsigned long long)st.st_size)
+    return false;
+
+  std::vector<unsigned char> entries(count*INDEXENTRY_SIZE+1);
+  if(readAll(m_iFD, &entries[0], count*INDEXENTRY_SIZE, offset+8) == false)
+    return false;
+
+  m_Index.resize(count);
+  for(unsigned int i=0; i < count; i++)
+  {
+    const unsigned char* p = &entries[i*INDEXENTRY_SIZE];
+    m_Index[i].offset = get64(p);
+    m_Index[i].firstTime = get64(p+8);
+    m_Index[i].lastTime = get64(p+16);
+    m_Index[i].threadMask = get64(p+24);
+    m_Index[i].classMask = get32(p+32);
+    m_Index[i].rawSize = get32(p+36);
+  }
+
+  return true;
+}
+
+bool CRTDebugBlockReader::scanBlocks()
+{
+  unsigned long long offset = FILEHEADER_SIZE;
+  unsigned char header[BLOCKHEADER_SIZE];
+
+  m_Index.clear();
+  while(readAll(m_iFD, header, sizeof(header), offset) == true &&
+        memcmp(header, "RTDB", 4) == 0)
+  {
+    CRTDebugBlockInfo info;
+    info.offset = offset;
+    info.rawSize = get32(header+4);
+    info.firstTime = get64(header+16);
+    info.lastTime = get64(header+24);
+    info.threadMask = get64(header+32);
+    info.classMask = get32(header+40);
+
+    m_Index.push_back(info);
+    offset += BLOCKHEADER_SIZE + get32(header+8);
+  }
+
+  return m_Index.empty() == false;
+}
+
+//  Class:       CRTDebugBlockReader
+//  Method:      findBlock
+//!
+//! Searches for the first block which might contain records at or after
+//! the specified time by a binary search over the block index.
+//!
+//! @return      the block number or blocks() if there is no such block
+////////////////////////////////////////////////////////////////////////////////
+size_t CRTDebugBlockReader::findBlock(const unsigned long long time) const
+{
+  return std::lower_bound(m_LastTimes.begin(), m_LastTimes.end(), time) - m_LastTimes.begin();
+}
+
+//  Class:       CRTDebugBlockReader
+//  Method:      readBlock
+//!
+//! Reads and decompresses a single block of the trace file.
+//!
+//! @return      false if the block is corrupt or could not be read
+////////////////////////////////////////////////////////////////////////////////
+bool CRTDebugBlockReader::readBlock(const size_t i, std::string& data)
+{
+  if(m_iFD < 0 || i >= m_Index.size())
+    return false;
+
+  unsigned char header[BLOCKHEADER_SIZE];
+  if(readAll(m_iFD, header, sizeof(header), m_Index[i].offset) == false ||
+     memcmp(header, "RTDB", 4) != 0)
+  {
+    return false;
+  }
+
+  size_t rawSize = get32(header+4);
+  size_t stored = get32(header+8);
+  unsigned int flags = get32(header+12);
+
+  m_Compressed.resize(stored+1);
+  if(readAll(m_iFD, &m_Compressed[0], stored, m_Index[i].offset+BLOCKHEADER_SIZE) == false)
+    return false;
+
+  if(flags & BLOCKFILE_FLAG_STORED)
+  {
+    data.assign(&m_Compressed[0], stored);
+    return stored == rawSize;
+  }
+
+  data.resize(rawSize);
+  return CRTDebugLZ::decompress(&m_Compressed[0], stored, &data[0], rawSize);
+}
+
+bool CRTDebugBlockReader::isBlockFile(const char* filename)
+{
+  int fd = ::open(filename, O_RDONLY);
+  if(fd < 0)
+    return false;
+
+  char magic[4];
+  bool result = readAll(fd, magic, sizeof(magic), 0) && memcmp(magic, "RTDZ", 4) == 0;
+  ::close(fd);
+
+  return result;
+}
@@ -0,0 +1,150 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+#ifndef CRTDEBUGBLOCKFILE_H
+#define CRTDEBUGBLOCKFILE_H
+
+#include "CRTDebugSink.h"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// The block compressed trace file format (all values little-endian):
+//
+//   file header:  "RTDZ", u32 version, u32 block size, u32 reserved
+//   n * block:    "RTDB", u32 raw size, u32 stored size, u32 flags,
+//                 u64 first time, u64 last time, u64 thread mask,
+//                 u32 class mask, u32 records, <stored size bytes payload>
+//   index:        "RTDI", u32 count, count * (u64 offset, u64 first time,
+//                 u64 last time, u64 thread mask, u32 class mask, u32 raw size)
+//   trailer:      u64 index offset, "RTDX", u32 reserved
+//
+// Every block only contains complete records so that it can be decoded on
+// its own. Times are microseconds since the epoch and the thread mask has
+// bit (id % 64) set for every rtdebug thread id which wrote to that block.
+// The index and trailer are written when the file is closed. If they are
+// missing (e.g. after a crash) a reader can still walk the block headers.
+#define BLOCKFILE_VERSION     1
+#define BLOCKFILE_BLOCKSIZE   (64*1024)
+#define BLOCKFILE_FLAG_STORED (1<<0) // payload is stored uncompressed
+
+//! information about a single block of a block compressed trace file
+struct CRTDebugBlockInfo
+{
+  unsigned long long  offset;       //!< file offset of the block header
+  unsigned long long  firstTime;    //!< time of the first record
+  unsigned long long  lastTime;     //!< time of the last record
+  unsigned long long  threadMask;   //!< bit set of thread ids in the block
+  unsigned int        classMask;    //!< debug classes found in the block
+  unsigned int        rawSize;      //!< uncompressed size of the block
+};
+
+//  Classname:   CRTDebugBlockWriter
+//! @brief sink writing block compressed trace files
+//! @ingroup debug
+//!
+//! Records are collected into fixed size blocks which are then compressed
+//! with CRTDebugLZ and written by a background thread, so that the threads
+//! emitting debug output never have to wait for the compression or the disk
+//! as long as the background thread keeps up.
+////////////////////////////////////////////////////////////////////////////////
+class CRTDebugBlockWriter : public CRTDebugSink
+{
+  public:
+    CRTDebugBlockWriter(const char* filename, const size_t blockSize=BLOCKFILE_BLOCKSIZE);
+    ~CRTDebugBlockWriter();
+
+    bool isOpen() const { return m_iFD >= 0; }
+    bool write(const CRTDebugRecordInfo& info, const char* data, const size_t len);
+    void flush();
+
+  private:
+    struct Block
+    {
+      std::vector<char>   data;
+      CRTDebugBlockInfo   info;
+      unsigned int        records;
+    };
+
+    void queueBlock();
+    void writeBlock(Block* block);
+    void writeIndex();
+    void compressThread();
+
+  private:
+    int                     m_iFD;          //!< the trace file descriptor
+    size_t                  m_iBlockSize;   //!< the raw size of a block
+    unsigned long long      m_iOffset;      //!< current file offset
+    Block*                  m_pCurrent;     //!< the block currently filled
+    std::deque<Block*>      m_Queue;        //!< full blocks to be compressed
+    std::vector<CRTDebugBlockInfo> m_Index; //!< the index of written blocks
+    std::vector<char>       m_Compressed;   //!< compression output buffer
+
+    std::thread             m_Thread;       //!< the compression thread
+    std::mutex              m_Mutex;        //!< protects the queue
+    std::condition_variable m_QueueCond;    //!< signals new queued blocks
+    std::condition_variable m_DoneCond;     //!< signals written blocks
+    bool                    m_bQuit;        //!< ask the thread to terminate
+    bool                    m_bBusy;        //!< thread writes a block
+};
+
+//  Classname:   CRTDebugBlockReader
+//! @brief reader for block compressed trace files
+//! @ingroup debug
+//!
+//! Loads the block index of a trace file written by CRTDebugBlockWriter
+//! (or reconstructs it from the block headers if the file was not closed
+//! properly) and allows to decompress individual blocks. Using the time
+//! ranges of the blocks a reader can directly skip all blocks outside
+//! of a time window of interest.
+////////////////////////////////////////////////////////////////////////////////
+class CRTDebugBlockReader
+{
+  public:
+    CRTDebugBlockReader();
+    ~CRTDebugBlockReader();
+
+    bool open(const char* filename);
+    void close();
+
+    size_t blocks() const { return m_Index.size(); }
+    const CRTDebugBlockInfo& block(const size_t i) const { return m_Index[i]; }
+    size_t findBlock(const unsigned long long time) const;
+    bool readBlock(const size_t i, std::string& data);
+
+    static bool isBlockFile(const char* filename);
+
+  private:
+    bool readIndex();
+    bool scanBlocks();
+
+  private:
+    int                     m_iFD;          //!< the trace file descriptor
+    std::vector<CRTDebugBlockInfo> m_Index; //!< the index of all blocks
+    std::vector<unsigned long long> m_LastTimes; //!< running maximum of the block end times
+    std::vector<char>       m_Compressed;   //!< buffer for the raw payload
+};
+
+#endif // CRTDEBUGBLOCKFILE_H
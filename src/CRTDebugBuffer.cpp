@@ -0,0 +1,202 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+#include "CRTDebugBuffer.h"
+#include "CRTDebugArena.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// the initial size of a record buffer. Most records fit into this, so
+// a buffer usually never has to grow at all.
+#define BUFFER_INITSIZE 1024
+
+CRTDebugBuffer::CRTDebugBuffer()
+  : m_pBuffer(NULL),
+    m_iLength(0),
+    m_iCapacity(0)
+{
+  reserve(BUFFER_INITSIZE-1);
+}
+
+CRTDebugBuffer::~CRTDebugBuffer()
+{
+  CRTDebugArena::instance()->release(m_pBuffer);
+}
+
+//  Class:       CRTDebugBuffer
+//  Method:      reserve
+//!
+//! Makes sure that at least len more bytes (plus a terminating NUL byte)
+//! can be appended to the buffer without having to grow it again.
+//!
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugBuffer::reserve(const size_t len)
+{
+  if(m_iLength+len+1 <= m_iCapacity)
+    return;
+
+  size_t capacity = m_iCapacity > 0 ? m_iCapacity : BUFFER_INITSIZE;
+  while(capacity < m_iLength+len+1)
+    capacity *= 2;
+
+  char* buffer = (char*)CRTDebugArena::instance()->reallocate(m_pBuffer, m_iCapacity, capacity);
+  if(buffer == NULL)
+    return;
+
+  m_pBuffer = buffer;
+  m_iCapacity = capacity;
+}
+
+void CRTDebugBuffer::append(const char* string)
+{
+  if(string != NULL)
+    append(string, strlen(string));
+}
+
+void CRTDebugBuffer::append(const char* string, size_t len)
+{
+  reserve(len);
+  if(m_iLength+len+1 > m_iCapacity)
+    return;
+
+  memcpy(m_pBuffer+m_iLength, string, len);
+  m_iLength += len;
+  m_pBuffer[m_iLength] = '\0';
+}
+
+void CRTDebugBuffer::append(const char c, const size_t count)
+{
+  reserve(count);
+  if(m_iLength+count+1 > m_iCapacity)
+    return;
+
+  memset(m_pBuffer+m_iLength, c, count);
+  m_iLength += count;
+  m_pBuffer[m_iLength] = '\0';
+}
+
+//  Class:       CRTDebugBuffer
+//  Method:      appendDec
+//!
+//! Appends a decimal number, optionally padded to a minimum width with
+//! the specified fill character (e.g. like std::setw()/std::setfill()).
+//!
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugBuffer::appendDec(const long long value, const int width, const char fill)
+{
+  char digits[24];
+  char* p = digits+sizeof(digits);
+  unsigned long long v = value < 0 ? -(unsigned long long)value : value;
+
+  do
+  {
+    *--p = '0' + (v % 10);
+    v /= 10;
+  }
+  while(v != 0);
+
+  if(value < 0)
+    *--p = '-';
+
+  int len = (digits+sizeof(digits)) - p;
+  if(len < width)
+    append(fill, width-len);
+
+  append(p, len);
+}
+
+//  Class:       CRTDebugBuffer
+//  Method:      appendHex
+//!
+//! Appends a lowercase hexadecimal number zero padded to a minimum width.
+//!
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugBuffer::appendHex(const unsigned long long value, const int width)
+{
+  static const char hexdigits[] = "0123456789abcdef";
+  char digits[20];
+  char* p = digits+sizeof(digits);
+  unsigned long long v = value;
+
+  do
+  {
+    *--p = hexdigits[v & 0xf];
+    v >>= 4;
+  }
+  while(v != 0);
+
+  int len = (digits+sizeof(digits)) - p;
+  if(len < width)
+    append('0', width-len);
+
+  append(p, len);
+}
+
+void CRTDebugBuffer::appendf(const char* fmt, ...)
+{
+  va_list args;
+  va_start(args, fmt);
+  vappendf(fmt, args);
+  va_end(args);
+}
+
+//  Class:       CRTDebugBuffer
+//  Method:      vappendf
+//!
+//! Formats a printf()-like format string directly into the buffer without
+//! requiring a temporary vasprintf() allocation.
+//!
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugBuffer::vappendf(const char* fmt, va_list args)
+{
+  if(m_pBuffer == NULL)
+    return;
+
+  va_list argcopy;
+  va_copy(argcopy, args);
+  int len = vsnprintf(m_pBuffer+m_iLength, m_iCapacity-m_iLength, fmt, argcopy);
+  va_end(argcopy);
+
+  if(len < 0)
+  {
+    m_pBuffer[m_iLength] = '\0';
+    return;
+  }
+
+  // if the output didn't fit we grow the buffer and format it once more
+  if(m_iLength+len+1 > m_iCapacity)
+  {
+    reserve(len);
+    if(m_iLength+len+1 > m_iCapacity)
+    {
+      m_pBuffer[m_iLength] = '\0';
+      return;
+    }
+
+    va_copy(argcopy, args);
+    vsnprintf(m_pBuffer+m_iLength, m_iCapacity-m_iLength, fmt, argcopy);
+    va_end(argcopy);
+  }
+
+  m_iLength += len;
+}
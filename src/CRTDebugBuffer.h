@@ -0,0 +1,74 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+#ifndef CRTDEBUGBUFFER_H
+#define CRTDEBUGBUFFER_H
+
+#include <cstdarg>
+#include <cstddef>
+
+//  Classname:   CRTDebugBuffer
+//! @brief growing character buffer used to assemble one output record
+//! @ingroup debug
+//!
+//! Every debug record is completely assembled within such a buffer before
+//! it is handed over to an output sink with a single write() call.
+//! This way a record (if smaller than PIPE_BUF) is written atomically even
+//! if several processes share the same terminal or pipe, and we avoid the
+//! many small writes an unbuffered std::cerr chain would cause.
+//!
+//! The buffer keeps its memory between records so that in the steady state
+//! no allocations are required at all.
+////////////////////////////////////////////////////////////////////////////////
+class CRTDebugBuffer
+{
+  public:
+    CRTDebugBuffer();
+    ~CRTDebugBuffer();
+
+    void clear() { m_iLength = 0; }
+    void truncate(const size_t len) { if(len < m_iLength) { m_iLength = len; m_pBuffer[len] = '\0'; } }
+    const char* data() const { return m_pBuffer; }
+    size_t length() const { return m_iLength; }
+
+    // methods to append data to the buffer
+    void append(const char* string);
+    void append(const char* string, size_t len);
+    void append(const char c, const size_t count=1);
+    void appendDec(const long long value, const int width=0, const char fill=' ');
+    void appendHex(const unsigned long long value, const int width=0);
+    void appendf(const char* fmt, ...);
+    void vappendf(const char* fmt, va_list args);
+
+  private:
+    void reserve(const size_t len);
+
+    // buffers must not be copied
+    CRTDebugBuffer(const CRTDebugBuffer&);
+    CRTDebugBuffer& operator=(const CRTDebugBuffer&);
+
+  private:
+    char*   m_pBuffer;    //!< the actual character data
+    size_t  m_iLength;    //!< number of used bytes
+    size_t  m_iCapacity;  //!< number of allocated bytes
+};
+
+#endif // CRTDEBUGBUFFER_H
@@ -0,0 +1,737 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+#include "CRTDebugColumns.h"
+#include "CRTDebugLZ.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define FILEHEADER_SIZE   16
+#define GROUPHEADER_SIZE  48
+#define COLUMNENTRY_SIZE  16
+#define INDEXENTRY_SIZE   40
+#define TRAILER_SIZE      16
+
+static inline void put32(unsigned char* p, const unsigned int v)
+{
+  p[0] = v & 0xff;
+  p[1] = (v >> 8) & 0xff;
+  p[2] = (v >> 16) & 0xff;
+  p[3] = (v >> 24) & 0xff;
+}
+
+static inline void put64(unsigned char* p, const unsigned long long v)
+{
+  put32(p, v & 0xffffffff);
+  put32(p+4, v >> 32);
+}
+
+static inline unsigned int get32(const unsigned char* p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static inline unsigned long long get64(const unsigned char* p)
+{
+  return get32(p) | ((unsigned long long)get32(p+4) << 32);
+}
+
+static inline void putVarint(std::string& column, unsigned long long v)
+{
+  while(v >= 0x80)
+  {
+    column += (char)((v & 0x7f) | 0x80);
+    v >>= 7;
+  }
+  column += (char)v;
+}
+
+static inline bool getVarint(const unsigned char*& p, const unsigned char* end, unsigned long long& v)
+{
+  v = 0;
+  for(int shift=0; p < end && shift < 64; shift += 7)
+  {
+    unsigned char b = *p++;
+    v |= (unsigned long long)(b & 0x7f) << shift;
+    if((b & 0x80) == 0)
+      return true;
+  }
+
+  return false;
+}
+
+static bool writeAll(const int fd, const void* data, const size_t len)
+{
+  const char* p = (const char*)data;
+  size_t left = len;
+
+  while(left > 0)
+  {
+    ssize_t written = ::write(fd, p, left);
+    if(written < 0)
+    {
+      if(errno == EINTR)
+        continue;
+
+      return false;
+    }
+
+    p += written;
+    left -= written;
+  }
+
+  return true;
+}
+
+static bool readAll(const int fd, void* data, const size_t len, const unsigned long long offset)
+{
+  char* p = (char*)data;
+  size_t left = len;
+  off_t pos = offset;
+
+  while(left > 0)
+  {
+    ssize_t got = pread(fd, p, left, pos);
+    if(got < 0 && errno == EINTR)
+      continue;
+
+    if(got <= 0)
+      return false;
+
+    p += got;
+    pos += got;
+    left -= got;
+  }
+
+  return true;
+}
+
+//  Class:       CRTDebugColumnWriter
+//  Constructor: CRTDebugColumnWriter
+//!
+//! Creates a new columnar trace file (an existing file will be truncated).
+//!
+////////////////////////////////////////////////////////////////////////////////
+CRTDebugColumnWriter::CRTDebugColumnWriter(const char* filename, const size_t rowGroupSize)
+  : m_iFD(-1),
+    m_iRowGroupSize(rowGroupSize),
+    m_iOffset(0),
+    m_iLastTime(0)
+{
+  memset(&m_Current, 0, sizeof(m_Current));
+
+  m_iFD = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if(m_iFD < 0)
+    return;
+
+  unsigned char header[FILEHEADER_SIZE];
+  memcpy(header, "RTDC", 4);
+  put32(header+4, COLUMNFILE_VERSION);
+  put32(header+8, m_iRowGroupSize);
+  put32(header+12, getpid());
+
+  if(writeAll(m_iFD, header, sizeof(header)) == false)
+  {
+    close(m_iFD);
+    m_iFD = -1;
+    return;
+  }
+
+  m_iOffset = sizeof(header);
+}
+
+//  Class:       CRTDebugColumnWriter
+//  Destructor:  CRTDebugColumnWriter
+//!
+//! Writes out the last row group and adds the row group index to the end
+//! of the file.
+//!
+////////////////////////////////////////////////////////////////////////////////
+CRTDebugColumnWriter::~CRTDebugColumnWriter()
+{
+  if(m_iFD < 0)
+    return;
+
+  writeRowGroup();
+  writeIndex();
+  close(m_iFD);
+}
+
+//  Class:       CRTDebugColumnWriter
+//  Method:      write
+//!
+//! Splits a record into its columns and appends them to the current row
+//! group. Records without a known message part (e.g. reports) are stored
+//! with their complete text as message.
+//!
+////////////////////////////////////////////////////////////////////////////////
+bool CRTDebugColumnWriter::write(const CRTDebugRecordInfo& info, const char* data, const size_t len)
+{
+  if(m_iFD < 0)
+    return false;
+
+  if(m_Current.rows == 0)
+  {
+    m_Current.firstTime = info.time;
+    m_Current.lastTime = info.time;
+    m_Current.threadMask = 0;
+    m_Current.classMask = 0;
+    m_iLastTime = 0;
+  }
+
+  // records of different threads are not strictly ordered by time
+  long long delta = (long long)(info.time - m_iLastTime);
+  putVarint(m_Columns[COLUMN_TIME], ((unsigned long long)delta << 1) ^ (unsigned long long)(delta >> 63));
+  m_iLastTime = info.time;
+
+  putVarint(m_Columns[COLUMN_THREAD], info.threadID);
+  putVarint(m_Columns[COLUMN_CLASS], info.cls);
+  putVarint(m_Columns[COLUMN_SPAN], info.span);
+  putVarint(m_Columns[COLUMN_INDENT], info.indent);
+  putVarint(m_Columns[COLUMN_FILE], lookup(info.file));
+  putVarint(m_Columns[COLUMN_LINE], info.line > 0 ? info.line : 0);
+  putVarint(m_Columns[COLUMN_MODULE], lookup(info.module));
+  putVarint(m_Columns[COLUMN_FUNCTION], lookup(info.function));
+  putVarint(m_Columns[COLUMN_FORMAT], lookup(info.format));
+
+  const char* message = data;
+  size_t messageLength = len;
+  if(info.file != NULL && (size_t)info.messageOffset + info.messageLength <= len)
+  {
+    message = data + info.messageOffset;
+    messageLength = info.messageLength;
+  }
+  else if(messageLength > 0 && message[messageLength-1] == '\n')
+    messageLength--;
+
+  putVarint(m_Columns[COLUMN_MESSAGE], messageLength);
+  m_Columns[COLUMN_MESSAGE].append(message, messageLength);
+
+  if(info.time < m_Current.firstTime)
+    m_Current.firstTime = info.time;
+  if(info.time > m_Current.lastTime)
+    m_Current.lastTime = info.time;
+
+  m_Current.threadMask |= 1ULL << (info.threadID % 64);
+  m_Current.classMask |= info.cls;
+  m_Current.rows++;
+
+  if(m_Current.rows >= m_iRowGroupSize)
+    writeRowGroup();
+
+  return true;
+}
+
+//  Class:       CRTDebugColumnWriter
+//  Method:      flush
+//!
+//! Writes the current row group even if it is not full yet.
+//!
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugColumnWriter::flush()
+{
+  if(m_iFD < 0)
+    return;
+
+  writeRowGroup();
+}
+
+//  Class:       CRTDebugColumnWriter
+//  Method:      lookup
+//!
+//! Returns the dictionary id of a string. Strings seen for the first time
+//! get the next free id and are added to the DICTIONARY column of the
+//! current row group.
+//!
+//! @param  string   the string to look up or NULL
+//! @return          the dictionary id or 0 for NULL and empty strings
+////////////////////////////////////////////////////////////////////////////////
+unsigned int CRTDebugColumnWriter::lookup(const char* string)
+{
+  if(string == NULL || *string == '\0')
+    return 0;
+
+  m_sKey.assign(string);
+  std::unordered_map<std::string, unsigned int>::const_iterator it = m_Dictionary.find(m_sKey);
+  if(it != m_Dictionary.end())
+    return it->second;
+
+  unsigned int id = m_Dictionary.size()+1;
+  m_Dictionary.insert(std::make_pair(m_sKey, id));
+
+  putVarint(m_Columns[COLUMN_DICTIONARY], m_sKey.length());
+  m_Columns[COLUMN_DICTIONARY].append(m_sKey);
+
+  return id;
+}
+
+void CRTDebugColumnWriter::writeRowGroup()
+{
+  if(m_Current.rows == 0)
+    return;
+
+  size_t headerSize = GROUPHEADER_SIZE + COLUMN_COUNT*COLUMNENTRY_SIZE;
+  size_t bound = headerSize;
+  for(int c=0; c < COLUMN_COUNT; c++)
+    bound += CRTDebugLZ::compressBound(m_Columns[c].size());
+
+  m_Compressed.resize(bound);
+  unsigned char* header = (unsigned char*)&m_Compressed[0];
+  size_t pos = headerSize;
+
+  for(int c=0; c < COLUMN_COUNT; c++)
+  {
+    const std::string& raw = m_Columns[c];
+    char* payload = &m_Compressed[pos];
+    unsigned int flags = 0;
+    size_t stored = 0;
+
+    if(raw.empty() == false)
+      stored = CRTDebugLZ::compress(raw.data(), raw.size(), payload, bound-pos);
+
+    // incompressible columns are simply stored
+    if(stored == 0 || stored >= raw.size())
+    {
+      memcpy(payload, raw.data(), raw.size());
+      stored = raw.size();
+      flags |= COLUMNFILE_FLAG_STORED;
+    }
+
+    unsigned char* entry = header + GROUPHEADER_SIZE + c*COLUMNENTRY_SIZE;
+    put32(entry, c);
+    put32(entry+4, raw.size());
+    put32(entry+8, stored);
+    put32(entry+12, flags);
+    pos += stored;
+  }
+
+  memcpy(header, "RTDG", 4);
+  put32(header+4, m_Current.rows);
+  put32(header+8, COLUMN_COUNT);
+  put32(header+12, 0);
+  put64(header+16, m_Current.firstTime);
+  put64(header+24, m_Current.lastTime);
+  put64(header+32, m_Current.threadMask);
+  put32(header+40, m_Current.classMask);
+  put32(header+44, 0);
+
+  if(writeAll(m_iFD, header, pos) == true)
+  {
+    m_Current.offset = m_iOffset;
+    m_Index.push_back(m_Current);
+    m_iOffset += pos;
+  }
+
+  for(int c=0; c < COLUMN_COUNT; c++)
+    m_Columns[c].clear();
+
+  m_Current.rows = 0;
+}
+
+void CRTDebugColumnWriter::writeIndex()
+{
+  std::vector<unsigned char> index(8 + m_Index.size()*INDEXENTRY_SIZE + TRAILER_SIZE);
+  unsigned char* p = &index[0];
+
+  memcpy(p, "RTDI", 4);
+  put32(p+4, m_Index.size());
+  p += 8;
+
+  for(size_t i=0; i < m_Index.size(); i++)
+  {
+    put64(p, m_Index[i].offset);
+    put64(p+8, m_Index[i].firstTime);
+    put64(p+16, m_Index[i].lastTime);
+    put64(p+24, m_Index[i].threadMask);
+    put32(p+32, m_Index[i].classMask);
+    put32(p+36, m_Index[i].rows);
+    p += INDEXENTRY_SIZE;
+  }
+
+  put64(p, m_iOffset);
+  memcpy(p+8, "RTDX", 4);
+  put32(p+12, 0);
+
+  writeAll(m_iFD, &index[0], index.size());
+}
+
+CRTDebugColumnReader::CRTDebugColumnReader()
+  : m_iFD(-1),
+    m_iPID(0)
+{
+}
+
+CRTDebugColumnReader::~CRTDebugColumnReader()
+{
+  close();
+}
+
+//  Class:       CRTDebugColumnReader
+//  Method:      open
+//!
+//! Opens a columnar trace file and loads its row group index as well as
+//! the dictionary entries of all row groups.
+//!
+//! @return      true if the file is a valid columnar trace file
+////////////////////////////////////////////////////////////////////////////////
+bool CRTDebugColumnReader::open(const char* filename)
+{
+  close();
+
+  m_iFD = ::open(filename, O_RDONLY);
+  if(m_iFD < 0)
+    return false;
+
+  unsigned char header[FILEHEADER_SIZE];
+  if(readAll(m_iFD, header, sizeof(header), 0) == false ||
+     memcmp(header, "RTDC", 4) != 0 || get32(header+4) != COLUMNFILE_VERSION)
+  {
+    close();
+    return false;
+  }
+
+  m_iPID = get32(header+12);
+
+  // use the index at the end of the file or walk all row group
+  // headers in case the writer didn't finish the file
+  if(readIndex() == false)
+    scanRowGroups();
+
+  if(readDictionaries() == false)
+  {
+    close();
+    return false;
+  }
+
+  return true;
+}
+
+void CRTDebugColumnReader::close()
+{
+  if(m_iFD >= 0)
+    ::close(m_iFD);
+
+  m_iFD = -1;
+  m_iPID = 0;
+  m_Index.clear();
+  m_Dictionary.clear();
+}
+
+bool CRTDebugColumnReader::readIndex()
+{
+  struct stat st;
+  if(fstat(m_iFD, &st) != 0 || st.st_size < FILEHEADER_SIZE+8+TRAILER_SIZE)
+    return false;
+
+  unsigned char trailer[TRAILER_SIZE];
+  if(readAll(m_iFD, trailer, sizeof(trailer), st.st_size-TRAILER_SIZE) == false ||
+     memcmp(trailer+8, "RTDX", 4) != 0)
+  {
+    return false;
+  }
+
+  unsigned long long offset = get64(trailer);
+  unsigned char head[8];
+  if(offset+8 > (unsigned long long)st.st_size ||
+     readAll(m_iFD, head, sizeof(head), offset) == false ||
+     memcmp(head, "RTDI", 4) != 0)
+  {
+    return false;
+  }
+
+  unsigned int count = get32(head+4);
+  if(offset+8+(unsigned long long)count*INDEXENTRY_SIZE+TRAILER_SIZE != (unsigned long long)st.st_size)
+    return false;
+
+  std::vector<unsigned char> entries(count*INDEXENTRY_SIZE+1);
+  if(readAll(m_iFD, &entries[0], count*INDEXENTRY_SIZE, offset+8) == false)
+    return false;
+
+  m_Index.resize(count);
+  for(unsigned int i=0; i < count; i++)
+  {
+    const unsigned char* p = &entries[i*INDEXENTRY_SIZE];
+    m_Index[i].offset = get64(p);
+    m_Index[i].firstTime = get64(p+8);
+    m_Index[i].lastTime = get64(p+16);
+    m_Index[i].threadMask = get64(p+24);
+    m_Index[i].classMask = get32(p+32);
+    m_Index[i].rows = get32(p+36);
+  }
+
+  return true;
+}
+
+bool CRTDebugColumnReader::scanRowGroups()
+{
+  unsigned long long offset = FILEHEADER_SIZE;
+  unsigned char header[GROUPHEADER_SIZE];
+
+  m_Index.clear();
+  while(readAll(m_iFD, header, sizeof(header), offset) == true &&
+        memcmp(header, "RTDG", 4) == 0)
+  {
+    unsigned int columns = get32(header+8);
+    std::vector<unsigned char> table(columns*COLUMNENTRY_SIZE+1);
+    if(readAll(m_iFD, &table[0], columns*COLUMNENTRY_SIZE, offset+GROUPHEADER_SIZE) == false)
+      break;
+
+    CRTDebugRowGroupInfo info;
+    info.offset = offset;
+    info.rows = get32(header+4);
+    info.firstTime = get64(header+16);
+    info.lastTime = get64(header+24);
+    info.threadMask = get64(header+32);
+    info.classMask = get32(header+40);
+
+    m_Index.push_back(info);
+
+    offset += GROUPHEADER_SIZE + columns*COLUMNENTRY_SIZE;
+    for(unsigned int c=0; c < columns; c++)
+      offset += get32(&table[c*COLUMNENTRY_SIZE+8]);
+  }
+
+  return m_Index.empty() == false;
+}
+
+bool CRTDebugColumnReader::readDictionaries()
+{
+  // id 0 stands for no string at all
+  m_Dictionary.assign(1, std::string());
+
+  std::string data;
+  for(size_t i=0; i < m_Index.size(); i++)
+  {
+    if(readColumn(i, COLUMN_DICTIONARY, data) == false)
+      return false;
+
+    const unsigned char* p = (const unsigned char*)data.data();
+    const unsigned char* end = p + data.size();
+    while(p < end)
+    {
+      unsigned long long len;
+      if(getVarint(p, end, len) == false || len > (unsigned long long)(end - p))
+        return false;
+
+      m_Dictionary.push_back(std::string((const char*)p, len));
+      p += len;
+    }
+  }
+
+  return true;
+}
+
+//  Class:       CRTDebugColumnReader
+//  Method:      findRowGroup
+//!
+//! Searches for the first row group which might contain records at or
+//! after the specified time.
+//!
+//! @return      the row group number or rowGroups() if there is no such group
+////////////////////////////////////////////////////////////////////////////////
+size_t CRTDebugColumnReader::findRowGroup(const unsigned long long time) const
+{
+  for(size_t i=0; i < m_Index.size(); i++)
+  {
+    if(m_Index[i].lastTime >= time)
+      return i;
+  }
+
+  return m_Index.size();
+}
+
+const std::string& CRTDebugColumnReader::string(const unsigned int id) const
+{
+  static const std::string none;
+
+  return id < m_Dictionary.size() ? m_Dictionary[id] : none;
+}
+
+//  Class:       CRTDebugColumnReader
+//  Method:      readColumn
+//!
+//! Reads and decompresses the payload of a single column of a row group
+//! without touching any of the other columns.
+//!
+//! @return      false if the row group is corrupt or could not be read
+////////////////////////////////////////////////////////////////////////////////
+bool CRTDebugColumnReader::readColumn(const size_t group, const CRTDebugColumn column, std::string& data)
+{
+  if(m_iFD < 0 || group >= m_Index.size())
+    return false;
+
+  unsigned long long offset = m_Index[group].offset;
+  unsigned char header[GROUPHEADER_SIZE];
+  if(readAll(m_iFD, header, sizeof(header), offset) == false ||
+     memcmp(header, "RTDG", 4) != 0)
+  {
+    return false;
+  }
+
+  unsigned int columns = get32(header+8);
+  std::vector<unsigned char> table(columns*COLUMNENTRY_SIZE+1);
+  if(readAll(m_iFD, &table[0], columns*COLUMNENTRY_SIZE, offset+GROUPHEADER_SIZE) == false)
+    return false;
+
+  // the payloads follow the column table in the same order
+  offset += GROUPHEADER_SIZE + columns*COLUMNENTRY_SIZE;
+  for(unsigned int c=0; c < columns; c++)
+  {
+    const unsigned char* entry = &table[c*COLUMNENTRY_SIZE];
+    size_t rawSize = get32(entry+4);
+    size_t stored = get32(entry+8);
+
+    if(get32(entry) != (unsigned int)column)
+    {
+      offset += stored;
+      continue;
+    }
+
+    m_Compressed.resize(stored+1);
+    if(readAll(m_iFD, &m_Compressed[0], stored, offset) == false)
+      return false;
+
+    if(get32(entry+12) & COLUMNFILE_FLAG_STORED)
+    {
+      data.assign(&m_Compressed[0], stored);
+      return stored == rawSize;
+    }
+
+    data.resize(rawSize);
+    return CRTDebugLZ::decompress(&m_Compressed[0], stored, &data[0], rawSize);
+  }
+
+  // columns unknown to the writer are empty
+  data.clear();
+  return true;
+}
+
+//  Class:       CRTDebugColumnReader
+//  Method:      readValues
+//!
+//! Decodes a numeric column or the ids of a dictionary column of a row
+//! group. Times are returned as absolute values.
+//!
+//! @return      false if the column is corrupt or could not be read
+////////////////////////////////////////////////////////////////////////////////
+bool CRTDebugColumnReader::readValues(const size_t group, const CRTDebugColumn column,
+                                      std::vector<unsigned long long>& values)
+{
+  std::string data;
+  if(column == COLUMN_MESSAGE || column == COLUMN_DICTIONARY ||
+     readColumn(group, column, data) == false)
+  {
+    return false;
+  }
+
+  const unsigned char* p = (const unsigned char*)data.data();
+  const unsigned char* end = p + data.size();
+  unsigned int rows = m_Index[group].rows;
+  unsigned long long time = 0;
+
+  values.resize(rows);
+  for(unsigned int i=0; i < rows; i++)
+  {
+    unsigned long long v;
+    if(getVarint(p, end, v) == false)
+      return false;
+
+    if(column == COLUMN_TIME)
+    {
+      time += (v >> 1) ^ (~(v & 1) + 1);
+      v = time;
+    }
+
+    values[i] = v;
+  }
+
+  return true;
+}
+
+//  Class:       CRTDebugColumnReader
+//  Method:      readStrings
+//!
+//! Decodes the message column or resolves the ids of a dictionary column
+//! of a row group to their strings.
+//!
+//! @return      false if the column is corrupt or could not be read
+////////////////////////////////////////////////////////////////////////////////
+bool CRTDebugColumnReader::readStrings(const size_t group, const CRTDebugColumn column,
+                                       std::vector<std::string>& values)
+{
+  if(column != COLUMN_MESSAGE)
+  {
+    if(column != COLUMN_FILE && column != COLUMN_MODULE &&
+       column != COLUMN_FUNCTION && column != COLUMN_FORMAT)
+    {
+      return false;
+    }
+
+    std::vector<unsigned long long> ids;
+    if(readValues(group, column, ids) == false)
+      return false;
+
+    values.resize(ids.size());
+    for(size_t i=0; i < ids.size(); i++)
+      values[i] = string(ids[i]);
+
+    return true;
+  }
+
+  std::string data;
+  if(readColumn(group, column, data) == false)
+    return false;
+
+  const unsigned char* p = (const unsigned char*)data.data();
+  const unsigned char* end = p + data.size();
+  unsigned int rows = m_Index[group].rows;
+
+  values.resize(rows);
+  for(unsigned int i=0; i < rows; i++)
+  {
+    unsigned long long len;
+    if(getVarint(p, end, len) == false || len > (unsigned long long)(end - p))
+      return false;
+
+    values[i].assign((const char*)p, len);
+    p += len;
+  }
+
+  return true;
+}
+
+bool CRTDebugColumnReader::isColumnFile(const char* filename)
+{
+  int fd = ::open(filename, O_RDONLY);
+  if(fd < 0)
+    return false;
+
+  char magic[4];
+  bool result = readAll(fd, magic, sizeof(magic), 0) && memcmp(magic, "RTDC", 4) == 0;
+  ::close(fd);
+
+  return result;
+}
@@ -0,0 +1,173 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+#ifndef CRTDEBUGCOLUMNS_H
+#define CRTDEBUGCOLUMNS_H
+
+#include "CRTDebugSink.h"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+// The columnar trace file format (all fixed size values little-endian):
+//
+//   file header:  "RTDC", u32 version, u32 row group size, u32 process ID
+//   n * group:    "RTDG", u32 rows, u32 columns, u32 reserved,
+//                 u64 first time, u64 last time, u64 thread mask,
+//                 u32 class mask, u32 reserved,
+//                 columns * (u32 column, u32 raw size, u32 stored size, u32 flags),
+//                 <the stored column payloads in the same order>
+//   index:        "RTDI", u32 count, count * (u64 offset, u64 first time,
+//                 u64 last time, u64 thread mask, u32 class mask, u32 rows)
+//   trailer:      u64 index offset, "RTDX", u32 reserved
+//
+// Within a row group every column holds one value per row. Integers are
+// stored as LEB128 varints, times as zigzag encoded deltas to the previous
+// row (the first row to 0) and messages as varint length + text. Source
+// files, modules, functions and format strings are replaced by ids of a
+// dictionary shared by the whole file (0 stands for none). Each row group
+// carries the dictionary entries it introduced in its DICTIONARY column
+// (a sequence of varint length + text), so that a reader has to load
+// the DICTIONARY columns of all preceding groups to resolve the ids. Each
+// column payload is compressed with CRTDebugLZ unless that doesn't pay off.
+#define COLUMNFILE_VERSION      1
+#define COLUMNFILE_ROWGROUP     16384
+#define COLUMNFILE_FLAG_STORED  (1<<0) // payload is stored uncompressed
+
+//! the columns of a row group
+enum CRTDebugColumn
+{
+  COLUMN_TIME = 0,      //!< record time (usec since epoch)
+  COLUMN_THREAD,        //!< rtdebug thread id
+  COLUMN_CLASS,         //!< debug class
+  COLUMN_SPAN,          //!< attached span or 0
+  COLUMN_INDENT,        //!< indention level
+  COLUMN_FILE,          //!< dictionary id of the source file
+  COLUMN_LINE,          //!< source line
+  COLUMN_MODULE,        //!< dictionary id of the debug module
+  COLUMN_FUNCTION,      //!< dictionary id of the ENTER()/LEAVE() function
+  COLUMN_FORMAT,        //!< dictionary id of the D()/E()/W() format string
+  COLUMN_MESSAGE,       //!< message text without the record header
+  COLUMN_DICTIONARY,    //!< dictionary entries introduced by the row group
+  COLUMN_COUNT
+};
+
+//! information about a single row group of a columnar trace file
+struct CRTDebugRowGroupInfo
+{
+  unsigned long long  offset;       //!< file offset of the row group header
+  unsigned long long  firstTime;    //!< earliest record time
+  unsigned long long  lastTime;     //!< latest record time
+  unsigned long long  threadMask;   //!< bit set of thread ids in the group
+  unsigned int        classMask;    //!< debug classes found in the group
+  unsigned int        rows;         //!< number of records in the group
+};
+
+//  Classname:   CRTDebugColumnWriter
+//! @brief sink exporting records column-wise for offline analytics
+//! @ingroup debug
+//!
+//! Instead of the formatted text lines the meta information of every record
+//! (time, thread, class, source position, etc.) and its bare message are
+//! appended to per-column buffers, which are written as a row group once it
+//! is full. Analytics can then read just the columns they need and work on
+//! integer ids instead of parsing and comparing the same strings again and
+//! again. The row groups are written by the calling thread, so the sink is
+//! best combined with the asynchronous output.
+////////////////////////////////////////////////////////////////////////////////
+class CRTDebugColumnWriter : public CRTDebugSink
+{
+  public:
+    CRTDebugColumnWriter(const char* filename, const size_t rowGroupSize=COLUMNFILE_ROWGROUP);
+    ~CRTDebugColumnWriter();
+
+    bool isOpen() const { return m_iFD >= 0; }
+    bool write(const CRTDebugRecordInfo& info, const char* data, const size_t len);
+    void flush();
+
+  private:
+    unsigned int lookup(const char* string);
+    void writeRowGroup();
+    void writeIndex();
+
+  private:
+    int                     m_iFD;            //!< the trace file descriptor
+    size_t                  m_iRowGroupSize;  //!< the rows of a full row group
+    unsigned long long      m_iOffset;        //!< current file offset
+    std::string             m_Columns[COLUMN_COUNT]; //!< the encoded columns of the current group
+    CRTDebugRowGroupInfo    m_Current;        //!< the current row group
+    unsigned long long      m_iLastTime;      //!< time of the previous row
+    std::unordered_map<std::string, unsigned int> m_Dictionary; //!< ids of all strings
+    std::string             m_sKey;           //!< lookup key buffer
+    std::vector<CRTDebugRowGroupInfo> m_Index; //!< the index of written groups
+    std::vector<char>       m_Compressed;     //!< compression output buffer
+};
+
+//  Classname:   CRTDebugColumnReader
+//! @brief reader for columnar trace files
+//! @ingroup debug
+//!
+//! Loads the row group index and the complete dictionary of a columnar
+//! trace file written by CRTDebugColumnWriter and decodes single columns
+//! of single row groups, so that an analysis only pays for the columns and
+//! time ranges it actually looks at.
+////////////////////////////////////////////////////////////////////////////////
+class CRTDebugColumnReader
+{
+  public:
+    CRTDebugColumnReader();
+    ~CRTDebugColumnReader();
+
+    bool open(const char* filename);
+    void close();
+
+    unsigned int processID() const { return m_iPID; }
+
+    size_t rowGroups() const { return m_Index.size(); }
+    const CRTDebugRowGroupInfo& rowGroup(const size_t i) const { return m_Index[i]; }
+    size_t findRowGroup(const unsigned long long time) const;
+
+    // the dictionary shared by all row groups (id 0 is the empty string)
+    size_t dictionarySize() const { return m_Dictionary.size(); }
+    const std::string& string(const unsigned int id) const;
+
+    // decode a numeric/dictionary id or the message column of a row group
+    bool readValues(const size_t group, const CRTDebugColumn column, std::vector<unsigned long long>& values);
+    bool readStrings(const size_t group, const CRTDebugColumn column, std::vector<std::string>& values);
+
+    static bool isColumnFile(const char* filename);
+
+  private:
+    bool readIndex();
+    bool scanRowGroups();
+    bool readDictionaries();
+    bool readColumn(const size_t group, const CRTDebugColumn column, std::string& data);
+
+  private:
+    int                     m_iFD;          //!< the trace file descriptor
+    unsigned int            m_iPID;         //!< the process which wrote the file
+    std::vector<CRTDebugRowGroupInfo> m_Index; //!< the index of all row groups
+    std::vector<std::string> m_Dictionary;  //!< all dictionary strings by id
+    std::vector<char>       m_Compressed;   //!< buffer for a stored payload
+};
+
+#endif // CRTDEBUGCOLUMNS_H
@@ -0,0 +1,295 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+#include "CRTDebugCounters.h"
+
+#include <cstdlib>
+#include <climits>
+#include <new>
+#include <algorithm>
+
+// the maximum number of counters
+#define COUNTER_MAX 4096
+
+// the number of values per cache line
+#define VALUES_PER_LINE (COUNTER_CACHELINE/sizeof(long long))
+
+// the counter shard of the current thread
+static thread_local CRTDebugCounterShard counterShard;
+
+// allocates a cache line aligned array of values
+static std::atomic<long long>* allocValues(const size_t count)
+{
+  void* mem = NULL;
+  if(posix_memalign(&mem, COUNTER_CACHELINE, count*sizeof(std::atomic<long long>)) != 0)
+    return NULL;
+
+  return (std::atomic<long long>*)mem;
+}
+
+CRTDebugCounterShard::CRTDebugCounterShard()
+  : values(NULL),
+    capacity(0),
+    registered(false)
+{
+}
+
+CRTDebugCounterShard::~CRTDebugCounterShard()
+{
+  if(registered == true)
+    CRTDebugCounters::instance()->retire(*this);
+
+  free(values);
+}
+
+CRTDebugCounters::CRTDebugCounters()
+{
+  m_pGauges = allocValues(COUNTER_MAX*VALUES_PER_LINE);
+  for(size_t i=0; i < COUNTER_MAX*VALUES_PER_LINE; i++)
+    new(&m_pGauges[i]) std::atomic<long long>(0);
+}
+
+//  Class:       CRTDebugCounters
+//  Method:      instance
+//!
+//! Returns the counter registry which is intentionally never freed.
+////////////////////////////////////////////////////////////////////////////////
+CRTDebugCounters* CRTDebugCounters::instance()
+{
+  static CRTDebugCounters* counters = new CRTDebugCounters();
+
+  return counters;
+}
+
+long long CRTDebugCounters::initialValue(const int type)
+{
+  return type == DBN_MAX ? LLONG_MIN : 0;
+}
+
+//  Class:       CRTDebugCounters
+//  Method:      counter
+//!
+//! Returns the ID of a counter and registers it on first use. Using the
+//! same name with different types results in the type of the first use.
+//!
+//! @param  name  the name of the counter
+//! @param  type  DBN_COUNT, DBN_GAUGE or DBN_MAX
+//! @param  file  the source file of the call site
+//! @param  line  the source line of the call site
+//! @return       the ID of the counter or -1 if there are too many counters
+////////////////////////////////////////////////////////////////////////////////
+int CRTDebugCounters::counter(const char* name, const int type, const char* file, const long line)
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+
+  for(size_t i=0; i < m_Counters.size(); i++)
+  {
+    if(m_Counters[i].name == name)
+      return i;
+  }
+
+  if(m_Counters.size() >= COUNTER_MAX || m_pGauges == NULL)
+    return -1;
+
+  Counter c;
+  c.name = name;
+  c.type = type;
+  c.file = file;
+  c.line = line;
+  c.retired = initialValue(type);
+  m_Counters.push_back(c);
+
+  return m_Counters.size()-1;
+}
+
+size_t CRTDebugCounters::size()
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+
+  return m_Counters.size();
+}
+
+//  Class:       CRTDebugCounters
+//  Method:      grow
+//!
+//! Enlarges the shard of the calling thread so that it contains the value
+//! of a counter, and registers the shard on first use.
+//!
+//! @param  shard  the shard of the calling thread
+//! @param  id     the ID of the counter to be updated
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugCounters::grow(CRTDebugCounterShard& shard, const size_t id)
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+
+  // round up to whole cache lines so that no two threads share one
+  size_t capacity = std::max(m_Counters.size(), id+1);
+  capacity = (capacity + VALUES_PER_LINE-1) / VALUES_PER_LINE * VALUES_PER_LINE;
+
+  std::atomic<long long>* values = allocValues(capacity);
+  if(values == NULL)
+    return;
+
+  for(size_t i=0; i < capacity; i++)
+  {
+    long long v = i < shard.capacity ? shard.values[i].load(std::memory_order_relaxed)
+                                     : (i < m_Counters.size() ? initialValue(m_Counters[i].type) : 0);
+    new(&values[i]) std::atomic<long long>(v);
+  }
+
+  // the old values are only read with the registry locked
+  free(shard.values);
+  shard.values = values;
+  shard.capacity = capacity;
+
+  if(shard.registered == false)
+  {
+    m_Shards.push_back(&shard);
+    shard.registered = true;
+  }
+}
+
+//  Class:       CRTDebugCounters
+//  Method:      retire
+//!
+//! Folds the values of a terminating thread into the registry.
+//!
+//! @param  shard  the shard of the terminating thread
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugCounters::retire(CRTDebugCounterShard& shard)
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+
+  for(size_t i=0; i < shard.capacity && i < m_Counters.size(); i++)
+  {
+    long long v = shard.values[i].load(std::memory_order_relaxed);
+    if(m_Counters[i].type == DBN_MAX)
+      m_Counters[i].retired = std::max(m_Counters[i].retired, v);
+    else
+      m_Counters[i].retired += v;
+  }
+
+  m_Shards.erase(std::remove(m_Shards.begin(), m_Shards.end(), &shard), m_Shards.end());
+  shard.registered = false;
+}
+
+//  Class:       CRTDebugCounters
+//  Method:      snapshot
+//!
+//! Aggregates the values of all threads.
+//!
+//! @param  values  receives the aggregated values of all counters
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugCounters::snapshot(std::vector<CRTDebugCounterValue>& values)
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+
+  values.resize(m_Counters.size());
+  for(size_t i=0; i < m_Counters.size(); i++)
+  {
+    const Counter& c = m_Counters[i];
+    CRTDebugCounterValue& v = values[i];
+
+    v.name = c.name;
+    v.type = c.type;
+    v.file = c.file;
+    v.line = c.line;
+
+    if(c.type == DBN_GAUGE)
+    {
+      v.value = gauge(i)->load(std::memory_order_relaxed);
+      v.valid = true;
+      continue;
+    }
+
+    v.value = c.retired;
+    for(size_t s=0; s < m_Shards.size(); s++)
+    {
+      if(i >= m_Shards[s]->capacity)
+        continue;
+
+      long long sv = m_Shards[s]->values[i].load(std::memory_order_relaxed);
+      if(c.type == DBN_MAX)
+        v.value = std::max(v.value, sv);
+      else
+        v.value += sv;
+    }
+
+    v.valid = (c.type != DBN_MAX || v.value != LLONG_MIN);
+  }
+}
+
+//  Class:       CRTDebug
+//  Method:      counter
+//!
+//! Returns the ID of a named counter, gauge or maximum. The ID is normally
+//! looked up once per call site by the RTCOUNT(), RTGAUGE() and RTMAX()
+//! macros.
+//!
+//! @param  name  the name of the counter
+//! @param  type  DBN_COUNT, DBN_GAUGE or DBN_MAX
+//! @param  file  the source file of the call site
+//! @param  line  the source line of the call site
+//! @return       the ID of the counter
+////////////////////////////////////////////////////////////////////////////////
+int CRTDebug::counter(const char* name, const int type, const char* file, const long line)
+{
+  return CRTDebugCounters::instance()->counter(name, type, file, line);
+}
+
+//  Class:       CRTDebug
+//  Method:      count
+//!
+//! Updates the value of a counter within the shard of the calling thread.
+//! No lock is taken unless the shard has to grow.
+//!
+//! @param  id     the ID of the counter
+//! @param  type   DBN_COUNT to add, DBN_GAUGE to set or DBN_MAX to raise
+//!                the value
+//! @param  value  the value
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebug::count(const int id, const int type, const long long value)
+{
+  if(id < 0)
+    return;
+
+  if(type == DBN_GAUGE)
+  {
+    CRTDebugCounters::instance()->gauge(id)->store(value, std::memory_order_relaxed);
+    return;
+  }
+
+  CRTDebugCounterShard& shard = counterShard;
+  if((size_t)id >= shard.capacity)
+  {
+    CRTDebugCounters::instance()->grow(shard, id);
+    if((size_t)id >= shard.capacity)
+      return;
+  }
+
+  // only the owning thread writes its values, so no atomic increment is needed
+  std::atomic<long long>& v = shard.values[id];
+  long long old = v.load(std::memory_order_relaxed);
+  if(type == DBN_COUNT)
+    v.store(old + value, std::memory_order_relaxed);
+  else if(value > old)
+    v.store(value, std::memory_order_relaxed);
+}
@@ -0,0 +1,107 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+#ifndef CRTDEBUGCOUNTERS_H
+#define CRTDEBUGCOUNTERS_H
+
+#include "CRTDebug.h"
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+
+// the values of a thread are allocated in multiples of a cache line
+#define COUNTER_CACHELINE 64
+
+//! the counter values of a single thread
+struct CRTDebugCounterShard
+{
+  CRTDebugCounterShard();
+  ~CRTDebugCounterShard();
+
+  std::atomic<long long>* values;     //!< one value per counter, only written by the owner
+  size_t                  capacity;   //!< number of allocated values
+  bool                    registered; //!< the shard is known to the registry
+};
+
+//! a snapshot of a counter
+struct CRTDebugCounterValue
+{
+  std::string   name;   //!< the name of the counter
+  int           type;   //!< DBN_COUNT, DBN_GAUGE or DBN_MAX
+  const char*   file;   //!< source file of the first use
+  long          line;   //!< source line of the first use
+  long long     value;  //!< the aggregated value
+  bool          valid;  //!< a value was set at all
+};
+
+//  Classname:   CRTDebugCounters
+//! @brief registry of the sharded counters, gauges and maxima
+//! @ingroup debug
+//!
+//! Every thread updates its own cache line aligned array of values (its
+//! shard) without any locking or atomic read-modify-write operations. The
+//! values are only aggregated when a snapshot is taken. Values of
+//! terminated threads are folded into the registry. Gauges represent the
+//! last value set by any thread and are therefore stored centrally.
+//!
+//! The registry is never freed, so the counter IDs cached at the call sites
+//! stay valid for the whole runtime of the application.
+////////////////////////////////////////////////////////////////////////////////
+class CRTDebugCounters
+{
+  public:
+    static CRTDebugCounters* instance();
+
+    int counter(const char* name, const int type, const char* file, const long line);
+    size_t size();
+    void snapshot(std::vector<CRTDebugCounterValue>& values);
+
+    // the shard of the calling thread
+    void grow(CRTDebugCounterShard& shard, const size_t id);
+    void retire(CRTDebugCounterShard& shard);
+
+    // the central gauge values
+    std::atomic<long long>* gauge(const size_t id) { return m_pGauges + id*(COUNTER_CACHELINE/sizeof(long long)); }
+
+  private:
+    CRTDebugCounters();
+
+    static long long initialValue(const int type);
+
+  private:
+    struct Counter
+    {
+      std::string   name;
+      int           type;
+      const char*   file;
+      long          line;
+      long long     retired;  // folded values of terminated threads
+    };
+
+    std::mutex                          m_Mutex;    //!< protects the registry
+    std::vector<Counter>                m_Counters; //!< all known counters
+    std::vector<CRTDebugCounterShard*>  m_Shards;   //!< the shards of the running threads
+    std::atomic<long long>*             m_pGauges;  //!< one cache line per gauge
+};
+
+#endif // CRTDEBUGCOUNTERS_H
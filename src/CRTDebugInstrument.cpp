@@ -0,0 +1,342 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+#include "CRTDebugInstrument.h"
+#include "CRTDebug.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+
+#include <fnmatch.h>
+
+#include "config.h"
+
+#if defined(HAVE_DLADDR)
+#include <dlfcn.h>
+#include <cxxabi.h>
+#endif
+
+// the hooks and everything they call must not be instrumented themselves
+#if defined(__GNUC__)
+#define NO_INSTRUMENT __attribute__((no_instrument_function))
+#define WEAK          __attribute__((weak))
+#else
+#define NO_INSTRUMENT
+#define WEAK
+#endif
+
+//! an entry of the per-thread function cache
+struct CRTDebugFunctionSlot
+{
+  void*                   address;
+  unsigned int            generation;
+  bool                    show;
+  const CRTDebugFunction* function;
+};
+
+// the hooks are active
+static std::atomic<bool> instrumentEnabled(false);
+
+// changed whenever the filters change, which invalidates all cached results
+static std::atomic<unsigned int> filterGeneration(1);
+
+// the functions recently called by the current thread
+static thread_local CRTDebugFunctionSlot functionCache[INSTRUMENT_CACHE];
+
+// set while a hook is running to ignore instrumented functions it calls
+static thread_local bool inHook = false;
+
+//! a call entered by the current thread
+struct CRTDebugCallEntry
+{
+  void*                   address;
+  const CRTDebugFunction* function; //!< the traced function or NULL
+};
+
+// the calls entered by the current thread while the hooks were active,
+// and the number of deeper calls which didn't fit onto that stack
+static thread_local CRTDebugCallEntry callStack[INSTRUMENT_DEPTH];
+static thread_local unsigned int callDepth = 0;
+static thread_local unsigned int callOverflow = 0;
+
+// strips the parameter list (and qualifiers) from a demangled name
+static void stripParameters(std::string& name)
+{
+  size_t end = name.rfind(')');
+  if(end == std::string::npos)
+    return;
+
+  int depth = 0;
+  for(size_t i=end+1; i-- > 0;)
+  {
+    if(name[i] == ')')
+      depth++;
+    else if(name[i] == '(' && --depth == 0)
+    {
+      name.erase(i);
+      return;
+    }
+  }
+}
+
+//  Class:       CRTDebugInstrument
+//  Method:      instance
+//!
+//! Returns the function registry which is intentionally never freed.
+////////////////////////////////////////////////////////////////////////////////
+CRTDebugInstrument* CRTDebugInstrument::instance()
+{
+  static CRTDebugInstrument* instrument = new CRTDebugInstrument();
+
+  return instrument;
+}
+
+bool CRTDebugInstrument::enabled() const
+{
+  return instrumentEnabled.load(std::memory_order_relaxed);
+}
+
+void CRTDebugInstrument::setEnabled(const bool enable)
+{
+  instrumentEnabled.store(enable, std::memory_order_relaxed);
+}
+
+//  Class:       CRTDebugInstrument
+//  Method:      setFilter
+//!
+//! Appends a pattern to the list of filters.
+//!
+//! @param  pattern  fnmatch() pattern for the function or object file name
+//! @param  show     true to include, false to exclude matching functions
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugInstrument::setFilter(const char* pattern, const bool show)
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+
+  Filter filter;
+  filter.pattern = pattern;
+  filter.show = show;
+  m_Filters.push_back(filter);
+
+  filterGeneration.fetch_add(1, std::memory_order_release);
+}
+
+void CRTDebugInstrument::clearFilters()
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+
+  m_Filters.clear();
+  filterGeneration.fetch_add(1, std::memory_order_release);
+}
+
+//  Class:       CRTDebugInstrument
+//  Method:      reset
+//!
+//! Switches off the hooks and removes all filters, so that a new CRTDebug
+//! instance starts with the default configuration.
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugInstrument::reset()
+{
+  setEnabled(false);
+  clearFilters();
+}
+
+bool CRTDebugInstrument::match(const CRTDebugFunction* function) const
+{
+  bool show = m_Filters.empty() || m_Filters[0].show == false;
+
+  // the internals of the standard library are only traced on request
+  if(strncmp(function->name.c_str(), "std::", 5) == 0 ||
+     strncmp(function->name.c_str(), "__gnu_cxx::", 11) == 0)
+  {
+    show = false;
+  }
+
+  for(size_t i=0; i < m_Filters.size(); i++)
+  {
+    const char* pattern = m_Filters[i].pattern.c_str();
+    if(fnmatch(pattern, function->name.c_str(), 0) == 0 ||
+       fnmatch(pattern, function->file.c_str(), 0) == 0)
+    {
+      show = m_Filters[i].show;
+    }
+  }
+
+  return show;
+}
+
+//  Class:       CRTDebugInstrument
+//  Method:      resolve
+//!
+//! Returns the function at an address. It is symbolized on first use and
+//! the filters are applied again whenever they were changed.
+//!
+//! @param  address     the start address of the function
+//! @param  show        returns if the function passed the filters
+//! @param  generation  returns the filter generation show refers to
+//! @return             the function
+////////////////////////////////////////////////////////////////////////////////
+const CRTDebugFunction* CRTDebugInstrument::resolve(void* address, bool& show, unsigned int& generation)
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+
+  CRTDebugFunction*& function = m_Functions[address];
+  if(function == NULL)
+  {
+    function = new CRTDebugFunction();
+    function->generation = 0;
+
+    #if defined(HAVE_DLADDR)
+    Dl_info info;
+    if(dladdr(address, &info) != 0)
+    {
+      if(info.dli_sname != NULL && info.dli_saddr == address)
+      {
+        int status = -1;
+        char* demangled = abi::__cxa_demangle(info.dli_sname, NULL, NULL, &status);
+
+        function->name = status == 0 ? demangled : info.dli_sname;
+        stripParameters(function->name);
+
+        free(demangled);
+      }
+
+      if(info.dli_fname != NULL)
+      {
+        const char* file = strrchr(info.dli_fname, '/');
+        function->file = file != NULL ? file+1 : info.dli_fname;
+      }
+
+      // functions without an exported symbol (e.g. static ones) are named
+      // by their offset within the object file for addr2line
+      if(function->name.empty() == true)
+      {
+        char name[32];
+        snprintf(name, sizeof(name), "+0x%lx", (unsigned long)((char*)address - (char*)info.dli_fbase));
+        function->name = name;
+      }
+    }
+    #endif
+
+    // without any information at least output the address
+    if(function->name.empty() == true)
+    {
+      char name[32];
+      snprintf(name, sizeof(name), "0x%lx", (unsigned long)(uintptr_t)address);
+      function->name = name;
+    }
+
+    if(function->file.empty() == true)
+      function->file = "??";
+  }
+
+  generation = filterGeneration.load(std::memory_order_acquire);
+  if(function->generation != generation)
+  {
+    function->show = match(function);
+    function->generation = generation;
+  }
+
+  show = function->show;
+
+  return function;
+}
+
+// returns the function at an address if it has to be traced
+static inline NO_INSTRUMENT const CRTDebugFunction* tracedFunction(void* address)
+{
+  CRTDebugFunctionSlot& slot = functionCache[((uintptr_t)address >> 4) & (INSTRUMENT_CACHE-1)];
+  unsigned int generation = filterGeneration.load(std::memory_order_acquire);
+
+  if(slot.address != address || slot.generation != generation)
+  {
+    slot.function = CRTDebugInstrument::instance()->resolve(address, slot.show, slot.generation);
+    slot.address = address;
+  }
+
+  return slot.show ? slot.function : NULL;
+}
+
+// the node of the module the calls are output for, looked up only once
+static inline NO_INSTRUMENT const CRTDebugModule* hookModule()
+{
+  static const CRTDebugModule* const module = CRTDebug::module(DBM_NONE);
+
+  return module;
+}
+
+// the hooks are weak, so that an application can still provide its own
+extern "C" NO_INSTRUMENT WEAK void __cyg_profile_func_enter(void* fn, void* site)
+{
+  (void)site;
+
+  if(instrumentEnabled.load(std::memory_order_relaxed) == false || inHook == true)
+    return;
+
+  if(callDepth == INSTRUMENT_DEPTH)
+  {
+    callOverflow++;
+    return;
+  }
+
+  inHook = true;
+
+  // remember whether the call is output, so that its exit is output the
+  // same way even if the filters change in the meantime
+  const CRTDebugFunction* function = tracedFunction(fn);
+  callStack[callDepth].address = fn;
+  callStack[callDepth].function = function;
+  callDepth++;
+
+  if(function != NULL)
+    CRTDebugCall()->Enter(DBC_CTRACE, hookModule(), function->file.c_str(), 0, function->name.c_str());
+
+  inHook = false;
+}
+
+extern "C" NO_INSTRUMENT WEAK void __cyg_profile_func_exit(void* fn, void* site)
+{
+  (void)site;
+
+  // only calls entered while the hooks were active are left, even if the
+  // hooks were disabled in the meantime
+  if(callDepth == 0 || inHook == true)
+    return;
+
+  if(callOverflow > 0)
+  {
+    callOverflow--;
+    return;
+  }
+
+  if(callStack[callDepth-1].address != fn)
+    return;
+
+  inHook = true;
+
+  const CRTDebugFunction* function = callStack[--callDepth].function;
+  if(function != NULL)
+    CRTDebugCall()->Leave(DBC_CTRACE, hookModule(), function->file.c_str(), 0, function->name.c_str());
+
+  inHook = false;
+}
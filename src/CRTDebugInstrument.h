@@ -0,0 +1,100 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+#ifndef CRTDEBUGINSTRUMENT_H
+#define CRTDEBUGINSTRUMENT_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
+
+// the number of entries of the per-thread function cache (a power of two)
+#define INSTRUMENT_CACHE 1024
+
+// the call depth up to which the hooks remember the functions they entered
+#define INSTRUMENT_DEPTH 256
+
+//! an instrumented function as seen by the call hooks
+struct CRTDebugFunction
+{
+  std::string   name;       //!< the demangled name without parameters
+  std::string   file;       //!< the object file containing the function
+  bool          show;       //!< the function passed the filters (registry only)
+  unsigned int  generation; //!< the filter generation show was evaluated with
+};
+
+//  Classname:   CRTDebugInstrument
+//! @brief call tracing of builds compiled with -finstrument-functions
+//! @ingroup debug
+//!
+//! The compiler calls __cyg_profile_func_enter()/__cyg_profile_func_exit()
+//! at every entry and exit of an instrumented function, which are mapped
+//! to CRTDebug::Enter()/Leave() for the DBC_CTRACE class. Function addresses
+//! are symbolized lazily (via dladdr(), so the executable has to be linked
+//! with -rdynamic) and kept forever. Every thread caches the functions it
+//! called together with the filter result, so that the hooks of excluded
+//! functions only cost a lookup in a small direct-mapped table. The exit
+//! hook outputs a Leave() record only if the entry hook of the same call
+//! output the Enter() record, even if the filters changed in between.
+//!
+//! Functions are selected by an ordered list of fnmatch() patterns matched
+//! against the function and the object file name where the last matching
+//! pattern wins. If the first pattern includes functions, all others are
+//! excluded by default. Functions of the std and __gnu_cxx namespaces, which
+//! are mostly inlined helpers, have to be included explicitly.
+//!
+//! The registry is never freed, so the cached functions stay valid for the
+//! whole runtime of the application.
+////////////////////////////////////////////////////////////////////////////////
+class CRTDebugInstrument
+{
+  public:
+    static CRTDebugInstrument* instance();
+
+    bool enabled() const;
+    void setEnabled(const bool enable);
+    void setFilter(const char* pattern, const bool show);
+    void clearFilters();
+    void reset();
+
+    // symbolize a function and apply the current filters
+    const CRTDebugFunction* resolve(void* address, bool& show, unsigned int& generation);
+
+  private:
+    CRTDebugInstrument() {}
+
+    bool match(const CRTDebugFunction* function) const;
+
+  private:
+    struct Filter
+    {
+      std::string pattern;
+      bool        show;
+    };
+
+    std::mutex                                    m_Mutex;      //!< protects the registry
+    std::vector<Filter>                           m_Filters;    //!< the ordered filter patterns
+    std::unordered_map<void*, CRTDebugFunction*>  m_Functions;  //!< all symbolized functions
+};
+
+#endif // CRTDEBUGINSTRUMENT_H
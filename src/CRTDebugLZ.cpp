@@ -0,0 +1,223 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+#include "CRTDebugLZ.h"
+
+#include <cstring>
+#include <stdint.h>
+
+#define HASH_BITS     13
+#define MIN_MATCH     4
+#define MAX_OFFSET    65535
+#define LAST_LITERALS 5   // the last bytes of a block are always literals
+#define MATCH_LIMIT   12  // no match may start within the last bytes
+
+static inline uint32_t read32(const unsigned char* p)
+{
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint32_t hash32(const uint32_t v)
+{
+  return (v * 2654435761U) >> (32-HASH_BITS);
+}
+
+// writes an extended length (the part >= 15) of a token
+static inline unsigned char* writeLength(unsigned char* op, size_t len)
+{
+  while(len >= 255)
+  {
+    *op++ = 255;
+    len -= 255;
+  }
+  *op++ = (unsigned char)len;
+
+  return op;
+}
+
+size_t CRTDebugLZ::compressBound(const size_t len)
+{
+  return len + len/255 + 16;
+}
+
+//  Class:       CRTDebugLZ
+//  Method:      compress
+//!
+//! Compresses a block of data. The destination buffer should be at least
+//! compressBound(srcLen) bytes large.
+//!
+//! @return      the size of the compressed data or 0 if it did not fit
+////////////////////////////////////////////////////////////////////////////////
+size_t CRTDebugLZ::compress(const char* src, const size_t srcLen, char* dst, const size_t dstLen)
+{
+  const unsigned char* ip = (const unsigned char*)src;
+  const unsigned char* base = ip;
+  const unsigned char* anchor = ip;
+  const unsigned char* iend = ip + srcLen;
+  const unsigned char* mlimit = srcLen > MATCH_LIMIT ? iend - MATCH_LIMIT : ip;
+  unsigned char* op = (unsigned char*)dst;
+  unsigned char* oend = op + dstLen;
+  uint32_t table[1<<HASH_BITS];
+
+  memset(table, 0, sizeof(table));
+
+  while(ip < mlimit)
+  {
+    uint32_t seq = read32(ip);
+    uint32_t h = hash32(seq);
+    const unsigned char* ref = base + table[h];
+    table[h] = ip - base;
+
+    if(ref >= ip || ip - ref > MAX_OFFSET || read32(ref) != seq)
+    {
+      ip++;
+      continue;
+    }
+
+    // extend the match as far as possible
+    size_t mlen = MIN_MATCH;
+    while(ip + mlen < iend - LAST_LITERALS && ref[mlen] == ip[mlen])
+      mlen++;
+
+    size_t llen = ip - anchor;
+    if(op + 1 + llen + llen/255 + 2 + mlen/255 + 2 > oend)
+      return 0;
+
+    // write the token and literals
+    unsigned char* token = op++;
+    *token = (unsigned char)((llen >= 15 ? 15 : llen) << 4);
+    if(llen >= 15)
+      op = writeLength(op, llen-15);
+    memcpy(op, anchor, llen);
+    op += llen;
+
+    // write the match offset and length
+    size_t offset = ip - ref;
+    *op++ = offset & 0xff;
+    *op++ = (offset >> 8) & 0xff;
+    size_t ml = mlen - MIN_MATCH;
+    *token |= (unsigned char)(ml >= 15 ? 15 : ml);
+    if(ml >= 15)
+      op = writeLength(op, ml-15);
+
+    ip += mlen;
+    anchor = ip;
+  }
+
+  // the remaining bytes are output as literals
+  size_t llen = iend - anchor;
+  if(op + 1 + llen + llen/255 + 1 > oend)
+    return 0;
+
+  *op++ = (unsigned char)((llen >= 15 ? 15 : llen) << 4);
+  if(llen >= 15)
+    op = writeLength(op, llen-15);
+  memcpy(op, anchor, llen);
+  op += llen;
+
+  return op - (unsigned char*)dst;
+}
+
+//  Class:       CRTDebugLZ
+//  Method:      decompress
+//!
+//! Decompresses a block of data into a destination buffer of exactly the
+//! original size. All offsets and lengths are bounds checked so that corrupt
+//! input can never write outside of the destination buffer.
+//!
+//! @return      true if the block was decompressed successfully
+////////////////////////////////////////////////////////////////////////////////
+bool CRTDebugLZ::decompress(const char* src, const size_t srcLen, char* dst, const size_t dstLen)
+{
+  const unsigned char* ip = (const unsigned char*)src;
+  const unsigned char* iend = ip + srcLen;
+  unsigned char* op = (unsigned char*)dst;
+  unsigned char* ostart = op;
+  unsigned char* oend = op + dstLen;
+
+  while(ip < iend)
+  {
+    unsigned int token = *ip++;
+
+    // copy the literals
+    size_t llen = token >> 4;
+    if(llen == 15)
+    {
+      unsigned char b;
+      do
+      {
+        if(ip >= iend)
+          return false;
+        b = *ip++;
+        llen += b;
+      }
+      while(b == 255);
+    }
+
+    if(llen > (size_t)(iend - ip) || llen > (size_t)(oend - op))
+      return false;
+
+    memcpy(op, ip, llen);
+    ip += llen;
+    op += llen;
+
+    // the last token only carries literals
+    if(ip == iend)
+      break;
+
+    // copy the match
+    if(iend - ip < 2)
+      return false;
+
+    size_t offset = ip[0] | (ip[1] << 8);
+    ip += 2;
+    if(offset == 0 || offset > (size_t)(op - ostart))
+      return false;
+
+    size_t mlen = token & 0x0f;
+    if(mlen == 15)
+    {
+      unsigned char b;
+      do
+      {
+        if(ip >= iend)
+          return false;
+        b = *ip++;
+        mlen += b;
+      }
+      while(b == 255);
+    }
+    mlen += MIN_MATCH;
+
+    if(mlen > (size_t)(oend - op))
+      return false;
+
+    // matches may overlap with the output, so copy bytewise
+    const unsigned char* ref = op - offset;
+    for(size_t i=0; i < mlen; i++)
+      op[i] = ref[i];
+    op += mlen;
+  }
+
+  return op == oend;
+}
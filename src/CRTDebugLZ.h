@@ -0,0 +1,54 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+#ifndef CRTDEBUGLZ_H
+#define CRTDEBUGLZ_H
+
+#include <cstddef>
+
+//  Classname:   CRTDebugLZ
+//! @brief small and fast LZ77 style block codec
+//! @ingroup debug
+//!
+//! This is a simple byte oriented LZ codec (similar to the well-known LZ4
+//! block format) which trades compression ratio for speed. It is used for
+//! compressing trace files which consist of highly repetitive text so that
+//! no external compression library is required.
+//!
+//! A compressed block is a sequence of tokens. Each token byte holds the
+//! number of following literal bytes in its upper and the match length
+//! (minus 4) in its lower nibble. A nibble value of 15 signals that further
+//! length bytes follow (added up until a byte != 255). Each match is encoded
+//! by a 16-bit little-endian backward offset. The last token of a block
+//! only carries literals.
+////////////////////////////////////////////////////////////////////////////////
+class CRTDebugLZ
+{
+  public:
+    // the maximum size a compressed block can have
+    static size_t compressBound(const size_t len);
+
+    // compress/decompress a complete block
+    static size_t compress(const char* src, const size_t srcLen, char* dst, const size_t dstLen);
+    static bool decompress(const char* src, const size_t srcLen, char* dst, const size_t dstLen);
+};
+
+#endif // CRTDEBUGLZ_H
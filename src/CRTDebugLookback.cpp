@@ -0,0 +1,431 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+#include "CRTDebugLookback.h"
+#include "CRTDebugBuffer.h"
+
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+
+#include <sys/types.h>
+
+// the length modifiers of a printf() conversion
+enum Length { LEN_NONE, LEN_HH, LEN_H, LEN_L, LEN_LL, LEN_J, LEN_Z, LEN_T, LEN_LD };
+
+// a parsed printf() conversion specification
+struct Conversion
+{
+  const char* start;    // the '%' character
+  const char* end;      // the character after the conversion
+  int         stars;    // number of '*' width/precision arguments
+  Length      length;   // the length modifier
+  char        conv;     // the conversion character
+};
+
+// parses the conversion specification starting at the '%' character
+static void parseConversion(const char* p, Conversion& c)
+{
+  c.start = p++;
+  c.stars = 0;
+  c.length = LEN_NONE;
+
+  // flags, field width and precision
+  while(*p && strchr("-+ #0123456789.*'", *p))
+  {
+    if(*p == '*')
+      c.stars++;
+    p++;
+  }
+
+  // length modifiers
+  switch(*p)
+  {
+    case 'h': c.length = p[1] == 'h' ? LEN_HH : LEN_H; p += p[1] == 'h' ? 2 : 1; break;
+    case 'l': c.length = p[1] == 'l' ? LEN_LL : LEN_L; p += p[1] == 'l' ? 2 : 1; break;
+    case 'q': c.length = LEN_LL; p++; break;
+    case 'j': c.length = LEN_J;  p++; break;
+    case 'z': c.length = LEN_Z;  p++; break;
+    case 't': c.length = LEN_T;  p++; break;
+    case 'L': c.length = LEN_LD; p++; break;
+  }
+
+  c.conv = *p;
+  c.end = *p ? p+1 : p;
+}
+
+// the storage size of an argument of a conversion
+static size_t argumentSize(const Conversion& c)
+{
+  switch(c.conv)
+  {
+    case 'd': case 'i': case 'u': case 'o': case 'x': case 'X': case 'c':
+      return sizeof(long long);
+
+    case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+      return c.length == LEN_LD ? sizeof(long double) : sizeof(double);
+
+    case 'p':
+      return sizeof(void*);
+  }
+
+  return 0;
+}
+
+CRTDebugLookback::CRTDebugLookback(const size_t records)
+  : m_Entries(records),
+    m_iNext(0),
+    m_iCount(0)
+{
+}
+
+//  Class:       CRTDebugLookback
+//  Method:      entry
+//!
+//! Returns a record of the buffer, 0 being the oldest one.
+////////////////////////////////////////////////////////////////////////////////
+const CRTDebugLookbackEntry& CRTDebugLookback::entry(const size_t i) const
+{
+  return m_Entries[(m_iNext + m_Entries.size() - m_iCount + i) % m_Entries.size()];
+}
+
+void CRTDebugLookback::clear()
+{
+  m_iCount = 0;
+}
+
+//  Class:       CRTDebugLookback
+//  Method:      record
+//!
+//! Stores a record in the ring buffer, overwriting the oldest one if the
+//! buffer is full. The arguments are captured according to the format
+//! string without formatting them.
+//!
+//! @param  tp     the time of the record
+//! @param  cls    the debug class of the record
+//! @param  file   the source file name (string literal)
+//! @param  line   the source line number
+//! @param  ident  the ident level of the thread
+//! @param  fmt    the format string (string literal)
+//! @param  args   the arguments to the format string
+//! @param  frames      an optional raw backtrace of the record
+//! @param  frameCount  the number of backtrace frames
+//! @param  value  an optional raw value appended to the message
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugLookback::record(const struct timeval* tp, const int cls, const char* file, const long line,
+                              const unsigned int ident, const char* fmt, va_list args,
+                              void* const* frames, const int frameCount,
+                              const CRTDebugRawValue* value)
+{
+  if(m_Entries.empty())
+    return;
+
+  std::lock_guard<std::mutex> lock(m_Mutex);
+
+  CRTDebugLookbackEntry& e = m_Entries[m_iNext];
+  m_iNext = (m_iNext + 1) % m_Entries.size();
+  if(m_iCount < m_Entries.size())
+    m_iCount++;
+
+  e.time = *tp;
+  e.file = file;
+  e.line = line;
+  e.fmt = fmt;
+  e.cls = cls;
+  e.ident = ident;
+  e.argsLength = 0;
+  e.truncated = false;
+  e.value = NULL;
+  e.valueLength = 0;
+  e.frameCount = frameCount < LOOKBACK_FRAMES ? frameCount : LOOKBACK_FRAMES;
+  if(e.frameCount > 0)
+    memcpy(e.frames, frames, e.frameCount*sizeof(void*));
+
+  char* p = e.args;
+  char* end = e.args + LOOKBACK_ARGSIZE;
+
+  for(const char* f = strchr(fmt, '%'); f != NULL; f = strchr(f, '%'))
+  {
+    Conversion c;
+    parseConversion(f, c);
+    f = c.end;
+
+    if(c.conv == '%')
+      continue;
+
+    // the field width and precision arguments
+    for(int i=0; i < c.stars; i++)
+    {
+      int v = va_arg(args, int);
+      if(p + sizeof(v) > end)
+      {
+        e.truncated = true;
+        break;
+      }
+
+      memcpy(p, &v, sizeof(v));
+      p += sizeof(v);
+    }
+
+    if(e.truncated)
+      break;
+
+    // strings are copied including their terminating NUL byte
+    if(c.conv == 's' && c.length == LEN_NONE)
+    {
+      const char* s = va_arg(args, const char*);
+      if(s == NULL)
+        s = "(null)";
+
+      size_t len = strlen(s);
+      if(p + len + 1 > end)
+      {
+        len = end - p - 1;
+        e.truncated = true;
+      }
+
+      memcpy(p, s, len);
+      p[len] = '\0';
+      p += len + 1;
+
+      if(e.truncated)
+        break;
+
+      continue;
+    }
+
+    size_t size = argumentSize(c);
+    if(size == 0)
+    {
+      // unsupported conversions (e.g. wide strings) end the capture
+      e.truncated = true;
+      break;
+    }
+
+    if(p + size > end)
+    {
+      e.truncated = true;
+      break;
+    }
+
+    switch(c.conv)
+    {
+      case 'd': case 'i': case 'u': case 'o': case 'x': case 'X': case 'c':
+      {
+        long long v;
+        switch(c.length)
+        {
+          case LEN_L:  v = va_arg(args, long);      break;
+          case LEN_LL: v = va_arg(args, long long); break;
+          case LEN_J:  v = va_arg(args, intmax_t);  break;
+          case LEN_Z:  v = va_arg(args, size_t);    break;
+          case LEN_T:  v = va_arg(args, ptrdiff_t); break;
+          default:     v = va_arg(args, int);       break;
+        }
+        memcpy(p, &v, sizeof(v));
+      }
+      break;
+
+      case 'p':
+      {
+        void* v = va_arg(args, void*);
+        memcpy(p, &v, sizeof(v));
+      }
+      break;
+
+      default:
+      {
+        if(c.length == LEN_LD)
+        {
+          long double v = va_arg(args, long double);
+          memcpy(p, &v, sizeof(v));
+        }
+        else
+        {
+          double v = va_arg(args, double);
+          memcpy(p, &v, sizeof(v));
+        }
+      }
+      break;
+    }
+
+    p += size;
+  }
+
+  e.argsLength = p - e.args;
+
+  // the raw value follows the arguments. Only strings may be cut off.
+  if(value != NULL && e.truncated == false)
+  {
+    size_t len = value->size;
+    if(p + len + 1 > end)
+    {
+      len = value->string ? end - p - 1 : 0;
+      e.truncated = true;
+    }
+
+    if(value->string || e.truncated == false)
+    {
+      memcpy(p, value->data, len);
+      p[len] = '\0';
+      e.value = value->format;
+      e.valueLength = len;
+    }
+  }
+}
+
+// appends a single argument with the width/precision arguments of a conversion
+template<typename T>
+static void appendArgument(CRTDebugBuffer& buf, const char* spec, const int* stars, const int n, T value)
+{
+  switch(n)
+  {
+    case 0:  buf.appendf(spec, value); break;
+    case 1:  buf.appendf(spec, stars[0], value); break;
+    default: buf.appendf(spec, stars[0], stars[1], value); break;
+  }
+}
+
+//  Class:       CRTDebugLookback
+//  Method:      format
+//!
+//! Formats the message of a recorded entry from its format string and the
+//! captured arguments. If not all arguments could be captured, the message
+//! ends with "..." at the first missing argument.
+//!
+//! @param  entry  the recorded entry
+//! @param  buf    the buffer to append the message to
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugLookback::format(const CRTDebugLookbackEntry& entry, CRTDebugBuffer& buf)
+{
+  const char* f = entry.fmt;
+  const char* p = entry.args;
+  const char* end = entry.args + entry.argsLength;
+
+  while(*f)
+  {
+    const char* pc = strchr(f, '%');
+    if(pc == NULL)
+    {
+      buf.append(f);
+      break;
+    }
+
+    buf.append(f, pc-f);
+
+    Conversion c;
+    parseConversion(pc, c);
+    f = c.end;
+
+    if(c.conv == '%')
+    {
+      buf.append('%');
+      continue;
+    }
+
+    int stars[2] = { 0, 0 };
+    size_t size = c.conv == 's' && c.length == LEN_NONE ? 1 : argumentSize(c);
+    if(size == 0 || c.stars > 2 || p + c.stars*sizeof(int) + size > end || (size_t)(c.end-c.start) >= 32)
+    {
+      buf.append("...");
+      return;
+    }
+
+    for(int i=0; i < c.stars; i++)
+    {
+      memcpy(&stars[i], p, sizeof(int));
+      p += sizeof(int);
+    }
+
+    char spec[32];
+    memcpy(spec, c.start, c.end-c.start);
+    spec[c.end-c.start] = '\0';
+
+    switch(c.conv)
+    {
+      case 's':
+      {
+        appendArgument(buf, spec, stars, c.stars, p);
+        p += strlen(p) + 1;
+      }
+      break;
+
+      case 'd': case 'i': case 'u': case 'o': case 'x': case 'X': case 'c':
+      {
+        long long v;
+        memcpy(&v, p, sizeof(v));
+        p += sizeof(v);
+
+        switch(c.length)
+        {
+          case LEN_L:  appendArgument(buf, spec, stars, c.stars, (long)v);      break;
+          case LEN_LL: appendArgument(buf, spec, stars, c.stars, v);            break;
+          case LEN_J:  appendArgument(buf, spec, stars, c.stars, (intmax_t)v);  break;
+          case LEN_Z:  appendArgument(buf, spec, stars, c.stars, (size_t)v);    break;
+          case LEN_T:  appendArgument(buf, spec, stars, c.stars, (ptrdiff_t)v); break;
+          default:     appendArgument(buf, spec, stars, c.stars, (int)v);       break;
+        }
+      }
+      break;
+
+      case 'p':
+      {
+        void* v;
+        memcpy(&v, p, sizeof(v));
+        p += sizeof(v);
+        appendArgument(buf, spec, stars, c.stars, v);
+      }
+      break;
+
+      default:
+      {
+        if(c.length == LEN_LD)
+        {
+          long double v;
+          memcpy(&v, p, sizeof(v));
+          p += sizeof(v);
+          appendArgument(buf, spec, stars, c.stars, v);
+        }
+        else
+        {
+          double v;
+          memcpy(&v, p, sizeof(v));
+          p += sizeof(v);
+          appendArgument(buf, spec, stars, c.stars, v);
+        }
+      }
+      break;
+    }
+  }
+
+  if(entry.value != NULL)
+  {
+    // copied for the alignment of the value
+    union { long double align; char data[LOOKBACK_ARGSIZE]; } raw;
+    memcpy(raw.data, end, entry.valueLength+1);
+
+    CRTDebugOutput out(buf);
+    entry.value(out, raw.data);
+  }
+
+  if(entry.truncated && p >= end)
+    buf.append("...");
+}
@@ -0,0 +1,104 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+#ifndef CRTDEBUGLOOKBACK_H
+#define CRTDEBUGLOOKBACK_H
+
+#include "CRTDebugArena.h"
+#include "CRTDebugValue.h"
+
+#include <cstdarg>
+#include <cstddef>
+#include <vector>
+#include <mutex>
+
+#include <sys/time.h>
+
+class CRTDebugBuffer;
+
+// the number of bytes available for the arguments of a record
+#define LOOKBACK_ARGSIZE 200
+
+// the maximum number of backtrace frames of a record
+#define LOOKBACK_FRAMES  16
+
+//! a single unformatted record of the lookback buffer
+struct CRTDebugLookbackEntry
+{
+  struct timeval  time;       //!< time of the record
+  const char*     file;       //!< source file of the record
+  long            line;       //!< source line of the record
+  const char*     fmt;        //!< the printf() like format string
+  int             cls;        //!< debug class of the record
+  unsigned int    ident;      //!< ident level of the thread
+  unsigned int    argsLength; //!< number of used argument bytes
+  bool            truncated;  //!< not all arguments fitted
+  CRTDebugFormatFunc value;   //!< formatter of a raw value following the arguments or NULL
+  unsigned int    valueLength; //!< number of bytes of the raw value
+  char            args[LOOKBACK_ARGSIZE]; //!< the captured arguments
+  int             frameCount; //!< number of captured backtrace frames
+  void*           frames[LOOKBACK_FRAMES]; //!< the raw backtrace
+};
+
+//  Classname:   CRTDebugLookback
+//! @brief ring buffer of suppressed records of a thread
+//! @ingroup debug
+//!
+//! Records which are not output are kept in binary form: only the format
+//! string pointer and a copy of the raw arguments are stored (strings are
+//! copied as they may not exist anymore later on). Formatting takes place
+//! only if the records are actually output, e.g. because an error occurred,
+//! so that recording costs little more than copying the arguments.
+//!
+//! The format string and the file name have to be string literals, which
+//! is the case for all records of the debug macros. A SHOWVALUE() value
+//! captured in raw form (see CRTDebugFormat) is copied behind the arguments
+//! and formatted after the message.
+////////////////////////////////////////////////////////////////////////////////
+class CRTDebugLookback
+{
+  public:
+    CRTDebugLookback(const size_t records);
+
+    size_t capacity() const { return m_Entries.size(); }
+    size_t size() const { return m_iCount; }
+    const CRTDebugLookbackEntry& entry(const size_t i) const;
+
+    void record(const struct timeval* tp, const int cls, const char* file, const long line,
+                const unsigned int ident, const char* fmt, va_list args,
+                void* const* frames=NULL, const int frameCount=0,
+                const CRTDebugRawValue* value=NULL);
+    void clear();
+
+    // the lock protecting the buffer against concurrent readers
+    std::mutex& mutex() { return m_Mutex; }
+
+    // formats the message of a record
+    static void format(const CRTDebugLookbackEntry& entry, CRTDebugBuffer& buf);
+
+  private:
+    std::vector<CRTDebugLookbackEntry, CRTDebugArenaAllocator<CRTDebugLookbackEntry> > m_Entries; //!< the ring of records
+    size_t                  m_iNext;    //!< the next entry to be written
+    size_t                  m_iCount;   //!< number of valid entries
+    std::mutex              m_Mutex;    //!< protects the entries
+};
+
+#endif // CRTDEBUGLOOKBACK_H
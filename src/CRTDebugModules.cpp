@@ -0,0 +1,303 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+#include "CRTDebugModules.h"
+
+#include <cstring>
+#include <strings.h>
+
+// the default verbosity level of all modules
+#define DEFAULT_LEVEL 0
+
+CRTDebugModuleNode::CRTDebugModuleNode(const char* name, const size_t len, CRTDebugModuleNode* parent,
+                                       const char* path, const size_t pathLen)
+  : m_sName(name, len),
+    m_sPath(path != NULL ? path : name, path != NULL ? pathLen : len),
+    m_pParent(parent),
+    m_pChildren(NULL),
+    m_pNext(NULL),
+    m_iState(-1),
+    m_iLevel(-1),
+    m_iInheritedLevel(parent != NULL ? parent->m_iInheritedLevel : DEFAULT_LEVEL)
+{
+  for(size_t i=0; i < m_sName.size(); i++)
+    m_sName[i] = tolower(m_sName[i]);
+
+  state.store(parent != NULL ? parent->state.load() : -1);
+  level.store(parent != NULL ? parent->level.load() : m_iInheritedLevel);
+  this->name = m_sPath.c_str();
+}
+
+CRTDebugModuleTree::CRTDebugModuleTree()
+  : m_Root(DBM_ALL, strlen(DBM_ALL), NULL),
+    m_None("", 0, NULL)
+{
+  m_None.name = DBM_NONE;
+}
+
+// searches the child node of a name component without locking
+static CRTDebugModuleNode* findChild(const CRTDebugModuleNode* node, const char* name, const size_t len)
+{
+  for(CRTDebugModuleNode* child = node->m_pChildren.load(std::memory_order_acquire); child != NULL; child = child->m_pNext)
+  {
+    if(child->m_sName.size() == len && strncasecmp(child->m_sName.c_str(), name, len) == 0)
+      return child;
+  }
+
+  return NULL;
+}
+
+//  Class:       CRTDebugModuleTree
+//  Method:      node
+//!
+//! Returns the node of a dotted module name and creates all missing nodes
+//! on the way. The returned node stays valid for the lifetime of the tree.
+//!
+//! @param  name  the dotted module name, NULL or "all" for the root node
+//! @return       the node of the module
+////////////////////////////////////////////////////////////////////////////////
+CRTDebugModuleNode* CRTDebugModuleTree::node(const char* name)
+{
+  CRTDebugModuleNode* node = &m_Root;
+
+  if(name == NULL || strcasecmp(name, DBM_ALL) == 0)
+    return node;
+
+  std::lock_guard<std::mutex> lock(m_Mutex);
+
+  const char* path = name;
+  while(*name)
+  {
+    const char* e = strchr(name, '.');
+    size_t len = e != NULL ? (size_t)(e-name) : strlen(name);
+
+    if(len > 0)
+    {
+      CRTDebugModuleNode* child = findChild(node, name, len);
+      if(child == NULL)
+      {
+        // publish the completely initialized node to lock-free readers
+        child = new CRTDebugModuleNode(name, len, node, path, (size_t)(name-path)+len);
+        child->m_pNext = node->m_pChildren.load(std::memory_order_relaxed);
+        node->m_pChildren.store(child, std::memory_order_release);
+      }
+
+      node = child;
+    }
+
+    if(e == NULL)
+      break;
+
+    name = e+1;
+  }
+
+  return node;
+}
+
+//  Class:       CRTDebugModuleTree
+//  Method:      resolve
+//!
+//! Returns the most specific existing node of a dotted module name without
+//! creating new nodes. As nodes inherit the configuration of their parents,
+//! the resolved state and level of that node apply to the module.
+//!
+//! @param  name  the dotted module name
+//! @return       the node whose configuration applies to the module
+////////////////////////////////////////////////////////////////////////////////
+const CRTDebugModuleNode* CRTDebugModuleTree::resolve(const char* name) const
+{
+  const CRTDebugModuleNode* node = &m_Root;
+
+  if(name == NULL)
+    return node;
+
+  while(*name)
+  {
+    const char* e = strchr(name, '.');
+    size_t len = e != NULL ? (size_t)(e-name) : strlen(name);
+
+    if(len > 0)
+    {
+      const CRTDebugModuleNode* child = findChild(node, name, len);
+      if(child == NULL)
+        break;
+
+      node = child;
+    }
+
+    if(e == NULL)
+      break;
+
+    name = e+1;
+  }
+
+  return node;
+}
+
+//  Class:       CRTDebugModuleTree
+//  Method:      set
+//!
+//! Configures the state and verbosity level of a module and all of its
+//! submodules which are not configured on their own.
+//!
+//! @param  name   the dotted module name
+//! @param  state  0 to hide or 1 to show the output of the module
+//! @param  level  the verbosity level or -1 to keep the inherited one
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugModuleTree::set(const char* name, const int state, const int level)
+{
+  CRTDebugModuleNode* n = node(name);
+
+  std::lock_guard<std::mutex> lock(m_Mutex);
+
+  n->m_iState = state;
+  n->m_iLevel = level;
+  inherit(n);
+}
+
+void CRTDebugModuleTree::clear(const char* name)
+{
+  CRTDebugModuleNode* n = node(name);
+
+  std::lock_guard<std::mutex> lock(m_Mutex);
+
+  n->m_iState = -1;
+  n->m_iLevel = -1;
+  inherit(n);
+}
+
+//  Class:       CRTDebugModuleTree
+//  Method:      reset
+//!
+//! Removes the configuration of all modules. The nodes themselves are kept
+//! as call sites may still refer to them.
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugModuleTree::reset()
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+
+  CRTDebugModuleNode* node = &m_Root;
+  while(node != NULL)
+  {
+    node->m_iState = -1;
+    node->m_iLevel = -1;
+
+    // walk the tree in depth-first order
+    if(node->m_pChildren.load() != NULL)
+      node = node->m_pChildren.load();
+    else
+    {
+      while(node != NULL && node->m_pNext == NULL)
+        node = node->m_pParent;
+
+      if(node != NULL)
+        node = node->m_pNext;
+    }
+  }
+
+  inherit(&m_Root);
+}
+
+//  Class:       CRTDebugModuleTree
+//  Method:      inherit
+//!
+//! Recalculates the resolved state and level of a node and all its
+//! children. Has to be called with the tree locked.
+//!
+//! @param  node  the node whose configuration changed
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugModuleTree::inherit(CRTDebugModuleNode* node)
+{
+  const CRTDebugModuleNode* parent = node->m_pParent;
+
+  if(node->m_iState >= 0)
+    node->state.store(node->m_iState, std::memory_order_relaxed);
+  else
+    node->state.store(parent != NULL ? parent->state.load(std::memory_order_relaxed) : -1, std::memory_order_relaxed);
+
+  if(node->m_iLevel >= 0)
+    node->m_iInheritedLevel = node->m_iLevel;
+  else
+    node->m_iInheritedLevel = parent != NULL ? parent->m_iInheritedLevel : DEFAULT_LEVEL;
+
+  // a hidden module doesn't output anything at any level
+  node->level.store(node->state.load(std::memory_order_relaxed) == 0 ? -1 : node->m_iInheritedLevel, std::memory_order_relaxed);
+
+  // call sites without a module follow the level of the root
+  if(node == &m_Root)
+    m_None.level.store(node->level.load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+  for(CRTDebugModuleNode* child = node->m_pChildren.load(); child != NULL; child = child->m_pNext)
+    inherit(child);
+}
+
+//  Class:       CRTDebugModuleTree
+//  Method:      spec
+//!
+//! Returns the configured modules in the form they are specified in the
+//! environment variable (e.g. "net=2 !net.tls").
+////////////////////////////////////////////////////////////////////////////////
+std::string CRTDebugModuleTree::spec() const
+{
+  std::string prefix;
+  std::string result;
+
+  appendSpec(&m_Root, prefix, result);
+
+  return result;
+}
+
+void CRTDebugModuleTree::appendSpec(const CRTDebugModuleNode* node, std::string& prefix, std::string& result) const
+{
+  std::string name = node == &m_Root ? node->m_sName : prefix + node->m_sName;
+
+  if(node->m_iState >= 0 || node->m_iLevel >= 0)
+  {
+    if(result.empty() == false)
+      result += " ";
+
+    if(node->m_iState == 0)
+      result += "!";
+
+    result += name;
+
+    if(node->m_iLevel >= 0)
+      result += "=" + std::to_string(node->m_iLevel);
+  }
+
+  std::string childPrefix = node == &m_Root ? "" : name + ".";
+  for(const CRTDebugModuleNode* child = node->m_pChildren.load(); child != NULL; child = child->m_pNext)
+    appendSpec(child, childPrefix, result);
+}
+
+//  Class:       CRTDebugModuleTree
+//  Method:      debugModules
+//!
+//! Returns the module tree used for the debug output. It is created on first
+//! use and intentionally never freed, so that the module nodes cached by the
+//! V() call sites stay valid even across CRTDebug::destroy().
+////////////////////////////////////////////////////////////////////////////////
+CRTDebugModuleTree* CRTDebugModuleTree::debugModules()
+{
+  static CRTDebugModuleTree* tree = new CRTDebugModuleTree();
+
+  return tree;
+}
@@ -0,0 +1,99 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+#ifndef CRTDEBUGMODULES_H
+#define CRTDEBUGMODULES_H
+
+#include "CRTDebug.h"
+
+#include <string>
+#include <atomic>
+#include <mutex>
+
+//  Classname:   CRTDebugModuleNode
+//! @brief a single node of the hierarchical module namespace
+//! @ingroup debug
+//!
+//! Every component of a dotted module name (e.g. "net.tls") is a node of
+//! the tree. A node carries the explicitly configured show/hide state and
+//! verbosity level as well as the values resolved by inheriting the
+//! configuration of its parents.
+////////////////////////////////////////////////////////////////////////////////
+class CRTDebugModuleNode : public CRTDebugModule
+{
+  public:
+    CRTDebugModuleNode(const char* name, const size_t len, CRTDebugModuleNode* parent, const char* path=NULL, const size_t pathLen=0);
+
+  public:
+    std::string                       m_sName;      //!< the (lowercase) name component
+    std::string                       m_sPath;      //!< the dotted name of the module
+    CRTDebugModuleNode*               m_pParent;    //!< the parent node
+    std::atomic<CRTDebugModuleNode*>  m_pChildren;  //!< the first child node
+    CRTDebugModuleNode*               m_pNext;      //!< the next sibling node
+    int                               m_iState;     //!< configured state (-1 none, 0 hide, 1 show)
+    int                               m_iLevel;     //!< configured verbosity level (-1 inherit)
+    int                               m_iInheritedLevel; //!< verbosity level ignoring the state
+};
+
+//  Classname:   CRTDebugModuleTree
+//! @brief prefix tree of dotted module names
+//! @ingroup debug
+//!
+//! Resolves dotted module names against the configured module namespace so
+//! that e.g. "net" applies to all "net.*" modules unless a more specific
+//! node like "net.tls" is configured differently. The configuration is
+//! inherited down the tree whenever it changes, so looking up a module only
+//! needs to walk its name components. Nodes are never deleted and lookups
+//! are lock-free, which allows call sites to cache the node of their module.
+//! The root node stands for the special module name "all". Call sites
+//! without a module (DBM_NONE) use a separate node outside of the tree which
+//! is never configured itself but follows the verbosity level of the root.
+////////////////////////////////////////////////////////////////////////////////
+class CRTDebugModuleTree
+{
+  public:
+    CRTDebugModuleTree();
+
+    // lookup of modules
+    CRTDebugModuleNode* node(const char* name);
+    const CRTDebugModuleNode* resolve(const char* name) const;
+    const CRTDebugModuleNode* none() const { return &m_None; }
+
+    // configuration of modules
+    void set(const char* name, const int state, const int level=-1);
+    void clear(const char* name);
+    void reset();
+    std::string spec() const;
+
+    // the tree of the debug modules
+    static CRTDebugModuleTree* debugModules();
+
+  private:
+    void inherit(CRTDebugModuleNode* node);
+    void appendSpec(const CRTDebugModuleNode* node, std::string& prefix, std::string& result) const;
+
+  private:
+    CRTDebugModuleNode  m_Root;   //!< the root ("all") node
+    CRTDebugModuleNode  m_None;   //!< the node of call sites without a module
+    std::mutex          m_Mutex;  //!< serializes modifications of the tree
+};
+
+#endif // CRTDEBUGMODULES_H
@@ -0,0 +1,204 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+#include "CRTDebugPerCPU.h"
+#include "CRTDebugArena.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <algorithm>
+
+#include <sched.h>
+#include <unistd.h>
+
+#include "config.h"
+
+// records are aligned within the buffers
+#define RECORD_ALIGN(len) (((len) + 7) & ~(size_t)7)
+
+// the sequence number orders records of the same thread and time which
+// ended up in the buffers of different CPUs
+static thread_local unsigned int recordSequence;
+
+CRTDebugPerCPU::CRTDebugPerCPU(const size_t bufferSize)
+  : m_iCPUs(1),
+    m_iBufferSize(bufferSize),
+    m_iStride(0),
+    m_pBuffers(NULL)
+{
+  long cpus = sysconf(_SC_NPROCESSORS_CONF);
+  if(cpus > 1)
+    m_iCPUs = cpus;
+
+  m_iStride = (sizeof(Buffer) + PERCPU_CACHELINE-1) & ~(size_t)(PERCPU_CACHELINE-1);
+
+  void* mem = NULL;
+  if(posix_memalign(&mem, PERCPU_CACHELINE, m_iCPUs*m_iStride) != 0)
+    abort();
+  m_pBuffers = (char*)mem;
+
+  for(unsigned int i=0; i < m_iCPUs; i++)
+  {
+    Buffer* b = new(buffer(i)) Buffer;
+    b->lock.clear();
+    b->data = (char*)CRTDebugArena::instance()->allocate(m_iBufferSize);
+    b->spare = (char*)CRTDebugArena::instance()->allocate(m_iBufferSize);
+    b->used = 0;
+  }
+}
+
+CRTDebugPerCPU::~CRTDebugPerCPU()
+{
+  for(unsigned int i=0; i < m_iCPUs; i++)
+  {
+    Buffer* b = buffer(i);
+    CRTDebugArena::instance()->release(b->data);
+    CRTDebugArena::instance()->release(b->spare);
+    b->~Buffer();
+  }
+
+  free(m_pBuffers);
+}
+
+unsigned int CRTDebugPerCPU::currentCPU() const
+{
+  #if defined(HAVE_SCHED_GETCPU)
+  int cpu = sched_getcpu();
+  if(cpu >= 0)
+    return (unsigned int)cpu % m_iCPUs;
+  #endif
+
+  // without a CPU number the threads are at least spread over the buffers
+  static std::atomic<unsigned int> next(0);
+  static thread_local unsigned int slot = next++;
+
+  return slot % m_iCPUs;
+}
+
+//  Class:       CRTDebugPerCPU
+//  Method:      append
+//!
+//! Appends a record to the buffer of the current CPU.
+//!
+//! @return      false if the buffer is full and has to be collected first
+////////////////////////////////////////////////////////////////////////////////
+bool CRTDebugPerCPU::append(const CRTDebugRecordInfo& info, const char* data, const size_t len)
+{
+  size_t size = RECORD_ALIGN(sizeof(Record) + len);
+  Buffer* b;
+
+  for(int attempt=0; ; attempt++)
+  {
+    unsigned int cpu = currentCPU();
+    b = buffer(cpu);
+
+    for(int spin=0; b->lock.test_and_set(std::memory_order_acquire) == true; spin++)
+    {
+      if(spin >= 100)
+        sched_yield();
+    }
+
+    // we were migrated while waiting for the lock. Any buffer is safe to
+    // use as we hold its lock, but the buffers should stay CPU local.
+    if(attempt < 2 && currentCPU() != cpu)
+    {
+      b->lock.clear(std::memory_order_release);
+      continue;
+    }
+
+    break;
+  }
+
+  if(b->used + size > m_iBufferSize)
+  {
+    b->lock.clear(std::memory_order_release);
+    return false;
+  }
+
+  Record* record = (Record*)(b->data + b->used);
+  record->info = info;
+  record->sequence = recordSequence++;
+  record->length = len;
+  memcpy(record+1, data, len);
+  b->used += size;
+
+  b->lock.clear(std::memory_order_release);
+
+  return true;
+}
+
+//  Class:       CRTDebugPerCPU
+//  Method:      collect
+//!
+//! Takes the records of all CPUs and writes them ordered by time to a sink.
+//! Calls have to be serialised by the caller.
+//!
+//! @param  sink     the sink to write the records to
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugPerCPU::collect(CRTDebugSink* sink)
+{
+  std::vector<size_t> used(m_iCPUs);
+
+  for(unsigned int i=0; i < m_iCPUs; i++)
+  {
+    Buffer* b = buffer(i);
+
+    while(b->lock.test_and_set(std::memory_order_acquire) == true)
+      sched_yield();
+
+    std::swap(b->data, b->spare);
+    used[i] = b->used;
+    b->used = 0;
+
+    b->lock.clear(std::memory_order_release);
+  }
+
+  m_Records.clear();
+  for(unsigned int i=0; i < m_iCPUs; i++)
+  {
+    const char* p = buffer(i)->spare;
+    const char* end = p + used[i];
+    while(p < end)
+    {
+      const Record* record = (const Record*)p;
+      m_Records.push_back(record);
+      p += RECORD_ALIGN(sizeof(Record) + record->length);
+    }
+  }
+
+  std::sort(m_Records.begin(), m_Records.end(), [](const Record* a, const Record* b)
+  {
+    if(a->info.time != b->info.time)
+      return a->info.time < b->info.time;
+    if(a->info.threadID != b->info.threadID)
+      return a->info.threadID < b->info.threadID;
+
+    // sequence numbers may wrap around
+    return (int)(a->sequence - b->sequence) < 0;
+  });
+
+  for(size_t i=0; i < m_Records.size(); i++)
+  {
+    const Record* record = m_Records[i];
+    sink->write(record->info, (const char*)(record+1), record->length);
+  }
+}
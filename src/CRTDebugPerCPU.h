@@ -0,0 +1,90 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+#ifndef CRTDEBUGPERCPU_H
+#define CRTDEBUGPERCPU_H
+
+#include "CRTDebugSink.h"
+
+#include <atomic>
+#include <vector>
+
+// each buffer header occupies its own cache line(s)
+#define PERCPU_CACHELINE 64
+#define PERCPU_BUFSIZE   (256*1024)
+
+//  Classname:   CRTDebugPerCPU
+//! @brief per-CPU record buffers merged by a collector
+//! @ingroup debug
+//!
+//! Instead of serialising all threads on the output stream lock, records
+//! are appended to the buffer of the CPU the thread is running on. The CPU
+//! number is only a hint (the thread may be migrated at any time), so each
+//! buffer is protected by its own spin lock which is practically never
+//! contended. If the thread was migrated while acquiring the lock it
+//! retries on the buffer of its new CPU.
+//!
+//! Every CPU owns two buffers. The collector swaps them under the spin lock
+//! and then merges the records of all CPUs by time without blocking the
+//! producers. The memory used therefore only depends on the number of CPUs
+//! and not on the number of threads.
+////////////////////////////////////////////////////////////////////////////////
+class CRTDebugPerCPU
+{
+  public:
+    CRTDebugPerCPU(const size_t bufferSize=PERCPU_BUFSIZE);
+    ~CRTDebugPerCPU();
+
+    bool append(const CRTDebugRecordInfo& info, const char* data, const size_t len);
+    void collect(CRTDebugSink* sink);
+
+    unsigned int cpus() const { return m_iCPUs; }
+    size_t bufferSize() const { return m_iBufferSize; }
+
+  private:
+    struct Buffer
+    {
+      std::atomic_flag    lock;       //!< spin lock of the buffer
+      char*               data;       //!< the buffer records are appended to
+      char*               spare;      //!< the buffer the collector works on
+      size_t              used;       //!< bytes used in data
+    };
+
+    //! the header of a record within a buffer
+    struct Record
+    {
+      CRTDebugRecordInfo  info;       //!< meta information of the record
+      unsigned int        sequence;   //!< per-thread sequence number
+      unsigned int        length;     //!< length of the record text
+    };
+
+    Buffer* buffer(const unsigned int cpu) { return (Buffer*)(m_pBuffers + cpu*m_iStride); }
+    unsigned int currentCPU() const;
+
+  private:
+    unsigned int          m_iCPUs;        //!< number of configured CPUs
+    size_t                m_iBufferSize;  //!< size of each buffer
+    size_t                m_iStride;      //!< distance between buffer headers
+    char*                 m_pBuffers;     //!< the cache line aligned buffer headers
+    std::vector<const Record*> m_Records; //!< the records of a collection run
+};
+
+#endif // CRTDEBUGPERCPU_H
@@ -0,0 +1,301 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+#include "CRTDebugProfile.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+// returns the histogram bucket of a duration
+static inline unsigned int bucketIndex(const unsigned long long v)
+{
+  if(v < 16)
+    return v;
+
+  #if defined(__GNUC__)
+  unsigned int e = 63 - __builtin_clzll(v);
+  #else
+  unsigned int e = 4;
+  while((v >> (e+1)) != 0)
+    e++;
+  #endif
+
+  return 16 + (e-4)*8 + ((v >> (e-3)) & 7);
+}
+
+// returns the smallest duration falling into a histogram bucket
+static inline unsigned long long bucketStart(const unsigned int i)
+{
+  if(i < 16)
+    return i;
+
+  unsigned int e = (i-16)/8 + 4;
+  return (8ULL + (i-16)%8) << (e-3);
+}
+
+CRTDebugProfileEntry::CRTDebugProfileEntry()
+  : count(0),
+    total(0),
+    min(0),
+    max(0),
+    sumSquares(0.0)
+{
+  memset(buckets, 0, sizeof(buckets));
+}
+
+void CRTDebugProfileEntry::add(const unsigned long long duration)
+{
+  if(count == 0 || duration < min)
+    min = duration;
+  if(duration > max)
+    max = duration;
+
+  count++;
+  total += duration;
+  sumSquares += (double)duration * (double)duration;
+  buckets[bucketIndex(duration)]++;
+}
+
+void CRTDebugProfileEntry::merge(const CRTDebugProfileEntry& other)
+{
+  if(other.count == 0)
+    return;
+
+  if(count == 0 || other.min < min)
+    min = other.min;
+  if(other.max > max)
+    max = other.max;
+
+  count += other.count;
+  total += other.total;
+  sumSquares += other.sumSquares;
+
+  for(unsigned int i=0; i < PROFILE_BUCKETS; i++)
+    buckets[i] += other.buckets[i];
+}
+
+//  Class:       CRTDebugProfileEntry
+//  Method:      percentile
+//!
+//! Estimates a percentile from the histogram as the middle of the bucket
+//! it falls into, limited to the measured minimum and maximum.
+//!
+//! @param  p        the percentile as fraction (e.g. 0.99)
+//! @return          the estimated duration in ns
+////////////////////////////////////////////////////////////////////////////////
+unsigned long long CRTDebugProfileEntry::percentile(const double p) const
+{
+  if(count == 0)
+    return 0;
+
+  unsigned long long rank = (unsigned long long)ceil(p * count);
+  if(rank == 0)
+    rank = 1;
+
+  unsigned long long seen = 0;
+  for(unsigned int i=0; i < PROFILE_BUCKETS; i++)
+  {
+    seen += buckets[i];
+    if(seen < rank)
+      continue;
+
+    unsigned long long start = bucketStart(i);
+    unsigned long long end = i+1 < PROFILE_BUCKETS ? bucketStart(i+1) : max+1;
+    unsigned long long value = start + (end-start)/2;
+
+    return value < min ? min : (value > max ? max : value);
+  }
+
+  return max;
+}
+
+double CRTDebugProfileEntry::stddev() const
+{
+  if(count < 2)
+    return 0.0;
+
+  double mean = (double)total / count;
+  double variance = (sumSquares - mean*mean*count) / (count-1);
+
+  return variance > 0.0 ? sqrt(variance) : 0.0;
+}
+
+CRTDebugProfile::CRTDebugProfile()
+  : m_iClockStart(0)
+{
+}
+
+//  Class:       CRTDebugProfile
+//  Method:      enter
+//!
+//! Remembers the time a function was entered.
+//!
+//! @param  file     source file of the ENTER()
+//! @param  function name of the entered function
+//! @param  now      the current monotonic time in ns
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugProfile::enter(const char* file, const char* function, const unsigned long long now)
+{
+  Call call = { { file, function }, now };
+
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_Calls.push_back(call);
+}
+
+//  Class:       CRTDebugProfile
+//  Method:      leave
+//!
+//! Accounts the duration of the innermost call of a function. Calls entered
+//! later which were never left (e.g. an early return without LEAVE()) are
+//! dropped, a LEAVE() without a matching ENTER() is ignored.
+//!
+//! @param  function name of the left function
+//! @param  now      the current monotonic time in ns
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugProfile::leave(const char* function, const unsigned long long now)
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+
+  for(size_t i=m_Calls.size(); i > 0; i--)
+  {
+    const Call& call = m_Calls[i-1];
+    if(call.key.function != function && strcmp(call.key.function, function) != 0)
+      continue;
+
+    m_Functions[call.key].add(now - call.start);
+    m_Calls.resize(i-1);
+    break;
+  }
+}
+
+void CRTDebugProfile::startClock(const unsigned long long now)
+{
+  m_iClockStart = now;
+}
+
+//  Class:       CRTDebugProfile
+//  Method:      stopClock
+//!
+//! Accounts the time since the last STARTCLOCK() of the thread to a timer.
+//!
+//! @param  name     the string identifying the timer
+//! @param  now      the current monotonic time in ns
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugProfile::stopClock(const char* name, const unsigned long long now)
+{
+  if(m_iClockStart == 0)
+    return;
+
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_Timers[name].add(now - m_iClockStart);
+}
+
+//  Class:       CRTDebugProfile
+//  Method:      merge
+//!
+//! Adds the durations of another profile (e.g. of a terminating thread).
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugProfile::merge(const CRTDebugProfile& other)
+{
+  for(FunctionMap::const_iterator it = other.m_Functions.begin(); it != other.m_Functions.end(); ++it)
+    m_Functions[it->first].merge(it->second);
+
+  for(CRTDebugProfileMap::const_iterator it = other.m_Timers.begin(); it != other.m_Timers.end(); ++it)
+    m_Timers[it->first].merge(it->second);
+}
+
+//  Class:       CRTDebugProfile
+//  Method:      collect
+//!
+//! Adds the durations of the profile to maps of functions and timers by
+//! name. Functions are named "file:function" with the base name of their
+//! source file, so that the names are stable across builds.
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugProfile::collect(CRTDebugProfileMap& functions, CRTDebugProfileMap& timers) const
+{
+  for(FunctionMap::const_iterator it = m_Functions.begin(); it != m_Functions.end(); ++it)
+  {
+    const char* file = strrchr(it->first.file, '/') ? strrchr(it->first.file, '/')+1 : it->first.file;
+    functions[std::string(file) + ':' + it->first.function].merge(it->second);
+  }
+
+  for(CRTDebugProfileMap::const_iterator it = m_Timers.begin(); it != m_Timers.end(); ++it)
+    timers[it->first].merge(it->second);
+}
+
+void CRTDebugProfile::clear()
+{
+  m_Functions.clear();
+  m_Timers.clear();
+  m_Calls.clear();
+  m_iClockStart = 0;
+}
+
+// writes the rows of one kind of profile entries
+static void writeEntries(FILE* fh, const char* kind, const CRTDebugProfileMap& entries)
+{
+  for(CRTDebugProfileMap::const_iterator it = entries.begin(); it != entries.end(); ++it)
+  {
+    const CRTDebugProfileEntry& e = it->second;
+    if(e.count == 0)
+      continue;
+
+    // names must not break the tab separated format
+    std::string name = it->first;
+    for(size_t i=0; i < name.size(); i++)
+    {
+      if(name[i] == '\t' || name[i] == '\n')
+        name[i] = ' ';
+    }
+
+    fprintf(fh, "%s\t%s\t%llu\t%llu\t%.1f\t%.1f\t%llu\t%llu\t%llu\t%llu\t%llu\n",
+            kind, name.c_str(), e.count, e.total, (double)e.total / e.count, e.stddev(),
+            e.min, e.percentile(0.5), e.percentile(0.9), e.percentile(0.99), e.max);
+  }
+}
+
+//  Class:       CRTDebugProfile
+//  Method:      write
+//!
+//! Writes a profile file. After two comment lines a header row names the
+//! tab separated columns, followed by one row per function and timer sorted
+//! by kind and name. All durations are in ns.
+//!
+//! @return      false if the file could not be written
+////////////////////////////////////////////////////////////////////////////////
+bool CRTDebugProfile::write(const char* filename, const CRTDebugProfileMap& functions,
+                            const CRTDebugProfileMap& timers, const unsigned int pid)
+{
+  FILE* fh = fopen(filename, "w");
+  if(fh == NULL)
+    return false;
+
+  fprintf(fh, "# rtdebug profile %d\n", PROFILE_VERSION);
+  fprintf(fh, "# pid %u, %zu functions, %zu timers\n", pid, functions.size(), timers.size());
+  fprintf(fh, "kind\tname\tcount\ttotal_ns\tmean_ns\tstddev_ns\tmin_ns\tp50_ns\tp90_ns\tp99_ns\tmax_ns\n");
+
+  writeEntries(fh, "function", functions);
+  writeEntries(fh, "timer", timers);
+
+  bool result = ferror(fh) == 0;
+  return fclose(fh) == 0 && result;
+}
@@ -0,0 +1,122 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+#ifndef CRTDEBUGPROFILE_H
+#define CRTDEBUGPROFILE_H
+
+#include "CRTDebugArena.h"
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <unordered_map>
+
+// the durations are counted in log-linear buckets: values below 16ns have
+// an own bucket, every higher power of two is split into 8 buckets. So all
+// percentiles are exact to 1/16 of their value.
+#define PROFILE_BUCKETS   496
+#define PROFILE_VERSION   1
+
+//! the aggregated durations of a single function or timer (all times in ns)
+struct CRTDebugProfileEntry
+{
+  unsigned long long  count;        //!< number of measured durations
+  unsigned long long  total;        //!< sum of all durations
+  unsigned long long  min;          //!< shortest duration
+  unsigned long long  max;          //!< longest duration
+  double              sumSquares;   //!< sum of the squared durations
+  unsigned long long  buckets[PROFILE_BUCKETS]; //!< histogram of the durations
+
+  CRTDebugProfileEntry();
+
+  void add(const unsigned long long duration);
+  void merge(const CRTDebugProfileEntry& other);
+  unsigned long long percentile(const double p) const;
+  double stddev() const;
+};
+
+typedef std::map<std::string, CRTDebugProfileEntry> CRTDebugProfileMap;
+
+//  Classname:   CRTDebugProfile
+//! @brief call and timer profile of a thread
+//! @ingroup debug
+//!
+//! Measures the time between ENTER() and LEAVE()/RETURN() of every function
+//! and between STARTCLOCK() and STOPCLOCK() of every timer. Every thread
+//! owns such a profile, which is only locked against the profile report
+//! collecting it. Functions are identified by the address of their
+//! __FILE__ and __FUNCTION__ strings and joined by name when collected.
+////////////////////////////////////////////////////////////////////////////////
+class CRTDebugProfile
+{
+  public:
+    CRTDebugProfile();
+
+    void enter(const char* file, const char* function, const unsigned long long now);
+    void leave(const char* function, const unsigned long long now);
+    void startClock(const unsigned long long now);
+    void stopClock(const char* name, const unsigned long long now);
+
+    void merge(const CRTDebugProfile& other);
+    void collect(CRTDebugProfileMap& functions, CRTDebugProfileMap& timers) const;
+    void clear();
+
+    // the lock protecting the profile against the report
+    std::mutex& mutex() { return m_Mutex; }
+
+    // writes a profile file in the stable tab separated format
+    static bool write(const char* filename, const CRTDebugProfileMap& functions,
+                      const CRTDebugProfileMap& timers, const unsigned int pid);
+
+  private:
+    struct Key
+    {
+      const char* file;
+      const char* function;
+
+      bool operator==(const Key& other) const { return file == other.file && function == other.function; }
+    };
+
+    struct KeyHash
+    {
+      size_t operator()(const Key& key) const { return (size_t)key.file * 31 + (size_t)key.function; }
+    };
+
+    struct Call
+    {
+      Key                 key;      //!< the called function
+      unsigned long long  start;    //!< time of the ENTER()
+    };
+
+    typedef std::unordered_map<Key, CRTDebugProfileEntry, KeyHash, std::equal_to<Key>,
+                               CRTDebugArenaAllocator<std::pair<const Key, CRTDebugProfileEntry> > > FunctionMap;
+
+  private:
+    FunctionMap           m_Functions;    //!< the durations of all functions
+    CRTDebugProfileMap    m_Timers;       //!< the durations of all timers
+    std::vector<Call, CRTDebugArenaAllocator<Call> > m_Calls; //!< the functions currently entered
+    unsigned long long    m_iClockStart;  //!< time of the last STARTCLOCK() or 0
+    std::mutex            m_Mutex;        //!< protects the profile against the report
+};
+
+#endif // CRTDEBUGPROFILE_H
@@ -0,0 +1,78 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+#include "CRTDebugSink.h"
+
+#include <cerrno>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+CRTDebugFileSink::CRTDebugFileSink(const int fd)
+  : m_iFD(fd),
+    m_bOwnsFD(false)
+{
+}
+
+CRTDebugFileSink::CRTDebugFileSink(const char* filename)
+  : m_iFD(-1),
+    m_bOwnsFD(true)
+{
+  m_iFD = open(filename, O_WRONLY | O_CREAT | O_APPEND, 0644);
+}
+
+CRTDebugFileSink::~CRTDebugFileSink()
+{
+  if(m_bOwnsFD == true && m_iFD >= 0)
+    close(m_iFD);
+}
+
+//  Class:       CRTDebugFileSink
+//  Method:      write
+//!
+//! Writes a record to the file descriptor. Normally this results in exactly
+//! one write() call. Only in case of interrupted or partial writes (e.g.
+//! full pipes) we have to loop.
+//!
+//! @return      false in case the data could not be written
+////////////////////////////////////////////////////////////////////////////////
+bool CRTDebugFileSink::write(const CRTDebugRecordInfo&, const char* data, const size_t len)
+{
+  const char* p = data;
+  size_t left = len;
+
+  while(left > 0)
+  {
+    ssize_t written = ::write(m_iFD, p, left);
+    if(written < 0)
+    {
+      if(errno == EINTR)
+        continue;
+
+      return false;
+    }
+
+    p += written;
+    left -= written;
+  }
+
+  return true;
+}
@@ -0,0 +1,99 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+#ifndef CRTDEBUGSINK_H
+#define CRTDEBUGSINK_H
+
+#include <cstddef>
+
+//! meta information about a single output record which is passed to
+//! the output sinks together with the already formatted record text. The
+//! source fields are only set for records emitted by the debug macros and
+//! the strings are expected to be static (e.g. __FILE__ or literal format
+//! strings). Without a source file the message part of the record is not
+//! known and the whole record text has to be taken instead.
+struct CRTDebugRecordInfo
+{
+  CRTDebugRecordInfo()
+    : time(0), cls(0), threadID(0), file(NULL), line(0), module(NULL),
+      function(NULL), format(NULL), span(0), indent(0),
+      messageOffset(0), messageLength(0)
+  {
+  }
+
+  unsigned long long  time;       //!< time of the record (usec since epoch)
+  unsigned int        cls;        //!< debug class of the record
+  unsigned int        threadID;   //!< rtdebug internal thread id
+
+  const char*         file;       //!< source file of the record or NULL
+  long                line;       //!< source line of the record
+  const char*         module;     //!< debug module of the record or NULL
+  const char*         function;   //!< function of ENTER()/LEAVE() records or NULL
+  const char*         format;     //!< format string of D()/E()/W() records or NULL
+  unsigned long long  span;       //!< span attached to the thread or 0
+  unsigned int        indent;     //!< indention level of the thread
+  unsigned int        messageOffset; //!< start of the message within the record
+  unsigned int        messageLength; //!< length of the message
+};
+
+//  Classname:   CRTDebugSink
+//! @brief abstract output destination for debug records
+//! @ingroup debug
+//!
+//! All debug records are passed to exactly one sink which is in charge of
+//! getting the formatted record data to its final destination (terminal,
+//! plain file, compressed trace file, etc.). The sinks are always called
+//! with the output stream lock held, so they don't need to care about
+//! concurrent calls themselves.
+////////////////////////////////////////////////////////////////////////////////
+class CRTDebugSink
+{
+  public:
+    virtual ~CRTDebugSink() {}
+
+    virtual bool write(const CRTDebugRecordInfo& info, const char* data, const size_t len) = 0;
+    virtual void flush() {}
+};
+
+//  Classname:   CRTDebugFileSink
+//! @brief sink writing records straight to a file descriptor
+//! @ingroup debug
+//!
+//! Every record results in a single write() call to the file descriptor,
+//! which is either one of the standard output descriptors or a plain trace
+//! file opened in append mode.
+////////////////////////////////////////////////////////////////////////////////
+class CRTDebugFileSink : public CRTDebugSink
+{
+  public:
+    CRTDebugFileSink(const int fd);
+    CRTDebugFileSink(const char* filename);
+    ~CRTDebugFileSink();
+
+    bool isOpen() const { return m_iFD >= 0; }
+    bool write(const CRTDebugRecordInfo& info, const char* data, const size_t len);
+
+  private:
+    int   m_iFD;        //!< the file descriptor we write to
+    bool  m_bOwnsFD;    //!< should the descriptor be closed on destruction
+};
+
+#endif // CRTDEBUGSINK_H
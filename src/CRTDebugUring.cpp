@@ -0,0 +1,495 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+#include "CRTDebugUring.h"
+#include "CRTDebug.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+
+#include "config.h"
+
+#if defined(HAVE_IO_URING)
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#define URING_ENTRIES     (URING_BUFFERS*2)
+
+// liburing is not required, the few system calls are issued directly
+static inline int uringSetup(const unsigned int entries, struct io_uring_params* p)
+{
+  return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static inline int uringEnter(const int fd, const unsigned int submit, const unsigned int complete,
+                             const unsigned int flags)
+{
+  return (int)syscall(__NR_io_uring_enter, fd, submit, complete, flags, NULL, 0);
+}
+
+static inline int uringRegister(const int fd, const unsigned int opcode, const void* arg,
+                                const unsigned int args)
+{
+  return (int)syscall(__NR_io_uring_register, fd, opcode, arg, args);
+}
+#endif
+
+CRTDebugUringSink::CRTDebugUringSink(const char* filename)
+  : m_iFD(-1),
+    m_iOffset(0),
+    m_iCurrent(-1),
+    m_iPending(0),
+    m_bError(false),
+    m_iRingFD(-1),
+    m_bFixed(false),
+    m_pSQRing(MAP_FAILED),
+    m_pCQRing(MAP_FAILED),
+    m_pSQEs(MAP_FAILED),
+    m_iSQRingSize(0),
+    m_iCQRingSize(0),
+    m_iSQEsSize(0),
+    m_pSQHead(NULL),
+    m_pSQTail(NULL),
+    m_pSQMask(NULL),
+    m_pSQArray(NULL),
+    m_pCQHead(NULL),
+    m_pCQTail(NULL),
+    m_pCQMask(NULL),
+    m_pCQEs(NULL)
+{
+  memset(m_Buffers, 0, sizeof(m_Buffers));
+
+  // the buffers are written at explicit offsets, so instead of O_APPEND
+  // we start at the current end of the file
+  m_iFD = open(filename, O_WRONLY | O_CREAT, 0644);
+  if(m_iFD < 0)
+    return;
+
+  off_t end = lseek(m_iFD, 0, SEEK_END);
+  m_iOffset = end > 0 ? end : 0;
+
+  for(int i=0; i < URING_BUFFERS; i++)
+  {
+    if(posix_memalign((void**)&m_Buffers[i].data, 4096, URING_BUFFERSIZE) != 0)
+    {
+      close(m_iFD);
+      m_iFD = -1;
+      return;
+    }
+  }
+
+  setupRing();
+}
+
+CRTDebugUringSink::~CRTDebugUringSink()
+{
+  if(m_iFD >= 0)
+  {
+    flush();
+    close(m_iFD);
+  }
+
+  #if defined(HAVE_IO_URING)
+  if(m_pSQEs != MAP_FAILED)
+    munmap(m_pSQEs, m_iSQEsSize);
+  if(m_pCQRing != MAP_FAILED && m_pCQRing != m_pSQRing)
+    munmap(m_pCQRing, m_iCQRingSize);
+  if(m_pSQRing != MAP_FAILED)
+    munmap(m_pSQRing, m_iSQRingSize);
+  if(m_iRingFD >= 0)
+    close(m_iRingFD);
+  #endif
+
+  for(int i=0; i < URING_BUFFERS; i++)
+    free(m_Buffers[i].data);
+}
+
+//  Class:       CRTDebugUringSink
+//  Method:      setupRing
+//!
+//! Creates the io_uring instance, maps its rings and registers the output
+//! buffers. If the buffers can't be registered (e.g. due to RLIMIT_MEMLOCK)
+//! plain instead of fixed buffer writes are submitted.
+//!
+//! @return      false if io_uring is not available
+////////////////////////////////////////////////////////////////////////////////
+bool CRTDebugUringSink::setupRing()
+{
+  #if defined(HAVE_IO_URING)
+  struct io_uring_params p;
+  memset(&p, 0, sizeof(p));
+
+  int ringFD = uringSetup(URING_ENTRIES, &p);
+  if(ringFD < 0)
+    return false;
+
+  m_iSQRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+  m_iCQRingSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  if(p.features & IORING_FEAT_SINGLE_MMAP)
+  {
+    if(m_iCQRingSize > m_iSQRingSize)
+      m_iSQRingSize = m_iCQRingSize;
+    m_iCQRingSize = m_iSQRingSize;
+  }
+
+  m_pSQRing = mmap(NULL, m_iSQRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFD, IORING_OFF_SQ_RING);
+  if(m_pSQRing == MAP_FAILED)
+  {
+    close(ringFD);
+    return false;
+  }
+
+  if(p.features & IORING_FEAT_SINGLE_MMAP)
+    m_pCQRing = m_pSQRing;
+  else
+    m_pCQRing = mmap(NULL, m_iCQRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFD, IORING_OFF_CQ_RING);
+
+  m_iSQEsSize = p.sq_entries * sizeof(struct io_uring_sqe);
+  m_pSQEs = mmap(NULL, m_iSQEsSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFD, IORING_OFF_SQES);
+
+  if(m_pCQRing == MAP_FAILED || m_pSQEs == MAP_FAILED)
+  {
+    if(m_pSQEs != MAP_FAILED)
+      munmap(m_pSQEs, m_iSQEsSize);
+    if(m_pCQRing != MAP_FAILED && m_pCQRing != m_pSQRing)
+      munmap(m_pCQRing, m_iCQRingSize);
+    munmap(m_pSQRing, m_iSQRingSize);
+    m_pSQRing = m_pCQRing = m_pSQEs = MAP_FAILED;
+    close(ringFD);
+    return false;
+  }
+
+  char* sq = (char*)m_pSQRing;
+  m_pSQHead = (unsigned int*)(sq + p.sq_off.head);
+  m_pSQTail = (unsigned int*)(sq + p.sq_off.tail);
+  m_pSQMask = (unsigned int*)(sq + p.sq_off.ring_mask);
+  m_pSQArray = (unsigned int*)(sq + p.sq_off.array);
+
+  char* cq = (char*)m_pCQRing;
+  m_pCQHead = (unsigned int*)(cq + p.cq_off.head);
+  m_pCQTail = (unsigned int*)(cq + p.cq_off.tail);
+  m_pCQMask = (unsigned int*)(cq + p.cq_off.ring_mask);
+  m_pCQEs = cq + p.cq_off.cqes;
+
+  struct iovec iov[URING_BUFFERS];
+  for(int i=0; i < URING_BUFFERS; i++)
+  {
+    iov[i].iov_base = m_Buffers[i].data;
+    iov[i].iov_len = URING_BUFFERSIZE;
+  }
+  m_bFixed = uringRegister(ringFD, IORING_REGISTER_BUFFERS, iov, URING_BUFFERS) == 0;
+
+  m_iRingFD = ringFD;
+  return true;
+  #else
+  return false;
+  #endif
+}
+
+//  Class:       CRTDebugUringSink
+//  Method:      write
+//!
+//! Copies a record into the current buffer. Only if the buffer is full
+//! (or the record is an error) the buffer is submitted.
+//!
+//! @return      false if a previous write of the file failed
+////////////////////////////////////////////////////////////////////////////////
+bool CRTDebugUringSink::write(const CRTDebugRecordInfo& info, const char* data, const size_t len)
+{
+  if(m_iCurrent >= 0 && m_Buffers[m_iCurrent].length + len > URING_BUFFERSIZE)
+    submit(m_iCurrent);
+
+  if(len > URING_BUFFERSIZE)
+  {
+    // oversized records are written directly at their offset; the order
+    // within the file is kept as all writes use explicit offsets
+    bool result = writeAt(data, len, m_iOffset);
+    m_iOffset += len;
+    return result && m_bError == false;
+  }
+
+  if(m_iCurrent < 0)
+  {
+    m_iCurrent = nextBuffer();
+    if(m_iCurrent < 0)
+      return false;
+
+    m_Buffers[m_iCurrent].length = 0;
+  }
+
+  Buffer& buffer = m_Buffers[m_iCurrent];
+  memcpy(buffer.data + buffer.length, data, len);
+  buffer.length += len;
+
+  if(info.cls & (DBC_ERROR | DBC_ASSERT))
+  {
+    submit(m_iCurrent);
+    if(m_iRingFD < 0)
+      writeQueued();
+  }
+
+  return m_bError == false;
+}
+
+//  Class:       CRTDebugUringSink
+//  Method:      flush
+//!
+//! Submits the current buffer and waits until all buffers are written.
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugUringSink::flush()
+{
+  if(m_iCurrent >= 0)
+    submit(m_iCurrent);
+
+  if(m_iRingFD >= 0)
+  {
+    while(m_iPending > 0)
+    {
+      if(reap(true) == false)
+        break;
+    }
+  }
+  else
+    writeQueued();
+}
+
+//  Class:       CRTDebugUringSink
+//  Method:      submit
+//!
+//! Assigns the next file offset to a filled buffer and submits it as one
+//! write, or queues it for the next pwritev() without io_uring.
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugUringSink::submit(const int index)
+{
+  Buffer& buffer = m_Buffers[index];
+
+  if(index == m_iCurrent)
+    m_iCurrent = -1;
+
+  if(buffer.length == 0)
+    return;
+
+  buffer.offset = m_iOffset;
+  buffer.busy = true;
+  m_iOffset += buffer.length;
+  m_iPending++;
+
+  #if defined(HAVE_IO_URING)
+  if(m_iRingFD >= 0)
+  {
+    unsigned int tail = *m_pSQTail;
+    unsigned int slot = tail & *m_pSQMask;
+    struct io_uring_sqe* sqe = &((struct io_uring_sqe*)m_pSQEs)[slot];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = m_bFixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+    sqe->fd = m_iFD;
+    sqe->addr = (unsigned long)buffer.data;
+    sqe->len = buffer.length;
+    sqe->off = buffer.offset;
+    sqe->buf_index = m_bFixed ? index : 0;
+    sqe->user_data = index;
+
+    m_pSQArray[slot] = slot;
+    __atomic_store_n(m_pSQTail, tail+1, __ATOMIC_RELEASE);
+
+    if(uringEnter(m_iRingFD, 1, 0, 0) < 0)
+    {
+      // the kernel refused the submission, so we write it ourselves
+      __atomic_store_n(m_pSQTail, tail, __ATOMIC_RELEASE);
+      if(writeAt(buffer.data, buffer.length, buffer.offset) == false)
+        m_bError = true;
+      buffer.busy = false;
+      m_iPending--;
+    }
+  }
+  #endif
+}
+
+//  Class:       CRTDebugUringSink
+//  Method:      reap
+//!
+//! Processes the available completions. Short or failed writes are
+//! completed synchronously.
+//!
+//! @param  wait     wait for at least one completion
+//! @return          false if waiting for completions failed
+////////////////////////////////////////////////////////////////////////////////
+bool CRTDebugUringSink::reap(const bool wait)
+{
+  #if defined(HAVE_IO_URING)
+  unsigned int head = *m_pCQHead;
+
+  if(wait == true && head == __atomic_load_n(m_pCQTail, __ATOMIC_ACQUIRE))
+  {
+    if(uringEnter(m_iRingFD, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR)
+      return false;
+  }
+
+  while(head != __atomic_load_n(m_pCQTail, __ATOMIC_ACQUIRE))
+  {
+    struct io_uring_cqe* cqe = &((struct io_uring_cqe*)m_pCQEs)[head & *m_pCQMask];
+    Buffer& buffer = m_Buffers[cqe->user_data];
+
+    size_t written = cqe->res > 0 ? cqe->res : 0;
+    if(written < buffer.length &&
+       writeAt(buffer.data + written, buffer.length - written, buffer.offset + written) == false)
+    {
+      m_bError = true;
+    }
+
+    buffer.busy = false;
+    m_iPending--;
+    head++;
+  }
+
+  __atomic_store_n(m_pCQHead, head, __ATOMIC_RELEASE);
+  #else
+  (void)wait;
+  #endif
+
+  return true;
+}
+
+//  Class:       CRTDebugUringSink
+//  Method:      writeQueued
+//!
+//! Writes all queued buffers in case io_uring is not available. Buffers
+//! which directly follow each other in the file are written with a single
+//! pwritev() call, which normally covers all of them.
+////////////////////////////////////////////////////////////////////////////////
+bool CRTDebugUringSink::writeQueued()
+{
+  // sort the queued buffers by their offset
+  int order[URING_BUFFERS];
+  int count = 0;
+
+  for(int i=0; i < URING_BUFFERS; i++)
+  {
+    if(m_Buffers[i].busy == false)
+      continue;
+
+    int j = count++;
+    for(; j > 0 && m_Buffers[order[j-1]].offset > m_Buffers[i].offset; j--)
+      order[j] = order[j-1];
+    order[j] = i;
+  }
+
+  bool result = true;
+  for(int first=0; first < count; )
+  {
+    struct iovec iov[URING_BUFFERS];
+    unsigned long long offset = m_Buffers[order[first]].offset;
+    unsigned long long next = offset;
+    int n = 0;
+
+    while(first+n < count && m_Buffers[order[first+n]].offset == next)
+    {
+      iov[n].iov_base = m_Buffers[order[first+n]].data;
+      iov[n].iov_len = m_Buffers[order[first+n]].length;
+      next += iov[n].iov_len;
+      n++;
+    }
+
+    ssize_t written = pwritev(m_iFD, iov, n, offset);
+
+    // short writes are completed buffer by buffer
+    size_t done = written > 0 ? written : 0;
+    for(int i=0; i < n; i++)
+    {
+      size_t len = iov[i].iov_len;
+      if(done < len && writeAt((const char*)iov[i].iov_base + done, len - done, offset + done) == false)
+        result = false;
+
+      done = done > len ? done - len : 0;
+      offset += len;
+    }
+
+    first += n;
+  }
+
+  for(int i=0; i < URING_BUFFERS; i++)
+    m_Buffers[i].busy = false;
+  m_iPending = 0;
+
+  if(result == false)
+    m_bError = true;
+
+  return result;
+}
+
+//  Class:       CRTDebugUringSink
+//  Method:      writeAt
+//!
+//! Synchronously writes data at a file offset.
+////////////////////////////////////////////////////////////////////////////////
+bool CRTDebugUringSink::writeAt(const char* data, size_t len, unsigned long long offset)
+{
+  while(len > 0)
+  {
+    ssize_t written = pwrite(m_iFD, data, len, offset);
+    if(written < 0)
+    {
+      if(errno == EINTR)
+        continue;
+
+      return false;
+    }
+
+    data += written;
+    len -= written;
+    offset += written;
+  }
+
+  return true;
+}
+
+//  Class:       CRTDebugUringSink
+//  Method:      nextBuffer
+//!
+//! Returns a free buffer. Completions are only reaped (or the queued
+//! buffers written) once no free buffer is left.
+////////////////////////////////////////////////////////////////////////////////
+int CRTDebugUringSink::nextBuffer()
+{
+  for(;;)
+  {
+    for(int i=0; i < URING_BUFFERS; i++)
+    {
+      if(m_Buffers[i].busy == false)
+        return i;
+    }
+
+    if(m_iRingFD >= 0)
+    {
+      if(reap(false) == false || (m_iPending == URING_BUFFERS && reap(true) == false))
+        return -1;
+    }
+    else if(writeQueued() == false)
+      return -1;
+  }
+}
@@ -0,0 +1,99 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+#ifndef CRTDEBUGURING_H
+#define CRTDEBUGURING_H
+
+#include "CRTDebugSink.h"
+
+#define URING_BUFFERS     8           // number of registered buffers
+#define URING_BUFFERSIZE  (64*1024)   // size of each buffer
+
+//  Classname:   CRTDebugUringSink
+//! @brief sink writing plain trace files asynchronously via io_uring
+//! @ingroup debug
+//!
+//! Records are collected in a small set of buffers which are registered
+//! with the kernel once. A full buffer is submitted as a single write at an
+//! explicit file offset, so the emitting thread neither waits for the disk
+//! nor needs a writer thread. Completions are only reaped when a buffer is
+//! needed again. Errors and failed assertions submit the current buffer
+//! right away so that they reach the file as early as possible.
+//!
+//! If io_uring is not available (old kernels, seccomp filters or a build
+//! without <linux/io_uring.h>) full buffers are queued instead and written
+//! with a single pwritev() once no free buffer is left.
+////////////////////////////////////////////////////////////////////////////////
+class CRTDebugUringSink : public CRTDebugSink
+{
+  public:
+    CRTDebugUringSink(const char* filename);
+    ~CRTDebugUringSink();
+
+    bool isOpen() const { return m_iFD >= 0; }
+    bool usesUring() const { return m_iRingFD >= 0; }
+    bool write(const CRTDebugRecordInfo& info, const char* data, const size_t len);
+    void flush();
+
+  private:
+    struct Buffer
+    {
+      char*               data;       //!< the (registered) buffer memory
+      size_t              length;     //!< bytes used in the buffer
+      unsigned long long  offset;     //!< file offset the buffer is written to
+      bool                busy;       //!< submitted/queued and not yet written
+    };
+
+    bool setupRing();
+    void submit(const int index);
+    bool reap(const bool wait);
+    bool writeQueued();
+    bool writeAt(const char* data, size_t len, unsigned long long offset);
+    int nextBuffer();
+
+  private:
+    int                 m_iFD;            //!< the trace file descriptor
+    unsigned long long  m_iOffset;        //!< file offset of the next buffer
+    Buffer              m_Buffers[URING_BUFFERS]; //!< the output buffers
+    int                 m_iCurrent;       //!< the buffer currently filled
+    unsigned int        m_iPending;       //!< number of submitted/queued buffers
+    bool                m_bError;         //!< a write failed
+
+    // the io_uring instance
+    int                 m_iRingFD;        //!< the ring descriptor or -1
+    bool                m_bFixed;         //!< the buffers are registered
+    void*               m_pSQRing;        //!< the mapped submission ring
+    void*               m_pCQRing;        //!< the mapped completion ring
+    void*               m_pSQEs;          //!< the mapped submission entries
+    size_t              m_iSQRingSize;    //!< size of the submission ring mapping
+    size_t              m_iCQRingSize;    //!< size of the completion ring mapping
+    size_t              m_iSQEsSize;      //!< size of the submission entry mapping
+    unsigned int*       m_pSQHead;        //!< submission ring head
+    unsigned int*       m_pSQTail;        //!< submission ring tail
+    unsigned int*       m_pSQMask;        //!< submission ring mask
+    unsigned int*       m_pSQArray;       //!< submission ring index array
+    unsigned int*       m_pCQHead;        //!< completion ring head
+    unsigned int*       m_pCQTail;        //!< completion ring tail
+    unsigned int*       m_pCQMask;        //!< completion ring mask
+    void*               m_pCQEs;          //!< the completion entries
+};
+
+#endif // CRTDEBUGURING_H
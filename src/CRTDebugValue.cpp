@@ -0,0 +1,131 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+#include "CRTDebugValue.h"
+#include "CRTDebugBuffer.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cfloat>
+
+void CRTDebugOutput::append(const char* string)
+{
+  m_Buffer.append(string);
+}
+
+void CRTDebugOutput::append(const char* string, const size_t len)
+{
+  m_Buffer.append(string, len);
+}
+
+void CRTDebugOutput::appendChar(const char c)
+{
+  m_Buffer.append(c);
+}
+
+void CRTDebugOutput::appendDec(const long long value)
+{
+  m_Buffer.appendDec(value);
+}
+
+void CRTDebugOutput::appendUnsigned(const unsigned long long value)
+{
+  char digits[24];
+  char* p = digits+sizeof(digits);
+  unsigned long long v = value;
+
+  do
+  {
+    *--p = '0' + (v % 10);
+    v /= 10;
+  }
+  while(v != 0);
+
+  m_Buffer.append(p, (digits+sizeof(digits)) - p);
+}
+
+void CRTDebugOutput::appendHex(const unsigned long long value, const int width)
+{
+  m_Buffer.appendHex(value, width);
+}
+
+//  Class:       CRTDebugOutput
+//  Method:      appendFloat
+//!
+//! Appends a floating point number with the least number of digits which
+//! still reads back to the same value, so that e.g. 0.1 is not output as
+//! 0.10000000000000001.
+//!
+//! @param  value    the number to append
+//! @param  single   the number is a float instead of a double
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugOutput::appendFloat(const double value, const bool single)
+{
+  char digits[32];
+
+  int len = snprintf(digits, sizeof(digits), "%.*g", single ? FLT_DIG : DBL_DIG, value);
+  if((single ? (double)strtof(digits, NULL) : strtod(digits, NULL)) != value)
+    len = snprintf(digits, sizeof(digits), "%.*g", single ? FLT_DIG+3 : DBL_DIG+2, value);
+
+  m_Buffer.append(digits, len);
+}
+
+//  Class:       CRTDebugOutput
+//  Method:      appendQuoted
+//!
+//! Appends a string in double quotes. Quotes, backslashes and control
+//! characters are escaped so that the record always stays a single line.
+//!
+//! @param  string   the characters to append
+//! @param  len      the number of characters
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugOutput::appendQuoted(const char* string, const size_t len)
+{
+  m_Buffer.append('"');
+
+  const char* start = string;
+  for(size_t i=0; i < len; i++)
+  {
+    unsigned char c = string[i];
+    if(c >= ' ' && c != 127 && c != '"' && c != '\\')
+      continue;
+
+    m_Buffer.append(start, string+i - start);
+    start = string+i+1;
+
+    m_Buffer.append('\\');
+    switch(c)
+    {
+      case '"':  m_Buffer.append('"');  break;
+      case '\\': m_Buffer.append('\\'); break;
+      case '\n': m_Buffer.append('n');  break;
+      case '\r': m_Buffer.append('r');  break;
+      case '\t': m_Buffer.append('t');  break;
+      default:
+        m_Buffer.append('x');
+        m_Buffer.appendHex(c, 2);
+      break;
+    }
+  }
+
+  m_Buffer.append(start, string+len - start);
+  m_Buffer.append('"');
+}
@@ -0,0 +1,323 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+#ifndef CRTDEBUGVALUE_H
+#define CRTDEBUGVALUE_H
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <iterator>
+#include <sstream>
+#include <type_traits>
+
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+
+// the maximum number of elements SHOWVALUE() outputs of a range
+#if !defined(RTDEBUG_RANGE_LIMIT)
+#define RTDEBUG_RANGE_LIMIT 16
+#endif
+
+// forward declarations
+class CRTDebugBuffer;
+
+//  Classname:   CRTDebugOutput
+//! @brief append-only view of the buffer used to format values
+//! @ingroup debug
+//!
+//! SHOWVALUE() formats its value into a per-thread buffer through this
+//! class, and only after the debug class, module and file filters decided
+//! that the record is output, so that nothing is formatted for suppressed
+//! records.
+//!
+//! User types are formatted through the customization point
+//!
+//!   void rtdebugFormat(CRTDebugOutput& out, const MyType& value);
+//!
+//! declared in the namespace of the type (or the global one), which may
+//! again use CRTDebugFormat::format() for the members of the type. It is
+//! called without any lock held and may use the debug macros itself.
+////////////////////////////////////////////////////////////////////////////////
+class CRTDebugOutput
+{
+  public:
+    explicit CRTDebugOutput(CRTDebugBuffer& buf) : m_Buffer(buf) {}
+
+    void append(const char* string);
+    void append(const char* string, const size_t len);
+    void appendChar(const char c);
+    void appendDec(const long long value);
+    void appendUnsigned(const unsigned long long value);
+    void appendHex(const unsigned long long value, const int width=0);
+    void appendFloat(const double value, const bool single=false);
+    void appendQuoted(const char* string, const size_t len);
+
+  private:
+    CRTDebugBuffer& m_Buffer;   //!< the buffer of the record
+};
+
+// the type erased formatter of a SHOWVALUE() value
+typedef void (*CRTDebugFormatFunc)(CRTDebugOutput& out, const void* value);
+
+//! a SHOWVALUE() value kept in raw form by the lookback buffer, so that it
+//! is only formatted if the lookback is output
+struct CRTDebugRawValue
+{
+  const void*         data;     //!< the bytes of the value
+  size_t              size;     //!< the number of bytes
+  bool                string;   //!< the bytes are characters which may be cut off
+  CRTDebugFormatFunc  format;   //!< formats a copy of the bytes (followed by a NUL byte)
+};
+
+// the type erased capture of a SHOWVALUE() value for the lookback buffer
+typedef bool (*CRTDebugCaptureFunc)(const void* value, CRTDebugRawValue& raw);
+
+// tags ranking the formatters of CRTDebugFormat, higher ones are preferred
+template<unsigned int N> struct CRTDebugPriority : CRTDebugPriority<N-1> {};
+template<> struct CRTDebugPriority<0> {};
+
+//  Classname:   CRTDebugFormat
+//! @brief type dependent formatting of SHOWVALUE() values
+//! @ingroup debug
+//!
+//! Selects the formatter of a value by its type. In order of preference
+//! these are a user supplied rtdebugFormat(), booleans, strings, numbers,
+//! enums, pointers, pairs, ranges (up to RTDEBUG_RANGE_LIMIT elements)
+//! and at last any type with an operator<< for std::ostream.
+//!
+//! For the lookback buffer numbers, enums and strings are captured in raw
+//! form and formatted later from the copy. All other values may point to
+//! memory which is gone by then, so they can't be captured.
+////////////////////////////////////////////////////////////////////////////////
+struct CRTDebugFormat
+{
+  template<typename T> static void format(CRTDebugOutput& out, const T& value)
+  {
+    write(out, value, CRTDebugPriority<6>());
+  }
+
+  // the type erased formatter called by CRTDebug::ShowFormatted()
+  template<typename T> static void formatErased(CRTDebugOutput& out, const void* value)
+  {
+    format(out, *static_cast<const T*>(value));
+  }
+
+  // the type erased capture called by CRTDebug::ShowFormatted()
+  template<typename T> static bool captureErased(const void* value, CRTDebugRawValue& raw)
+  {
+    return capture(*static_cast<const T*>(value), raw, CRTDebugPriority<3>());
+  }
+
+  private:
+    // formats the characters of a captured string
+    static void formatString(CRTDebugOutput& out, const void* value)
+    {
+      const char* string = static_cast<const char*>(value);
+      out.appendQuoted(string, std::char_traits<char>::length(string));
+    }
+
+    static bool captureString(const char* string, const size_t len, CRTDebugRawValue& raw)
+    {
+      raw.data = string;
+      raw.size = len;
+      raw.string = true;
+      raw.format = &formatString;
+
+      return true;
+    }
+
+    template<typename T> static typename std::enable_if<std::is_arithmetic<T>::value || std::is_enum<T>::value, bool>::type
+      capture(const T& value, CRTDebugRawValue& raw, CRTDebugPriority<3>)
+    {
+      raw.data = &value;
+      raw.size = sizeof(value);
+      raw.string = false;
+      raw.format = &formatErased<T>;
+
+      return true;
+    }
+
+    // strings with an own formatter are not taken as plain characters
+    template<typename T> static auto capture(const T& value, CRTDebugRawValue&, CRTDebugPriority<2>)
+      -> decltype(rtdebugFormat(std::declval<CRTDebugOutput&>(), value), bool())
+    {
+      return false;
+    }
+
+    template<typename T> static typename std::enable_if<std::is_same<T, std::string>::value, bool>::type
+      capture(const T& value, CRTDebugRawValue& raw, CRTDebugPriority<1>)
+    {
+      return captureString(value.data(), value.length(), raw);
+    }
+
+    #if __cplusplus >= 201703L
+    template<typename T> static typename std::enable_if<std::is_same<T, std::string_view>::value, bool>::type
+      capture(const T& value, CRTDebugRawValue& raw, CRTDebugPriority<1>)
+    {
+      return captureString(value.data(), value.length(), raw);
+    }
+    #endif
+
+    template<typename T> static typename std::enable_if<std::is_same<T, const char*>::value || std::is_same<T, char*>::value, bool>::type
+      capture(const T& value, CRTDebugRawValue& raw, CRTDebugPriority<1>)
+    {
+      return value != NULL && captureString(value, std::char_traits<char>::length(value), raw);
+    }
+
+    template<size_t N> static bool capture(const char (&value)[N], CRTDebugRawValue& raw, CRTDebugPriority<1>)
+    {
+      size_t len = 0;
+      while(len < N && value[len] != '\0')
+        len++;
+
+      return captureString(value, len, raw);
+    }
+
+    template<typename T> static bool capture(const T&, CRTDebugRawValue&, CRTDebugPriority<0>)
+    {
+      return false;
+    }
+
+    template<typename T> static auto write(CRTDebugOutput& out, const T& value, CRTDebugPriority<6>)
+      -> decltype(rtdebugFormat(out, value), void())
+    {
+      rtdebugFormat(out, value);
+    }
+
+    // the exact types are matched by templates, as plain overloads would
+    // also take any value implicitly convertible to them
+    template<typename T> static typename std::enable_if<std::is_same<T, bool>::value>::type
+      write(CRTDebugOutput& out, const T& value, CRTDebugPriority<5>)
+    {
+      out.append(value ? "true" : "false");
+    }
+
+    template<typename T> static typename std::enable_if<std::is_same<T, std::string>::value>::type
+      write(CRTDebugOutput& out, const T& value, CRTDebugPriority<4>)
+    {
+      out.appendQuoted(value.data(), value.length());
+    }
+
+    #if __cplusplus >= 201703L
+    template<typename T> static typename std::enable_if<std::is_same<T, std::string_view>::value>::type
+      write(CRTDebugOutput& out, const T& value, CRTDebugPriority<4>)
+    {
+      out.appendQuoted(value.data(), value.length());
+    }
+    #endif
+
+    template<typename T> static typename std::enable_if<std::is_same<T, const char*>::value || std::is_same<T, char*>::value>::type
+      write(CRTDebugOutput& out, const T& value, CRTDebugPriority<4>)
+    {
+      if(value != NULL)
+        out.appendQuoted(value, std::char_traits<char>::length(value));
+      else
+        out.append("NULL");
+    }
+
+    template<size_t N> static void write(CRTDebugOutput& out, const char (&value)[N], CRTDebugPriority<4>)
+    {
+      size_t len = 0;
+      while(len < N && value[len] != '\0')
+        len++;
+
+      out.appendQuoted(value, len);
+    }
+
+    template<typename T> static typename std::enable_if<std::is_same<T, char>::value>::type
+      write(CRTDebugOutput& out, const T& value, CRTDebugPriority<4>)
+    {
+      out.appendChar('\'');
+      out.appendChar(value);
+      out.appendChar('\'');
+    }
+
+    template<typename T> static typename std::enable_if<std::is_floating_point<T>::value>::type
+      write(CRTDebugOutput& out, const T& value, CRTDebugPriority<3>)
+    {
+      out.appendFloat(value, sizeof(T) == sizeof(float));
+    }
+
+    template<typename T> static typename std::enable_if<(std::is_integral<T>::value && std::is_signed<T>::value && std::is_same<T, char>::value == false) || std::is_enum<T>::value>::type
+      write(CRTDebugOutput& out, const T& value, CRTDebugPriority<3>)
+    {
+      out.appendDec((long long)value);
+    }
+
+    template<typename T> static typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value && std::is_same<T, bool>::value == false && std::is_same<T, char>::value == false>::type
+      write(CRTDebugOutput& out, const T& value, CRTDebugPriority<3>)
+    {
+      out.appendUnsigned(value);
+    }
+
+    template<typename T> static void write(CRTDebugOutput& out, T* const& value, CRTDebugPriority<2>)
+    {
+      out.append("0x");
+      out.appendHex((unsigned long long)(size_t)value, 8);
+    }
+
+    template<typename A, typename B> static void write(CRTDebugOutput& out, const std::pair<A, B>& value, CRTDebugPriority<2>)
+    {
+      out.appendChar('(');
+      format(out, value.first);
+      out.append(", ");
+      format(out, value.second);
+      out.appendChar(')');
+    }
+
+    template<typename T> static auto write(CRTDebugOutput& out, const T& value, CRTDebugPriority<1>)
+      -> decltype(std::begin(value) != std::end(value), void())
+    {
+      size_t count = 0;
+
+      out.appendChar('[');
+      for(auto it = std::begin(value); it != std::end(value); ++it, count++)
+      {
+        if(count < RTDEBUG_RANGE_LIMIT)
+        {
+          if(count > 0)
+            out.append(", ");
+          format(out, *it);
+        }
+      }
+
+      if(count > RTDEBUG_RANGE_LIMIT)
+      {
+        out.append(", ... ");
+        out.appendUnsigned(count - RTDEBUG_RANGE_LIMIT);
+        out.append(" more");
+      }
+      out.appendChar(']');
+    }
+
+    // the last resort allocates a stream, but only for output records
+    template<typename T> static auto write(CRTDebugOutput& out, const T& value, CRTDebugPriority<0>)
+      -> decltype(std::declval<std::ostream&>() << value, void())
+    {
+      std::ostringstream stream;
+      stream << value;
+      out.append(stream.str().c_str(), stream.str().length());
+    }
+};
+
+#endif // CRTDEBUGVALUE_H
@@ -0,0 +1,101 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+#include "CRTDebugVolume.h"
+
+CRTDebugVolume::CRTDebugVolume()
+  : m_pLast(NULL)
+{
+}
+
+//  Class:       CRTDebugVolume
+//  Method:      account
+//!
+//! Counts an output record of a call site. As most threads output bursts of
+//! records from the same call site, the last site is checked before the
+//! hash lookup.
+//!
+//! @param  file     source file of the call site
+//! @param  line     source line of the call site
+//! @param  module   debug module of the call site
+//! @param  cl       the debug class of the record
+//! @param  bytes    the size of the output record
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugVolume::account(const char* file, const long line, const char* module, const int cl,
+                             const size_t bytes)
+{
+  CRTDebugVolumeSite* site = m_pLast;
+
+  if(site == NULL || site->file != file || site->line != line || site->cls != cl)
+  {
+    Key key = { file, line, cl };
+    SiteMap::iterator it = m_Sites.find(key);
+    if(it == m_Sites.end())
+    {
+      CRTDebugVolumeSite newSite;
+      newSite.file = file;
+      newSite.line = line;
+      newSite.module = module;
+      newSite.cls = cl;
+
+      it = m_Sites.insert(std::make_pair(key, newSite)).first;
+    }
+
+    site = m_pLast = &(it->second);
+  }
+
+  site->count.records++;
+  site->count.bytes += bytes;
+
+  m_Total.records++;
+  m_Total.bytes += bytes;
+}
+
+//  Class:       CRTDebugVolume
+//  Method:      merge
+//!
+//! Adds the volume of all call sites of another table (e.g. of a
+//! terminating thread).
+////////////////////////////////////////////////////////////////////////////////
+void CRTDebugVolume::merge(const CRTDebugVolume& other)
+{
+  for(SiteMap::const_iterator it = other.m_Sites.begin(); it != other.m_Sites.end(); ++it)
+  {
+    std::pair<SiteMap::iterator, bool> result = m_Sites.insert(*it);
+    if(result.second == false)
+    {
+      CRTDebugVolumeSite& site = result.first->second;
+      site.count.records += it->second.count.records;
+      site.count.bytes += it->second.count.bytes;
+    }
+  }
+
+  m_Total.records += other.m_Total.records;
+  m_Total.bytes += other.m_Total.bytes;
+  m_pLast = NULL;
+}
+
+void CRTDebugVolume::clear()
+{
+  m_Sites.clear();
+  m_Total = CRTDebugVolumeCount();
+  m_pLast = NULL;
+}
@@ -0,0 +1,96 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+#ifndef CRTDEBUGVOLUME_H
+#define CRTDEBUGVOLUME_H
+
+#include "CRTDebugArena.h"
+
+#include <cstddef>
+#include <unordered_map>
+
+//! records and bytes output by a call site, module, class or thread
+struct CRTDebugVolumeCount
+{
+  unsigned long long  records;      //!< number of output records
+  unsigned long long  bytes;        //!< number of output bytes
+
+  CRTDebugVolumeCount() : records(0), bytes(0) {}
+};
+
+//! the output volume of a single call site
+struct CRTDebugVolumeSite
+{
+  const char*         file;         //!< source file of the call site
+  long                line;         //!< source line of the call site
+  const char*         module;       //!< debug module of the call site or NULL
+  int                 cls;          //!< debug class of the records
+  CRTDebugVolumeCount count;        //!< the output volume
+};
+
+//  Classname:   CRTDebugVolume
+//! @brief output volume accounting of a thread
+//! @ingroup debug
+//!
+//! Counts the records and bytes each call site outputs per debug class.
+//! Every thread owns such a table, so no synchronisation is required for
+//! counting. The call sites are identified by the address of their __FILE__
+//! string and line, so a report has to join sites of the same file name
+//! which were compiled into different translation units.
+////////////////////////////////////////////////////////////////////////////////
+class CRTDebugVolume
+{
+  public:
+    CRTDebugVolume();
+
+    void account(const char* file, const long line, const char* module, const int cl, const size_t bytes);
+    void merge(const CRTDebugVolume& other);
+    void clear();
+
+    const CRTDebugVolumeCount& total() const { return m_Total; }
+
+  public:
+    struct Key
+    {
+      const char* file;
+      long        line;
+      int         cls;
+
+      bool operator==(const Key& other) const { return file == other.file && line == other.line && cls == other.cls; }
+    };
+
+    struct KeyHash
+    {
+      size_t operator()(const Key& key) const { return ((size_t)key.file * 31 + key.line) * 31 + key.cls; }
+    };
+
+    typedef std::unordered_map<Key, CRTDebugVolumeSite, KeyHash, std::equal_to<Key>,
+                               CRTDebugArenaAllocator<std::pair<const Key, CRTDebugVolumeSite> > > SiteMap;
+
+    const SiteMap& sites() const { return m_Sites; }
+
+  private:
+    SiteMap               m_Sites;      //!< the volume of all call sites
+    CRTDebugVolumeCount   m_Total;      //!< the total volume
+    CRTDebugVolumeSite*   m_pLast;      //!< the last accounted call site
+};
+
+#endif // CRTDEBUGVOLUME_H
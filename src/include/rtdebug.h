@@ -61,6 +61,12 @@
 #if defined(STOPCLOCK)
 #undef STOPCLOCK
 #endif
+#if defined(FLOW_SEND)
+#undef FLOW_SEND
+#endif
+#if defined(FLOW_RECV)
+#undef FLOW_RECV
+#endif
 #if defined(D)
 #undef D
 #endif
@@ -70,6 +76,18 @@
 #if defined(W)
 #undef W
 #endif
+#if defined(V)
+#undef V
+#endif
+#if defined(RTCOUNT)
+#undef RTCOUNT
+#endif
+#if defined(RTGAUGE)
+#undef RTGAUGE
+#endif
+#if defined(RTMAX)
+#undef RTMAX
+#endif
 #if defined(ASSERT)
 #undef ASSERT
 #endif
@@ -101,32 +119,75 @@
 #define DEBUG_MODULE DBM_NONE
 #endif
 
+// the node of the module of a call site. A module given as string literal
+// is looked up only once per call site, so that neither the check of a
+// suppressed message nor the output of a shown one has to resolve the module
+// name again. Any other DEBUG_MODULE expression is resolved on every call.
+#define RTDEBUG_MODULE \
+  CRTDebug::module(DEBUG_MODULE, [](const char* _rtdebug_name) RTDEBUG_NO_INSTRUMENT -> const CRTDebugModule* \
+                   { static const CRTDebugModule* const _rtdebug_module = CRTDebug::module(_rtdebug_name); return _rtdebug_module; })
+
 // Core class information class messages
-#define ENTER()         CRTDebug::instance()->Enter(DBC_CTRACE, DEBUG_MODULE, __FILE__, __LINE__, __FUNCTION__)
-#define LEAVE()         CRTDebug::instance()->Leave(DBC_CTRACE, DEBUG_MODULE, __FILE__, __LINE__, __FUNCTION__)
-#define RETURN(r)       CRTDebug::instance()->Return(DBC_CTRACE, DEBUG_MODULE, __FILE__, __LINE__, __FUNCTION__, (long)r)
-#define SHOWVALUE(v)    CRTDebug::instance()->ShowValue(DBC_REPORT, DEBUG_MODULE, (long long)v, sizeof(v), #v, __FILE__, __LINE__)
-#define SHOWPOINTER(p)  CRTDebug::instance()->ShowPointer(DBC_REPORT, DEBUG_MODULE, p, #p, __FILE__, __LINE__)
-#define SHOWSTRING(s)   CRTDebug::instance()->ShowString(DBC_REPORT, DEBUG_MODULE, s, #s, __FILE__, __LINE__)
-#define SHOWMSG(m)      CRTDebug::instance()->ShowMessage(DBC_REPORT, DEBUG_MODULE, m, __FILE__, __LINE__)
-#define STARTCLOCK(s)   CRTDebug::instance()->StartClock(DBC_TIMEVAL, DEBUG_MODULE,  s, __FILE__, __LINE__)
-#define STOPCLOCK(s)    CRTDebug::instance()->StopClock(DBC_TIMEVAL, DEBUG_MODULE, s, __FILE__, __LINE__)
-#define D(s, vargs...)  CRTDebug::instance()->dprintf(DBC_DEBUG, DEBUG_MODULE, __FILE__, __LINE__, true, s, ## vargs)
-#define DN(s, vargs...) CRTDebug::instance()->dprintf(DBC_DEBUG, DEBUG_MODULE, __FILE__, __LINE__, false, s, ## vargs)
-#define E(s, vargs...)  CRTDebug::instance()->dprintf(DBC_ERROR, DEBUG_MODULE, __FILE__, __LINE__, true, s, ## vargs)
-#define EN(s, vargs...) CRTDebug::instance()->dprintf(DBC_ERROR, DEBUG_MODULE, __FILE__, __LINE__, false, s, ## vargs)
-#define W(s, vargs...)  CRTDebug::instance()->dprintf(DBC_WARNING, DEBUG_MODULE, __FILE__, __LINE__, true, s, ## vargs)
-#define WN(s, vargs...) CRTDebug::instance()->dprintf(DBC_WARNING, DEBUG_MODULE, __FILE__, __LINE__, false, s, ## vargs)
+#define ENTER()         CRTDebugCall()->Enter(DBC_CTRACE, RTDEBUG_MODULE, __FILE__, __LINE__, __FUNCTION__)
+#define LEAVE()         CRTDebugCall()->Leave(DBC_CTRACE, RTDEBUG_MODULE, __FILE__, __LINE__, __FUNCTION__)
+#define RETURN(r)       CRTDebugCall()->Return(DBC_CTRACE, RTDEBUG_MODULE, __FILE__, __LINE__, __FUNCTION__, (long)r)
+#define SHOWVALUE(v)    CRTDebugCall()->ShowValue(DBC_REPORT, RTDEBUG_MODULE, (v), #v, __FILE__, __LINE__)
+#define SHOWPOINTER(p)  CRTDebugCall()->ShowPointer(DBC_REPORT, RTDEBUG_MODULE, p, #p, __FILE__, __LINE__)
+#define SHOWSTRING(s)   CRTDebugCall()->ShowString(DBC_REPORT, RTDEBUG_MODULE, s, #s, __FILE__, __LINE__)
+#define SHOWMSG(m)      CRTDebugCall()->ShowMessage(DBC_REPORT, RTDEBUG_MODULE, m, __FILE__, __LINE__)
+#define STARTCLOCK(s)   CRTDebugCall()->StartClock(DBC_TIMEVAL, RTDEBUG_MODULE,  s, __FILE__, __LINE__)
+#define STOPCLOCK(s)    CRTDebugCall()->StopClock(DBC_TIMEVAL, RTDEBUG_MODULE, s, __FILE__, __LINE__)
+#define FLOW_SEND(s)    CRTDebugCall()->Flow(DBC_REPORT, RTDEBUG_MODULE, s, false, __FILE__, __LINE__)
+#define FLOW_RECV(s)    CRTDebugCall()->Flow(DBC_REPORT, RTDEBUG_MODULE, s, true, __FILE__, __LINE__)
+#define D(s, vargs...)  CRTDebugCall()->dprintf(DBC_DEBUG, RTDEBUG_MODULE, __FILE__, __LINE__, true, s, ## vargs)
+#define DN(s, vargs...) CRTDebugCall()->dprintf(DBC_DEBUG, RTDEBUG_MODULE, __FILE__, __LINE__, false, s, ## vargs)
+#define E(s, vargs...)  CRTDebugCall()->dprintf(DBC_ERROR, RTDEBUG_MODULE, __FILE__, __LINE__, true, s, ## vargs)
+#define EN(s, vargs...) CRTDebugCall()->dprintf(DBC_ERROR, RTDEBUG_MODULE, __FILE__, __LINE__, false, s, ## vargs)
+#define W(s, vargs...)  CRTDebugCall()->dprintf(DBC_WARNING, RTDEBUG_MODULE, __FILE__, __LINE__, true, s, ## vargs)
+#define WN(s, vargs...) CRTDebugCall()->dprintf(DBC_WARNING, RTDEBUG_MODULE, __FILE__, __LINE__, false, s, ## vargs)
+
+// verbosity dependent debug output. A suppressed message only costs a
+// single integer comparison against the level of the cached module node.
+#define V(l, s, vargs...) \
+  (RTDEBUG_MODULE->level.load(std::memory_order_relaxed) >= (l) ? \
+   CRTDebugCall()->dprintf(DBC_DEBUG, RTDEBUG_MODULE, __FILE__, __LINE__, true, s, ## vargs) : std::cerr)
+
+// counters, gauges and maxima which are reported periodically and at
+// CRTDebug::destroy(). The ID of the counter is looked up only once per
+// call site, and updates go to a shard of the calling thread without any
+// locking.
+#define RTCOUNT(name, n) \
+  do                     \
+  {                      \
+    static const int _rtdebug_counter = CRTDebug::counter(name, DBN_COUNT, __FILE__, __LINE__); \
+    CRTDebug::count(_rtdebug_counter, DBN_COUNT, (n)); \
+  }                      \
+  while(0)
+#define RTGAUGE(name, v) \
+  do                     \
+  {                      \
+    static const int _rtdebug_counter = CRTDebug::counter(name, DBN_GAUGE, __FILE__, __LINE__); \
+    CRTDebug::count(_rtdebug_counter, DBN_GAUGE, (v)); \
+  }                      \
+  while(0)
+#define RTMAX(name, v)   \
+  do                     \
+  {                      \
+    static const int _rtdebug_counter = CRTDebug::counter(name, DBN_MAX, __FILE__, __LINE__); \
+    CRTDebug::count(_rtdebug_counter, DBN_MAX, (v)); \
+  }                      \
+  while(0)
+
 #define ASSERT(expression)      \
   ((void)                       \
    ((expression) ? 0 :          \
     (                           \
-     CRTDebug::instance()->dprintf(DBC_ASSERT,   \
-                                   DEBUG_MODULE, \
-                                   __FILE__,     \
-                                   __LINE__,     \
-                                   true,         \
-                                   "failed assertion '%s'", #expression), \
+     CRTDebugCall()->dprintf(DBC_ASSERT,   \
+                             RTDEBUG_MODULE, \
+                             __FILE__,     \
+                             __LINE__,     \
+                             true,         \
+                             "failed assertion '%s'", #expression), \
      abort(),                   \
      0                          \
     )                           \
@@ -135,19 +196,19 @@
 
 // define some information messages which will also be compiled in no matter
 // if there is debug mode enabled or not
-#define Info(s, vargs...)    CRTDebug::instance()->printf(INC_INFO, INFO_MODULE, __FILE__, __LINE__, true, s, ## vargs)
-#define Verbose(s, vargs...) CRTDebug::instance()->printf(INC_VERBOSE, INFO_MODULE, __FILE__, __LINE__, true, s, ## vargs)
-#define Warning(s, vargs...) CRTDebug::instance()->printf(INC_WARNING, INFO_MODULE, __FILE__, __LINE__, true, s, ## vargs)
-#define Error(s, vargs...)   CRTDebug::instance()->printf(INC_ERROR, INFO_MODULE, __FILE__, __LINE__, true, s, ## vargs)
-#define Fatal(s, vargs...)   CRTDebug::instance()->printf(INC_FATAL, INFO_MODULE, __FILE__, __LINE__, true, s, ## vargs)
-#define Debug(s, vargs...)   CRTDebug::instance()->printf(INC_DEBUG, INFO_MODULE, __FILE__, __LINE__, true, s, ## vargs)
-
-#define InfoN(s, vargs...)    CRTDebug::instance()->printf(INC_INFO, INFO_MODULE, __FILE__, __LINE__, false, s, ## vargs)
-#define VerboseN(s, vargs...) CRTDebug::instance()->printf(INC_VERBOSE, INFO_MODULE, __FILE__, __LINE__, false, s, ## vargs)
-#define WarningN(s, vargs...) CRTDebug::instance()->printf(INC_WARNING, INFO_MODULE, __FILE__, __LINE__, false, s, ## vargs)
-#define ErrorN(s, vargs...)   CRTDebug::instance()->printf(INC_ERROR, INFO_MODULE, __FILE__, __LINE__, false, s, ## vargs)
-#define FatalN(s, vargs...)   CRTDebug::instance()->printf(INC_FATAL, INFO_MODULE, __FILE__, __LINE__, false, s, ## vargs)
-#define DebugN(s, vargs...)   CRTDebug::instance()->printf(INC_DEBUG, INFO_MODULE, __FILE__, __LINE__, false, s, ## vargs)
+#define Info(s, vargs...)    CRTDebugCall()->printf(INC_INFO, INFO_MODULE, __FILE__, __LINE__, true, s, ## vargs)
+#define Verbose(s, vargs...) CRTDebugCall()->printf(INC_VERBOSE, INFO_MODULE, __FILE__, __LINE__, true, s, ## vargs)
+#define Warning(s, vargs...) CRTDebugCall()->printf(INC_WARNING, INFO_MODULE, __FILE__, __LINE__, true, s, ## vargs)
+#define Error(s, vargs...)   CRTDebugCall()->printf(INC_ERROR, INFO_MODULE, __FILE__, __LINE__, true, s, ## vargs)
+#define Fatal(s, vargs...)   CRTDebugCall()->printf(INC_FATAL, INFO_MODULE, __FILE__, __LINE__, true, s, ## vargs)
+#define Debug(s, vargs...)   CRTDebugCall()->printf(INC_DEBUG, INFO_MODULE, __FILE__, __LINE__, true, s, ## vargs)
+
+#define InfoN(s, vargs...)    CRTDebugCall()->printf(INC_INFO, INFO_MODULE, __FILE__, __LINE__, false, s, ## vargs)
+#define VerboseN(s, vargs...) CRTDebugCall()->printf(INC_VERBOSE, INFO_MODULE, __FILE__, __LINE__, false, s, ## vargs)
+#define WarningN(s, vargs...) CRTDebugCall()->printf(INC_WARNING, INFO_MODULE, __FILE__, __LINE__, false, s, ## vargs)
+#define ErrorN(s, vargs...)   CRTDebugCall()->printf(INC_ERROR, INFO_MODULE, __FILE__, __LINE__, false, s, ## vargs)
+#define FatalN(s, vargs...)   CRTDebugCall()->printf(INC_FATAL, INFO_MODULE, __FILE__, __LINE__, false, s, ## vargs)
+#define DebugN(s, vargs...)   CRTDebugCall()->printf(INC_DEBUG, INFO_MODULE, __FILE__, __LINE__, false, s, ## vargs)
 
 #else // DEBUG
 
@@ -160,29 +221,35 @@
 #define SHOWMSG(m)          (void(0))
 #define STARTCLOCK(s)       (void(0))
 #define STOPCLOCK(s)        (void(0))
+#define FLOW_SEND(s)        (void(0))
+#define FLOW_RECV(s)        ((void)CRTDebug::attachSpan(s))
 #define D(s, vargs...)      (void(0))
 #define E(s, vargs...)      (void(0))
 #define W(s, vargs...)      (void(0))
 #define DN(s, vargs...)     (void(0))
 #define EN(s, vargs...)     (void(0))
 #define WN(s, vargs...)     (void(0))
+#define V(l, s, vargs...)   (void(0))
+#define RTCOUNT(name, n)    (void(0))
+#define RTGAUGE(name, v)    (void(0))
+#define RTMAX(name, v)      (void(0))
 #define ASSERT(expression)  (void(0))
 
 // define some information messages which will also be compiled in no matter
 // if there is debug mode enabled or not
-#define Info(s, vargs...)    CRTDebug::instance()->printf(INC_INFO, INFO_MODULE, 0, 0, true, s, ## vargs)
-#define Verbose(s, vargs...) CRTDebug::instance()->printf(INC_VERBOSE, INFO_MODULE, 0, 0, true, s, ## vargs)
-#define Warning(s, vargs...) CRTDebug::instance()->printf(INC_WARNING, INFO_MODULE, 0, 0, true, s, ## vargs)
-#define Error(s, vargs...)   CRTDebug::instance()->printf(INC_ERROR, INFO_MODULE, 0, 0, true, s, ## vargs)
-#define Fatal(s, vargs...)   CRTDebug::instance()->printf(INC_FATAL, INFO_MODULE, 0, 0, true, s, ## vargs)
-#define Debug(s, vargs...)   CRTDebug::instance()->printf(INC_DEBUG, INFO_MODULE, 0, 0, true, s, ## vargs)
-
-#define InfoN(s, vargs...)    CRTDebug::instance()->printf(INC_INFO, INFO_MODULE, 0, 0, false, s, ## vargs)
-#define VerboseN(s, vargs...) CRTDebug::instance()->printf(INC_VERBOSE, INFO_MODULE, 0, 0, false, s, ## vargs)
-#define WarningN(s, vargs...) CRTDebug::instance()->printf(INC_WARNING, INFO_MODULE, 0, 0, false, s, ## vargs)
-#define ErrorN(s, vargs...)   CRTDebug::instance()->printf(INC_ERROR, INFO_MODULE, 0, 0, false, s, ## vargs)
-#define FatalN(s, vargs...)   CRTDebug::instance()->printf(INC_FATAL, INFO_MODULE, 0, 0, false, s, ## vargs)
-#define DebugN(s, vargs...)   CRTDebug::instance()->printf(INC_DEBUG, INFO_MODULE, 0, 0, false, s, ## vargs)
+#define Info(s, vargs...)    CRTDebugCall()->printf(INC_INFO, INFO_MODULE, 0, 0, true, s, ## vargs)
+#define Verbose(s, vargs...) CRTDebugCall()->printf(INC_VERBOSE, INFO_MODULE, 0, 0, true, s, ## vargs)
+#define Warning(s, vargs...) CRTDebugCall()->printf(INC_WARNING, INFO_MODULE, 0, 0, true, s, ## vargs)
+#define Error(s, vargs...)   CRTDebugCall()->printf(INC_ERROR, INFO_MODULE, 0, 0, true, s, ## vargs)
+#define Fatal(s, vargs...)   CRTDebugCall()->printf(INC_FATAL, INFO_MODULE, 0, 0, true, s, ## vargs)
+#define Debug(s, vargs...)   CRTDebugCall()->printf(INC_DEBUG, INFO_MODULE, 0, 0, true, s, ## vargs)
+
+#define InfoN(s, vargs...)    CRTDebugCall()->printf(INC_INFO, INFO_MODULE, 0, 0, false, s, ## vargs)
+#define VerboseN(s, vargs...) CRTDebugCall()->printf(INC_VERBOSE, INFO_MODULE, 0, 0, false, s, ## vargs)
+#define WarningN(s, vargs...) CRTDebugCall()->printf(INC_WARNING, INFO_MODULE, 0, 0, false, s, ## vargs)
+#define ErrorN(s, vargs...)   CRTDebugCall()->printf(INC_ERROR, INFO_MODULE, 0, 0, false, s, ## vargs)
+#define FatalN(s, vargs...)   CRTDebugCall()->printf(INC_FATAL, INFO_MODULE, 0, 0, false, s, ## vargs)
+#define DebugN(s, vargs...)   CRTDebugCall()->printf(INC_DEBUG, INFO_MODULE, 0, 0, false, s, ## vargs)
 
 #endif // DEBUG
 
@@ -0,0 +1,143 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+
+/*
+ * helper functions shared by the tests
+ *
+ * Every test is a small program which configures the library like an
+ * application would (mostly through the environment variable passed to
+ * CRTDebug::init()), writes its records to trace files in the current
+ * directory and checks their content. Failed checks are reported with
+ * their source line and make the program exit with a non-zero status.
+ */
+
+#ifndef RTDEBUG_TEST_H
+#define RTDEBUG_TEST_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <sys/wait.h>
+
+#include <rtdebug.h>
+
+// the number of failed checks
+static int testFailures = 0;
+
+// reports a failed check without aborting the test
+#define CHECK(condition)                                                      \
+  ((condition) ? (void)0 :                                                    \
+   (void)(fprintf(stderr, "%s:%d: check '%s' failed\n", __FILE__, __LINE__, #condition), \
+          testFailures++))
+
+// configures the library like the environment variable of an application
+static inline void testInit(const char* spec)
+{
+  setenv("RTDEBUG_TEST", spec, 1);
+  CRTDebug::init("RTDEBUG_TEST");
+}
+
+// returns the content of a file or an empty string
+static inline std::string readFile(const char* filename)
+{
+  std::string content;
+  FILE* fh = fopen(filename, "rb");
+  if(fh == NULL)
+    return content;
+
+  char buf[4096];
+  size_t len;
+  while((len = fread(buf, 1, sizeof(buf), fh)) > 0)
+    content.append(buf, len);
+
+  fclose(fh);
+
+  return content;
+}
+
+// splits a text into its lines
+static inline std::vector<std::string> splitLines(const std::string& text)
+{
+  std::vector<std::string> lines;
+  size_t start = 0;
+
+  while(start < text.size())
+  {
+    size_t end = text.find('\n', start);
+    if(end == std::string::npos)
+      end = text.size();
+
+    lines.push_back(text.substr(start, end-start));
+    start = end+1;
+  }
+
+  return lines;
+}
+
+// returns the number of lines containing a string
+static inline size_t countLines(const std::string& text, const char* needle)
+{
+  std::vector<std::string> lines = splitLines(text);
+  size_t count = 0;
+
+  for(size_t i=0; i < lines.size(); i++)
+  {
+    if(lines[i].find(needle) != std::string::npos)
+      count++;
+  }
+
+  return count;
+}
+
+// runs a shell command and returns its exit status and standard output
+static inline int runCommand(const std::string& command, std::string* output=NULL)
+{
+  FILE* fh = popen(command.c_str(), "r");
+  if(fh == NULL)
+    return -1;
+
+  char buf[4096];
+  size_t len;
+  while((len = fread(buf, 1, sizeof(buf), fh)) > 0)
+  {
+    if(output != NULL)
+      output->append(buf, len);
+  }
+
+  int status = pclose(fh);
+
+  return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+// reports the result of a test and returns its exit status
+static inline int testResult(const char* name)
+{
+  if(testFailures > 0)
+    fprintf(stderr, "%s: %d checks failed\n", name, testFailures);
+
+  return testFailures > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+#endif // RTDEBUG_TEST_H
@@ -0,0 +1,207 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+
+/*
+ * test-async - the overload policies of the asynchronous output
+ *
+ * Fills the queue of a CRTDebugAsyncSink while its writer thread is stuck
+ * in a stalled sink and checks what each overload policy does with the
+ * records which don't fit anymore. Every record has to be either written
+ * or counted as dropped, and the losses are reported in the output.
+ */
+
+#include "rtdebug-test.h"
+#include "CRTDebugAsync.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+#define RECORDS 20
+
+// a sink which doesn't return from write() until it is opened
+class StalledSink : public CRTDebugSink
+{
+  public:
+    StalledSink() : m_bOpen(false), m_bEntered(false) {}
+
+    bool write(const CRTDebugRecordInfo&, const char* data, const size_t len)
+    {
+      std::unique_lock<std::mutex> lock(m_Mutex);
+
+      m_bEntered = true;
+      m_Cond.notify_all();
+      while(m_bOpen == false)
+        m_Cond.wait(lock);
+
+      m_Records.push_back(std::string(data, len));
+
+      return true;
+    }
+
+    void waitEntered()
+    {
+      std::unique_lock<std::mutex> lock(m_Mutex);
+      while(m_bEntered == false)
+        m_Cond.wait(lock);
+    }
+
+    void open()
+    {
+      std::lock_guard<std::mutex> lock(m_Mutex);
+      m_bOpen = true;
+      m_Cond.notify_all();
+    }
+
+  public:
+    std::vector<std::string> m_Records;
+
+  private:
+    std::mutex              m_Mutex;
+    std::condition_variable m_Cond;
+    bool                    m_bOpen;
+    bool                    m_bEntered;
+};
+
+struct Overload
+{
+  unsigned int              accepted;   // records write() accepted
+  unsigned long long        dropped;    // records counted as dropped
+  std::vector<std::string>  records;    // records written to the sink
+  long long                 firstWait;  // duration of the first rejected write() (ms)
+  long long                 otherWaits; // duration of all later rejected ones (ms)
+};
+
+static bool queue(CRTDebugAsyncSink* async, const unsigned int cls, const std::string& record)
+{
+  CRTDebugRecordInfo info;
+  info.cls = cls;
+
+  return async->write(info, record.c_str(), record.length());
+}
+
+// queues RECORDS records of a class behind a stalled one
+static Overload overload(const unsigned int cls, const int policy, const unsigned int rate)
+{
+  Overload result;
+  result.accepted = 0;
+  result.firstWait = -1;
+  result.otherWaits = 0;
+
+  StalledSink* sink = new StalledSink();
+  CRTDebugAsyncSink* async = new CRTDebugAsyncSink(sink, 1024, 200);
+
+  CRTDebugOverloadPolicy overloadPolicy = { policy, rate };
+  async->setPolicy(cls, overloadPolicy);
+
+  queue(async, cls, "first\n");
+  sink->waitEntered();
+
+  for(int i=0; i < RECORDS; i++)
+  {
+    char record[128];
+    snprintf(record, sizeof(record), "record %02d %80s\n", i, "");
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    bool accepted = queue(async, cls, record);
+    long long elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+    if(accepted == true)
+      result.accepted++;
+    else if(result.firstWait < 0)
+      result.firstWait = elapsed;
+    else
+      result.otherWaits += elapsed;
+  }
+
+  unsigned long long records[ASYNC_CLASSES];
+  unsigned long long dropped[ASYNC_CLASSES];
+  async->counts(records, dropped);
+  result.dropped = dropped[__builtin_ctz(cls)];
+
+  sink->open();
+  async->release();
+  delete async;
+
+  result.records = sink->m_Records;
+  delete sink;
+
+  return result;
+}
+
+// returns the number of written records with a prefix
+static size_t written(const Overload& result, const char* prefix)
+{
+  size_t count = 0;
+  for(size_t i=0; i < result.records.size(); i++)
+  {
+    if(result.records[i].compare(0, strlen(prefix), prefix) == 0)
+      count++;
+  }
+
+  return count;
+}
+
+static bool hasRecord(const Overload& result, const int i)
+{
+  char prefix[16];
+  snprintf(prefix, sizeof(prefix), "record %02d ", i);
+
+  return written(result, prefix) == 1;
+}
+
+int main()
+{
+  // the newest records are dropped once the queue is full
+  Overload newest = overload(DBC_DEBUG, DBP_DROPNEWEST, 1);
+  CHECK(newest.accepted > 0 && newest.accepted < RECORDS);
+  CHECK(newest.dropped == RECORDS - newest.accepted);
+  CHECK(written(newest, "record ") == newest.accepted);
+  CHECK(hasRecord(newest, 0) == true);
+  CHECK(hasRecord(newest, RECORDS-1) == false);
+  CHECK(written(newest, "*** rtdebug: ") == 1);
+  CHECK(countLines(newest.records.back(), "records dropped (debug ") == 1);
+
+  // the oldest records make room for the new ones
+  Overload oldest = overload(DBC_DEBUG, DBP_DROPOLDEST, 1);
+  CHECK(oldest.accepted == RECORDS);
+  CHECK(oldest.dropped + written(oldest, "record ") == RECORDS);
+  CHECK(hasRecord(oldest, 0) == false);
+  CHECK(hasRecord(oldest, RECORDS-1) == true);
+
+  // only every 4th record of the overload is kept
+  Overload sample = overload(DBC_DEBUG, DBP_SAMPLE, 4);
+  unsigned int overflow = RECORDS - newest.accepted;
+  CHECK(sample.accepted == newest.accepted + overflow/4);
+  CHECK(sample.dropped + written(sample, "record ") == RECORDS);
+
+  // a blocking record waits at most once for the maximum wait, later ones
+  // are dropped right away until the queue has drained
+  Overload block = overload(DBC_ERROR, DBP_BLOCK, 1);
+  CHECK(block.accepted == newest.accepted);
+  CHECK(block.dropped == RECORDS - block.accepted);
+  CHECK(block.firstWait >= 150);
+  CHECK(block.otherWaits < 1000);
+  CHECK(countLines(block.records.back(), "records dropped (error ") == 1);
+
+  return testResult("test-async");
+}
@@ -0,0 +1,126 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+
+/*
+ * test-columns - the round trip of columnar trace files
+ *
+ * Writes more records than fit into a single row group with the 'columns'
+ * token and reads them back with CRTDebugColumnReader, checking that every
+ * column decodes to the values of the original records.
+ */
+
+#define DEBUG_MODULE "net"
+#include "rtdebug-test.h"
+#include "CRTDebugColumns.h"
+
+#define RECORDS (COLUMNFILE_ROWGROUP + 1000)
+
+static int netRecord(const int i)
+{
+  D("value %d", i);
+  return __LINE__-1;
+}
+
+#undef DEBUG_MODULE
+#define DEBUG_MODULE "disk"
+
+static void work()
+{
+  ENTER();
+  LEAVE();
+}
+
+int main()
+{
+  remove("test-columns.col");
+  testInit("@all,columns,>test-columns.col");
+
+  int line = 0;
+  for(int i=0; i < RECORDS; i++)
+    line = netRecord(i);
+
+  work();
+
+  CRTDebug::destroy();
+
+  CRTDebugColumnReader reader;
+  CHECK(CRTDebugColumnReader::isColumnFile("test-columns.col") == true);
+  CHECK(reader.open("test-columns.col") == true);
+  CHECK(reader.rowGroups() >= 2);
+
+  std::vector<std::string> messages, files, modules, formats, functions;
+  std::vector<unsigned long long> times, lines, classes;
+  for(size_t g=0; g < reader.rowGroups(); g++)
+  {
+    std::vector<std::string> strings;
+    std::vector<unsigned long long> values;
+
+    CHECK(reader.readStrings(g, COLUMN_MESSAGE, strings) == true);
+    CHECK(strings.size() == reader.rowGroup(g).rows);
+    messages.insert(messages.end(), strings.begin(), strings.end());
+    CHECK(reader.readStrings(g, COLUMN_FILE, strings) == true);
+    files.insert(files.end(), strings.begin(), strings.end());
+    CHECK(reader.readStrings(g, COLUMN_MODULE, strings) == true);
+    modules.insert(modules.end(), strings.begin(), strings.end());
+    CHECK(reader.readStrings(g, COLUMN_FORMAT, strings) == true);
+    formats.insert(formats.end(), strings.begin(), strings.end());
+    CHECK(reader.readStrings(g, COLUMN_FUNCTION, strings) == true);
+    functions.insert(functions.end(), strings.begin(), strings.end());
+
+    CHECK(reader.readValues(g, COLUMN_TIME, values) == true);
+    times.insert(times.end(), values.begin(), values.end());
+    CHECK(reader.readValues(g, COLUMN_LINE, values) == true);
+    lines.insert(lines.end(), values.begin(), values.end());
+    CHECK(reader.readValues(g, COLUMN_CLASS, values) == true);
+    classes.insert(classes.end(), values.begin(), values.end());
+  }
+
+  CHECK(messages.size() == RECORDS+2);
+  if(messages.size() != RECORDS+2 || files.size() != messages.size() ||
+     modules.size() != messages.size() || formats.size() != messages.size() ||
+     functions.size() != messages.size() || times.size() != messages.size() ||
+     lines.size() != messages.size() || classes.size() != messages.size())
+  {
+    return testResult("test-columns");
+  }
+
+  int mismatches = 0;
+  for(int i=0; i < RECORDS; i++)
+  {
+    if(messages[i] != "value " + std::to_string(i) || formats[i] != "value %d" ||
+       modules[i] != "net" || lines[i] != (unsigned long long)line ||
+       classes[i] != DBC_DEBUG || (i > 0 && times[i] < times[i-1]) ||
+       files[i].find("test-columns.cpp") == std::string::npos)
+    {
+      mismatches++;
+    }
+  }
+  CHECK(mismatches == 0);
+
+  CHECK(messages[RECORDS] == "Entering work()");
+  CHECK(messages[RECORDS+1] == "Leaving work()");
+  CHECK(functions[RECORDS] == "work" && functions[RECORDS+1] == "work");
+  CHECK(modules[RECORDS] == "disk");
+  CHECK(classes[RECORDS] == DBC_CTRACE);
+
+  return testResult("test-columns");
+}
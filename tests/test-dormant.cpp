@@ -0,0 +1,84 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+
+/*
+ * test-dormant - the calls after destroy()
+ *
+ * Runs two init()/destroy() cycles with a shown debug module and checks
+ * that every cycle only writes its own records and that the calls taken
+ * by the dormant instance after destroy() output nothing, even after they
+ * tried to change its configuration.
+ */
+
+#define DEBUG_MODULE "net"
+#include "rtdebug-test.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+int main()
+{
+  // the dormant instance writes to stderr
+  remove("test-dormant.err");
+  int fd = open("test-dormant.err", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  CHECK(fd >= 0);
+  int saved = dup(STDERR_FILENO);
+  dup2(fd, STDERR_FILENO);
+  close(fd);
+
+  remove("test-dormant-1.log");
+  testInit("@all,!%all,%net,>test-dormant-1.log");
+  D("first cycle");
+  CRTDebug::destroy();
+  D("late first");
+
+  remove("test-dormant-2.log");
+  testInit("@all,!%all,%net,>test-dormant-2.log");
+  D("second cycle");
+  CRTDebug::destroy();
+  D("late second");
+  E("late error");
+  SHOWVALUE(fd);
+
+  CRTDebug::instance()->setDebugClass(DBC_ALL);
+  CRTDebug::instance()->setDebugModule("net", true);
+  D("late configured");
+
+  fflush(stderr);
+  dup2(saved, STDERR_FILENO);
+  close(saved);
+
+  std::string first = readFile("test-dormant-1.log");
+  std::string second = readFile("test-dormant-2.log");
+  std::string err = readFile("test-dormant.err");
+
+  CHECK(countLines(first, ":first cycle") == 1);
+  CHECK(countLines(first, ":second cycle") == 0);
+  CHECK(countLines(second, ":second cycle") == 1);
+  CHECK(countLines(second, ":first cycle") == 0);
+
+  std::string all = first + second + err;
+  CHECK(countLines(all, "late") == 0);
+  CHECK(countLines(all, "fd = ") == 0);
+
+  return testResult("test-dormant");
+}
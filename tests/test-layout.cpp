@@ -0,0 +1,93 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+
+/*
+ * test-layout - the configurable layout of the record header
+ *
+ * Checks that layout patterns are rendered as configured, that invalid
+ * patterns are rejected without changing the layout and that changing the
+ * layout doesn't wait for a thread which logs continuously.
+ */
+
+#include "rtdebug-test.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+int main()
+{
+  remove("test-layout.log");
+  testInit("@all,>test-layout.log");
+
+  CRTDebug* rtdebug = CRTDebug::instance();
+
+  CHECK(rtdebug->setLayout("<%m>") == true);
+  CHECK(strcmp(rtdebug->layout(), "<%m>") == 0);
+  D("plain record");
+
+  CHECK(rtdebug->setLayout("%l|%m|%%") == true);
+  int line = __LINE__; D("line record");
+
+  // invalid patterns keep the current layout
+  CHECK(rtdebug->setLayout("%{nocolor}%m") == false);
+  CHECK(rtdebug->setLayout("%m%m") == false);
+  CHECK(rtdebug->setLayout("%{green") == false);
+  CHECK(strcmp(rtdebug->layout(), "%l|%m|%%") == 0);
+
+  CHECK(rtdebug->setLayout(NULL) == true);
+  D("default record");
+
+  // another thread logs all the time the layout is changed
+  std::atomic<bool> stop(false);
+  std::thread writer([&stop] { while(stop == false) D("busy record"); });
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for(int i=0; i < 100; i++)
+    rtdebug->setLayout(i % 2 == 0 ? "%t %m" : NULL);
+
+  long long elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+  CHECK(elapsed < 5000);
+
+  stop = true;
+  writer.join();
+
+  CRTDebug::destroy();
+
+  std::vector<std::string> lines = splitLines(readFile("test-layout.log"));
+  std::vector<std::string> records;
+  for(size_t i=0; i < lines.size(); i++)
+  {
+    if(lines[i].find("busy record") == std::string::npos)
+      records.push_back(lines[i]);
+  }
+
+  CHECK(records.size() == 3);
+  if(records.size() == 3)
+  {
+    CHECK(records[0] == "<plain record>");
+    CHECK(records[1] == std::to_string(line) + "|line record|%");
+    CHECK(records[2][0] == '[' && records[2].find("test-layout.cpp:") != std::string::npos);
+  }
+
+  return testResult("test-layout");
+}
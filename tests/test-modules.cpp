@@ -0,0 +1,140 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+
+/*
+ * test-modules - the hierarchical module namespace and the verbosity levels
+ *
+ * Checks that the configuration of a dotted module name applies to all of
+ * its sub-modules unless they are configured differently, that V() compares
+ * against the inherited verbosity level, that changes at runtime reach call
+ * sites which already cached their module node and that the debug macros
+ * can still be used as expressions.
+ */
+
+#define DEBUG_MODULE "net"
+#include "rtdebug-test.h"
+
+static void netRecords()
+{
+  D("net record");
+}
+
+#undef DEBUG_MODULE
+#define DEBUG_MODULE "net.http"
+
+static void httpRecords()
+{
+  D("net.http record");
+  V(1, "net.http verbose 1");
+  V(3, "net.http verbose 3");
+}
+
+#undef DEBUG_MODULE
+#define DEBUG_MODULE "net.tls"
+
+static void tlsRecords(const int pass)
+{
+  D("net.tls record %d", pass);
+}
+
+#undef DEBUG_MODULE
+#define DEBUG_MODULE "disk"
+
+static void diskRecords()
+{
+  D("disk record");
+}
+
+// a module name which changes at runtime
+static const char* currentModule = "net.tls";
+
+#undef DEBUG_MODULE
+#define DEBUG_MODULE currentModule
+
+static void runtimeRecords(const int pass)
+{
+  D("runtime module record %d", pass);
+}
+
+#undef DEBUG_MODULE
+#define DEBUG_MODULE "net"
+
+static int expressionRecords(const int value)
+{
+  // the macros are expressions returning a std::ostream&
+  std::ostream& stream = D("expression record");
+  (void)stream;
+
+  int result = (D("comma record"), value);
+
+  if(value > 0)
+    D("if branch record");
+  else
+    D("else branch record");
+
+  return result;
+}
+
+int main()
+{
+  remove("test-modules.log");
+  testInit("@all,!%all,%net=2,!%net.tls,>test-modules.log");
+
+  for(int pass=0; pass < 2; pass++)
+  {
+    netRecords();
+    httpRecords();
+    tlsRecords(pass);
+    diskRecords();
+    runtimeRecords(pass);
+
+    // the second pass runs with a changed configuration and module name
+    CRTDebug::instance()->setDebugModule("net.tls", true);
+    currentModule = "disk";
+  }
+
+  currentModule = "net";
+  runtimeRecords(2);
+
+  CHECK(expressionRecords(1) == 1);
+
+  CRTDebug::destroy();
+
+  std::string trace = readFile("test-modules.log");
+
+  CHECK(countLines(trace, ":net record") == 2);
+  CHECK(countLines(trace, ":net.http record") == 2);
+  CHECK(countLines(trace, ":net.http verbose 1") == 2);
+  CHECK(countLines(trace, ":net.http verbose 3") == 0);
+  CHECK(countLines(trace, ":net.tls record 0") == 0);
+  CHECK(countLines(trace, ":net.tls record 1") == 1);
+  CHECK(countLines(trace, ":disk record") == 0);
+  CHECK(countLines(trace, ":runtime module record 0") == 0);
+  CHECK(countLines(trace, ":runtime module record 1") == 0);
+  CHECK(countLines(trace, ":runtime module record 2") == 1);
+  CHECK(countLines(trace, ":expression record") == 1);
+  CHECK(countLines(trace, ":comma record") == 1);
+  CHECK(countLines(trace, ":if branch record") == 1);
+  CHECK(countLines(trace, ":else branch record") == 0);
+
+  return testResult("test-modules");
+}
@@ -0,0 +1,135 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+
+/*
+ * test-perthread - the per-thread trace files and their merge
+ *
+ * Lets some threads trace into their own files with the 'perthread' token
+ * and merges them with rtdebug-merge (passed as first argument), checking
+ * that every record shows up once, in the order of its thread and sorted
+ * by time.
+ */
+
+#include "rtdebug-test.h"
+
+#include <glob.h>
+#include <thread>
+
+#define THREADS 4
+#define RECORDS 500
+
+static void worker(const int thread)
+{
+  for(int i=0; i < RECORDS; i++)
+    D("thread %d record %d", thread, i);
+}
+
+// returns the time of day of a record in microseconds or -1
+static long long recordTime(const std::string& line)
+{
+  unsigned int h, m, s, us;
+  if(sscanf(line.c_str(), "[%u:%u:%u.%u]", &h, &m, &s, &us) != 4)
+    return -1;
+
+  return ((h*60LL + m)*60LL + s)*1000000LL + us;
+}
+
+int main(int argc, char* argv[])
+{
+  if(argc < 2)
+  {
+    fprintf(stderr, "usage: %s rtdebug-merge\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  glob_t files;
+  if(glob("test-perthread.*.*.*", 0, NULL, &files) == 0)
+  {
+    for(size_t i=0; i < files.gl_pathc; i++)
+      remove(files.gl_pathv[i]);
+    globfree(&files);
+  }
+
+  testInit("@all,perthread=test-perthread,>test-perthread.log");
+
+  std::vector<std::thread> threads;
+  for(int t=0; t < THREADS; t++)
+    threads.push_back(std::thread(worker, t));
+  for(int t=0; t < THREADS; t++)
+    threads[t].join();
+
+  CRTDebug::destroy();
+
+  std::string command = argv[1];
+  size_t inputs = 0;
+  if(glob("test-perthread.*.*.*", 0, NULL, &files) == 0)
+  {
+    for(size_t i=0; i < files.gl_pathc; i++)
+    {
+      command += ' ';
+      command += files.gl_pathv[i];
+    }
+    inputs = files.gl_pathc;
+    globfree(&files);
+  }
+  CHECK(inputs >= THREADS);
+
+  std::string output;
+  CHECK(runCommand(command, &output) == 0);
+
+  std::vector<std::string> lines = splitLines(output);
+  int next[THREADS] = { 0 };
+  long long last = -1;
+  size_t records = 0;
+  size_t unordered = 0;
+  size_t unsorted = 0;
+  for(size_t i=0; i < lines.size(); i++)
+  {
+    size_t pos = lines[i].find("thread ");
+    int thread, record;
+    if(pos == std::string::npos || lines[i].find("record ", pos) == std::string::npos ||
+       sscanf(lines[i].c_str() + pos, "thread %d record %d", &thread, &record) != 2 ||
+       thread < 0 || thread >= THREADS)
+    {
+      continue;
+    }
+
+    records++;
+    if(record != next[thread])
+      unordered++;
+    next[thread] = record+1;
+
+    // a time of day jumping back by more than 12 hours is midnight
+    long long time = recordTime(lines[i]);
+    if(time < 0 || (time < last && last - time < 43200LL*1000000LL))
+      unsorted++;
+    last = time;
+  }
+
+  CHECK(records == THREADS*RECORDS);
+  CHECK(unordered == 0);
+  CHECK(unsorted == 0);
+  for(int t=0; t < THREADS; t++)
+    CHECK(next[t] == RECORDS);
+
+  return testResult("test-perthread");
+}
@@ -0,0 +1,117 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+
+/*
+ * test-profile - the profile files and their comparison
+ *
+ * Checks the profile the 'profile' token writes for a traced function and
+ * the exit status of rtdebug-diff (passed as first argument) for profiles
+ * with and without a regression, including a limit below the threshold.
+ */
+
+#include "rtdebug-test.h"
+
+static void work()
+{
+  ENTER();
+  LEAVE();
+}
+
+// writes a profile with a single function of the given statistics
+static void writeProfile(const char* filename, const double mean, const double stddev)
+{
+  FILE* fh = fopen(filename, "w");
+  if(fh == NULL)
+    return;
+
+  fprintf(fh, "# rtdebug profile 1\n");
+  fprintf(fh, "kind\tname\tcount\ttotal_ns\tmean_ns\tstddev_ns\tmin_ns\tp50_ns\tp90_ns\tp99_ns\tmax_ns\n");
+  fprintf(fh, "function\ttest.cpp:work\t100\t%.0f\t%.0f\t%.0f\t%.0f\t%.0f\t%.0f\t%.0f\t%.0f\n",
+          mean*100, mean, stddev, mean/2, mean, mean*1.5, mean*2, mean*2);
+  fclose(fh);
+}
+
+// runs rtdebug-diff with some options on two profiles
+static int diff(const char* tool, const char* options, const char* a, const char* b)
+{
+  return runCommand(std::string(tool) + ' ' + options + ' ' + a + ' ' + b + " 2>/dev/null");
+}
+
+int main(int argc, char* argv[])
+{
+  if(argc < 2)
+  {
+    fprintf(stderr, "usage: %s rtdebug-diff\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  const char* tool = argv[1];
+
+  remove("test-profile.prof");
+  testInit("@all,profile=test-profile.prof,>test-profile.log");
+
+  for(int i=0; i < 20; i++)
+    work();
+
+  CRTDebug::destroy();
+
+  std::vector<std::string> lines = splitLines(readFile("test-profile.prof"));
+  CHECK(lines.size() >= 3);
+  CHECK(lines.empty() == false && lines[0] == "# rtdebug profile 1");
+
+  bool header = false;
+  bool found = false;
+  for(size_t i=0; i < lines.size(); i++)
+  {
+    if(lines[i].find("kind\tname\tcount\ttotal_ns\t") == 0)
+      header = true;
+    else if(header == true && lines[i].find("function\t") == 0 &&
+            lines[i].find(":work\t20\t") != std::string::npos)
+    {
+      found = true;
+    }
+  }
+  CHECK(header == true);
+  CHECK(found == true);
+
+  // a profile compared to itself has no regressions
+  CHECK(diff(tool, "-c 1", "test-profile.prof", "test-profile.prof") == 0);
+
+  writeProfile("test-profile-base.prof", 1000, 10);
+  writeProfile("test-profile-slow.prof", 1300, 10);
+  writeProfile("test-profile-noisy.prof", 1300, 10000);
+
+  CHECK(diff(tool, "", "test-profile-base.prof", "test-profile-base.prof") == 0);
+  CHECK(diff(tool, "", "test-profile-base.prof", "test-profile-slow.prof") == 1);
+  CHECK(diff(tool, "-l 50", "test-profile-base.prof", "test-profile-slow.prof") == 0);
+  CHECK(diff(tool, "", "test-profile-slow.prof", "test-profile-base.prof") == 0);
+
+  // a change of the mean within the variance is no regression
+  CHECK(diff(tool, "", "test-profile-base.prof", "test-profile-noisy.prof") == 0);
+  CHECK(diff(tool, "-m p50", "test-profile-base.prof", "test-profile-noisy.prof") == 1);
+
+  // a limit below the threshold is a usage error
+  CHECK(diff(tool, "-t 10 -l 5", "test-profile-base.prof", "test-profile-slow.prof") == 2);
+  CHECK(diff(tool, "", "test-profile-base.prof", "test-profile.log") == 2);
+
+  return testResult("test-profile");
+}
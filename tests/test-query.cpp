@@ -0,0 +1,89 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+
+/*
+ * test-query - the summary of rtdebug-query
+ *
+ * Traces calls of different durations and checks that the summary of
+ * rtdebug-query (passed as first argument) lists the longest of them
+ * sorted by their duration, also after the list was cut down to the top
+ * calls while reading the records.
+ */
+
+#include "rtdebug-test.h"
+
+#include <unistd.h>
+
+// the calls are cut down to the TOP longest every TOP*4 calls, so that
+// exactly TOP unordered calls are left at the end
+#define CALLS 39
+#define TOP   3
+
+static void work(const int usec)
+{
+  ENTER();
+  usleep(usec);
+  LEAVE();
+}
+
+int main(int argc, char* argv[])
+{
+  if(argc < 2)
+  {
+    fprintf(stderr, "usage: %s rtdebug-query\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  remove("test-query.log");
+  testInit("@all,>test-query.log");
+
+  // the durations are shuffled, the longest call takes at least 3.9ms
+  for(int i=0; i < CALLS; i++)
+    work(100 + (i*7 % CALLS)*100);
+
+  CRTDebug::destroy();
+
+  std::string output;
+  std::string command = std::string(argv[1]) + " -s -n " + std::to_string(TOP) + " test-query.log";
+  CHECK(runCommand(command, &output) == 0);
+
+  std::vector<std::string> lines = splitLines(output);
+  std::vector<unsigned long long> longest;
+  bool section = false;
+  for(size_t i=0; i < lines.size(); i++)
+  {
+    unsigned long long usec;
+    if(lines[i] == "longest calls:")
+      section = true;
+    else if(section == true && sscanf(lines[i].c_str(), "%llu us", &usec) == 1)
+      longest.push_back(usec);
+    else if(section == true)
+      break;
+  }
+
+  CHECK(longest.size() == TOP);
+  CHECK(longest.empty() == false && longest[0] >= 3900);
+  for(size_t i=1; i < longest.size(); i++)
+    CHECK(longest[i-1] >= longest[i]);
+
+  return testResult("test-query");
+}
@@ -0,0 +1,128 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+
+/*
+ * test-values - the type dependent formatting of SHOWVALUE()
+ *
+ * Checks the output of SHOWVALUE() for the different kinds of values and
+ * that the records kept for the lookback are output with the values they
+ * had when the record was suppressed, not with their later ones.
+ */
+
+#include "rtdebug-test.h"
+
+#include <map>
+
+enum Color { RED, GREEN };
+
+struct Point
+{
+  int x;
+  int y;
+};
+
+void rtdebugFormat(CRTDebugOutput& out, const Point& p)
+{
+  out.appendChar('(');
+  out.appendDec(p.x);
+  out.appendChar(',');
+  out.appendDec(p.y);
+  out.appendChar(')');
+}
+
+// returns the message part of the record of a value
+static std::string record(const std::string& text, const char* name)
+{
+  std::string needle = std::string(":") + name + " = ";
+  std::vector<std::string> lines = splitLines(text);
+
+  for(size_t i=0; i < lines.size(); i++)
+  {
+    size_t pos = lines[i].find(needle);
+    if(pos != std::string::npos)
+      return lines[i].substr(pos+1);
+  }
+
+  return std::string();
+}
+
+int main()
+{
+  remove("test-values.log");
+  testInit("@all,>test-values.log");
+
+  long long i = -5;
+  unsigned int u = 7;
+  double d = 3.5;
+  bool b = true;
+  std::string s = "text";
+  Point p = { 1, 2 };
+  std::vector<int> v = { 1, 2, 3 };
+  Color c = GREEN;
+  std::map<int, std::string> m = { { 1, "a" } };
+
+  SHOWVALUE(i);
+  SHOWVALUE(u);
+  SHOWVALUE(d);
+  SHOWVALUE(b);
+  SHOWVALUE(s);
+  SHOWVALUE(p);
+  SHOWVALUE(v);
+  SHOWVALUE(c);
+  SHOWVALUE(m);
+
+  CRTDebug::destroy();
+
+  std::string text = readFile("test-values.log");
+  CHECK(record(text, "i") == "i = -5, 0xfffffffffffffffb");
+  CHECK(record(text, "u") == "u = 7, 0x00000007");
+  CHECK(record(text, "d") == "d = 3.5");
+  CHECK(record(text, "b") == "b = true");
+  CHECK(record(text, "s") == "s = \"text\"");
+  CHECK(record(text, "p") == "p = (1,2)");
+  CHECK(record(text, "v") == "v = [1, 2, 3]");
+  CHECK(record(text, "c") == "c = 1, 0x00000001");
+  CHECK(record(text, "m") == "m = [(1, \"a\")]");
+
+  // the reports are suppressed and only kept for the lookback
+  remove("test-values-lookback.log");
+  testInit("@error,lookback=8,>test-values-lookback.log");
+
+  int count = 1;
+  std::string name = "first";
+  SHOWVALUE(count);
+  SHOWVALUE(name);
+
+  count = 2;
+  name = "second";
+  E("failed");
+
+  CRTDebug::destroy();
+
+  text = readFile("test-values-lookback.log");
+  CHECK(record(text, "count") == "count = 1, 0x00000001");
+  CHECK(record(text, "name") == "name = \"first\"");
+  CHECK(countLines(text, "second") == 0);
+  CHECK(countLines(text, ":failed") == 1);
+
+  return testResult("test-values");
+}
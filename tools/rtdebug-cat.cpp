@@ -0,0 +1,135 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+/*
+ * rtdebug-cat - outputs the content of block compressed trace files
+ *
+ * Usage: rtdebug-cat [-i] [-f from] [-t to] file...
+ *
+ *   -i       list the block index instead of the content
+ *   -f from  skip all blocks ending before this time
+ *   -t to    stop at the first block starting after this time
+ *
+ * Times can either be given as seconds since the epoch (e.g. 1571234567.25)
+ * or as a time of day (HH:MM:SS[.usec]) which is then taken relative to the
+ * day of the first block of the trace file. As the time index of the file is
+ * used to directly seek to the first relevant block, the time window is
+ * applied with block granularity.
+ */
+
+#include "CRTDebugBlockFile.h"
+#include "rtdebug-tools.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include <unistd.h>
+
+static void usage(const char* name)
+{
+  fprintf(stderr, "Usage: %s [-i] [-f from] [-t to] file...\n", name);
+  exit(EXIT_FAILURE);
+}
+
+static void formatTime(char* buf, const size_t len, const unsigned long long time)
+{
+  time_t tt_time = time / 1000000ULL;
+  struct tm tm_time;
+  localtime_r(&tt_time, &tm_time);
+
+  char fmtBuf[20];
+  strftime(fmtBuf, sizeof(fmtBuf), "%F %T", &tm_time);
+  snprintf(buf, len, "%s.%06llu", fmtBuf, time % 1000000ULL);
+}
+
+int main(int argc, char* argv[])
+{
+  const char* from = NULL;
+  const char* to = NULL;
+  bool listIndex = false;
+  int opt;
+
+  while((opt = getopt(argc, argv, "if:t:")) != -1)
+  {
+    switch(opt)
+    {
+      case 'i': listIndex = true; break;
+      case 'f': from = optarg;    break;
+      case 't': to = optarg;      break;
+      default:  usage(argv[0]);
+    }
+  }
+
+  if(optind >= argc)
+    usage(argv[0]);
+
+  int result = EXIT_SUCCESS;
+  for(int i=optind; i < argc; i++)
+  {
+    CRTDebugBlockReader reader;
+    if(reader.open(argv[i]) == false)
+    {
+      fprintf(stderr, "%s: '%s' is not a block compressed trace file\n", argv[0], argv[i]);
+      result = EXIT_FAILURE;
+      continue;
+    }
+
+    if(reader.blocks() == 0)
+      continue;
+
+    unsigned long long reference = reader.block(0).firstTime;
+    unsigned long long fromTime = from != NULL ? parseTime(from, reference) : 0;
+    unsigned long long toTime = to != NULL ? parseTime(to, reference) : ~0ULL;
+
+    std::string data;
+    for(size_t b=reader.findBlock(fromTime); b < reader.blocks(); b++)
+    {
+      const CRTDebugBlockInfo& info = reader.block(b);
+      if(info.firstTime > toTime)
+        break;
+
+      if(listIndex == true)
+      {
+        char first[40];
+        char last[40];
+        formatTime(first, sizeof(first), info.firstTime);
+        formatTime(last, sizeof(last), info.lastTime);
+
+        printf("block %zu: offset %llu, %u bytes, %s - %s, classes 0x%08x, threads 0x%016llx\n",
+               b, info.offset, info.rawSize, first, last, info.classMask, info.threadMask);
+        continue;
+      }
+
+      if(reader.readBlock(b, data) == false)
+      {
+        fprintf(stderr, "%s: '%s' block %zu is corrupt\n", argv[0], argv[i], b);
+        result = EXIT_FAILURE;
+        continue;
+      }
+
+      fwrite(data.data(), 1, data.size(), stdout);
+    }
+  }
+
+  return result;
+}
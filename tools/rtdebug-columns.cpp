@@ -0,0 +1,242 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+/*
+ * rtdebug-columns - outputs selected columns of columnar trace files
+ *
+ * Usage: rtdebug-columns [-i] [-d] [-c columns] [-f from] [-t to] file...
+ *
+ *   -i          list the row group index instead of the content
+ *   -d          list the dictionary instead of the content
+ *   -c columns  comma separated list of the columns to output (default:
+ *               time,thread,class,file,line,function,message)
+ *   -f from     skip all row groups ending before this time
+ *   -t to       stop at the first row group starting after this time
+ *
+ * The rows are output as tab separated values with a header line, so that
+ * they can directly be loaded by spreadsheets or data frame libraries. Only
+ * the requested columns are read and decompressed. Times are output as
+ * seconds since the epoch and can be given the same way or as a time of
+ * day (HH:MM:SS[.usec]) relative to the day of the first row group.
+ */
+
+#include "CRTDebugColumns.h"
+#include "rtdebug-tools.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include <unistd.h>
+
+static const char* columnNames[COLUMN_COUNT] =
+{
+  "time", "thread", "class", "span", "indent", "file", "line",
+  "module", "function", "format", "message", "dictionary"
+};
+
+static void usage(const char* name)
+{
+  fprintf(stderr, "Usage: %s [-i] [-d] [-c columns] [-f from] [-t to] file...\n", name);
+  exit(EXIT_FAILURE);
+}
+
+static bool parseColumns(const char* spec, std::vector<CRTDebugColumn>& columns)
+{
+  std::string list(spec);
+  size_t start = 0;
+
+  while(start <= list.size())
+  {
+    size_t end = list.find(',', start);
+    if(end == std::string::npos)
+      end = list.size();
+
+    std::string name = list.substr(start, end-start);
+    int c;
+    for(c=0; c < COLUMN_DICTIONARY; c++)
+    {
+      if(name == columnNames[c])
+        break;
+    }
+
+    if(c == COLUMN_DICTIONARY)
+    {
+      fprintf(stderr, "unknown column '%s'\n", name.c_str());
+      return false;
+    }
+
+    columns.push_back((CRTDebugColumn)c);
+    start = end+1;
+  }
+
+  return true;
+}
+
+// outputs a string without the characters separating values and rows
+static void printEscaped(const std::string& s)
+{
+  for(size_t i=0; i < s.size(); i++)
+  {
+    switch(s[i])
+    {
+      case '\t': fputs("\\t", stdout);  break;
+      case '\n': fputs("\\n", stdout);  break;
+      case '\\': fputs("\\\\", stdout); break;
+      default:   putchar(s[i]);         break;
+    }
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  const char* from = NULL;
+  const char* to = NULL;
+  bool listIndex = false;
+  bool listDictionary = false;
+  std::vector<CRTDebugColumn> columns;
+  int opt;
+
+  while((opt = getopt(argc, argv, "idc:f:t:")) != -1)
+  {
+    switch(opt)
+    {
+      case 'i': listIndex = true;       break;
+      case 'd': listDictionary = true;  break;
+      case 'f': from = optarg;          break;
+      case 't': to = optarg;            break;
+      case 'c':
+        if(parseColumns(optarg, columns) == false)
+          usage(argv[0]);
+      break;
+      default:  usage(argv[0]);
+    }
+  }
+
+  if(optind >= argc)
+    usage(argv[0]);
+
+  if(columns.empty())
+    parseColumns("time,thread,class,file,line,function,message", columns);
+
+  if(listIndex == false && listDictionary == false)
+  {
+    for(size_t c=0; c < columns.size(); c++)
+      printf("%s%s", c > 0 ? "\t" : "", columnNames[columns[c]]);
+    printf("\n");
+  }
+
+  int result = EXIT_SUCCESS;
+  for(int i=optind; i < argc; i++)
+  {
+    CRTDebugColumnReader reader;
+    if(reader.open(argv[i]) == false)
+    {
+      fprintf(stderr, "%s: '%s' is not a columnar trace file\n", argv[0], argv[i]);
+      result = EXIT_FAILURE;
+      continue;
+    }
+
+    if(listDictionary == true)
+    {
+      for(size_t id=1; id < reader.dictionarySize(); id++)
+      {
+        printf("%zu\t", id);
+        printEscaped(reader.string(id));
+        printf("\n");
+      }
+      continue;
+    }
+
+    if(reader.rowGroups() == 0)
+      continue;
+
+    unsigned long long reference = reader.rowGroup(0).firstTime;
+    unsigned long long fromTime = from != NULL ? parseTime(from, reference) : 0;
+    unsigned long long toTime = to != NULL ? parseTime(to, reference) : ~0ULL;
+
+    std::vector<std::vector<unsigned long long> > values(columns.size());
+    std::vector<std::vector<std::string> > strings(columns.size());
+    for(size_t g=reader.findRowGroup(fromTime); g < reader.rowGroups(); g++)
+    {
+      const CRTDebugRowGroupInfo& info = reader.rowGroup(g);
+      if(info.firstTime > toTime)
+        break;
+
+      if(listIndex == true)
+      {
+        printf("group %zu: offset %llu, %u rows, %llu.%06llu - %llu.%06llu, classes 0x%08x, threads 0x%016llx\n",
+               g, info.offset, info.rows, info.firstTime / 1000000ULL, info.firstTime % 1000000ULL,
+               info.lastTime / 1000000ULL, info.lastTime % 1000000ULL, info.classMask, info.threadMask);
+        continue;
+      }
+
+      // only the requested columns are decoded
+      bool ok = true;
+      for(size_t c=0; c < columns.size() && ok == true; c++)
+      {
+        switch(columns[c])
+        {
+          case COLUMN_FILE:
+          case COLUMN_MODULE:
+          case COLUMN_FUNCTION:
+          case COLUMN_FORMAT:
+          case COLUMN_MESSAGE:
+            ok = reader.readStrings(g, columns[c], strings[c]);
+          break;
+
+          default:
+            ok = reader.readValues(g, columns[c], values[c]);
+          break;
+        }
+      }
+
+      if(ok == false)
+      {
+        fprintf(stderr, "%s: '%s' row group %zu is corrupt\n", argv[0], argv[i], g);
+        result = EXIT_FAILURE;
+        continue;
+      }
+
+      for(unsigned int r=0; r < info.rows; r++)
+      {
+        for(size_t c=0; c < columns.size(); c++)
+        {
+          if(c > 0)
+            putchar('\t');
+
+          if(strings[c].empty() == false)
+            printEscaped(strings[c][r]);
+          else if(columns[c] == COLUMN_TIME)
+            printf("%llu.%06llu", values[c][r] / 1000000ULL, values[c][r] % 1000000ULL);
+          else if(columns[c] == COLUMN_CLASS || columns[c] == COLUMN_SPAN)
+            printf("0x%llx", values[c][r]);
+          else
+            printf("%llu", values[c][r]);
+        }
+        putchar('\n');
+      }
+    }
+  }
+
+  return result;
+}
@@ -0,0 +1,319 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+/*
+ * rtdebug-diff - compares the call and timer profiles of two runs
+ *
+ * Usage: rtdebug-diff [-m metric] [-t percent] [-s score] [-c count]
+ *                     [-l percent] [-n count] base.prof new.prof
+ *
+ *   -m metric   the duration to compare: mean (default), p50, p90, p99,
+ *               max or total. The percentiles are more robust against
+ *               single outliers (e.g. the first call of a thread)
+ *   -t percent  the minimum relative change to report (default 5)
+ *   -s score    the minimum Welch t score of a change of the mean, so that
+ *               noise of functions with a high variance is not reported
+ *               (default 3, only used for the mean)
+ *   -c count    the minimum number of calls in both runs (default 10)
+ *   -l percent  a significant regression of at least this size makes the
+ *               tool exit with status 1 (default 10, not below -t)
+ *   -n count    the number of regressions and improvements to list
+ *               (default 20)
+ *
+ * The profiles are written by librtdebug with the `profile[=file]` token
+ * or CRTDebug::setProfile(). Functions and timers are matched by their
+ * name. The regressions and improvements are ranked by their relative
+ * change, entries found in only one of the profiles are listed below.
+ * The exit status is 0 without regressions beyond the limit, 1 with such
+ * regressions and 2 if the profiles could not be read.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+#include <unistd.h>
+
+// the columns of a profile row following the kind and name
+enum Metric
+{
+  COUNT = 0, TOTAL, MEAN, STDDEV, MIN, P50, P90, P99, MAX, METRICS
+};
+
+struct Entry
+{
+  double values[METRICS];
+};
+
+struct Change
+{
+  std::string key;      // kind and name
+  double      base;     // metric of the base run
+  double      current;  // metric of the new run
+  double      percent;  // relative change
+  double      score;    // Welch t score or 0
+  const Entry* a;
+  const Entry* b;
+};
+
+static void usage(const char* name)
+{
+  fprintf(stderr, "Usage: %s [-m metric] [-t percent] [-s score] [-c count] [-l percent] [-n count] base.prof new.prof\n", name);
+  exit(2);
+}
+
+// loads a profile file into a map of "kind name" to its values
+static bool loadProfile(const char* filename, std::map<std::string, Entry>& entries)
+{
+  FILE* fh = fopen(filename, "r");
+  if(fh == NULL)
+    return false;
+
+  char line[4096];
+  bool header = false;
+  while(fgets(line, sizeof(line), fh) != NULL)
+  {
+    line[strcspn(line, "\r\n")] = '\0';
+    if(line[0] == '#' || line[0] == '\0')
+      continue;
+
+    if(header == false)
+    {
+      header = strncmp(line, "kind\tname\t", 10) == 0;
+      if(header == false)
+        break;
+
+      continue;
+    }
+
+    char* kind = strtok(line, "\t");
+    char* name = strtok(NULL, "\t");
+    if(kind == NULL || name == NULL)
+      continue;
+
+    Entry entry;
+    int i;
+    for(i=0; i < METRICS; i++)
+    {
+      char* value = strtok(NULL, "\t");
+      if(value == NULL)
+        break;
+
+      entry.values[i] = strtod(value, NULL);
+    }
+
+    if(i == METRICS)
+      entries[std::string(kind) + ' ' + name] = entry;
+  }
+
+  fclose(fh);
+  return header;
+}
+
+static void formatDuration(char* buf, const size_t len, const double ns)
+{
+  if(ns < 1000.0)
+    snprintf(buf, len, "%.0fns", ns);
+  else if(ns < 1000000.0)
+    snprintf(buf, len, "%.2fus", ns / 1000.0);
+  else if(ns < 1000000000.0)
+    snprintf(buf, len, "%.2fms", ns / 1000000.0);
+  else
+    snprintf(buf, len, "%.3fs", ns / 1000000000.0);
+}
+
+static void printChanges(const char* title, const std::vector<Change>& changes, const size_t limit)
+{
+  printf("%s (%zu):\n", title, changes.size());
+
+  for(size_t i=0; i < changes.size() && i < limit; i++)
+  {
+    const Change& c = changes[i];
+    char base[32];
+    char current[32];
+    formatDuration(base, sizeof(base), c.base);
+    formatDuration(current, sizeof(current), c.current);
+
+    printf("  %+8.1f%%  %-48s %10s -> %-10s (%.0f/%.0f calls",
+           c.percent, c.key.c_str(), base, current, c.a->values[COUNT], c.b->values[COUNT]);
+    if(c.score != 0.0)
+      printf(", t=%.1f", c.score);
+    printf(")\n");
+  }
+
+  if(changes.size() > limit)
+    printf("  ... %zu more\n", changes.size() - limit);
+}
+
+int main(int argc, char* argv[])
+{
+  static const char* metricNames[METRICS] = { "count", "total", "mean", "stddev", "min", "p50", "p90", "p99", "max" };
+  int metric = MEAN;
+  double threshold = 5.0;
+  double minScore = 3.0;
+  double minCount = 10;
+  double limit = 10.0;
+  size_t listCount = 20;
+  int opt;
+
+  while((opt = getopt(argc, argv, "m:t:s:c:l:n:")) != -1)
+  {
+    switch(opt)
+    {
+      case 'm':
+      {
+        for(metric=0; metric < METRICS; metric++)
+        {
+          if(strcmp(optarg, metricNames[metric]) == 0)
+            break;
+        }
+
+        if(metric != MEAN && metric != TOTAL && metric != P50 && metric != P90 &&
+           metric != P99 && metric != MAX)
+        {
+          usage(argv[0]);
+        }
+      }
+      break;
+
+      case 't': threshold = atof(optarg);  break;
+      case 's': minScore = atof(optarg);   break;
+      case 'c': minCount = atof(optarg);   break;
+      case 'l': limit = atof(optarg);      break;
+      case 'n': listCount = atoi(optarg);  break;
+      default:  usage(argv[0]);
+    }
+  }
+
+  if(argc - optind != 2)
+    usage(argv[0]);
+
+  // changes below the threshold are never looked at, so a lower limit
+  // could not fail for the regressions between both values
+  if(limit < threshold)
+  {
+    fprintf(stderr, "%s: the limit (-l %.1f) must not be below the threshold (-t %.1f)\n", argv[0], limit, threshold);
+    usage(argv[0]);
+  }
+
+  std::map<std::string, Entry> base;
+  std::map<std::string, Entry> current;
+  for(int i=0; i < 2; i++)
+  {
+    if(loadProfile(argv[optind+i], i == 0 ? base : current) == false)
+    {
+      fprintf(stderr, "%s: '%s' is not a rtdebug profile\n", argv[0], argv[optind+i]);
+      return 2;
+    }
+  }
+
+  std::vector<Change> regressions;
+  std::vector<Change> improvements;
+  std::vector<std::string> removed;
+  std::vector<std::string> added;
+  size_t compared = 0;
+  bool failed = false;
+
+  for(std::map<std::string, Entry>::const_iterator it = base.begin(); it != base.end(); ++it)
+  {
+    std::map<std::string, Entry>::const_iterator other = current.find(it->first);
+    if(other == current.end())
+    {
+      removed.push_back(it->first);
+      continue;
+    }
+
+    const Entry& a = it->second;
+    const Entry& b = other->second;
+    if(a.values[COUNT] < minCount || b.values[COUNT] < minCount)
+      continue;
+
+    compared++;
+
+    Change c;
+    c.key = it->first;
+    c.base = a.values[metric];
+    c.current = b.values[metric];
+    c.percent = c.base > 0.0 ? (c.current - c.base) * 100.0 / c.base : (c.current > 0.0 ? 100.0 : 0.0);
+    c.score = 0.0;
+    c.a = &a;
+    c.b = &b;
+
+    if(fabs(c.percent) < threshold)
+      continue;
+
+    // a change of the mean has to stand out of the variance of both runs
+    if(metric == MEAN)
+    {
+      double se = sqrt(a.values[STDDEV]*a.values[STDDEV] / a.values[COUNT] +
+                       b.values[STDDEV]*b.values[STDDEV] / b.values[COUNT]);
+      c.score = se > 0.0 ? (c.current - c.base) / se : (c.current > c.base ? HUGE_VAL : -HUGE_VAL);
+
+      if(fabs(c.score) < minScore)
+        continue;
+    }
+
+    if(c.percent > 0.0)
+    {
+      regressions.push_back(c);
+      if(c.percent >= limit)
+        failed = true;
+    }
+    else
+      improvements.push_back(c);
+  }
+
+  for(std::map<std::string, Entry>::const_iterator it = current.begin(); it != current.end(); ++it)
+  {
+    if(base.find(it->first) == base.end())
+      added.push_back(it->first);
+  }
+
+  std::sort(regressions.begin(), regressions.end(), [](const Change& x, const Change& y) { return x.percent > y.percent; });
+  std::sort(improvements.begin(), improvements.end(), [](const Change& x, const Change& y) { return x.percent < y.percent; });
+
+  printf("compared %zu functions and timers by %s (threshold %.1f%%, limit %.1f%%)\n\n",
+         compared, metricNames[metric], threshold, limit);
+
+  printChanges("regressions", regressions, listCount);
+  printChanges("improvements", improvements, listCount);
+
+  if(removed.empty() == false)
+  {
+    printf("only in %s (%zu):\n", argv[optind], removed.size());
+    for(size_t i=0; i < removed.size() && i < listCount; i++)
+      printf("  %s\n", removed[i].c_str());
+  }
+
+  if(added.empty() == false)
+  {
+    printf("only in %s (%zu):\n", argv[optind+1], added.size());
+    for(size_t i=0; i < added.size() && i < listCount; i++)
+      printf("  %s\n", added[i].c_str());
+  }
+
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,323 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+
+/*
+ * rtdebug-merge - merges per-thread trace files into one interleaved trace
+ *
+ * Usage: rtdebug-merge [-H] file...
+ *
+ *   -H   also output the header lines of the per-thread files
+ *
+ * The per-thread files written with the 'perthread' token (or any other
+ * plain trace files, e.g. the regular output holding the reports) are
+ * memory-mapped and merged by the time of their records, which are expected
+ * in the default layout "[HH:MM:SS.usec] ..." with or without ANSI
+ * highlighting. Continuation lines (e.g. backtraces) stay with their record
+ * and records of the same time keep the order of the files on the command
+ * line. A typical call is "rtdebug-merge trace.<pid>.* >trace".
+ *
+ * As the records only hold the time of day, the date is taken from the
+ * "*** rtdebug thread ... started YYYY-MM-DD ..." line at the start of each
+ * per-thread file (files without it use the earliest date of all files) and
+ * a time of day jumping back by more than 12 hours is taken as midnight.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <queue>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MICROSEC  1000000ULL
+#define DAY       (86400ULL*MICROSEC)
+#define HEADER    "*** rtdebug thread "
+
+// a memory-mapped input file and its current record
+struct Input
+{
+  const char*         data;     //!< the mapped file
+  size_t              size;     //!< the size of the file
+  const char*         pos;      //!< start of the next record
+  const char*         start;    //!< start of the current record
+  const char*         end;      //!< end of the current record
+  unsigned long long  time;     //!< absolute time of the current record
+  unsigned long long  day;      //!< day of the records (days since the epoch)
+  unsigned long long  lastTime; //!< time of day of the last record
+  bool                dated;    //!< the file has a header with a date
+};
+
+// orders the inputs by the time of their current record and by file order
+struct Later
+{
+  const std::vector<Input>& inputs;
+  Later(const std::vector<Input>& in) : inputs(in) {}
+
+  bool operator()(const size_t a, const size_t b) const
+  {
+    if(inputs[a].time != inputs[b].time)
+      return inputs[a].time > inputs[b].time;
+
+    return a > b;
+  }
+};
+
+static void usage(const char* name)
+{
+  fprintf(stderr, "Usage: %s [-H] file...\n", name);
+  exit(EXIT_FAILURE);
+}
+
+static inline void skipEscapes(const char*& p, const char* end)
+{
+  while(p+1 < end && p[0] == '\x1b' && p[1] == '[')
+  {
+    for(p += 2; p < end && *p != 'm'; p++)
+      ;
+
+    if(p < end)
+      p++;
+  }
+}
+
+static inline bool parseNumber(const char*& p, const char* end, unsigned long& value)
+{
+  const char* start = p;
+
+  for(value=0; p < end && *p >= '0' && *p <= '9'; p++)
+    value = value*10 + (*p - '0');
+
+  return p != start;
+}
+
+// parses the time of day of a record line, returns false for other lines
+static bool parseTime(const char* p, const char* end, unsigned long long& time)
+{
+  unsigned long hour, min, sec, usec;
+
+  skipEscapes(p, end);
+  if(p >= end || *p++ != '[')
+    return false;
+
+  if(parseNumber(p, end, hour) == false || p >= end || *p++ != ':' ||
+     parseNumber(p, end, min) == false || p >= end || *p++ != ':' ||
+     parseNumber(p, end, sec) == false || p >= end || *p++ != '.')
+  {
+    return false;
+  }
+
+  const char* digits = p;
+  if(parseNumber(p, end, usec) == false || p-digits != 6 || p >= end || *p != ']')
+    return false;
+
+  time = ((hour*60 + min)*60 + sec)*MICROSEC + usec;
+
+  return true;
+}
+
+// days since the epoch of a civil date
+static unsigned long long daysFromCivil(int y, const unsigned int m, const unsigned int d)
+{
+  y -= m <= 2;
+  const int era = (y >= 0 ? y : y-399) / 400;
+  const unsigned int yoe = (unsigned int)(y - era*400);
+  const unsigned int doy = (153*(m > 2 ? m-3 : m+9) + 2)/5 + d-1;
+  const unsigned int doe = yoe*365 + yoe/4 - yoe/100 + doy;
+
+  return (unsigned long long)(era*146097LL + doe - 719468LL);
+}
+
+static inline const char* lineEnd(const char* p, const char* end)
+{
+  const char* nl = (const char*)memchr(p, '\n', end-p);
+  return nl != NULL ? nl+1 : end;
+}
+
+// reads the date of the header line of a per-thread file
+static bool readHeader(Input& in, const bool showHeader)
+{
+  const char* end = in.data + in.size;
+  if(in.size < strlen(HEADER) || strncmp(in.data, HEADER, strlen(HEADER)) != 0)
+    return false;
+
+  const char* eol = lineEnd(in.data, end);
+  const char* started = (const char*)memmem(in.data, eol-in.data, " started ", 9);
+
+  int year;
+  unsigned int month, day;
+  if(started == NULL || sscanf(started+9, "%d-%u-%u", &year, &month, &day) != 3)
+    return false;
+
+  in.day = daysFromCivil(year, month, day);
+  in.pos = eol;
+
+  if(showHeader == true)
+    fwrite(in.data, 1, eol-in.data, stdout);
+
+  return true;
+}
+
+// reads the next record of an input including its continuation lines
+static bool nextRecord(Input& in)
+{
+  const char* end = in.data + in.size;
+  if(in.pos >= end)
+    return false;
+
+  // text before the first record is output right away
+  unsigned long long tod;
+  in.start = in.pos;
+  if(parseTime(in.pos, end, tod) == false)
+    in.time = 0;
+  else
+  {
+    // the time of day jumped back by more than 12 hours, so
+    // the next day has begun
+    if(tod + DAY/2 < in.lastTime)
+      in.day++;
+
+    in.lastTime = tod;
+    in.time = in.day*DAY + tod;
+  }
+
+  unsigned long long next;
+  for(in.end = lineEnd(in.pos, end); in.end < end; in.end = lineEnd(in.end, end))
+  {
+    if(parseTime(in.end, end, next) == true)
+      break;
+  }
+
+  in.pos = in.end;
+
+  return true;
+}
+
+static bool mapFile(const char* filename, Input& in)
+{
+  memset(&in, 0, sizeof(in));
+
+  int fd = open(filename, O_RDONLY);
+  if(fd < 0)
+  {
+    fprintf(stderr, "couldn't open '%s'\n", filename);
+    return false;
+  }
+
+  struct stat st;
+  if(fstat(fd, &st) != 0 || st.st_size == 0)
+  {
+    close(fd);
+    return st.st_size == 0;
+  }
+
+  void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if(data == MAP_FAILED)
+  {
+    fprintf(stderr, "couldn't map '%s'\n", filename);
+    return false;
+  }
+
+  madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+  in.data = (const char*)data;
+  in.size = st.st_size;
+  in.pos = in.data;
+
+  return true;
+}
+
+int main(int argc, char* argv[])
+{
+  bool showHeader = false;
+  int opt;
+
+  while((opt = getopt(argc, argv, "H")) != -1)
+  {
+    switch(opt)
+    {
+      case 'H': showHeader = true; break;
+      default:  usage(argv[0]);
+    }
+  }
+
+  if(optind >= argc)
+    usage(argv[0]);
+
+  int result = EXIT_SUCCESS;
+  std::vector<Input> inputs;
+  for(int i=optind; i < argc; i++)
+  {
+    Input in;
+    if(mapFile(argv[i], in) == false)
+      result = EXIT_FAILURE;
+    else if(in.data != NULL)
+    {
+      in.dated = readHeader(in, showHeader);
+      inputs.push_back(in);
+    }
+  }
+
+  // files without a header start at the earliest date of all files
+  unsigned long long firstDay = ~0ULL;
+  for(size_t i=0; i < inputs.size(); i++)
+  {
+    if(inputs[i].dated == true && inputs[i].day < firstDay)
+      firstDay = inputs[i].day;
+  }
+
+  for(size_t i=0; i < inputs.size(); i++)
+  {
+    if(inputs[i].dated == false && firstDay != ~0ULL)
+      inputs[i].day = firstDay;
+  }
+
+  // k-way merge of the records of all files
+  std::priority_queue<size_t, std::vector<size_t>, Later> queue((Later(inputs)));
+  for(size_t i=0; i < inputs.size(); i++)
+  {
+    if(nextRecord(inputs[i]) == true)
+      queue.push(i);
+  }
+
+  while(queue.empty() == false)
+  {
+    size_t i = queue.top();
+    queue.pop();
+
+    Input& in = inputs[i];
+    fwrite(in.start, 1, in.end-in.start, stdout);
+
+    if(nextRecord(in) == true)
+      queue.push(i);
+  }
+
+  for(size_t i=0; i < inputs.size(); i++)
+    munmap((void*)inputs[i].data, inputs[i].size);
+
+  return result;
+}
@@ -0,0 +1,968 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+/*
+ * rtdebug-query - filters, slices and summarizes (large) trace files
+ *
+ * Usage: rtdebug-query [-s] [-j jobs] [-n top] [-f from] [-t to] [-p pid]
+ *                      [-T tid] [-S span] [-c class] [-F file] [-e regex] file...
+ *
+ *   -s        output a summary instead of the matching records
+ *   -j jobs   number of worker threads (default: number of cores)
+ *   -n top    number of entries per summary table (default: 10)
+ *   -f from   skip all records before this time of day (HH:MM:SS[.usec])
+ *   -t to     skip all records after this time of day
+ *   -p pid    only records of this process
+ *   -T tid    only records of this rtdebug thread ID
+ *   -S span   only records stamped with this (hexadecimal) span ID
+ *   -c class  only records of this class (ctrace, report, assert, timeval,
+ *             debug, error or warning)
+ *   -F file   only records of source files matching this fnmatch() pattern
+ *   -e regex  only records whose message matches this extended regex
+ *
+ * Plain trace files are memory-mapped and split into chunks at line
+ * boundaries, block compressed files are split into their blocks (skipping
+ * all blocks outside of the time window or without the thread). The chunks
+ * are processed in parallel and their results are merged in file order.
+ *
+ * Records are expected in the default layout "[HH:MM:SS.usec] PID.TID: ..."
+ * (optionally followed by the span "#ID") with or without ANSI highlighting. As the plain text contains no debug
+ * class, it is derived from the highlighting color (ERROR and ASSERT are
+ * told apart by the "failed assertion" message) or, without highlighting,
+ * only ENTER()/LEAVE()/RETURN() records are recognized as "ctrace". The
+ * debug module is not part of the records, so use -F to select by source.
+ *
+ * The summary rebuilds the per-thread nesting of the ENTER()/LEAVE() records
+ * (also across chunk boundaries) and reports the record counts per thread and
+ * source file, the functions with the highest total time and the longest
+ * single calls. It also pairs the FLOW_SEND()/FLOW_RECV() records of every
+ * span and reports the handoffs between threads with the highest queueing
+ * latency. The class and message filters only select the records to count,
+ * while the calls and handoffs are taken from all records of the selected
+ * threads, spans and time window.
+ */
+
+#include "CRTDebugBlockFile.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <regex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// the classes derivable from a record
+enum { CLS_UNKNOWN=-1, CLS_CTRACE, CLS_REPORT, CLS_ASSERT, CLS_TIMEVAL, CLS_DEBUG, CLS_ERROR, CLS_WARNING };
+static const char* classNames[] = { "ctrace", "report", "assert", "timeval", "debug", "error", "warning" };
+
+#define MICROSEC        1000000ULL
+#define CHUNK_MINSIZE   (1024*1024)
+
+//! the filter options
+struct Query
+{
+  unsigned long long  from;
+  unsigned long long  to;
+  long                pid;
+  long                tid;
+  unsigned long long  span;
+  int                 cls;
+  const char*         file;
+  regex_t*            regex;
+  bool                summary;
+  size_t              top;
+};
+
+//! a parsed record, all strings point into the trace data
+struct Record
+{
+  unsigned long long  time;     // microseconds of the day
+  unsigned long       pid;
+  unsigned long       tid;
+  unsigned long long  span;
+  int                 cls;
+  std::string         file;
+  long                line;
+  const char*         msg;
+  size_t              msgLen;
+};
+
+//! a call which was entered but not yet left (or vice versa)
+struct Call
+{
+  std::string         function;
+  unsigned long long  time;
+};
+
+//! a completed call
+struct Duration
+{
+  std::string         function;
+  unsigned long long  start;
+  unsigned long long  usec;
+  unsigned long long  thread;
+};
+
+//! a FLOW_SEND() or FLOW_RECV() record
+struct Flow
+{
+  unsigned long long  span;
+  unsigned long long  time;
+  unsigned long long  thread;
+  bool                receive;
+};
+
+//! a handoff of a span from one thread to another
+struct Handoff
+{
+  unsigned long long  span;
+  unsigned long long  start;
+  unsigned long long  usec;
+  unsigned long long  from;
+  unsigned long long  to;
+};
+
+//! the statistics of a function
+struct FunctionStats
+{
+  unsigned long long  calls;
+  unsigned long long  total;
+  unsigned long long  max;
+};
+
+//! the calls of a thread which could not be matched within a chunk
+struct PendingCalls
+{
+  std::vector<Call>   leaves; // left calls entered before the chunk
+  std::vector<Call>   open;   // calls still open at the end of the chunk
+};
+
+//! the results of a chunk
+struct Chunk
+{
+  const char*                                   begin;
+  const char*                                   end;
+  size_t                                        block;    // block of a block compressed file
+  std::string                                   data;     // decompressed block
+  std::string                                   output;   // the matching records
+  std::string                                   leading;  // continuation lines before the first record
+  bool                                          lastMatched;
+  unsigned long long                            records;
+  unsigned long long                            matched;
+  std::map<unsigned long long, PendingCalls>    pending;
+  std::map<unsigned long long, unsigned long long> threads;
+  std::map<std::string, unsigned long long>     files;
+  std::map<std::string, FunctionStats>          functions;
+  std::vector<Duration>                         longest;
+  std::vector<Flow>                             flows;
+};
+
+static void usage(const char* name)
+{
+  fprintf(stderr, "Usage: %s [-s] [-j jobs] [-n top] [-f from] [-t to] [-p pid] [-T tid] [-S span] [-c class] [-F file] [-e regex] file...\n", name);
+  exit(EXIT_FAILURE);
+}
+
+// converts a time of day (HH:MM:SS[.usec]) to microseconds
+static unsigned long long parseTimeOfDay(const char* spec)
+{
+  int hour = 0, min = 0;
+  double sec = 0;
+
+  if(sscanf(spec, "%d:%d:%lf", &hour, &min, &sec) < 2)
+    return ~0ULL;
+
+  return (hour*3600ULL + min*60ULL)*MICROSEC + (unsigned long long)(sec*MICROSEC + 0.5);
+}
+
+static void formatTimeOfDay(char* buf, const size_t len, const unsigned long long time)
+{
+  unsigned long long sec = time / MICROSEC;
+  snprintf(buf, len, "%02llu:%02llu:%02llu.%06llu", sec/3600, (sec/60)%60, sec%60, time%MICROSEC);
+}
+
+static inline unsigned long long threadKey(const unsigned long pid, const unsigned long tid)
+{
+  return ((unsigned long long)pid << 32) | tid;
+}
+
+// skips ANSI escape sequences and remembers the last color set as
+// attribute*100 + color (e.g. 133 for bold yellow)
+static inline void skipEscapes(const char*& p, const char* end, int& color)
+{
+  while(p+1 < end && p[0] == '\x1b' && p[1] == '[')
+  {
+    int attribute = 0;
+    int code = 0;
+    for(p += 2; p < end && *p != 'm'; p++)
+    {
+      if(*p == ';')
+      {
+        attribute = code;
+        code = 0;
+      }
+      else
+        code = code*10 + (*p - '0');
+    }
+
+    color = attribute*100 + code;
+    if(p < end)
+      p++;
+  }
+}
+
+static inline bool parseNumber(const char*& p, const char* end, unsigned long& value)
+{
+  const char* start = p;
+
+  for(value=0; p < end && *p >= '0' && *p <= '9'; p++)
+    value = value*10 + (*p - '0');
+
+  return p != start;
+}
+
+// parses a record line, returns false for continuation lines
+static bool parseRecord(const char* p, const char* end, Record& rec)
+{
+  int color = -1;
+  unsigned long hour, min, sec, usec, value;
+
+  skipEscapes(p, end, color);
+  if(p >= end || *p++ != '[')
+    return false;
+
+  if(parseNumber(p, end, hour) == false || p >= end || *p++ != ':' ||
+     parseNumber(p, end, min) == false || p >= end || *p++ != ':' ||
+     parseNumber(p, end, sec) == false || p >= end || *p++ != '.')
+  {
+    return false;
+  }
+
+  const char* digits = p;
+  if(parseNumber(p, end, usec) == false || p-digits != 6 || p+1 >= end || *p++ != ']' || *p++ != ' ')
+    return false;
+
+  rec.time = ((hour*60 + min)*60 + sec)*MICROSEC + usec;
+
+  skipEscapes(p, end, color);
+  while(p < end && *p == ' ')
+    p++;
+
+  if(parseNumber(p, end, rec.pid) == false)
+    return false;
+
+  rec.tid = 0;
+  if(p < end && *p == '.')
+  {
+    p++;
+    skipEscapes(p, end, color);
+    if(parseNumber(p, end, rec.tid) == false)
+      return false;
+  }
+
+  skipEscapes(p, end, color);
+  if(p+1 >= end || *p++ != ':' || *p++ != ' ')
+    return false;
+
+  // the optional span attached to the thread
+  rec.span = 0;
+  if(p < end && *p == '#')
+  {
+    char* hexEnd;
+    rec.span = strtoull(p+1, &hexEnd, 16);
+    if(hexEnd >= end || *hexEnd != ' ')
+      return false;
+    p = hexEnd+1;
+  }
+
+  // the indention is followed by the color of the record class
+  color = -1;
+  while(p < end && *p == ' ')
+    p++;
+  skipEscapes(p, end, color);
+
+  const char* file = p;
+  while(p < end && *p != ':')
+    p++;
+  rec.file.assign(file, p-file);
+
+  if(p >= end)
+    return false;
+  p++;
+
+  if(parseNumber(p, end, value) == false || p >= end || *p++ != ':')
+    return false;
+  rec.line = value;
+
+  // strip the trailing color reset
+  rec.msg = p;
+  while(end-4 >= p && end[-1] == 'm' && end[-2] == '0' && end[-3] == '[' && end[-4] == '\x1b')
+    end -= 4;
+  rec.msgLen = end-p;
+
+  bool ctrace = (rec.msgLen > 9 && strncmp(rec.msg, "Entering ", 9) == 0) ||
+                (rec.msgLen > 8 && strncmp(rec.msg, "Leaving ", 8) == 0);
+
+  switch(color)
+  {
+    case 33:  rec.cls = CLS_CTRACE; break;
+    case 35:  rec.cls = CLS_REPORT; break;
+    case 34:  rec.cls = CLS_TIMEVAL; break;
+    case 32:  rec.cls = CLS_DEBUG; break;
+    case 133: rec.cls = CLS_WARNING; break;
+    case 31:  rec.cls = (rec.msgLen > 16 && strncmp(rec.msg, "failed assertion", 16) == 0) ? CLS_ASSERT : CLS_ERROR; break;
+    default:  rec.cls = ctrace ? CLS_CTRACE : CLS_UNKNOWN; break;
+  }
+
+  return true;
+}
+
+// extracts the function name of an ENTER()/LEAVE() record
+static bool parseCall(const Record& rec, bool& enter, std::string& function)
+{
+  size_t skip;
+
+  if(rec.msgLen > 9 && strncmp(rec.msg, "Entering ", 9) == 0)
+  {
+    enter = true;
+    skip = 9;
+  }
+  else if(rec.msgLen > 8 && strncmp(rec.msg, "Leaving ", 8) == 0)
+  {
+    enter = false;
+    skip = 8;
+  }
+  else
+    return false;
+
+  const char* name = rec.msg + skip;
+  const char* paren = (const char*)memmem(name, rec.msgLen - skip, "()", 2);
+  if(paren == NULL)
+    return false;
+
+  function.assign(name, paren-name);
+
+  return true;
+}
+
+// extracts the span of a FLOW_SEND()/FLOW_RECV() record
+static bool parseFlow(const Record& rec, bool& receive, unsigned long long& span)
+{
+  if(rec.msgLen <= 9 || (strncmp(rec.msg, "-> flow #", 9) != 0 && strncmp(rec.msg, "<- flow #", 9) != 0))
+    return false;
+
+  receive = rec.msg[0] == '<';
+  span = 0;
+  for(size_t i=9; i < rec.msgLen && isxdigit(rec.msg[i]); i++)
+    span = span*16 + (isdigit(rec.msg[i]) ? rec.msg[i]-'0' : (tolower(rec.msg[i])-'a'+10));
+
+  return span != 0;
+}
+
+static void addDuration(Chunk& chunk, const Query& query, const Duration& call)
+{
+  FunctionStats& stats = chunk.functions[call.function];
+  stats.calls++;
+  stats.total += call.usec;
+  stats.max = std::max(stats.max, call.usec);
+
+  chunk.longest.push_back(call);
+
+  // only keep the longest calls
+  if(chunk.longest.size() >= query.top*4)
+  {
+    std::nth_element(chunk.longest.begin(), chunk.longest.begin()+query.top, chunk.longest.end(),
+                     [](const Duration& a, const Duration& b) { return a.usec > b.usec; });
+    chunk.longest.resize(query.top);
+  }
+}
+
+// checks if a record belongs to the selected span, also the FLOW_SEND()
+// record of the producer of the span is part of it
+static inline bool selectedSpan(const Query& query, const Record& rec)
+{
+  bool receive;
+  unsigned long long span;
+
+  return query.span == 0 || query.span == rec.span ||
+         (parseFlow(rec, receive, span) == true && span == query.span);
+}
+
+// checks if a record belongs to the selected threads, spans, time and sources
+static inline bool selected(const Query& query, const Record& rec)
+{
+  return rec.time >= query.from && rec.time <= query.to &&
+         (query.pid < 0 || (unsigned long)query.pid == rec.pid) &&
+         (query.tid < 0 || (unsigned long)query.tid == rec.tid) &&
+         selectedSpan(query, rec) == true &&
+         (query.file == NULL || fnmatch(query.file, rec.file.c_str(), 0) == 0);
+}
+
+// processes all lines of a chunk
+static void processChunk(Chunk& chunk, const Query& query)
+{
+  Record rec;
+  std::string function;
+  std::string message;
+  bool first = true;
+  bool matched = false;
+
+  chunk.lastMatched = false;
+  chunk.records = 0;
+  chunk.matched = 0;
+
+  for(const char* p = chunk.begin; p < chunk.end;)
+  {
+    const char* eol = (const char*)memchr(p, '\n', chunk.end-p);
+    const char* next = eol != NULL ? eol+1 : chunk.end;
+    const char* end = eol != NULL ? eol : chunk.end;
+
+    if(parseRecord(p, end, rec) == false)
+    {
+      // continuation lines belong to the previous record
+      if(first == true)
+        chunk.leading.append(p, next-p);
+      else if(matched == true && query.summary == false)
+        chunk.output.append(p, next-p);
+
+      p = next;
+      continue;
+    }
+
+    first = false;
+    chunk.records++;
+
+    bool sel = selected(query, rec);
+    matched = sel &&
+              (query.cls == CLS_UNKNOWN || query.cls == rec.cls) &&
+              (query.regex == NULL || (message.assign(rec.msg, rec.msgLen), regexec(query.regex, message.c_str(), 0, NULL, 0) == 0));
+
+    if(matched == true)
+    {
+      chunk.matched++;
+
+      if(query.summary == true)
+      {
+        chunk.threads[threadKey(rec.pid, rec.tid)]++;
+        chunk.files[rec.file]++;
+      }
+      else
+        chunk.output.append(p, next-p);
+    }
+
+    // rebuild the nesting of the calls
+    bool enter;
+    if(query.summary == true && sel == true && parseCall(rec, enter, function) == true)
+    {
+      unsigned long long key = threadKey(rec.pid, rec.tid);
+      PendingCalls& pending = chunk.pending[key];
+
+      if(enter == true)
+      {
+        Call call = { function, rec.time };
+        pending.open.push_back(call);
+      }
+      else if(pending.open.empty() == true)
+      {
+        Call call = { function, rec.time };
+        pending.leaves.push_back(call);
+      }
+      else
+      {
+        // calls without a LEAVE() are skipped
+        size_t i = pending.open.size();
+        while(i > 0 && pending.open[i-1].function != function)
+          i--;
+
+        if(i > 0)
+        {
+          Duration call = { function, pending.open[i-1].time, rec.time - pending.open[i-1].time, key };
+          addDuration(chunk, query, call);
+          pending.open.resize(i-1);
+        }
+      }
+    }
+
+    // collect the handoffs of the spans
+    unsigned long long span;
+    if(query.summary == true && sel == true && parseFlow(rec, enter, span) == true)
+    {
+      Flow flow = { span, rec.time, threadKey(rec.pid, rec.tid), enter };
+      chunk.flows.push_back(flow);
+    }
+
+    p = next;
+  }
+
+  chunk.lastMatched = matched;
+}
+
+// splits a plain trace file into chunks at line boundaries
+static void splitChunks(const char* data, const size_t size, const size_t count, std::vector<Chunk>& chunks)
+{
+  size_t chunkSize = std::max((size_t)CHUNK_MINSIZE, size/count + 1);
+  const char* end = data + size;
+
+  for(const char* p = data; p < end;)
+  {
+    const char* e = p + std::min(chunkSize, (size_t)(end-p));
+    if(e < end)
+    {
+      const char* eol = (const char*)memchr(e, '\n', end-e);
+      e = eol != NULL ? eol+1 : end;
+    }
+
+    chunks.push_back(Chunk());
+    chunks.back().begin = p;
+    chunks.back().end = e;
+    p = e;
+  }
+}
+
+//! the merged results of all chunks
+struct Summary
+{
+  unsigned long long                                records;
+  unsigned long long                                matched;
+  std::map<unsigned long long, std::vector<Call> >  stacks;
+  std::map<unsigned long long, unsigned long long>  threads;
+  std::map<std::string, unsigned long long>         files;
+  std::map<std::string, FunctionStats>              functions;
+  std::vector<Duration>                             longest;
+  std::map<unsigned long long, Flow>                sends;
+  std::vector<Handoff>                              handoffs;
+  unsigned long long                                handoffCount;
+  unsigned long long                                handoffTotal;
+  bool                                              lastMatched;
+};
+
+// merges the results of a chunk in file order
+static void mergeChunk(Summary& summary, Chunk& chunk, const Query& query)
+{
+  if(summary.lastMatched == true && query.summary == false)
+    fwrite(chunk.leading.data(), 1, chunk.leading.size(), stdout);
+  fwrite(chunk.output.data(), 1, chunk.output.size(), stdout);
+
+  if(chunk.records > 0)
+    summary.lastMatched = chunk.lastMatched;
+
+  summary.records += chunk.records;
+  summary.matched += chunk.matched;
+
+  for(std::map<unsigned long long, unsigned long long>::iterator it = chunk.threads.begin(); it != chunk.threads.end(); ++it)
+    summary.threads[it->first] += it->second;
+
+  for(std::map<std::string, unsigned long long>::iterator it = chunk.files.begin(); it != chunk.files.end(); ++it)
+    summary.files[it->first] += it->second;
+
+  // calls left within this chunk but entered before
+  Chunk merged;
+  for(std::map<unsigned long long, PendingCalls>::iterator it = chunk.pending.begin(); it != chunk.pending.end(); ++it)
+  {
+    std::vector<Call>& stack = summary.stacks[it->first];
+
+    for(size_t l=0; l < it->second.leaves.size(); l++)
+    {
+      const Call& leave = it->second.leaves[l];
+
+      size_t i = stack.size();
+      while(i > 0 && stack[i-1].function != leave.function)
+        i--;
+
+      if(i > 0)
+      {
+        Duration call = { leave.function, stack[i-1].time, leave.time - stack[i-1].time, it->first };
+        addDuration(merged, query, call);
+        stack.resize(i-1);
+      }
+    }
+
+    stack.insert(stack.end(), it->second.open.begin(), it->second.open.end());
+  }
+
+  for(int c=0; c < 2; c++)
+  {
+    Chunk& from = c == 0 ? chunk : merged;
+
+    for(std::map<std::string, FunctionStats>::iterator it = from.functions.begin(); it != from.functions.end(); ++it)
+    {
+      FunctionStats& stats = summary.functions[it->first];
+      stats.calls += it->second.calls;
+      stats.total += it->second.total;
+      stats.max = std::max(stats.max, it->second.max);
+    }
+
+    summary.longest.insert(summary.longest.end(), from.longest.begin(), from.longest.end());
+  }
+
+  if(summary.longest.size() > query.top)
+  {
+    std::sort(summary.longest.begin(), summary.longest.end(),
+              [](const Duration& a, const Duration& b) { return a.usec > b.usec; });
+    summary.longest.resize(query.top);
+  }
+
+  // pair the flow records in file order, a span may be handed over
+  // several times
+  for(size_t i=0; i < chunk.flows.size(); i++)
+  {
+    const Flow& flow = chunk.flows[i];
+
+    if(flow.receive == false)
+    {
+      summary.sends[flow.span] = flow;
+      continue;
+    }
+
+    std::map<unsigned long long, Flow>::iterator send = summary.sends.find(flow.span);
+    if(send == summary.sends.end())
+      continue;
+
+    Handoff handoff = { flow.span, send->second.time, flow.time - send->second.time, send->second.thread, flow.thread };
+    summary.handoffs.push_back(handoff);
+    summary.handoffCount++;
+    summary.handoffTotal += handoff.usec;
+    summary.sends.erase(send);
+  }
+
+  if(summary.handoffs.size() >= query.top*4)
+  {
+    std::nth_element(summary.handoffs.begin(), summary.handoffs.begin()+query.top, summary.handoffs.end(),
+                     [](const Handoff& a, const Handoff& b) { return a.usec > b.usec; });
+    summary.handoffs.resize(query.top);
+  }
+
+  // free the memory of the chunk early
+  Chunk().output.swap(chunk.output);
+  std::string().swap(chunk.data);
+}
+
+// processes all chunks in parallel and merges them in order
+static void processChunks(std::vector<Chunk>& chunks, const Query& query, const unsigned int jobs,
+                          CRTDebugBlockReader* reader, const char* filename, Summary& summary)
+{
+  std::atomic<size_t> nextChunk(0);
+  std::vector<std::thread> workers;
+
+  for(unsigned int j=0; j < jobs && j < chunks.size(); j++)
+  {
+    workers.push_back(std::thread([&]()
+    {
+      // every worker needs its own reader of a block compressed file
+      CRTDebugBlockReader blocks;
+      if(reader != NULL && blocks.open(filename) == false)
+        return;
+
+      size_t i;
+      while((i = nextChunk.fetch_add(1)) < chunks.size())
+      {
+        Chunk& chunk = chunks[i];
+
+        if(reader != NULL)
+        {
+          if(blocks.readBlock(chunk.block, chunk.data) == false)
+          {
+            fprintf(stderr, "'%s' block %zu is corrupt\n", filename, chunk.block);
+            chunk.begin = chunk.end = NULL;
+          }
+          else
+          {
+            chunk.begin = chunk.data.data();
+            chunk.end = chunk.begin + chunk.data.size();
+          }
+        }
+
+        processChunk(chunk, query);
+      }
+    }));
+  }
+
+  for(size_t i=0; i < workers.size(); i++)
+    workers[i].join();
+
+  for(size_t i=0; i < chunks.size(); i++)
+    mergeChunk(summary, chunks[i], query);
+}
+
+static bool processFile(const char* filename, const Query& query, const unsigned int jobs, Summary& summary)
+{
+  std::vector<Chunk> chunks;
+
+  if(CRTDebugBlockReader::isBlockFile(filename) == true)
+  {
+    CRTDebugBlockReader reader;
+    if(reader.open(filename) == false)
+    {
+      fprintf(stderr, "'%s' is not a valid block compressed trace file\n", filename);
+      return false;
+    }
+
+    for(size_t b=0; b < reader.blocks(); b++)
+    {
+      const CRTDebugBlockInfo& info = reader.block(b);
+
+      // skip blocks outside of the time window (as time of day) or
+      // without the selected thread
+      struct tm tm_time;
+      time_t first = info.firstTime / MICROSEC;
+      time_t last = info.lastTime / MICROSEC;
+      localtime_r(&first, &tm_time);
+      unsigned long long firstTime = ((tm_time.tm_hour*60ULL + tm_time.tm_min)*60 + tm_time.tm_sec)*MICROSEC + info.firstTime%MICROSEC;
+      localtime_r(&last, &tm_time);
+      unsigned long long lastTime = ((tm_time.tm_hour*60ULL + tm_time.tm_min)*60 + tm_time.tm_sec)*MICROSEC + info.lastTime%MICROSEC;
+
+      if(firstTime <= lastTime && (lastTime < query.from || firstTime > query.to))
+        continue;
+
+      if(query.tid >= 0 && (info.threadMask & (1ULL << (query.tid % 64))) == 0)
+        continue;
+
+      chunks.push_back(Chunk());
+      chunks.back().block = b;
+    }
+
+    processChunks(chunks, query, jobs, &reader, filename, summary);
+
+    return true;
+  }
+
+  int fd = open(filename, O_RDONLY);
+  if(fd < 0)
+  {
+    fprintf(stderr, "couldn't open '%s'\n", filename);
+    return false;
+  }
+
+  struct stat st;
+  if(fstat(fd, &st) != 0 || st.st_size == 0)
+  {
+    close(fd);
+    return st.st_size == 0;
+  }
+
+  void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if(data == MAP_FAILED)
+  {
+    fprintf(stderr, "couldn't map '%s'\n", filename);
+    return false;
+  }
+
+  madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+  splitChunks((const char*)data, st.st_size, jobs*4, chunks);
+  processChunks(chunks, query, jobs, NULL, filename, summary);
+
+  munmap(data, st.st_size);
+
+  return true;
+}
+
+template<typename T> static bool byCount(const std::pair<T, unsigned long long>& a, const std::pair<T, unsigned long long>& b)
+{
+  return a.second > b.second;
+}
+
+static void printSummary(const Summary& summary, const Query& query)
+{
+  char time[32];
+
+  printf("records: %llu matching of %llu\n", summary.matched, summary.records);
+
+  std::vector<std::pair<unsigned long long, unsigned long long> > threads(summary.threads.begin(), summary.threads.end());
+  std::sort(threads.begin(), threads.end(), byCount<unsigned long long>);
+  if(threads.size() > query.top)
+    threads.resize(query.top);
+
+  printf("\nthreads by records:\n");
+  for(size_t i=0; i < threads.size(); i++)
+    printf("  %5llu.%02llu %12llu\n", threads[i].first >> 32, threads[i].first & 0xffffffffULL, threads[i].second);
+
+  std::vector<std::pair<std::string, unsigned long long> > files(summary.files.begin(), summary.files.end());
+  std::sort(files.begin(), files.end(), byCount<std::string>);
+  if(files.size() > query.top)
+    files.resize(query.top);
+
+  printf("\nfiles by records:\n");
+  for(size_t i=0; i < files.size(); i++)
+    printf("  %-40s %12llu\n", files[i].first.c_str(), files[i].second);
+
+  std::vector<std::pair<std::string, FunctionStats> > functions(summary.functions.begin(), summary.functions.end());
+  std::sort(functions.begin(), functions.end(),
+            [](const std::pair<std::string, FunctionStats>& a, const std::pair<std::string, FunctionStats>& b) { return a.second.total > b.second.total; });
+  if(functions.size() > query.top)
+    functions.resize(query.top);
+
+  printf("\nfunctions by total time:\n");
+  printf("  %-40s %10s %14s %12s %12s\n", "function", "calls", "total us", "avg us", "max us");
+  for(size_t i=0; i < functions.size(); i++)
+  {
+    const FunctionStats& stats = functions[i].second;
+    printf("  %-40s %10llu %14llu %12llu %12llu\n", functions[i].first.c_str(), stats.calls, stats.total, stats.total/stats.calls, stats.max);
+  }
+
+  // the chunks only cut their lists down to the top calls unordered
+  std::vector<Duration> longest(summary.longest);
+  std::sort(longest.begin(), longest.end(),
+            [](const Duration& a, const Duration& b) { return a.usec > b.usec; });
+  if(longest.size() > query.top)
+    longest.resize(query.top);
+
+  printf("\nlongest calls:\n");
+  for(size_t i=0; i < longest.size(); i++)
+  {
+    const Duration& call = longest[i];
+    formatTimeOfDay(time, sizeof(time), call.start);
+    printf("  %12llu us  %s  %5llu.%02llu  %s\n", call.usec, time, call.thread >> 32, call.thread & 0xffffffffULL, call.function.c_str());
+  }
+
+  // calls which were never left
+  unsigned long long open = 0;
+  for(std::map<unsigned long long, std::vector<Call> >::const_iterator it = summary.stacks.begin(); it != summary.stacks.end(); ++it)
+    open += it->second.size();
+
+  if(open > 0)
+    printf("\n%llu calls without LEAVE()\n", open);
+
+  if(summary.handoffCount == 0)
+    return;
+
+  std::vector<Handoff> handoffs(summary.handoffs);
+  std::sort(handoffs.begin(), handoffs.end(),
+            [](const Handoff& a, const Handoff& b) { return a.usec > b.usec; });
+  if(handoffs.size() > query.top)
+    handoffs.resize(query.top);
+
+  printf("\nhandoffs: %llu, avg %llu us\n", summary.handoffCount, summary.handoffTotal/summary.handoffCount);
+  printf("\nlongest handoffs:\n");
+  for(size_t i=0; i < handoffs.size(); i++)
+  {
+    const Handoff& handoff = handoffs[i];
+    formatTimeOfDay(time, sizeof(time), handoff.start);
+    printf("  %12llu us  %s  #%-8llx %5llu.%02llu -> %5llu.%02llu\n", handoff.usec, time, handoff.span,
+           handoff.from >> 32, handoff.from & 0xffffffffULL, handoff.to >> 32, handoff.to & 0xffffffffULL);
+  }
+
+  if(summary.sends.empty() == false)
+    printf("\n%zu handoffs without FLOW_RECV()\n", summary.sends.size());
+}
+
+int main(int argc, char* argv[])
+{
+  Query query;
+  regex_t regex;
+  unsigned int jobs = std::thread::hardware_concurrency();
+  int opt;
+
+  query.from = 0;
+  query.to = ~0ULL;
+  query.pid = -1;
+  query.tid = -1;
+  query.span = 0;
+  query.cls = CLS_UNKNOWN;
+  query.file = NULL;
+  query.regex = NULL;
+  query.summary = false;
+  query.top = 10;
+
+  while((opt = getopt(argc, argv, "sj:n:f:t:p:T:S:c:F:e:")) != -1)
+  {
+    switch(opt)
+    {
+      case 's': query.summary = true;               break;
+      case 'j': jobs = atoi(optarg);                break;
+      case 'n': query.top = atoi(optarg);           break;
+      case 'f': query.from = parseTimeOfDay(optarg); break;
+      case 't': query.to = parseTimeOfDay(optarg);  break;
+      case 'p': query.pid = atol(optarg);           break;
+      case 'T': query.tid = atol(optarg);           break;
+      case 'S': query.span = strtoull(optarg[0] == '#' ? optarg+1 : optarg, NULL, 16); break;
+      case 'F': query.file = optarg;                break;
+
+      case 'c':
+      {
+        for(int c=0; c < (int)(sizeof(classNames)/sizeof(classNames[0])); c++)
+        {
+          if(strcasecmp(optarg, classNames[c]) == 0)
+            query.cls = c;
+        }
+
+        if(query.cls == CLS_UNKNOWN)
+          usage(argv[0]);
+      }
+      break;
+
+      case 'e':
+      {
+        if(regcomp(&regex, optarg, REG_EXTENDED | REG_NOSUB) != 0)
+        {
+          fprintf(stderr, "%s: invalid regular expression '%s'\n", argv[0], optarg);
+          return EXIT_FAILURE;
+        }
+        query.regex = &regex;
+      }
+      break;
+
+      default:
+        usage(argv[0]);
+    }
+  }
+
+  if(optind >= argc || query.from == ~0ULL || query.top == 0)
+    usage(argv[0]);
+
+  if(jobs == 0)
+    jobs = 1;
+
+  Summary summary;
+  summary.records = 0;
+  summary.matched = 0;
+  summary.handoffCount = 0;
+  summary.handoffTotal = 0;
+  summary.lastMatched = false;
+
+  int result = EXIT_SUCCESS;
+  for(int i=optind; i < argc; i++)
+  {
+    if(processFile(argv[i], query, jobs, summary) == false)
+      result = EXIT_FAILURE;
+  }
+
+  if(query.summary == true)
+    printSummary(summary, query);
+
+  if(query.regex != NULL)
+    regfree(query.regex);
+
+  return result;
+}
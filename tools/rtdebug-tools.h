@@ -0,0 +1,56 @@
+/* vim:set ts=2 nowrap: ****************************************************
+
+ librtdebug - A C++ based thread-safe Runtime Debugging Library
+ Copyright (C) 2003-2019 Jens Maus <mail@jens-maus.de>
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+
+***************************************************************************/
+
+/*
+ * helper functions shared by the rtdebug tools
+ */
+
+#ifndef RTDEBUG_TOOLS_H
+#define RTDEBUG_TOOLS_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+
+// converts a time specification, either seconds since the epoch or a time
+// of day (HH:MM:SS[.usec]) on the day of the reference time, to
+// microseconds since the epoch
+static inline unsigned long long parseTime(const char* spec, const unsigned long long reference)
+{
+  int hour, min;
+  double sec;
+
+  if(sscanf(spec, "%d:%d:%lf", &hour, &min, &sec) == 3)
+  {
+    time_t ref = reference / 1000000ULL;
+    struct tm tm_time;
+    localtime_r(&ref, &tm_time);
+    tm_time.tm_hour = hour;
+    tm_time.tm_min = min;
+    tm_time.tm_sec = 0;
+
+    return mktime(&tm_time)*1000000ULL + (unsigned long long)(sec*1000000.0);
+  }
+
+  return (unsigned long long)(strtod(spec, NULL)*1000000.0);
+}
+
+#endif // RTDEBUG_TOOLS_H